@@ -0,0 +1,787 @@
+// Copyright (c) 2013 Austin T. Clements. All rights reserved.
+// Use of this source code is governed by an MIT license
+// that can be found in the LICENSE file.
+
+// Microbenchmarks for the hot paths of libelf++ and libdwarf++.
+//
+// Each benchmark runs a fixed amount of work over a binary several
+// times and reports one JSON object per line on stdout, so results
+// can be collected and compared across builds.
+
+#include "elf++.hh"
+#include "dwarf++.hh"
+
+#include <algorithm>
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <inttypes.h>
+#include <string.h>
+#include <unistd.h>
+
+using namespace std;
+
+/**
+ * The binary under test.  Benchmarks that measure cold access to
+ * the debug info get a freshly constructed dwarf for each
+ * repetition; the others share one.
+ */
+struct fixture
+{
+        string path;
+        elf::elf ef;
+        unique_ptr<dwarf::dwarf> dw;
+        size_t npcs;
+        unsigned seed;
+
+        // Sorted PCs for lookup benchmarks, covering both line
+        // table rows and arbitrary addresses in executable sections
+        vector<dwarf::taddr> pcs;
+
+        void fresh()
+        {
+                dw.reset(new dwarf::dwarf(dwarf::elf::create_loader(ef)));
+        }
+};
+
+struct benchmark
+{
+        const char *name;
+        const char *description;
+        // If true, reset the fixture's dwarf before each repetition
+        bool cold;
+        // Untimed preparation, run once before all repetitions
+        function<void(fixture &)> setup;
+        // The timed work.  Returns the number of items processed.
+        function<size_t(fixture &)> run;
+};
+
+//////////////////////////////////////////////////////////////////
+// Helpers
+//
+
+static int
+open_or_throw(const string &path)
+{
+        int fd = open(path.c_str(), O_RDONLY);
+        if (fd < 0)
+                throw runtime_error(path + ": " + strerror(errno));
+        return fd;
+}
+
+template<typename F>
+static void
+for_each_die(const dwarf::die &d, const F &f)
+{
+        f(d);
+        for (auto &child : d)
+                for_each_die(child, f);
+}
+
+template<typename F>
+static void
+for_each_die(const dwarf::dwarf &dw, const F &f)
+{
+        for (auto &cu : dw.compilation_units())
+                for_each_die(cu.root(), f);
+}
+
+static void
+make_pcs(fixture &fx)
+{
+        if (!fx.pcs.empty())
+                return;
+
+        // Half line table rows, half uniformly random addresses in
+        // executable sections
+        vector<dwarf::taddr> rows;
+        for (auto &cu : fx.dw->compilation_units()) {
+                try {
+                        for (auto &line : cu.get_line_table())
+                                rows.push_back(line.address);
+                } catch (dwarf::format_error &e) {
+                }
+        }
+        vector<pair<dwarf::taddr, dwarf::taddr> > text;
+        for (auto &sec : fx.ef.sections()) {
+                auto &hdr = sec.get_hdr();
+                if ((hdr.flags & elf::shf::execinstr) != elf::shf(0) && hdr.size)
+                        text.push_back({hdr.addr, hdr.size});
+        }
+
+        mt19937_64 rng(fx.seed);
+        for (size_t i = 0; i < fx.npcs; i++) {
+                if (i % 2 == 0 && !rows.empty()) {
+                        fx.pcs.push_back(rows[rng() % rows.size()]);
+                } else if (!text.empty()) {
+                        auto &t = text[rng() % text.size()];
+                        fx.pcs.push_back(t.first + rng() % t.second);
+                }
+        }
+        sort(fx.pcs.begin(), fx.pcs.end());
+}
+
+/**
+ * An expression context that satisfies every request with a
+ * plausible value, so expressions run to completion.
+ */
+class bench_expr_context : public dwarf::expr_context
+{
+public:
+        dwarf::taddr reg(unsigned regnum)
+        {
+                return 0x1000 + regnum * 8;
+        }
+
+        dwarf::taddr deref_size(dwarf::taddr address, unsigned size)
+        {
+                return address;
+        }
+
+        dwarf::taddr xderef_size(dwarf::taddr address, dwarf::taddr asid,
+                                 unsigned size)
+        {
+                return address;
+        }
+
+        dwarf::taddr form_tls_address(dwarf::taddr address)
+        {
+                return address;
+        }
+
+        dwarf::taddr call_frame_cfa()
+        {
+                return 0x8000;
+        }
+};
+
+/**
+ * Decode v according to its type without formatting it, and return
+ * something derived from it so the work can't be optimized away.
+ */
+static uint64_t
+decode(const dwarf::value &v)
+{
+        size_t size;
+        switch (v.get_type()) {
+        case dwarf::value::type::address:
+                return v.as_address();
+        case dwarf::value::type::block:
+                v.as_block(&size);
+                return size;
+        case dwarf::value::type::constant:
+        case dwarf::value::type::uconstant:
+                return v.as_uconstant();
+        case dwarf::value::type::sconstant:
+                return v.as_sconstant();
+        case dwarf::value::type::exprloc:
+                v.as_block(&size);
+                return size;
+        case dwarf::value::type::flag:
+                return v.as_flag();
+        case dwarf::value::type::line:
+        case dwarf::value::type::loclist:
+        case dwarf::value::type::mac:
+        case dwarf::value::type::rangelist:
+                return v.as_sec_offset();
+        case dwarf::value::type::reference:
+                return v.as_reference().get_section_offset();
+        case dwarf::value::type::string:
+                return strlen(v.as_cstr());
+        case dwarf::value::type::invalid:
+                break;
+        }
+        return 0;
+}
+
+//////////////////////////////////////////////////////////////////
+// Benchmarks
+//
+
+static size_t
+run_elf_open(fixture &fx)
+{
+        elf::elf ef(elf::create_mmap_loader(open_or_throw(fx.path)));
+        dwarf::dwarf dw(dwarf::elf::create_loader(ef));
+        return ef.sections().size();
+}
+
+static size_t
+run_cu_enum(fixture &fx)
+{
+        size_t n = 0;
+        for (auto &cu : fx.dw->compilation_units())
+                n += cu.root().tag != dwarf::DW_TAG(0);
+        return n;
+}
+
+static size_t
+run_die_walk(fixture &fx)
+{
+        size_t n = 0;
+        for_each_die(*fx.dw, [&](const dwarf::die &d) { n++; });
+        return n;
+}
+
+static size_t
+run_die_walk_stats(fixture &fx)
+{
+        // Like die_walk, but with statistics enabled, to measure
+        // their overhead
+        fx.dw->enable_stats();
+        size_t n = 0;
+        for_each_die(*fx.dw, [&](const dwarf::die &d) { n++; });
+        if (fx.dw->get_stats().dies_decoded < n)
+                throw runtime_error("statistics missed DIEs");
+        return n;
+}
+
+static size_t
+run_attr_decode(fixture &fx)
+{
+        size_t n = 0;
+        uint64_t sum = 0;
+        for_each_die(*fx.dw, [&](const dwarf::die &d) {
+                for (auto &attr : d.each_attribute()) {
+                        try {
+                                sum += decode(attr.second);
+                        } catch (dwarf::format_error &e) {
+                        } catch (out_of_range &e) {
+                        }
+                        n++;
+                }
+        });
+        asm volatile("" : : "r"(sum));
+        return n;
+}
+
+static size_t
+run_attr_vector(fixture &fx)
+{
+        // Like attr_decode, but through the vector die::attributes
+        size_t n = 0;
+        uint64_t sum = 0;
+        for_each_die(*fx.dw, [&](const dwarf::die &d) {
+                for (auto &attr : d.attributes()) {
+                        try {
+                                sum += decode(attr.second);
+                        } catch (dwarf::format_error &e) {
+                        } catch (out_of_range &e) {
+                        }
+                        n++;
+                }
+        });
+        asm volatile("" : : "r"(sum));
+        return n;
+}
+
+static size_t
+run_dump_tree(fixture &fx)
+{
+        // Everything examples/dump-tree does except the output
+        size_t n = 0, len = 0;
+        for_each_die(*fx.dw, [&](const dwarf::die &d) {
+                len += to_string(d.tag).size();
+                for (auto &attr : d.each_attribute()) {
+                        len += to_string(attr.first).size();
+                        len += to_string(attr.second).size();
+                }
+                n++;
+        });
+        asm volatile("" : : "r"(len));
+        return n;
+}
+
+static size_t
+run_refs(fixture &fx, dwarf::DW_FORM form)
+{
+        // Resolve every reference of the given form
+        size_t n = 0;
+        uint64_t sum = 0;
+        for_each_die(*fx.dw, [&](const dwarf::die &d) {
+                for (auto &attr : d.each_attribute()) {
+                        if (attr.second.get_form() != form)
+                                continue;
+                        try {
+                                sum += attr.second.as_reference().tag !=
+                                        dwarf::DW_TAG(0);
+                        } catch (dwarf::format_error &e) {
+                        }
+                        n++;
+                }
+        });
+        asm volatile("" : : "r"(sum));
+        return n;
+}
+
+static size_t
+run_line_iter(fixture &fx)
+{
+        size_t n = 0;
+        for (auto &cu : fx.dw->compilation_units())
+                for (auto &line : cu.get_line_table())
+                        n += line.line != ~0u;
+        return n;
+}
+
+static size_t
+run_line_paths(fixture &fx)
+{
+        // Resolve the path of every row, like a symbolizer would
+        size_t n = 0;
+        uint64_t sum = 0;
+        for (auto &cu : fx.dw->compilation_units()) {
+                for (auto &line : cu.get_line_table()) {
+                        sum += line.file->path_id();
+                        n++;
+                }
+        }
+        asm volatile("" : : "r"(sum));
+        return n;
+}
+
+static size_t
+run_line_find(fixture &fx, bool indexed)
+{
+        size_t found = 0;
+        for (auto pc : fx.pcs) {
+                const dwarf::compilation_unit *cu = fx.dw->find_cu(pc);
+                if (!cu)
+                        continue;
+                auto &lt = cu->get_line_table();
+                if (indexed)
+                        lt.use_address_index();
+                found += lt.find_address(pc) != lt.end();
+        }
+        asm volatile("" : : "r"(found));
+        return fx.pcs.size();
+}
+
+static size_t
+run_find_cu(fixture &fx)
+{
+        size_t found = 0;
+        for (auto pc : fx.pcs)
+                found += fx.dw->find_cu(pc) != nullptr;
+        asm volatile("" : : "r"(found));
+        return fx.pcs.size();
+}
+
+static size_t
+run_symbolize(fixture &fx)
+{
+        auto infos = fx.dw->symbolize(fx.pcs, 1);
+        return infos.size();
+}
+
+// Names of the named top-level types of each unit, and names that
+// no unit defines
+static vector<vector<string> > str_map_names;
+
+static void
+setup_str_map(fixture &fx)
+{
+        str_map_names.clear();
+        for (auto &cu : fx.dw->compilation_units()) {
+                str_map_names.emplace_back();
+                auto &names = str_map_names.back();
+                for (auto &d : cu.root()) {
+                        if (!d.has(dwarf::DW_AT::name))
+                                continue;
+                        try {
+                                names.push_back(at_name(d));
+                        } catch (dwarf::format_error &e) {
+                        }
+                }
+                names.push_back("__no_such_name__");
+        }
+}
+
+static size_t
+run_str_map(fixture &fx)
+{
+        size_t n = 0, found = 0;
+        auto &cus = fx.dw->compilation_units();
+        for (size_t i = 0; i < cus.size(); i++) {
+                auto map = dwarf::die_str_map::from_type_names(cus[i].root());
+                for (auto &name : str_map_names[i]) {
+                        found += map[name].valid();
+                        n++;
+                }
+        }
+        asm volatile("" : : "r"(found));
+        return n;
+}
+
+// The index file written by setup_index, removed at exit
+static struct index_temp
+{
+        string path;
+
+        ~index_temp()
+        {
+                if (!path.empty())
+                        unlink(path.c_str());
+        }
+} index_temp;
+
+static string
+index_key(fixture &fx)
+{
+        string key = fx.ef.get_build_id();
+        return key.empty() ? fx.path : key;
+}
+
+static void
+setup_index(fixture &fx)
+{
+        make_pcs(fx);
+        setup_str_map(fx);
+        if (index_temp.path.empty()) {
+                const char *dir = getenv("TMPDIR");
+                index_temp.path = string(dir ? dir : "/tmp") +
+                        "/libelfin-bench-" + to_string(getpid()) + ".dwarf-index";
+        }
+        fx.dw->save_index(index_temp.path, index_key(fx));
+}
+
+/**
+ * Look up every PC with find_cu and every name in str_map_names in
+ * the name index, optionally first loading both indexes from the
+ * file written by setup_index.
+ */
+static size_t
+run_index(fixture &fx, bool load)
+{
+        if (load && !fx.dw->load_index(index_temp.path, index_key(fx)))
+                throw runtime_error("index file did not match");
+        size_t found = 0, n = 0;
+        for (auto pc : fx.pcs)
+                found += fx.dw->find_cu(pc) != nullptr;
+        const dwarf::name_index &index = fx.dw->get_name_index();
+        for (auto &names : str_map_names) {
+                for (auto &name : names) {
+                        found += index.lookup(name).size();
+                        n++;
+                }
+        }
+        asm volatile("" : : "r"(found));
+        return fx.pcs.size() + n;
+}
+
+// The PC ranges of every DIE that has them, and addresses to probe
+// them with: each range's ends, its midpoint, and the address just
+// past it
+static vector<dwarf::rangelist> rangelists;
+static vector<dwarf::compact_rangelist> compact_rangelists;
+static vector<vector<dwarf::taddr> > range_probes;
+
+static void
+setup_rangelists(fixture &fx)
+{
+        rangelists.clear();
+        compact_rangelists.clear();
+        range_probes.clear();
+        for_each_die(*fx.dw, [&](const dwarf::die &d) {
+                if (!d.has(dwarf::DW_AT::ranges) && !d.has(dwarf::DW_AT::low_pc))
+                        return;
+                try {
+                        dwarf::rangelist rl = die_pc_range(d);
+                        vector<dwarf::taddr> probes;
+                        for (auto &ent : rl) {
+                                probes.push_back(ent.low);
+                                probes.push_back(ent.low + (ent.high - ent.low) / 2);
+                                probes.push_back(ent.high - 1);
+                                probes.push_back(ent.high);
+                        }
+                        compact_rangelists.emplace_back(rl);
+                        rangelists.push_back(move(rl));
+                        range_probes.push_back(move(probes));
+                } catch (dwarf::format_error &e) {
+                } catch (out_of_range &e) {
+                }
+        });
+}
+
+template<typename RL>
+static size_t
+run_contains(const vector<RL> &rls)
+{
+        size_t n = 0, found = 0;
+        for (size_t i = 0; i < rls.size(); i++) {
+                for (auto addr : range_probes[i])
+                        found += rls[i].contains(addr);
+                n += range_probes[i].size();
+        }
+        asm volatile("" : : "r"(found));
+        return n;
+}
+
+// Every DW_AT::location and DW_AT::frame_base expression
+static vector<dwarf::expr> exprs;
+
+static void
+setup_exprs(fixture &fx)
+{
+        exprs.clear();
+        for_each_die(*fx.dw, [&](const dwarf::die &d) {
+                for (auto attr : {dwarf::DW_AT::location, dwarf::DW_AT::frame_base}) {
+                        if (!d.has(attr))
+                                continue;
+                        dwarf::value v = d[attr];
+                        if (v.get_type() == dwarf::value::type::exprloc)
+                                exprs.push_back(v.as_exprloc());
+                }
+        });
+}
+
+static size_t
+run_expr_evaluate(fixture &fx)
+{
+        bench_expr_context ctx;
+        uint64_t sum = 0;
+        for (auto &e : exprs) {
+                try {
+                        sum += e.evaluate(&ctx).value;
+                } catch (runtime_error &err) {
+                        // Unsupported operations or malformed
+                        // expressions still count as evaluated
+                }
+        }
+        asm volatile("" : : "r"(sum));
+        return exprs.size();
+}
+
+// exprs, compiled
+static vector<dwarf::compiled_expr> compiled_exprs;
+
+static void
+setup_compiled_exprs(fixture &fx)
+{
+        setup_exprs(fx);
+        compiled_exprs.clear();
+        for (auto &e : exprs)
+                compiled_exprs.push_back(e.compile());
+}
+
+static size_t
+run_expr_compiled(fixture &fx)
+{
+        bench_expr_context ctx;
+        uint64_t sum = 0;
+        for (auto &e : compiled_exprs) {
+                try {
+                        sum += e.evaluate(&ctx).value;
+                } catch (runtime_error &err) {
+                        // As for run_expr_evaluate
+                }
+        }
+        asm volatile("" : : "r"(sum));
+        return compiled_exprs.size();
+}
+
+static const benchmark benchmarks[] = {
+        {"elf_open", "open the file and construct elf and dwarf",
+         false, nullptr, run_elf_open},
+        {"cu_enum", "enumerate units and read each root DIE",
+         true, nullptr, run_cu_enum},
+        {"die_walk", "visit every DIE", true, nullptr, run_die_walk},
+        {"die_walk_stats", "visit every DIE with statistics enabled",
+         true, nullptr, run_die_walk_stats},
+        {"attr_decode", "decode every attribute value", false, nullptr,
+         run_attr_decode},
+        {"attr_vector", "decode every attribute value from die::attributes",
+         false, nullptr, run_attr_vector},
+        {"dump_tree", "format every DIE and attribute like dump-tree",
+         false, nullptr, run_dump_tree},
+        {"type_refs", "resolve every type signature reference",
+         true, nullptr,
+         [](fixture &fx) { return run_refs(fx, dwarf::DW_FORM::ref_sig8); }},
+        {"addr_refs", "resolve every cross-unit reference",
+         false, nullptr,
+         [](fixture &fx) { return run_refs(fx, dwarf::DW_FORM::ref_addr); }},
+        {"line_iter", "iterate every line table row", true, nullptr,
+         run_line_iter},
+        {"line_paths", "iterate every line table row and get its file path",
+         true, nullptr, run_line_paths},
+        {"find_cu", "find the unit of each PC", false, make_pcs, run_find_cu},
+        {"line_find", "find_address of each PC, linear scan",
+         true, make_pcs,
+         [](fixture &fx) { return run_line_find(fx, false); }},
+        {"line_find_indexed", "find_address of each PC, address index",
+         true, make_pcs,
+         [](fixture &fx) { return run_line_find(fx, true); }},
+        {"symbolize", "symbolize every PC in one batch", true, make_pcs,
+         run_symbolize},
+        {"index_build", "build the unit address and name indexes and query them",
+         true, setup_index, [](fixture &fx) { return run_index(fx, false); }},
+        {"index_load", "load the same indexes from an index file and query them",
+         true, setup_index, [](fixture &fx) { return run_index(fx, true); }},
+        {"str_map", "build die_str_map for each unit and look up names",
+         false, setup_str_map, run_str_map},
+        {"rangelist_contains", "rangelist::contains on DIE ranges",
+         false, setup_rangelists,
+         [](fixture &fx) { return run_contains(rangelists); }},
+        {"compact_contains", "compact_rangelist::contains on DIE ranges",
+         false, setup_rangelists,
+         [](fixture &fx) { return run_contains(compact_rangelists); }},
+        {"expr_evaluate", "evaluate location and frame base expressions",
+         false, setup_exprs, run_expr_evaluate},
+        {"expr_compiled", "evaluate the same expressions precompiled",
+         false, setup_compiled_exprs, run_expr_compiled},
+};
+
+//////////////////////////////////////////////////////////////////
+// Driver
+//
+
+static string
+json_string(const string &s)
+{
+        string res = "\"";
+        for (char ch : s) {
+                if (ch == '"' || ch == '\\') {
+                        res += '\\';
+                        res += ch;
+                } else if ((unsigned char)ch < 0x20) {
+                        char buf[8];
+                        snprintf(buf, sizeof buf, "\\u%04x", ch);
+                        res += buf;
+                } else {
+                        res += ch;
+                }
+        }
+        return res + "\"";
+}
+
+// Where to write results
+static FILE *out = stdout;
+
+static void
+run_benchmark(const benchmark &b, fixture &fx, unsigned reps)
+{
+        vector<double> times;
+        size_t items = 0;
+        try {
+                fx.fresh();
+                if (b.setup)
+                        b.setup(fx);
+                for (unsigned rep = 0; rep < reps; rep++) {
+                        if (b.cold)
+                                fx.fresh();
+                        auto start = chrono::steady_clock::now();
+                        items = b.run(fx);
+                        auto end = chrono::steady_clock::now();
+                        times.push_back(chrono::duration<double, nano>(end - start).count());
+                }
+        } catch (exception &e) {
+                fprintf(out, "{\"benchmark\": %s, \"binary\": %s, \"error\": %s}\n",
+                        json_string(b.name).c_str(), json_string(fx.path).c_str(),
+                        json_string(e.what()).c_str());
+                fflush(out);
+                return;
+        }
+
+        sort(times.begin(), times.end());
+        double median = times[times.size() / 2];
+        fprintf(out, "{\"benchmark\": %s, \"binary\": %s, \"reps\": %u, "
+                "\"items\": %zu, \"ns_min\": %.0f, \"ns_median\": %.0f, "
+                "\"ns_per_item\": %.3f}\n",
+                json_string(b.name).c_str(), json_string(fx.path).c_str(),
+                reps, items, times.front(), median,
+                items ? median / items : 0.0);
+        fflush(out);
+}
+
+static void
+usage(const char *cmd)
+{
+        fprintf(stderr, "usage: %s [-r reps] [-n pcs] [-s seed] [-b benchmark,...]\n"
+                "           [-o output] elf-file...\n"
+                "       %s -l\n", cmd, cmd);
+        exit(2);
+}
+
+int
+main(int argc, char **argv)
+{
+        unsigned reps = 5, seed = 1;
+        size_t npcs = 20000;
+        vector<string> only;
+
+        int opt;
+        while ((opt = getopt(argc, argv, "r:n:s:b:o:l")) != -1) {
+                switch (opt) {
+                case 'r':
+                        reps = max(1, atoi(optarg));
+                        break;
+                case 'n':
+                        npcs = strtoull(optarg, nullptr, 0);
+                        break;
+                case 's':
+                        seed = strtoul(optarg, nullptr, 0);
+                        break;
+                case 'b': {
+                        string list(optarg);
+                        size_t pos = 0, comma;
+                        while ((comma = list.find(',', pos)) != string::npos) {
+                                only.push_back(list.substr(pos, comma - pos));
+                                pos = comma + 1;
+                        }
+                        only.push_back(list.substr(pos));
+                        break;
+                }
+                case 'o':
+                        out = fopen(optarg, "w");
+                        if (!out) {
+                                fprintf(stderr, "%s: %s\n", optarg, strerror(errno));
+                                return 1;
+                        }
+                        break;
+                case 'l':
+                        for (auto &b : benchmarks)
+                                printf("%-20s %s\n", b.name, b.description);
+                        return 0;
+                default:
+                        usage(argv[0]);
+                }
+        }
+        if (optind == argc)
+                usage(argv[0]);
+
+        for (auto &name : only) {
+                if (none_of(begin(benchmarks), end(benchmarks),
+                            [&](const benchmark &b) { return name == b.name; })) {
+                        fprintf(stderr, "unknown benchmark %s\n", name.c_str());
+                        return 2;
+                }
+        }
+
+        for (int i = optind; i < argc; i++) {
+                fixture fx;
+                fx.path = argv[i];
+                try {
+                        fx.ef = elf::elf(elf::create_mmap_loader(open_or_throw(fx.path)));
+                } catch (exception &e) {
+                        fprintf(stderr, "%s\n", e.what());
+                        return 1;
+                }
+                fx.npcs = npcs;
+                fx.seed = seed;
+
+                for (auto &b : benchmarks) {
+                        if (!only.empty() &&
+                            find(only.begin(), only.end(), b.name) == only.end())
+                                continue;
+                        run_benchmark(b, fx, reps);
+                }
+        }
+
+        return 0;
+}
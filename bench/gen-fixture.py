@@ -0,0 +1,224 @@
+# Copyright (c) 2013 Austin T. Clements. All rights reserved.
+# Use of this source code is governed by an MIT license
+# that can be found in the LICENSE file.
+
+# Generate a large synthetic C++ program and build it with debug info,
+# for use as a benchmark fixture.
+#
+# Every translation unit defines a few classes, a class template, and
+# functions with nested scopes, inlined calls, and local variables,
+# so the resulting DWARF has many units, a deep DIE tree, range
+# lists, location expressions, and large line tables.  Alternate units
+# are built with -ffunction-sections, which gives their compilation
+# unit DIEs range lists instead of a single low_pc/high_pc pair.
+#
+# GCC emits DW_AT_sibling for every DIE with children and Clang emits
+# none, so building the same fixture with both compilers covers both
+# cases of sibling traversal.
+
+import sys, os, subprocess, shutil, tempfile
+from concurrent.futures import ThreadPoolExecutor
+from optparse import OptionParser
+
+UNIT = '''\
+#include <stddef.h>
+
+namespace unit%(n)d {
+
+struct point
+{
+        long x, y;
+        point *next;
+};
+
+class shape
+{
+public:
+        virtual ~shape() { }
+        virtual long area(long scale) const = 0;
+};
+
+class box : public shape
+{
+        point corners[2];
+public:
+        box(long w, long h)
+        {
+                corners[0] = point{0, 0, nullptr};
+                corners[1] = point{w, h, &corners[0]};
+        }
+
+        long area(long scale) const
+        {
+                long w = corners[1].x - corners[0].x;
+                long h = corners[1].y - corners[0].y;
+                return w * h * scale;
+        }
+};
+
+enum class color { red, green, blue = %(n)d };
+
+template<typename T, int N>
+struct ring
+{
+        T items[N];
+        size_t head = 0;
+
+        void push(const T &v)
+        {
+                items[head++ %% N] = v;
+        }
+
+        T sum() const
+        {
+                T total = T();
+                for (int i = 0; i < N; i++)
+                        total += items[i];
+                return total;
+        }
+};
+
+static inline __attribute__((always_inline)) long
+mix(long a, long b)
+{
+        long t = a * %(mul)d + b;
+        return t ^ (t >> 7);
+}
+
+static long counter_%(n)d;
+
+__attribute__((noinline)) long
+walk(point *p, long limit)
+{
+        long steps = 0;
+        for (; p && steps < limit; p = p->next) {
+                long d = mix(p->x, p->y);
+                if (d & 1) {
+                        long odd = d * 3 + 1;
+                        counter_%(n)d += odd;
+                } else {
+                        long even = d / 2;
+                        counter_%(n)d -= even;
+                }
+                steps++;
+        }
+        return steps;
+}
+
+__attribute__((cold, noinline)) long
+fail(const char *msg, long code)
+{
+        long len = 0;
+        while (msg[len])
+                len++;
+        return len + code;
+}
+
+long
+entry(long seed)
+{
+        ring<long, %(ring)d> r;
+        ring<double, 4> rd;
+        box b(seed, seed + %(n)d);
+        point pts[3] = {{seed, 1, &pts[1]}, {2, seed, &pts[2]}, {3, 3, nullptr}};
+        for (long i = 0; i < seed %% 17; i++) {
+                r.push(mix(i, seed));
+                rd.push(i * 0.5);
+        }
+        long total = r.sum() + (long)rd.sum() + b.area(2) + walk(pts, 3);
+        if (total < 0)
+                return fail("negative", total);
+        shape *s = &b;
+        return total + s->area(1) + (long)color::blue;
+}
+
+}
+'''
+
+MAIN = '''\
+%(decls)s
+
+long (*const entries[])(long) = {
+%(entries)s
+};
+
+int
+main(int argc, char **argv)
+{
+        long total = 0;
+        for (auto f : entries)
+                total += f(argc);
+        return total == 42;
+}
+'''
+
+def run(cmd):
+    p = subprocess.run(cmd, stdout=subprocess.PIPE, stderr=subprocess.STDOUT,
+                       universal_newlines=True)
+    if p.returncode != 0:
+        sys.stderr.write(' '.join(cmd) + '\n' + p.stdout)
+        raise RuntimeError('command failed')
+
+def main():
+    parser = OptionParser(usage="%prog [options] output")
+    parser.add_option("-u", "--units", type="int", default=2000,
+                      help="number of translation units [default: %default]")
+    parser.add_option("-d", "--dwarf-version", type="int", default=4,
+                      help="DWARF version to emit [default: %default]")
+    parser.add_option("-O", "--optimize", default="1",
+                      help="optimization level [default: %default]")
+    parser.add_option("--cxx", default=os.environ.get("CXX", "c++"),
+                      help="C++ compiler [default: $CXX or c++]")
+    parser.add_option("-j", "--jobs", type="int", default=os.cpu_count(),
+                      help="parallel compiles [default: number of CPUs]")
+    parser.add_option("--keep", metavar="DIR",
+                      help="generate sources and objects in DIR and keep them")
+    (options, args) = parser.parse_args()
+    if len(args) != 1:
+        parser.error("expected one output file")
+    output = os.path.abspath(args[0])
+
+    if options.keep:
+        work = options.keep
+        os.makedirs(work, exist_ok=True)
+    else:
+        work = tempfile.mkdtemp(prefix="libelfin-fixture.")
+
+    try:
+        flags = ["-std=c++11", "-O" + options.optimize,
+                 "-g", "-gdwarf-%d" % options.dwarf_version]
+
+        def compile_unit(n):
+            src = os.path.join(work, "unit%d.cc" % n)
+            obj = os.path.join(work, "unit%d.o" % n)
+            with open(src, "w") as f:
+                f.write(UNIT % {"n": n, "mul": 2 * n + 1, "ring": 2 + n % 7})
+            extra = ["-ffunction-sections"] if n % 2 else []
+            run([options.cxx] + flags + extra + ["-c", src, "-o", obj])
+            return obj
+
+        with ThreadPoolExecutor(max_workers=max(1, options.jobs)) as pool:
+            objs = list(pool.map(compile_unit, range(options.units)))
+
+        src = os.path.join(work, "main.cc")
+        with open(src, "w") as f:
+            f.write(MAIN % {
+                "decls": "\n".join("namespace unit%d { long entry(long); }" % n
+                                   for n in range(options.units)),
+                "entries": "\n".join("        unit%d::entry," % n
+                                     for n in range(options.units))})
+        objs.append(os.path.join(work, "main.o"))
+        run([options.cxx] + flags + ["-c", src, "-o", objs[-1]])
+
+        # Link through a response file, since there may be more
+        # objects than fit on a command line
+        rsp = os.path.join(work, "objs.rsp")
+        with open(rsp, "w") as f:
+            f.write("\n".join(objs) + "\n")
+        run([options.cxx, "-o", output, "@" + rsp])
+    finally:
+        if not options.keep:
+            shutil.rmtree(work)
+
+if __name__ == "__main__":
+    main()
@@ -111,6 +111,7 @@ resolve_type(DW_AT name, DW_FORM form)
         case DW_FORM::strx2:
         case DW_FORM::strx3:
         case DW_FORM::strx4:
+        case DW_FORM::GNU_str_index:
                 return value::type::string;
 
         case DW_FORM::addrx:
@@ -118,6 +119,7 @@ resolve_type(DW_AT name, DW_FORM form)
         case DW_FORM::addrx2:
         case DW_FORM::addrx3:
         case DW_FORM::addrx4:
+        case DW_FORM::GNU_addr_index:
                 return value::type::address;
 
         case DW_FORM::implicit_const:
@@ -178,6 +180,68 @@ attribute_spec::attribute_spec(DW_AT name, DW_FORM form, int64_t implicit_const)
 {
 }
 
+/**
+ * Return the size of an attribute value of the given form, or -1 if
+ * the size depends on the value itself.
+ */
+static int
+fixed_form_size(DW_FORM form, format fmt, unsigned addr_size)
+{
+        // Section 7.5.4
+        switch (form) {
+        case DW_FORM::addr:
+                return addr_size;
+        case DW_FORM::sec_offset:
+        case DW_FORM::ref_addr:
+        case DW_FORM::strp:
+        case DW_FORM::line_strp:
+        case DW_FORM::strp_sup:
+                switch (fmt) {
+                case format::dwarf32:
+                        return 4;
+                case format::dwarf64:
+                        return 8;
+                case format::unknown:
+                        return -1;
+                }
+                return -1;
+        case DW_FORM::flag_present:
+        case DW_FORM::implicit_const:
+                return 0;
+        case DW_FORM::flag:
+        case DW_FORM::data1:
+        case DW_FORM::ref1:
+        case DW_FORM::strx1:
+        case DW_FORM::addrx1:
+                return 1;
+        case DW_FORM::data2:
+        case DW_FORM::ref2:
+        case DW_FORM::strx2:
+        case DW_FORM::addrx2:
+                return 2;
+        case DW_FORM::strx3:
+        case DW_FORM::addrx3:
+                return 3;
+        case DW_FORM::data4:
+        case DW_FORM::ref4:
+        case DW_FORM::ref_sup4:
+        case DW_FORM::strx4:
+        case DW_FORM::addrx4:
+                return 4;
+        case DW_FORM::data8:
+        case DW_FORM::ref_sig8:
+        case DW_FORM::ref_sup8:
+        case DW_FORM::ref8:
+                return 8;
+        case DW_FORM::data16:
+                return 16;
+        default:
+                // Variable-length, indirect, or unknown forms.  Unknown
+                // forms are diagnosed by skip_form when a DIE is read.
+                return -1;
+        }
+}
+
 bool
 abbrev_entry::read(cursor *cur)
 {
@@ -201,7 +265,50 @@ abbrev_entry::read(cursor *cur)
                 attributes.push_back(attribute_spec(name, form, implicit_const));
         }
         attributes.shrink_to_fit();
+        nfixed = 0;
+        fixed_size = false;
+        fixed_offsets.clear();
+        attr_slots.clear();
         return true;
 }
 
+void
+abbrev_entry::finalize(format fmt, unsigned addr_size)
+{
+        // Compute offsets of the leading run of fixed-size attributes
+        fixed_offsets.clear();
+        section_length off = 0;
+        for (nfixed = 0; nfixed < attributes.size(); ++nfixed) {
+                int size = fixed_form_size(attributes[nfixed].form,
+                                           fmt, addr_size);
+                if (size < 0)
+                        break;
+                fixed_offsets.push_back(off);
+                off += size;
+        }
+        fixed_size = (nfixed == attributes.size());
+        fixed_offsets.push_back(off);
+        fixed_offsets.shrink_to_fit();
+
+        // Build the attribute name lookup table.  If an attribute
+        // appears more than once (which is malformed), the first
+        // occurrence wins, as it would in a linear search.
+        attr_slots.clear();
+        if (attributes.empty())
+                return;
+        size_t nslots = 2;
+        while (nslots < attributes.size() * 2)
+                nslots *= 2;
+        attr_slots.assign(nslots, attr_slot{(DW_AT)0, -1});
+        size_t mask = nslots - 1;
+        for (size_t i = 0; i < attributes.size(); ++i) {
+                DW_AT name = attributes[i].name;
+                size_t h = hash_attr(name) & mask;
+                while (attr_slots[h].index >= 0 && attr_slots[h].name != name)
+                        h = (h + 1) & mask;
+                if (attr_slots[h].index < 0)
+                        attr_slots[h] = attr_slot{name, (int)i};
+        }
+}
+
 DWARFPP_END_NAMESPACE
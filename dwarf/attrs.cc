@@ -90,7 +90,28 @@ static uint64_t _at_udynamic(DW_AT attr, const die &d, expr_context *ctx, int de
 //
 
 AT_REFERENCE(sibling);
-// XXX location
+
+/**
+ * Evaluate the location description or location list v at pc.
+ * Returns an empty location if v has no location at pc.
+ */
+static expr_result
+evaluate_location(const value &v, expr_context *ctx, taddr pc,
+                  const std::initializer_list<taddr> &arguments)
+{
+        loclist ll = v.as_loclist();
+        const expr *loc = ll.find(pc);
+        if (!loc)
+                return {expr_result::type::empty, 0};
+        return loc->evaluate(ctx, arguments);
+}
+
+expr_result
+at_location(const die &d, expr_context *ctx, taddr pc)
+{
+        return evaluate_location(d[DW_AT::location], ctx, pc, {});
+}
+
 AT_STRING(name);
 AT_ENUM(ordering, DW_ORD);
 AT_UDYNAMIC(byte_size);
@@ -169,10 +190,8 @@ at_data_member_location(const die &d, expr_context *ctx, taddr base, taddr pc)
         case value::type::uconstant:
                 return {expr_result::type::address, base + v.as_uconstant()};
         case value::type::exprloc:
-                return v.as_exprloc().evaluate(ctx, base);
         case value::type::loclist:
-                // XXX
-                throw std::runtime_error("not implemented");
+                return evaluate_location(v, ctx, pc, {base});
         default:
                 throw format_error("DW_AT_data_member_location has unexpected type " +
                                    to_string(v.get_type()));
@@ -188,7 +207,12 @@ AT_FLAG(external);
 // 0x4X
 //
 
-// XXX frame_base
+expr_result
+at_frame_base(const die &d, expr_context *ctx, taddr pc)
+{
+        return evaluate_location(d[DW_AT::frame_base], ctx, pc, {});
+}
+
 die at_friend(const die &d)
 {
         return d[DW_AT::friend_].as_reference();
@@ -264,4 +288,16 @@ die_pc_range(const die &d)
         return rangelist({{low, high}});
 }
 
+compact_rangelist
+die_compact_pc_range(const die &d)
+{
+        if (d.has(DW_AT::ranges))
+                return compact_rangelist(at_ranges(d));
+        if (!d.has(DW_AT::low_pc))
+                return compact_rangelist();
+        taddr low = at_low_pc(d);
+        taddr high = d.has(DW_AT::high_pc) ? at_high_pc(d) : (low + 1);
+        return compact_rangelist({{low, high}});
+}
+
 DWARFPP_END_NAMESPACE
@@ -0,0 +1,883 @@
+// Copyright (c) 2013 Austin T. Clements. All rights reserved.
+// Use of this source code is governed by an MIT license
+// that can be found in the LICENSE file.
+
+#include "internal.hh"
+
+#include <algorithm>
+#include <mutex>
+#include <unordered_map>
+
+using namespace std;
+
+DWARFPP_BEGIN_NAMESPACE
+
+// Pointer encodings used by .eh_frame and .eh_frame_hdr (Linux
+// Standard Base Core Specification, section 10.5.1)
+namespace eh_pe {
+        enum : ubyte {
+                absptr   = 0x00,
+                uleb128  = 0x01,
+                udata2   = 0x02,
+                udata4   = 0x03,
+                udata8   = 0x04,
+                sleb128  = 0x09,
+                sdata2   = 0x0a,
+                sdata4   = 0x0b,
+                sdata8   = 0x0c,
+
+                pcrel    = 0x10,
+                textrel  = 0x20,
+                datarel  = 0x30,
+                funcrel  = 0x40,
+                aligned  = 0x50,
+
+                indirect = 0x80,
+                omit     = 0xff,
+        };
+}
+
+/**
+ * An .eh_frame or .debug_frame section.  The two share a format, but
+ * differ in how CIEs are identified and addresses are encoded.
+ */
+struct frame_section
+{
+        shared_ptr<section> sec;
+        bool eh;
+        // The address of sec in the target, for pcrel pointers
+        taddr addr;
+        // The base for datarel pointers
+        taddr data_base;
+};
+
+/**
+ * A decoded CIE.
+ */
+struct cie
+{
+        uint64_t code_align;
+        int64_t data_align;
+        unsigned ra_reg;
+        unsigned addr_size, segment_size;
+        // Encoding of addresses in FDEs (eh_pe::absptr for
+        // .debug_frame)
+        ubyte fde_enc;
+        // True if FDEs using this CIE have augmentation data
+        bool augmentation_data;
+        bool signal_frame;
+        // The rules after executing the initial instructions
+        cfi_row initial;
+};
+
+/**
+ * The header of a CIE or FDE.
+ */
+struct frame_entry
+{
+        // The offsets just past the CIE ID/pointer and just past the
+        // entry
+        section_offset body, end;
+        bool is_cie;
+        // For FDEs, the offset of the CIE
+        section_offset cie_offset;
+};
+
+/**
+ * Read the header of the entry at offset.  Returns false for a
+ * zero-length entry, which terminates .eh_frame.
+ */
+static bool
+read_frame_entry(const frame_section &fs, section_offset offset,
+                 frame_entry *out)
+{
+        cursor cur(fs.sec, offset);
+        uint64_t length = cur.fixed<uword>();
+        bool dwarf64 = false;
+        if (length == 0xffffffff) {
+                length = cur.fixed<uint64_t>();
+                dwarf64 = true;
+        } else if (length >= 0xfffffff0) {
+                throw format_error("initial length has reserved value");
+        }
+        if (length == 0) {
+                out->end = cur.get_section_offset();
+                return false;
+        }
+
+        section_offset id_pos = cur.get_section_offset();
+        if (length > fs.sec->size() - id_pos)
+                throw format_error("call frame entry exceeds section size");
+        out->end = id_pos + length;
+
+        uint64_t id = dwarf64 ? cur.fixed<uint64_t>() : cur.fixed<uword>();
+        if (fs.eh) {
+                // .eh_frame CIE pointers are relative to the pointer
+                out->is_cie = (id == 0);
+                if (!out->is_cie && id > id_pos)
+                        throw format_error("FDE CIE pointer out of range");
+                out->cie_offset = id_pos - id;
+        } else {
+                out->is_cie = (id == (dwarf64 ? ~(uint64_t)0 : 0xffffffff));
+                out->cie_offset = id;
+        }
+        out->body = cur.get_section_offset();
+        return true;
+}
+
+static uint64_t
+read_sized(cursor *cur, unsigned size)
+{
+        switch (size) {
+        case 1:
+                return cur->fixed<uint8_t>();
+        case 2:
+                return cur->fixed<uint16_t>();
+        case 4:
+                return cur->fixed<uint32_t>();
+        case 8:
+                return cur->fixed<uint64_t>();
+        }
+        throw format_error("address size " + std::to_string(size) + " not supported");
+}
+
+/**
+ * Read a pointer with the given eh_pe encoding.
+ */
+static taddr
+read_encoded(cursor *cur, ubyte enc, const frame_section &fs)
+{
+        if (enc == eh_pe::omit)
+                return 0;
+        if (enc & eh_pe::indirect)
+                throw format_error("indirect pointer encodings not supported");
+
+        taddr base;
+        switch (enc & 0x70) {
+        case eh_pe::absptr:
+                base = 0;
+                break;
+        case eh_pe::pcrel:
+                base = fs.addr + cur->get_section_offset();
+                break;
+        case eh_pe::datarel:
+                base = fs.data_base;
+                break;
+        case eh_pe::aligned: {
+                unsigned align = cur->sec->addr_size;
+                section_offset pos = cur->get_section_offset();
+                *cur += (align - pos % align) % align;
+                base = 0;
+                break;
+        }
+        default:
+                throw format_error("unsupported pointer encoding 0x" + to_hex(enc));
+        }
+
+        switch (enc & 0x0f) {
+        case eh_pe::absptr:
+                return base + cur->address();
+        case eh_pe::uleb128:
+                return base + cur->uleb128();
+        case eh_pe::udata2:
+                return base + cur->fixed<uint16_t>();
+        case eh_pe::udata4:
+                return base + cur->fixed<uint32_t>();
+        case eh_pe::udata8:
+                return base + cur->fixed<uint64_t>();
+        case eh_pe::sleb128:
+                return base + cur->sleb128();
+        case eh_pe::sdata2:
+                return base + cur->fixed<int16_t>();
+        case eh_pe::sdata4:
+                return base + cur->fixed<int32_t>();
+        case eh_pe::sdata8:
+                return base + cur->fixed<int64_t>();
+        }
+        throw format_error("unsupported pointer encoding 0x" + to_hex(enc));
+}
+
+/**
+ * Return the size of a fixed-size pointer encoding, or 0 if the
+ * encoding is variable-length.
+ */
+static unsigned
+encoded_size(ubyte enc)
+{
+        switch (enc & 0x0f) {
+        case eh_pe::udata2:
+        case eh_pe::sdata2:
+                return 2;
+        case eh_pe::udata4:
+        case eh_pe::sdata4:
+                return 4;
+        case eh_pe::udata8:
+        case eh_pe::sdata8:
+                return 8;
+        }
+        return 0;
+}
+
+//////////////////////////////////////////////////////////////////
+// Call frame instructions
+//
+
+/**
+ * An interpreter for call frame instructions (DWARF4 section 6.4.2).
+ */
+struct cfi_interp
+{
+        const frame_section &fs;
+        const cie &c;
+        expr_cache *exprs;
+
+        cfi_interp(const frame_section &fs, const cie &c, expr_cache *exprs)
+                : fs(fs), c(c), exprs(exprs) { }
+
+        static cfi_rule make_rule(cfi_rule::type kind, unsigned reg = 0,
+                                  int64_t offset = 0)
+        {
+                cfi_rule rule;
+                rule.kind = kind;
+                rule.reg = reg;
+                rule.offset = offset;
+                return rule;
+        }
+
+        cfi_rule make_expr_rule(cfi_rule::type kind, cursor *cur)
+        {
+                cfi_rule rule = make_rule(kind);
+                rule.expr_len = cur->uleb128();
+                rule.expr_offset = cur->get_section_offset();
+                rule.sec = fs.sec.get();
+                rule.exprs = exprs;
+                cur->ensure(rule.expr_len);
+                *cur += rule.expr_len;
+                return rule;
+        }
+
+        /**
+         * Execute the instructions in [begin, end) against row until
+         * the location would advance past pc.  In that case, set
+         * row->end to the new location and return true.  If the
+         * instructions run out first, return false.  initial gives
+         * the rules for DW_CFA_restore, or is nullptr while executing
+         * CIE initial instructions.
+         */
+        bool run(section_offset begin, section_offset end, taddr pc,
+                 cfi_row *row, const cfi_row *initial)
+        {
+                // Limit the cursor to the instructions, while keeping
+                // offsets relative to the real section for
+                // expression rules
+                const section &sec = *fs.sec;
+                section insns(sec.type, sec.begin, end, sec.ord, sec.fmt,
+                              c.addr_size);
+                cursor cur(&insns, begin);
+                vector<cfi_row> saved;
+
+                while (!cur.end()) {
+                        ubyte op = cur.fixed<ubyte>();
+                        ubyte operand = op & 0x3f;
+                        unsigned reg;
+                        taddr loc;
+
+                        switch ((DW_CFA)(op & 0xc0)) {
+                        case DW_CFA::advance_loc:
+                                loc = row->loc + operand * c.code_align;
+                                goto advance;
+                        case DW_CFA::offset:
+                                row->set_rule(operand, make_rule(
+                                        cfi_rule::type::offset, 0,
+                                        cur.uleb128() * c.data_align));
+                                continue;
+                        case DW_CFA::restore:
+                                reg = operand;
+                                goto restore;
+                        default:
+                                break;
+                        }
+
+                        switch ((DW_CFA)op) {
+                        case DW_CFA::nop:
+                                break;
+                        case DW_CFA::set_loc:
+                                if (fs.eh)
+                                        loc = read_encoded(&cur, c.fde_enc, fs);
+                                else
+                                        loc = cur.address();
+                                goto advance;
+                        case DW_CFA::advance_loc1:
+                                loc = row->loc + cur.fixed<uint8_t>() * c.code_align;
+                                goto advance;
+                        case DW_CFA::advance_loc2:
+                                loc = row->loc + cur.fixed<uint16_t>() * c.code_align;
+                                goto advance;
+                        case DW_CFA::advance_loc4:
+                                loc = row->loc + cur.fixed<uint32_t>() * c.code_align;
+                                goto advance;
+
+                        case DW_CFA::offset_extended:
+                                reg = cur.uleb128();
+                                row->set_rule(reg, make_rule(
+                                        cfi_rule::type::offset, 0,
+                                        cur.uleb128() * c.data_align));
+                                break;
+                        case DW_CFA::offset_extended_sf:
+                                reg = cur.uleb128();
+                                row->set_rule(reg, make_rule(
+                                        cfi_rule::type::offset, 0,
+                                        cur.sleb128() * c.data_align));
+                                break;
+                        case DW_CFA::GNU_negative_offset_extended:
+                                reg = cur.uleb128();
+                                row->set_rule(reg, make_rule(
+                                        cfi_rule::type::offset, 0,
+                                        -(int64_t)(cur.uleb128() * c.data_align)));
+                                break;
+                        case DW_CFA::val_offset:
+                                reg = cur.uleb128();
+                                row->set_rule(reg, make_rule(
+                                        cfi_rule::type::val_offset, 0,
+                                        cur.uleb128() * c.data_align));
+                                break;
+                        case DW_CFA::val_offset_sf:
+                                reg = cur.uleb128();
+                                row->set_rule(reg, make_rule(
+                                        cfi_rule::type::val_offset, 0,
+                                        cur.sleb128() * c.data_align));
+                                break;
+                        case DW_CFA::restore_extended:
+                                reg = cur.uleb128();
+                                goto restore;
+                        case DW_CFA::undefined:
+                                row->set_rule(cur.uleb128(), make_rule(
+                                        cfi_rule::type::undefined));
+                                break;
+                        case DW_CFA::same_value:
+                                row->set_rule(cur.uleb128(), make_rule(
+                                        cfi_rule::type::same_value));
+                                break;
+                        case DW_CFA::register_:
+                                reg = cur.uleb128();
+                                row->set_rule(reg, make_rule(
+                                        cfi_rule::type::reg, cur.uleb128()));
+                                break;
+                        case DW_CFA::expression:
+                                reg = cur.uleb128();
+                                row->set_rule(reg, make_expr_rule(
+                                        cfi_rule::type::expression, &cur));
+                                break;
+                        case DW_CFA::val_expression:
+                                reg = cur.uleb128();
+                                row->set_rule(reg, make_expr_rule(
+                                        cfi_rule::type::val_expression, &cur));
+                                break;
+
+                        case DW_CFA::remember_state:
+                                saved.push_back(*row);
+                                break;
+                        case DW_CFA::restore_state:
+                                // The CFA rule is part of the saved
+                                // state, but the location isn't
+                                if (saved.empty())
+                                        throw format_error("DW_CFA_restore_state without matching DW_CFA_remember_state");
+                                loc = row->loc;
+                                *row = saved.back();
+                                row->loc = loc;
+                                saved.pop_back();
+                                break;
+
+                        case DW_CFA::def_cfa:
+                                reg = cur.uleb128();
+                                row->cfa = make_rule(cfi_rule::type::reg, reg,
+                                                     cur.uleb128());
+                                break;
+                        case DW_CFA::def_cfa_sf:
+                                reg = cur.uleb128();
+                                row->cfa = make_rule(cfi_rule::type::reg, reg,
+                                                     cur.sleb128() * c.data_align);
+                                break;
+                        case DW_CFA::def_cfa_register:
+                                row->cfa.kind = cfi_rule::type::reg;
+                                row->cfa.reg = cur.uleb128();
+                                break;
+                        case DW_CFA::def_cfa_offset:
+                                row->cfa.kind = cfi_rule::type::reg;
+                                row->cfa.offset = cur.uleb128();
+                                break;
+                        case DW_CFA::def_cfa_offset_sf:
+                                row->cfa.kind = cfi_rule::type::reg;
+                                row->cfa.offset = cur.sleb128() * c.data_align;
+                                break;
+                        case DW_CFA::def_cfa_expression:
+                                row->cfa = make_expr_rule(
+                                        cfi_rule::type::val_expression, &cur);
+                                break;
+
+                        case DW_CFA::GNU_args_size:
+                                cur.uleb128();
+                                break;
+                        case DW_CFA::GNU_window_save:
+                                // SPARC register windows, or AArch64
+                                // DW_CFA_AARCH64_negate_ra_state.
+                                // Neither affects the rules we track.
+                                break;
+
+                        default:
+                                throw format_error("unknown call frame instruction " +
+                                                   to_string((DW_CFA)op));
+                        }
+                        continue;
+
+                advance:
+                        if (!initial)
+                                throw format_error("location advance in CIE initial instructions");
+                        if (loc > pc) {
+                                row->end = loc;
+                                return true;
+                        }
+                        row->loc = loc;
+                        continue;
+
+                restore:
+                        if (!initial)
+                                throw format_error("DW_CFA_restore in CIE initial instructions");
+                        row->set_rule(reg, initial->get_rule(reg));
+                }
+                return false;
+        }
+};
+
+//////////////////////////////////////////////////////////////////
+// class cfi_rule and class cfi_row
+//
+
+expr
+cfi_rule::get_expr() const
+{
+        if (kind != type::expression && kind != type::val_expression)
+                throw value_type_mismatch("CFI rule is not an expression");
+        return expr(sec, expr_offset, expr_len, exprs);
+}
+
+cfi_rule
+cfi_row::get_rule(unsigned regnum) const
+{
+        for (size_t i = 0; i < regs.size(); i++)
+                if (regs[i].regnum == regnum)
+                        return regs[i].rule;
+        return cfi_rule();
+}
+
+void
+cfi_row::set_rule(unsigned regnum, const cfi_rule &rule)
+{
+        // Restoring a register the CIE has no rule for leaves it
+        // unspecified, so drop it rather than storing that
+        for (size_t i = 0; i < regs.size(); i++) {
+                if (regs[i].regnum == regnum) {
+                        if (rule.kind != cfi_rule::type::unspecified) {
+                                regs[i].rule = rule;
+                                return;
+                        }
+                        for (; i + 1 < regs.size(); i++)
+                                regs[i] = regs[i + 1];
+                        regs.pop_back();
+                        return;
+                }
+        }
+        if (rule.kind != cfi_rule::type::unspecified)
+                regs.push_back(reg_rule{regnum, rule});
+}
+
+taddr
+cfi_row::get_cfa(expr_context *ctx) const
+{
+        switch (cfa.kind) {
+        case cfi_rule::type::reg:
+                return ctx->reg(cfa.reg) + cfa.offset;
+        case cfi_rule::type::val_expression:
+                return cfa.get_expr().evaluate(ctx).value;
+        default:
+                throw format_error("call frame row has no CFA rule");
+        }
+}
+
+//////////////////////////////////////////////////////////////////
+// class cfi
+//
+
+struct cfi::impl
+{
+        frame_section eh, debug;
+
+        // The binary search table from .eh_frame_hdr, if any.  Each
+        // entry is an (initial location, FDE address) pair of
+        // hdr_entry_size-byte values in hdr_enc.
+        frame_section hdr;
+        section_offset hdr_table;
+        size_t hdr_count;
+        ubyte hdr_enc;
+        unsigned hdr_entry_size;
+        taddr hdr_eh_frame_ptr;
+
+        // FDE indexes built from the FDE headers, for sections
+        // without a binary search table.  Sorted by lo.
+        struct fde_ref
+        {
+                taddr lo, hi;
+                section_offset offset;
+        };
+        vector<fde_ref> eh_index, debug_index;
+        once_flag eh_index_once, debug_index_once;
+
+        // Decoded CIEs by section offset.  Entries are never removed,
+        // so references to them remain valid.
+        unordered_map<section_offset, unique_ptr<cie> > eh_cies, debug_cies;
+        mutex cies_lock;
+
+        // Compiled expressions of expression rules
+        unique_ptr<expr_cache> exprs;
+
+        impl() : hdr_count(0) { }
+
+        void read_hdr();
+        const cie &get_cie(const frame_section &fs, section_offset offset);
+        void read_fde(const frame_section &fs, const frame_entry &ent,
+                      const cie **c, taddr *lo, taddr *hi,
+                      section_offset *insns);
+        void build_index(const frame_section &fs, vector<fde_ref> *index);
+        bool find_hdr(taddr pc, section_offset *fde);
+        bool find_index(const vector<fde_ref> &index, taddr pc,
+                        section_offset *fde);
+        bool find_row(const frame_section &fs, section_offset fde,
+                      taddr pc, cfi_row *row);
+};
+
+void
+cfi::impl::read_hdr()
+{
+        // LSB 10.6.2
+        cursor cur(hdr.sec);
+        if (cur.fixed<ubyte>() != 1)
+                return;
+        ubyte eh_frame_ptr_enc = cur.fixed<ubyte>();
+        ubyte fde_count_enc = cur.fixed<ubyte>();
+        ubyte table_enc = cur.fixed<ubyte>();
+        hdr_eh_frame_ptr = read_encoded(&cur, eh_frame_ptr_enc, hdr);
+        if (fde_count_enc == eh_pe::omit || table_enc == eh_pe::omit)
+                return;
+        size_t count = read_encoded(&cur, fde_count_enc, hdr);
+
+        // Binary search requires fixed-size entries whose values
+        // don't depend on their position
+        unsigned size = encoded_size(table_enc);
+        if (size == 0 || (table_enc & eh_pe::indirect))
+                return;
+        if ((table_enc & 0x70) != eh_pe::absptr &&
+            (table_enc & 0x70) != eh_pe::datarel)
+                return;
+        // datarel values are relative to .eh_frame_hdr, so we need
+        // to know where it is
+        if ((table_enc & 0x70) == eh_pe::datarel && hdr.addr == 0)
+                return;
+        if (count > (hdr.sec->size() - cur.get_section_offset()) / (2 * size))
+                throw format_error(".eh_frame_hdr table exceeds section size");
+
+        hdr_table = cur.get_section_offset();
+        hdr_count = count;
+        hdr_enc = table_enc;
+        hdr_entry_size = size;
+}
+
+const cie &
+cfi::impl::get_cie(const frame_section &fs, section_offset offset)
+{
+        lock_guard<mutex> lock(cies_lock);
+        auto &cies = fs.eh ? eh_cies : debug_cies;
+        auto it = cies.find(offset);
+        if (it != cies.end())
+                return *it->second;
+
+        frame_entry ent;
+        if (!read_frame_entry(fs, offset, &ent) || !ent.is_cie)
+                throw format_error("FDE CIE pointer does not point to a CIE");
+
+        // DWARF4 section 6.4.1
+        unique_ptr<cie> c(new cie);
+        cursor cur(fs.sec, ent.body);
+        ubyte version = cur.fixed<ubyte>();
+        if (version != 1 && version != 3 && version != 4)
+                throw format_error("unknown CIE version " + std::to_string(version));
+        const char *aug = cur.cstr();
+        c->addr_size = fs.sec->addr_size;
+        c->segment_size = 0;
+        if (version >= 4) {
+                c->addr_size = cur.fixed<ubyte>();
+                c->segment_size = cur.fixed<ubyte>();
+        }
+        c->code_align = cur.uleb128();
+        c->data_align = cur.sleb128();
+        c->ra_reg = version == 1 ? cur.fixed<ubyte>() : cur.uleb128();
+        c->fde_enc = eh_pe::absptr;
+        c->augmentation_data = false;
+        c->signal_frame = false;
+
+        // Augmentations (LSB 10.6.1.1)
+        if (aug[0] == 'z') {
+                c->augmentation_data = true;
+                section_length len = cur.uleb128();
+                section_offset aug_end = cur.get_section_offset() + len;
+                for (const char *p = aug + 1; *p; p++) {
+                        if (*p == 'R') {
+                                c->fde_enc = cur.fixed<ubyte>();
+                        } else if (*p == 'P') {
+                                // Personality routine
+                                ubyte enc = cur.fixed<ubyte>();
+                                read_encoded(&cur, enc & ~eh_pe::indirect, fs);
+                        } else if (*p == 'L') {
+                                // LSDA encoding
+                                cur.fixed<ubyte>();
+                        } else if (*p == 'S') {
+                                c->signal_frame = true;
+                        } else {
+                                // Unknown augmentations (like 'B' and
+                                // 'G' on AArch64) are covered by the
+                                // augmentation length
+                                break;
+                        }
+                }
+                cur = cursor(fs.sec, aug_end);
+        } else if (aug[0] == 'e' && aug[1] == 'h') {
+                // Old GCC: followed by the address of exception
+                // handler data
+                cur.address();
+                if (aug[2])
+                        throw format_error(string("unknown CIE augmentation ") + aug);
+        } else if (aug[0]) {
+                throw format_error(string("unknown CIE augmentation ") + aug);
+        }
+
+        c->initial.return_address_register = c->ra_reg;
+        c->initial.signal_frame = c->signal_frame;
+        cfi_interp(fs, *c, exprs.get()).run(cur.get_section_offset(), ent.end, 0,
+                               &c->initial, nullptr);
+
+        const cie &res = *c;
+        cies[offset] = move(c);
+        return res;
+}
+
+void
+cfi::impl::read_fde(const frame_section &fs, const frame_entry &ent,
+                    const cie **c_out, taddr *lo, taddr *hi,
+                    section_offset *insns)
+{
+        const cie &c = get_cie(fs, ent.cie_offset);
+        section sec(*fs.sec);
+        sec.addr_size = c.addr_size;
+        cursor cur(&sec, ent.body);
+        taddr range;
+        if (fs.eh) {
+                *lo = read_encoded(&cur, c.fde_enc, fs);
+                // The range is just a number, so only its format
+                // applies
+                range = read_encoded(&cur, c.fde_enc & 0x0f, fs);
+        } else {
+                if (c.segment_size)
+                        read_sized(&cur, c.segment_size);
+                *lo = cur.address();
+                range = cur.address();
+        }
+        if (c.augmentation_data) {
+                section_length len = cur.uleb128();
+                cur.ensure(len);
+                cur += len;
+        }
+        *c_out = &c;
+        *hi = *lo + range;
+        *insns = cur.get_section_offset();
+}
+
+void
+cfi::impl::build_index(const frame_section &fs, vector<fde_ref> *index)
+{
+        section_offset off = 0;
+        while (off < fs.sec->size()) {
+                frame_entry ent;
+                if (!read_frame_entry(fs, off, &ent)) {
+                        // A zero terminator ends .eh_frame.
+                        // .debug_frame just treats it as padding.
+                        if (fs.eh)
+                                break;
+                        off = ent.end;
+                        continue;
+                }
+                if (!ent.is_cie) {
+                        const cie *c;
+                        taddr lo, hi;
+                        section_offset insns;
+                        read_fde(fs, ent, &c, &lo, &hi, &insns);
+                        if (lo < hi)
+                                index->push_back(fde_ref{lo, hi, off});
+                }
+                off = ent.end;
+        }
+        sort(index->begin(), index->end(),
+             [](const fde_ref &a, const fde_ref &b) { return a.lo < b.lo; });
+        index->shrink_to_fit();
+}
+
+bool
+cfi::impl::find_hdr(taddr pc, section_offset *fde)
+{
+        taddr base = (hdr_enc & 0x70) == eh_pe::datarel ? hdr.addr : 0;
+        auto entry = [&](size_t i, taddr *loc, taddr *addr) {
+                cursor cur(hdr.sec, hdr_table + i * 2 * hdr_entry_size);
+                bool sign = hdr_enc & 0x08;
+                uint64_t v = read_sized(&cur, hdr_entry_size);
+                uint64_t a = read_sized(&cur, hdr_entry_size);
+                if (sign && hdr_entry_size < 8) {
+                        unsigned shift = 64 - 8 * hdr_entry_size;
+                        v = (uint64_t)((int64_t)(v << shift) >> shift);
+                        a = (uint64_t)((int64_t)(a << shift) >> shift);
+                }
+                *loc = base + v;
+                if (addr)
+                        *addr = base + a;
+        };
+
+        // Find the last entry with initial location <= pc
+        size_t lo = 0, hi = hdr_count;
+        while (lo < hi) {
+                size_t mid = lo + (hi - lo) / 2;
+                taddr loc;
+                entry(mid, &loc, nullptr);
+                if (loc <= pc)
+                        lo = mid + 1;
+                else
+                        hi = mid;
+        }
+        if (lo == 0)
+                return false;
+        taddr loc, addr;
+        entry(lo - 1, &loc, &addr);
+        if (addr < hdr_eh_frame_ptr ||
+            addr - hdr_eh_frame_ptr >= eh.sec->size())
+                throw format_error(".eh_frame_hdr FDE address out of range");
+        *fde = addr - hdr_eh_frame_ptr;
+        return true;
+}
+
+bool
+cfi::impl::find_index(const vector<fde_ref> &index, taddr pc,
+                      section_offset *fde)
+{
+        auto it = upper_bound(index.begin(), index.end(), pc,
+                              [](taddr pc, const fde_ref &r) {
+                                      return pc < r.lo;
+                              });
+        if (it == index.begin())
+                return false;
+        --it;
+        if (pc >= it->hi)
+                return false;
+        *fde = it->offset;
+        return true;
+}
+
+bool
+cfi::impl::find_row(const frame_section &fs, section_offset fde,
+                    taddr pc, cfi_row *row)
+{
+        frame_entry ent;
+        if (!read_frame_entry(fs, fde, &ent) || ent.is_cie)
+                throw format_error("expected FDE at offset 0x" + to_hex(fde));
+        const cie *c;
+        taddr lo, hi;
+        section_offset insns;
+        read_fde(fs, ent, &c, &lo, &hi, &insns);
+        if (pc < lo || pc >= hi)
+                return false;
+
+        *row = c->initial;
+        row->loc = lo;
+        if (!cfi_interp(fs, *c, exprs.get()).run(insns, ent.end, pc, row, &c->initial))
+                row->end = hi;
+        return true;
+}
+
+cfi::cfi(const std::shared_ptr<section> &eh_frame, taddr eh_frame_addr,
+         const std::shared_ptr<section> &eh_frame_hdr, taddr eh_frame_hdr_addr,
+         const std::shared_ptr<section> &debug_frame, unsigned addr_size)
+        : m(make_shared<impl>())
+{
+        // Copy the sections so they carry the target address size,
+        // which is needed to read pointers
+        auto with_addr_size = [&](const shared_ptr<section> &sec) {
+                auto res = make_shared<section>(*sec);
+                res->addr_size = addr_size;
+                return res;
+        };
+
+        if (eh_frame) {
+                m->eh = frame_section{with_addr_size(eh_frame), true,
+                                      eh_frame_addr, 0};
+                if (eh_frame_hdr) {
+                        m->hdr = frame_section{with_addr_size(eh_frame_hdr),
+                                               true, eh_frame_hdr_addr,
+                                               eh_frame_hdr_addr};
+                        m->read_hdr();
+                }
+        }
+        if (debug_frame)
+                m->debug = frame_section{with_addr_size(debug_frame), false,
+                                         0, 0};
+        m->exprs.reset(new expr_cache((eh_frame ? eh_frame->size() : 0) +
+                                      (debug_frame ? debug_frame->size() : 0)));
+}
+
+bool
+cfi::find_row(taddr pc, cfi_row *row) const
+{
+        if (!m)
+                return false;
+
+        section_offset fde;
+        if (m->eh.sec) {
+                bool found;
+                if (m->hdr_count) {
+                        found = m->find_hdr(pc, &fde);
+                } else {
+                        call_once(m->eh_index_once, [&]() {
+                                m->build_index(m->eh, &m->eh_index);
+                        });
+                        found = m->find_index(m->eh_index, pc, &fde);
+                }
+                if (found && m->find_row(m->eh, fde, pc, row))
+                        return true;
+        }
+
+        if (m->debug.sec) {
+                call_once(m->debug_index_once, [&]() {
+                        m->build_index(m->debug, &m->debug_index);
+                });
+                if (m->find_index(m->debug_index, pc, &fde) &&
+                    m->find_row(m->debug, fde, pc, row))
+                        return true;
+        }
+        return false;
+}
+
+taddr
+cfi::get_cfa(taddr pc, expr_context *ctx) const
+{
+        cfi_row row;
+        if (!find_row(pc, &row))
+                throw out_of_range("no call frame information for PC 0x" +
+                                   to_hex(pc));
+        return row.get_cfa(ctx);
+}
+
+DWARFPP_END_NAMESPACE
@@ -15,11 +15,17 @@ int64_t
 cursor::sleb128()
 {
         // Appendix C
+        if (pos < sec->end && !(*pos & 0x80)) {
+                uint8_t byte = *(uint8_t*)(pos++);
+                return (byte & 0x40) ? (int64_t)byte - 0x80 : byte;
+        }
+
         uint64_t result = 0;
         unsigned shift = 0;
         while (pos < sec->end) {
                 uint8_t byte = *(uint8_t*)(pos++);
-                result |= (uint64_t)(byte & 0x7f) << shift;
+                if (shift < sizeof(result)*8)
+                        result |= (uint64_t)(byte & 0x7f) << shift;
                 shift += 7;
                 if ((byte & 0x80) == 0) {
                         if (shift < sizeof(result)*8 && (byte & 0x40))
@@ -31,8 +37,79 @@ cursor::sleb128()
         return 0;
 }
 
+uint64_t
+cursor::uleb128_slow()
+{
+        // Appendix C
+        uint64_t result = 0;
+        unsigned shift = 0;
+        const char *p = pos;
+        if (sec->end - p >= 10) {
+                // Any value that fits in 64 bits takes at most 10
+                // bytes, so these don't need bounds checks
+                for (unsigned i = 0; i < 10; i++) {
+                        uint8_t byte = p[i];
+                        result |= (uint64_t)(byte & 0x7f) << (7 * i);
+                        if ((byte & 0x80) == 0) {
+                                pos = p + i + 1;
+                                return result;
+                        }
+                }
+                p += 10;
+                shift = 70;
+        }
+        // Short sections, and padded values whose high bytes don't
+        // fit in the result
+        while (p < sec->end) {
+                uint8_t byte = *p++;
+                if (shift < sizeof(result)*8)
+                        result |= (uint64_t)(byte & 0x7f) << shift;
+                shift += 7;
+                if ((byte & 0x80) == 0) {
+                        pos = p;
+                        return result;
+                }
+        }
+        underflow();
+        return 0;
+}
+
+void
+cursor::skip_leb128(unsigned n)
+{
+        // Scan eight bytes at a time for bytes with a clear high
+        // bit, which end values.
+        static const uint64_t high_bits = 0x8080808080808080ull;
+        while (n && sec->end - pos >= 8) {
+                uint64_t ends = ~load_unaligned<uint64_t, byte_order::lsb>(pos) &
+                        high_bits;
+                unsigned count = __builtin_popcountll(ends);
+                if (count < n) {
+                        n -= count;
+                        pos += 8;
+                        continue;
+                }
+                // Drop the ends of the first n-1 values
+                while (--n)
+                        ends &= ends - 1;
+                pos += __builtin_ctzll(ends) / 8 + 1;
+                return;
+        }
+        while (n && pos < sec->end)
+                if ((*(uint8_t*)(pos++) & 0x80) == 0)
+                        n--;
+        if (n)
+                underflow();
+}
+
 shared_ptr<section>
 cursor::subsection()
+{
+        return make_shared<section>(subsection_value());
+}
+
+section
+cursor::subsection_value()
 {
         // Section 7.4
         const char *begin = pos;
@@ -49,7 +126,9 @@ cursor::subsection()
                 throw format_error("initial length has reserved value");
         }
         pos = begin + length;
-        return make_shared<section>(sec->type, begin, length, sec->ord, fmt);
+        section sub(sec->type, begin, length, sec->ord, fmt);
+        sub.stats = sec->stats;
+        return sub;
 }
 
 void
@@ -67,12 +146,6 @@ cursor::skip_initial_length()
         }
 }
 
-void
-cursor::skip_unit_type()
-{
-    pos += sizeof(sbyte);
-}
-
 section_offset
 cursor::offset()
 {
@@ -203,9 +276,9 @@ cursor::skip_form(DW_FORM form)
         case DW_FORM::addrx:
         case DW_FORM::loclistx:
         case DW_FORM::rnglistx:
-                while (pos < sec->end && (*(uint8_t*)pos & 0x80))
-                        pos++;
-                pos++;
+        case DW_FORM::GNU_addr_index:
+        case DW_FORM::GNU_str_index:
+                skip_leb128();
                 break;
         case DW_FORM::string:
                 while (pos < sec->end && *pos)
@@ -91,6 +91,10 @@ enum class DW_TAG
         type_unit                = 0x41,
         rvalue_reference_type    = 0x42,
         template_alias           = 0x43,
+
+        // DWARF 5
+        skeleton_unit            = 0x4a,
+
         lo_user                  = 0x4080,
         hi_user                  = 0xffff,
 };
@@ -213,7 +217,48 @@ enum class DW_AT
         enum_class           = 0x6d, // flag
         linkage_name         = 0x6e, // string
 
+        // DWARF 5
+        string_length_bit_size  = 0x6f, // constant
+        string_length_byte_size = 0x70, // constant
+        rank                 = 0x71, // constant, exprloc
+        str_offsets_base     = 0x72, // stroffsetsptr
+        addr_base            = 0x73, // addrptr
+        rnglists_base        = 0x74, // rnglistsptr
+        dwo_name             = 0x76, // string
+        reference            = 0x77, // flag
+        rvalue_reference     = 0x78, // flag
+        macros               = 0x79, // macptr
+        call_all_calls       = 0x7a, // flag
+        call_all_source_calls = 0x7b, // flag
+        call_all_tail_calls  = 0x7c, // flag
+        call_return_pc       = 0x7d, // address
+        call_value           = 0x7e, // exprloc
+        call_origin          = 0x7f, // exprloc
+        call_parameter       = 0x80, // reference
+        call_pc              = 0x81, // address
+        call_tail_call       = 0x82, // flag
+        call_target          = 0x83, // exprloc
+        call_target_clobbered = 0x84, // exprloc
+        call_data_location   = 0x85, // exprloc
+        call_data_value      = 0x86, // exprloc
+        noreturn             = 0x87, // flag
+        alignment            = 0x88, // constant
+        export_symbols       = 0x89, // flag
+        deleted              = 0x8a, // flag
+        defaulted            = 0x8b, // constant
+        loclists_base        = 0x8c, // loclistsptr
+
         lo_user              = 0x2000,
+
+        // GNU split DWARF extensions, the DWARF 4 forerunners of
+        // dwo_name, addr_base, and friends
+        GNU_dwo_name         = 0x2130, // string
+        GNU_dwo_id           = 0x2131, // constant
+        GNU_ranges_base      = 0x2132, // rangelistptr
+        GNU_addr_base        = 0x2133, // addrptr
+        GNU_pubnames         = 0x2134, // flag
+        GNU_pubtypes         = 0x2135, // flag
+
         hi_user              = 0x3fff,
 };
 
@@ -271,6 +316,10 @@ enum class DW_FORM
         addrx2       = 0x2a,    // 2-byte address index
         addrx3       = 0x2b,    // 3-byte address index
         addrx4       = 0x2c,    // 4-byte address index
+
+        // GNU split DWARF extensions, equivalent to addrx and strx
+        GNU_addr_index = 0x1f01, // address index in .debug_addr
+        GNU_str_index  = 0x1f02, // string index in .debug_str_offsets
 };
 
 std::string
@@ -357,7 +406,24 @@ enum class DW_OP : ubyte
         implicit_value      = 0x9e, // [ULEB128 size, block of that size]
         stack_value         = 0x9f,
 
+        // DWARF 5
+        implicit_pointer    = 0xa0, // [4- or 8-byte offset of DIE, SLEB128 offset]
+        addrx               = 0xa1, // [ULEB128 index into .debug_addr]
+        constx              = 0xa2, // [ULEB128 index into .debug_addr]
+        entry_value         = 0xa3, // [ULEB128 size, block of that size]
+        const_type          = 0xa4, // [ULEB128 type offset, 1-byte size, constant]
+        regval_type         = 0xa5, // [ULEB128 register, ULEB128 type offset]
+        deref_type          = 0xa6, // [1-byte size, ULEB128 type offset]
+        xderef_type         = 0xa7, // [1-byte size, ULEB128 type offset]
+        convert             = 0xa8, // [ULEB128 type offset]
+        reinterpret         = 0xa9, // [ULEB128 type offset]
+
         lo_user             = 0xe0,
+
+        // GNU split DWARF extensions, equivalent to addrx and constx
+        GNU_addr_index      = 0xfb, // [ULEB128 index into .debug_addr]
+        GNU_const_index     = 0xfc, // [ULEB128 index into .debug_addr]
+
         hi_user             = 0xff,
 };
 
@@ -595,6 +661,51 @@ enum class DW_LNCT
 std::string
 to_string(DW_LNCT v);
 
+// Call frame instruction encodings (DWARF4 section 7.23 figure 40)
+enum class DW_CFA : ubyte
+{
+        // High 2 bits; the low 6 bits are an operand
+        advance_loc        = 0x40,
+        offset             = 0x80,
+        restore            = 0xc0,
+
+        nop                = 0x00,
+        set_loc            = 0x01,
+        advance_loc1       = 0x02,
+        advance_loc2       = 0x03,
+        advance_loc4       = 0x04,
+        offset_extended    = 0x05,
+        restore_extended   = 0x06,
+        undefined          = 0x07,
+        same_value         = 0x08,
+        register_          = 0x09,
+        remember_state     = 0x0a,
+        restore_state      = 0x0b,
+        def_cfa            = 0x0c,
+        def_cfa_register   = 0x0d,
+        def_cfa_offset     = 0x0e,
+
+        // DWARF 3
+        def_cfa_expression = 0x0f,
+        expression         = 0x10,
+        offset_extended_sf = 0x11,
+        def_cfa_sf         = 0x12,
+        def_cfa_offset_sf  = 0x13,
+        val_offset         = 0x14,
+        val_offset_sf      = 0x15,
+        val_expression     = 0x16,
+
+        lo_user            = 0x1c,
+        // GNU extensions
+        GNU_window_save    = 0x2d,
+        GNU_args_size      = 0x2e,
+        GNU_negative_offset_extended = 0x2f,
+        hi_user            = 0x3f,
+};
+
+std::string
+to_string(DW_CFA v);
+
 // Range list entry encodings (DWARF5 section 7.25)
 enum class DW_RLE : ubyte
 {
@@ -611,6 +722,57 @@ enum class DW_RLE : ubyte
 std::string
 to_string(DW_RLE v);
 
+// Location list entry encodings (DWARF5 section 7.7.3)
+enum class DW_LLE : ubyte
+{
+        end_of_list      = 0x00,
+        base_addressx    = 0x01,
+        startx_endx      = 0x02,
+        startx_length    = 0x03,
+        offset_pair      = 0x04,
+        default_location = 0x05,
+        base_address     = 0x06,
+        start_end        = 0x07,
+        start_length     = 0x08,
+        // GNU location view extension: two ULEB128 view numbers
+        // for the range entry that follows
+        GNU_view_pair    = 0x09,
+};
+
+std::string
+to_string(DW_LLE v);
+
+// Unit header unit types (DWARF5 section 7.5.1)
+enum class DW_UT : ubyte
+{
+        compile       = 0x01,
+        type          = 0x02,
+        partial       = 0x03,
+        skeleton      = 0x04,
+        split_compile = 0x05,
+        split_type    = 0x06,
+        lo_user       = 0x80,
+        hi_user       = 0xff,
+};
+
+std::string
+to_string(DW_UT v);
+
+// Name index attributes (DWARF5 section 7.19 table 7.23)
+enum class DW_IDX
+{
+        compile_unit = 0x01,
+        type_unit    = 0x02,
+        die_offset   = 0x03,
+        parent       = 0x04,
+        type_hash    = 0x05,
+        lo_user      = 0x2000,
+        hi_user      = 0x3fff,
+};
+
+std::string
+to_string(DW_IDX v);
+
 DWARFPP_END_NAMESPACE
 
 #endif
@@ -9,7 +9,7 @@ using namespace std;
 DWARFPP_BEGIN_NAMESPACE
 
 die::die(const unit *cu)
-        : cu(cu), abbrev(nullptr)
+        : cu(cu), abbrev(nullptr), attr_base(0)
 {
 }
 
@@ -25,9 +25,31 @@ die::get_section_offset() const
         return cu->get_section_offset() + offset;
 }
 
+/**
+ * Append to out the offsets of the n attributes with the
+ * specifications in specs, starting at cur, and advance cur past
+ * them.
+ */
+template<typename Cursor>
+static void
+skip_attributes(cursor *cur, const attribute_spec *specs, size_t n,
+                small_vector<section_offset, 6> *out)
+{
+        Cursor c(cur->sec, cur->get_section_offset());
+        for (size_t i = 0; i < n; ++i) {
+                out->push_back(c.get_section_offset());
+                c.skip_form(specs[i].form);
+        }
+        cur->pos = c.pos;
+}
+
 void
 die::read(section_offset off)
 {
+        typedef void (*skip_fn)(cursor *, const attribute_spec *, size_t,
+                                small_vector<section_offset, 6> *);
+        static const skip_fn skippers[] = CURSOR_KERNELS(skip_attributes);
+
         cursor cur(cu->data(), off);
 
         offset = off;
@@ -42,15 +64,26 @@ die::read(section_offset off)
 
         tag = abbrev->tag;
 
-        // XXX We can pre-compute almost all of this work in the
-        // abbrev_entry.
+        // The offsets of the leading fixed-size attributes are
+        // precomputed in the abbrev.  Only the remaining attributes
+        // need to be skipped over one at a time.
+        attr_base = cur.get_section_offset();
+        size_t nattrs = abbrev->attributes.size();
         attrs.clear();
-        attrs.reserve(abbrev->attributes.size());
-        for (auto &attr : abbrev->attributes) {
-                attrs.push_back(cur.get_section_offset());
-                cur.skip_form(attr.form);
+        cur += abbrev->fixed_offsets[abbrev->nfixed];
+        if (!abbrev->fixed_size) {
+                attrs.reserve(nattrs - abbrev->nfixed);
+                skippers[cu->get_cursor_kind()](
+                        &cur, &abbrev->attributes[abbrev->nfixed],
+                        nattrs - abbrev->nfixed, &attrs);
         }
         next = cur.get_section_offset();
+
+        stats_block *stats = cur.sec->stats;
+        if (stats_on(stats)) {
+                count_stat(stats, counter::dies_decoded);
+                count_decoded(stats, cur.sec->type, next - off);
+        }
 }
 
 bool
@@ -58,25 +91,16 @@ die::has(DW_AT attr) const
 {
         if (!abbrev)
                 return false;
-        // XXX Totally lame
-        for (auto &a : abbrev->attributes)
-                if (a.name == attr)
-                        return true;
-        return false;
+        return abbrev->find(attr) >= 0;
 }
 
 value
 die::operator[](DW_AT attr) const
 {
-        // XXX We can pre-compute almost all of this work in the
-        // abbrev_entry.
         if (abbrev) {
-                int i = 0;
-                for (auto &a : abbrev->attributes) {
-                        if (a.name == attr)
-                                return value(cu, a, attrs[i]);
-                        i++;
-                }
+                int i = abbrev->find(attr);
+                if (i >= 0)
+                        return value(cu, abbrev->attributes[i], attr_offset(i));
         }
         throw out_of_range("DIE does not have attribute " + to_string(attr));
 }
@@ -145,15 +169,19 @@ die::iterator::operator++()
                 // They made it easy on us.  Follow the sibling
                 // pointer.  XXX Probably worth optimizing
                 d = d[DW_AT::sibling].as_reference();
+        } else if (section_offset next = d.cu->get_cached_sibling(d.offset)) {
+                // We've walked this DIE's children before
+                d.read(next);
         } else {
                 // It's a hard-knock life.  We have to iterate through
-                // the children to find the next DIE.
-                // XXX Particularly unfortunate if the user is doing a
-                // DFS, since this will result in N^2 behavior.  Maybe
-                // a small cache of terminator locations in the CU?
+                // the children to find the next DIE.  Record where
+                // they end so a DFS doesn't do this repeatedly, which
+                // would result in N^2 behavior.  Incrementing sub
+                // caches the ends of any deeper subtrees as well.
                 iterator sub(d.cu, d.next);
                 while (sub->abbrev)
                         ++sub;
+                d.cu->cache_sibling(d.offset, sub->next);
                 d.read(sub->next);
         }
 
@@ -168,18 +196,32 @@ die::attributes() const
         if (!abbrev)
                 return res;
 
-        // XXX Quite slow, especially when using this to traverse an
-        // entire DIE tree since each DIE will produce a new vector
-        // (whereas other vectors get reused).  Might be worth a
-        // custom iterator.
+        // This produces a new vector for each DIE, which is slow
+        // when traversing an entire DIE tree.  each_attribute avoids
+        // this.
         int i = 0;
         for (auto &a : abbrev->attributes) {
-                res.push_back(make_pair(a.name, value(cu, a, attrs[i])));
+                res.push_back(make_pair(a.name, value(cu, a, attr_offset(i))));
                 i++;
         }
         return res;
 }
 
+die::attribute_range
+die::each_attribute() const
+{
+        return attribute_range(this, abbrev ? abbrev->attributes.size() : 0);
+}
+
+void
+die::attribute_iterator::load()
+{
+        if (!d || !d->abbrev || i >= d->abbrev->attributes.size())
+                return;
+        cur.first = d->abbrev->attributes[i].name;
+        cur.second = value(d->cu, d->abbrev->attributes[i], d->attr_offset(i));
+}
+
 bool
 die::operator==(const die &o) const
 {
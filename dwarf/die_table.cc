@@ -0,0 +1,127 @@
+// Copyright (c) 2013 Austin T. Clements. All rights reserved.
+// Use of this source code is governed by an MIT license
+// that can be found in the LICENSE file.
+
+#include "internal.hh"
+
+#include <algorithm>
+
+using namespace std;
+
+DWARFPP_BEGIN_NAMESPACE
+
+const die_table::index die_table::npos;
+
+die_table::die_table(const unit *cu)
+        : cu(cu)
+{
+        if (cu->data()->size() > 0xffffffff)
+                throw format_error("unit too large to materialize");
+
+        // Decode the DIEs in the order they appear in the unit,
+        // keeping a stack of the DIEs whose children we're in.
+        // Unlike die::iterator, this never needs to skip over a
+        // subtree, so it reads every DIE exactly once.
+        struct level
+        {
+                index parent, last_child;
+        };
+        vector<level> stack;
+
+        die d(cu);
+        section_offset pos = cu->root().get_unit_offset();
+        do {
+                d.read(pos);
+                pos = d.next;
+                if (!d.abbrev) {
+                        // Sibling list terminator
+                        if (stack.empty())
+                                throw format_error("unexpected sibling list terminator");
+                        stack.pop_back();
+                        continue;
+                }
+
+                index i = tags.size();
+                if (i == npos)
+                        throw format_error("too many DIEs to materialize");
+                index parent = npos;
+                if (!stack.empty()) {
+                        parent = stack.back().parent;
+                        if (stack.back().last_child == npos)
+                                first_children[parent] = i;
+                        else
+                                next_siblings[stack.back().last_child] = i;
+                        stack.back().last_child = i;
+                }
+
+                tags.push_back(d.tag);
+                abbrevs.push_back(d.abbrev);
+                offsets.push_back(d.offset);
+                parents.push_back(parent);
+                first_children.push_back(npos);
+                next_siblings.push_back(npos);
+                ends.push_back(d.next);
+                attr_base.push_back(attr_offsets.size());
+                for (size_t a = 0; a < d.abbrev->attributes.size(); ++a)
+                        attr_offsets.push_back(d.attr_offset(a));
+
+                if (d.abbrev->children)
+                        stack.push_back(level{i, npos});
+        } while (!stack.empty() && pos < cu->data()->size());
+        attr_base.push_back(attr_offsets.size());
+
+        tags.shrink_to_fit();
+        abbrevs.shrink_to_fit();
+        offsets.shrink_to_fit();
+        parents.shrink_to_fit();
+        first_children.shrink_to_fit();
+        next_siblings.shrink_to_fit();
+        ends.shrink_to_fit();
+        attr_base.shrink_to_fit();
+        attr_offsets.shrink_to_fit();
+}
+
+bool
+die_table::has(index i, DW_AT attr) const
+{
+        return abbrevs[i]->find(attr) >= 0;
+}
+
+value
+die_table::get(index i, DW_AT attr) const
+{
+        const abbrev_entry *abbrev = abbrevs[i];
+        int a = abbrev->find(attr);
+        if (a < 0)
+                throw out_of_range("DIE does not have attribute " + to_string(attr));
+        return value(cu, abbrev->attributes[a], attr_offsets[attr_base[i] + a]);
+}
+
+die_table::index
+die_table::find(section_offset unit_offset) const
+{
+        // DIE offsets increase with their index
+        auto it = lower_bound(offsets.begin(), offsets.end(), unit_offset);
+        if (it == offsets.end() || *it != unit_offset)
+                return npos;
+        return it - offsets.begin();
+}
+
+die
+die_table::to_die(index i) const
+{
+        die d(cu);
+        d.abbrev = abbrevs[i];
+        d.tag = tags[i];
+        d.offset = offsets[i];
+        d.next = ends[i];
+        // die stores only the offsets of the variable-size
+        // attributes.  The first fixed-size one is at attr_base.
+        if (d.abbrev->nfixed)
+                d.attr_base = attr_offsets[attr_base[i]];
+        for (auto a = attr_base[i] + d.abbrev->nfixed; a < attr_base[i + 1]; ++a)
+                d.attrs.push_back(attr_offsets[a]);
+        return d;
+}
+
+DWARFPP_END_NAMESPACE
@@ -13,33 +13,53 @@
 #include "data.hh"
 #include "small_vector.hh"
 
+#include <atomic>
 #include <initializer_list>
+#include <iterator>
 #include <map>
 #include <memory>
 #include <stdexcept>
 #include <string>
 #include <vector>
+#if __cplusplus >= 201703L
+#include <string_view>
+#endif
 
 DWARFPP_BEGIN_NAMESPACE
 
 // Forward declarations
 class dwarf;
 class loader;
+class unit;
 class compilation_unit;
 class type_unit;
 class die;
 class value;
 class expr;
+class compiled_expr;
 class expr_context;
 class expr_result;
 class rangelist;
+class loclist;
 class line_table;
+class die_table;
+class name_index;
+class cfi;
+class pc_info;
+class scope_index;
 
 // Internal type forward-declarations
 struct section;
 struct abbrev_entry;
+struct abbrev_table;
 struct attribute_spec;
 struct cursor;
+struct expr_program;
+struct expr_cache;
+struct path_table;
+struct index_writer;
+class index_file;
+struct stats_block;
 
 // XXX Audit for binary-compatibility
 
@@ -56,8 +76,7 @@ struct cursor;
 
 // XXX Indicate DWARF4 in all spec references
 
-// XXX Big missing support: .debug_aranges, .debug_frame, loclists,
-// macros
+// XXX Big missing support: macros
 
 //////////////////////////////////////////////////////////////////
 // DWARF files
@@ -77,31 +96,149 @@ public:
 
 /**
  * DWARF section types.  These correspond to the names of ELF
- * sections, though DWARF can be embedded in other formats.
+ * sections, though DWARF can be embedded in other formats.  Split
+ * DWARF files (.dwo) and packages (.dwp) use the same types for
+ * their .dwo sections.
  */
 enum class section_type
 {
         abbrev,
         addr,           // DWARF 5 .debug_addr
         aranges,
+        cu_index,       // .debug_cu_index of a DWARF package
+        eh_frame,       // .eh_frame (not a .debug_ section)
+        eh_frame_hdr,   // .eh_frame_hdr (not a .debug_ section)
         frame,
         info,
         line,
         line_str,
         loc,
+        loclists,       // DWARF 5 .debug_loclists
         macinfo,
+        names,          // DWARF 5 .debug_names
         pubnames,
         pubtypes,
         ranges,
         rnglists,       // DWARF 5 .debug_rnglists
         str,
         str_offsets,
+        tu_index,       // .debug_tu_index of a DWARF package
         types,
 };
 
 std::string
 to_string(section_type v);
 
+//////////////////////////////////////////////////////////////////
+// Statistics and tracing
+//
+
+/**
+ * The lazily constructed kinds of state that dwarf_stats times and
+ * tracers are told about.
+ */
+enum class phase
+{
+        load_section,   // Loading a section from the loader
+        abbrev_table,   // Parsing an abbrev table
+        line_table,     // Reading a line table's header
+        line_index,     // Building a line table's address index
+        die_table,      // unit::materialize
+        scope_index,    // compilation_unit::get_scope_index
+        name_index,     // dwarf::get_name_index
+        cu_index,       // The address index of dwarf::find_cu
+        type_index,     // The type unit index of dwarf::get_type_unit
+        cfi,            // dwarf::get_cfi
+        split_unit,     // compilation_unit::get_split_unit
+};
+
+std::string
+to_string(phase v);
+
+/**
+ * A snapshot of the decoding statistics of a dwarf file, returned by
+ * dwarf::get_stats.  These count the work done through the file, its
+ * units, and their split units while statistics were enabled.
+ */
+struct dwarf_stats
+{
+        struct cache
+        {
+                std::uint64_t hits, misses;
+        };
+
+        struct phase_time
+        {
+                // The number of times the phase ran and the total
+                // nanoseconds it took, including nested phases
+                std::uint64_t count, ns;
+        };
+
+        // DIEs decoded, including DIEs decoded more than once
+        std::uint64_t dies_decoded;
+
+        // Bytes of each section, indexed by section_type, read from
+        // the loader and decoded.  Decoded bytes count DIEs, abbrev
+        // tables, line programs, and range and location lists, each
+        // time they are decoded.
+        std::uint64_t bytes_loaded[(unsigned)section_type::types + 1];
+        std::uint64_t bytes_decoded[(unsigned)section_type::types + 1];
+
+        // Abbrev tables parsed, and units that shared a table
+        // another unit had already parsed
+        std::uint64_t abbrev_tables_parsed, abbrev_tables_shared;
+
+        // Line programs run from the beginning, by line table
+        // iteration, linear find_address, or building an address
+        // index
+        std::uint64_t line_programs_executed;
+
+        // line_table::find_address lookups answered by the address
+        // index (hits) or by running the line program (misses)
+        cache line_lookups;
+        // Lookups in the cache of subtree ends that lets
+        // die::iterator skip the children of DIEs without
+        // DW_AT::sibling
+        cache sibling_cache;
+        // DW_FORM::ref_addr resolutions answered by a unit's recent
+        // reference targets
+        cache ref_targets;
+        // dwarf::get_section calls, where misses go to the loader
+        cache sections;
+        // dwarf::get_type_unit calls, where misses construct the
+        // unit
+        cache type_units;
+
+        // Time spent in each phase, indexed by phase
+        phase_time phases[(unsigned)phase::split_unit + 1];
+};
+
+/**
+ * An interface for observing the phases of a dwarf file with
+ * statistics enabled, for example, to record them in an external
+ * tracing system.  Phases may nest (a section may be loaded while
+ * an index is built) and may run concurrently on any thread that
+ * uses the file, so implementations must be thread-safe.  The
+ * default implementations do nothing.
+ */
+class tracer
+{
+public:
+        virtual ~tracer() { }
+
+        /**
+         * Called when phase p begins.  u is the unit it's for, or
+         * nullptr for phases of the whole file.
+         */
+        virtual void begin(phase p, const unit *u) { }
+
+        /**
+         * Called when phase p ends, normally or by an exception,
+         * after ns nanoseconds.
+         */
+        virtual void end(phase p, const unit *u, std::uint64_t ns) { }
+};
+
 /**
  * A DWARF file.  This class is internally reference counted and can
  * be efficiently copied.
@@ -109,6 +246,16 @@ to_string(section_type v);
  * Objects retrieved from this object may depend on it; the caller is
  * responsible for keeping this object live as long as any retrieved
  * object may be in use.
+ *
+ * Thread safety: const methods of this object and of the units, DIEs,
+ * values, and line tables retrieved from it may be called
+ * concurrently from any number of threads.  Lazily computed state
+ * (sections, abbrev tables, root DIEs, line tables, and indexes) is
+ * constructed exactly once and is immutable once published, so
+ * lookups take no locks once it exists.  Calls to the loader are
+ * serialized, so loaders need not be thread-safe.  Iterators and
+ * die_str_map objects are not thread-safe, but separate instances
+ * may be used concurrently.
  */
 class dwarf
 {
@@ -119,6 +266,15 @@ public:
          */
         explicit dwarf(const std::shared_ptr<loader> &l);
 
+        /**
+         * \internal Construct a DWARF file that records its
+         * statistics in stats, which it shares with another file.
+         * This is how split DWARF files report to their skeleton's
+         * file.
+         */
+        dwarf(const std::shared_ptr<loader> &l,
+              const std::shared_ptr<stats_block> &stats);
+
         /**
          * Construct a DWARF file that is initially not valid.
          */
@@ -154,6 +310,8 @@ public:
         // iterable collection over const references.
         /**
          * Return the list of compilation units in this DWARF file.
+         * This does not include DWARF 5 type units, even though they
+         * are stored in .debug_info; use get_type_unit for those.
          */
         const std::vector<compilation_unit> &compilation_units() const;
 
@@ -161,14 +319,201 @@ public:
          * Return the type unit with the given signature.  If the
          * signature does not correspond to a type unit, throws
          * out_of_range.
+         *
+         * This covers DWARF 4 type units in .debug_types and DWARF
+         * 5 type units in .debug_info.  The first call builds a
+         * hash index of type unit signatures from just the unit
+         * headers.  Each type unit is only constructed the first
+         * time its signature is looked up, and later lookups return
+         * the same object.
          */
         const type_unit &get_type_unit(uint64_t type_signature) const;
 
+        /**
+         * Return the compilation unit whose code contains the given
+         * address, or nullptr if no compilation unit covers it.
+         *
+         * The first call builds a sorted index of address ranges,
+         * which later calls binary search.  If several units' ranges
+         * contain the address, this returns the unit whose range
+         * starts last.  The index comes from
+         * .debug_aranges where available.  Compilation units that
+         * .debug_aranges does not describe (or all of them, if the
+         * section is missing) are indexed using the PC range of
+         * their root DIE.
+         */
+        const compilation_unit *find_cu(taddr pc) const;
+
+        /**
+         * Return the compilation unit whose part of .debug_info
+         * contains the given section offset, or nullptr if no
+         * compilation unit contains it.  This is a binary search of
+         * an index of unit offsets, built along with the list of
+         * compilation units.
+         */
+        const compilation_unit *find_cu_containing(section_offset off) const;
+
+        /**
+         * Return the index of function, variable, and type names in
+         * all compilation units of this file.  The index is built by
+         * the first call.  For units described only by
+         * .debug_pubnames, it covers just their global names (see
+         * name_index).
+         */
+        const name_index &get_name_index() const;
+
+        /**
+         * Return the call frame information of this file, from
+         * .eh_frame (and .eh_frame_hdr) and .debug_frame, whichever
+         * are present.  The first call locates the sections; CIEs
+         * and FDEs are parsed lazily.
+         */
+        const cfi &get_cfi() const;
+
+        /**
+         * Describe each of the n PCs in pcs.  For each PC, this finds
+         * the compilation unit containing it, the line table row
+         * for it, and the subprogram and inlined subroutine DIEs
+         * containing it.  The results are in the same order as pcs.
+         *
+         * The result for each PC is the same as looking it up with
+         * find_cu, line_table::find_address, and a depth-first
+         * search of the unit's DIE tree.  However, this sorts and
+         * deduplicates the PCs and then sweeps the line program and
+         * DIE tree of each unit only once for all of the PCs that
+         * fall in it.  This makes it suitable for large address sets,
+         * such as profiles.  Units are processed in parallel using
+         * up to nthreads threads.  If nthreads is 0, this uses one
+         * thread per hardware thread.  If reading any unit fails,
+         * this rethrows the first exception.
+         */
+        std::vector<pc_info> symbolize(const taddr *pcs, size_t n,
+                                       unsigned nthreads = 0) const;
+
+        /**
+         * Describe each PC in pcs.  This is equivalent to
+         * symbolize(pcs.data(), pcs.size(), nthreads).
+         */
+        std::vector<pc_info> symbolize(const std::vector<taddr> &pcs,
+                                       unsigned nthreads = 0) const;
+
+        /**
+         * Eagerly construct the lazily computed state of every
+         * compilation unit, using up to nthreads threads.  This
+         * loads abbrev tables, root DIEs, and line tables of all
+         * units, and then builds the indexes used by find_cu and
+         * get_name_index.  If nthreads is 0, this uses one thread
+         * per hardware thread.
+         *
+         * This is purely an optimization for callers that will
+         * touch most of the file: the results are the same as if
+         * they were computed lazily.  If constructing any of this
+         * state fails, this rethrows the first exception.
+         */
+        void prefetch_all(unsigned nthreads = 0) const;
+
+        /**
+         * Write the indexes used by find_cu and get_name_index to an
+         * index file at path, building them first if necessary.
+         * key identifies the binary this file was read from (for
+         * example, its build ID; see elf::elf::get_build_id) and
+         * must be passed to load_index.  The file is written to a
+         * temporary name and renamed into place, so concurrent
+         * readers never see a partial file.  Throws
+         * std::system_error if the file can't be written.
+         */
+        void save_index(const std::string &path, const std::string &key) const;
+
+        /**
+         * Use the indexes in the index file at path, written by
+         * save_index, instead of building them.  The file is mapped
+         * and its tables are used in place, so this takes time
+         * independent of the size of the debug info.  Indexes that
+         * have already been built are kept.  Returns true if any
+         * index was taken from the file.  Returns false, and leaves
+         * this file unchanged, if the file is missing, was written
+         * by a different version of libelfin or on a machine of
+         * different byte order, or doesn't match key and this
+         * file's .debug_info.
+         *
+         * The file is checked for consistency with this DWARF only
+         * when it's opened; corruption found later surfaces as
+         * format_error from find_cu or name_index lookups.
+         */
+        bool load_index(const std::string &path, const std::string &key) const;
+
+        /**
+         * Use an index file in the cache directory dir, named after
+         * key.  If a matching file exists, this is load_index and
+         * returns true.  Otherwise, this builds the indexes, tries to
+         * save them for later runs (ignoring failures), and returns
+         * false.  If key is empty, this does nothing and returns
+         * false, since there's no way to tell binaries apart.
+         */
+        bool use_index_cache(const std::string &dir, const std::string &key) const;
+
+        /**
+         * Start collecting decoding statistics (see get_stats) for
+         * this file, its units, and their split units.  If t is
+         * non-null, also tell t about each phase.  This must be
+         * called before other threads use the file.  While
+         * statistics are disabled, which is the default, they cost
+         * one predictable branch on each hot path.  Enabled, they
+         * cost an atomic increment per DIE decoded, and a clock read
+         * per phase.  If libelfin was built with
+         * DWARFPP_DISABLE_STATS, this does nothing.
+         */
+        void enable_stats(const std::shared_ptr<tracer> &t = nullptr) const;
+
+        /**
+         * Return the statistics collected since enable_stats or the
+         * last reset_stats.
+         */
+        dwarf_stats get_stats() const;
+
+        /**
+         * Zero the collected statistics.
+         */
+        void reset_stats() const;
+
         /**
          * \internal Retrieve the specified section from this file.
          * If the section does not exist, throws format_error.
          */
-        std::shared_ptr<section> get_section(section_type type) const;
+        const std::shared_ptr<section> &get_section(section_type type) const;
+
+        /**
+         * \internal Retrieve the abbrev table at the given offset in
+         * .debug_abbrev, laid out for the format and address size of
+         * the unit data in unit_sec.  Each table is parsed at most
+         * once and shared by all units that use it.
+         */
+        std::shared_ptr<const abbrev_table>
+        get_abbrev_table(section_offset offset,
+                         const section &unit_sec) const;
+
+        /**
+         * \internal Return the table of interned source file paths
+         * shared by the line tables of this file.
+         */
+        path_table &get_path_table() const;
+
+        /**
+         * \internal Return the statistics of this file.
+         */
+        stats_block *get_stats_block() const;
+
+        /**
+         * \internal Find the split compilation unit for a skeleton
+         * unit of this file, whose DWO name and compilation
+         * directory are dwo_name and comp_dir.  If have_dwo_id, the
+         * split unit must have DWO ID dwo_id.  Returns an invalid
+         * unit if there is none.
+         */
+        compilation_unit find_split_unit(const std::string &dwo_name,
+                                         const std::string &comp_dir,
+                                         bool have_dwo_id,
+                                         std::uint64_t dwo_id) const;
 
 private:
         struct impl;
@@ -189,9 +534,50 @@ public:
          * valid and unchanged until the loader is destroyed.  If the
          * requested section does not exist, this should return
          * nullptr.  If the section exists but cannot be loaded for
-         * any reason, this should throw an exception.
+         * any reason, this should throw an exception.  The dwarf
+         * object never calls this concurrently.
          */
         virtual const void *load(section_type section, size_t *size_out) = 0;
+
+        /**
+         * Return the address of the given section in the target's
+         * address space, or 0 if it is not known.  This is needed to
+         * decode the PC-relative pointers in .eh_frame and
+         * .eh_frame_hdr.  Like load, this is never called
+         * concurrently.
+         */
+        virtual taddr get_address(section_type section)
+        {
+                return 0;
+        }
+
+        /**
+         * Return loaders for the files that may be the split DWARF
+         * file (.dwo) named by the DW_AT::dwo_name of a skeleton
+         * unit, in order of preference.  comp_dir is the skeleton's
+         * DW_AT::comp_dir, against which relative names are
+         * resolved.  The first file with a unit whose DWO ID matches
+         * the skeleton's is used, so a stale file in one place
+         * doesn't hide the right one in another.  Like load, this is
+         * never called concurrently.  The default finds no split
+         * DWARF files.
+         */
+        virtual std::vector<std::shared_ptr<loader> >
+        open_dwo(const std::string &dwo_name, const std::string &comp_dir)
+        {
+                return {};
+        }
+
+        /**
+         * Return a loader for the DWARF package (.dwp) of this file,
+         * or nullptr if it has none.  This is called at most once,
+         * the first time a split unit is needed, and is tried before
+         * open_dwo.  The default finds no package.
+         */
+        virtual std::shared_ptr<loader> open_dwp()
+        {
+                return nullptr;
+        }
 };
 
 /**
@@ -241,6 +627,30 @@ public:
          */
         const die &root() const;
 
+        /**
+         * Return a flattened, fully decoded copy of this unit's DIE
+         * tree.  The first call decodes every DIE in the unit once;
+         * later calls return the same table.  The table uses memory
+         * proportional to the number of DIEs and attributes in the
+         * unit and lives as long as the unit does, so this is meant
+         * for analyses that traverse the tree several times.
+         */
+        const die_table &materialize() const;
+
+        /**
+         * If this is a split unit returned by
+         * compilation_unit::get_split_unit, return its skeleton
+         * unit.  Otherwise, return nullptr.
+         */
+        const compilation_unit *get_skeleton_unit() const;
+
+        /**
+         * If this is a skeleton or split compilation unit, set *out
+         * to its DWO ID, which links the two, and return true.
+         * Otherwise, return false.
+         */
+        bool get_dwo_id(std::uint64_t *out) const;
+
         /**
          * \internal Return the data for this unit.
          */
@@ -252,6 +662,104 @@ public:
          */
         const abbrev_entry &get_abbrev(std::uint64_t acode) const;
 
+        /**
+         * \internal Return the kind of cursor that decodes this
+         * unit's data (see select_cursor_kind).
+         */
+        unsigned get_cursor_kind() const;
+
+        /**
+         * \internal Return the unit-relative offset of the DIE
+         * following the subtree of the DIE at unit-relative offset
+         * off, if it has been recorded by cache_sibling.  Otherwise,
+         * return 0.
+         */
+        section_offset get_cached_sibling(section_offset off) const;
+
+        /**
+         * \internal Record that the subtree of the DIE at
+         * unit-relative offset off ends at offset next.  The cache
+         * has a fixed size, so this may be silently dropped.
+         */
+        void cache_sibling(section_offset off, section_offset next) const;
+
+        /**
+         * \internal Return the DWARF version from this unit's header.
+         */
+        unsigned get_version() const;
+
+        /**
+         * \internal Return true if this unit came from a split DWARF
+         * file (.dwo or .dwp), so DWARF 4 location lists use the
+         * split format.
+         */
+        bool is_split() const;
+
+        /**
+         * \internal Return the base address of this unit for range
+         * and location lists, which is the DW_AT::low_pc of its root
+         * DIE or 0 if it has none.
+         */
+        taddr get_base_address() const;
+
+        /**
+         * \internal Return the compilation unit containing offset off
+         * in .debug_info, as referenced by DW_FORM::ref_addr from
+         * this unit.  Throws format_error if no unit contains off.
+         * Each unit remembers the last few units its references
+         * resolved to, since references from one unit tend to go
+         * to the same few others.
+         */
+        const compilation_unit &find_ref_target(section_offset off) const;
+
+        /**
+         * \internal Return the string at the given index in this
+         * unit's contribution to .debug_str_offsets, as referenced by
+         * the DW_FORM::strx forms (DWARF5 section 7.26).  If size_out
+         * is non-null, set it to the length of the string.
+         */
+        const char *get_strx(std::uint64_t index, size_t *size_out) const;
+
+        /**
+         * \internal Return the address at the given index in this
+         * unit's contribution to .debug_addr, as referenced by the
+         * DW_FORM::addrx forms (DWARF5 section 7.27).
+         */
+        taddr get_addrx(std::uint64_t index) const;
+
+        /**
+         * \internal Return the .debug_rnglists offset of the range
+         * list at the given index in this unit's range list offset
+         * table, as referenced by DW_FORM::rnglistx (DWARF5 section
+         * 7.28).
+         */
+        section_offset get_rnglistx(std::uint64_t index) const;
+
+        /**
+         * \internal Return the .debug_loclists offset of the
+         * location list at the given index in this unit's location
+         * list offset table, as referenced by DW_FORM::loclistx
+         * (DWARF5 section 7.29).
+         */
+        section_offset get_loclistx(std::uint64_t index) const;
+
+        /**
+         * \internal Return the .debug_ranges section that this
+         * unit's DWARF 4 range list offsets (DW_AT::ranges) refer
+         * to, and set *base to the offset they are relative to.
+         * For split units, this is the skeleton's section and
+         * DW_AT::GNU_ranges_base.  Otherwise, it's this unit's file's
+         * section and 0.
+         */
+        const std::shared_ptr<section> &
+        get_ranges_section(section_offset *base) const;
+
+        /**
+         * \internal Return the cache of compiled expressions of this
+         * unit and its location lists.
+         */
+        expr_cache &get_expr_cache() const;
+
 protected:
         friend struct ::std::hash<unit>;
         struct impl;
@@ -285,6 +793,36 @@ public:
          * table.
          */
         const line_table &get_line_table() const;
+
+        /**
+         * Return the index of the code scopes of this compilation
+         * unit.  The first call builds the index, which decodes
+         * every DIE in the unit once.  For a skeleton unit with a
+         * split unit, this is the split unit's scope index.
+         */
+        const scope_index &get_scope_index() const;
+
+        /**
+         * If this is a skeleton unit (DW_UT::skeleton, or a DWARF 4
+         * unit with DW_AT::GNU_dwo_name), return the split compilation
+         * unit that holds the rest of its DIEs.  Otherwise, or if
+         * the split unit can't be found, return nullptr.
+         *
+         * The first call for each skeleton looks the unit up in the
+         * file's DWARF package, if the loader provides one, or else
+         * opens the .dwo file named by the skeleton (see
+         * loader::open_dwp and loader::open_dwo).  Split units whose
+         * DWO ID doesn't match the skeleton's are ignored.  Later
+         * calls return the same unit, so only the skeletons that
+         * are asked for ever have their split units read.  Throws
+         * format_error if the split file or package index is
+         * malformed.
+         *
+         * The split unit reads addresses, DWARF 4 range lists, and
+         * its line table through this skeleton, so it's only valid
+         * as long as this unit's dwarf is.
+         */
+        const compilation_unit *get_split_unit() const;
 };
 
 /**
@@ -303,9 +841,12 @@ public:
 
         /**
          * \internal Construct a type unit whose header begins offset
-         * bytes into the .debug_types section of file.
+         * bytes into section sec of file.  sec must be
+         * section_type::types for DWARF 4 type units or
+         * section_type::info for DWARF 5 type units.
          */
-        type_unit(const dwarf &file, section_offset offset);
+        type_unit(const dwarf &file, section_offset offset,
+                  section_type sec = section_type::types);
 
         /**
          * Return the 64-bit unique signature that identifies this
@@ -344,7 +885,7 @@ class die
 public:
         DW_TAG tag;
 
-        die() : cu(nullptr), abbrev(nullptr) { }
+        die() : cu(nullptr), abbrev(nullptr), attr_base(0) { }
         die(const die &o) = default;
         die(die &&o) = default;
 
@@ -417,10 +958,24 @@ public:
         iterator end() const;
 
         /**
-         * Return a vector of the attributes of this DIE.
+         * Return a vector of the attributes of this DIE.  This
+         * allocates a new vector for every call; when visiting many
+         * DIEs, each_attribute is much faster.
          */
         const std::vector<std::pair<DW_AT, value> > attributes() const;
 
+        class attribute_iterator;
+        class attribute_range;
+
+        /**
+         * Return a range over the attributes of this DIE, in the
+         * same order as attributes().  Unlike attributes(), this
+         * never allocates; each value is constructed as the iterator
+         * reaches it.  The range refers to this DIE, so it must not
+         * outlive it.
+         */
+        attribute_range each_attribute() const;
+
         bool operator==(const die &o) const;
         bool operator!=(const die &o) const;
 
@@ -428,6 +983,9 @@ private:
         friend class unit;
         friend class type_unit;
         friend class value;
+        friend class die_table;
+        friend class name_index;
+        friend class scope_index;
         // XXX If we can get the CU, we don't need this
         friend struct ::std::hash<die>;
 
@@ -438,9 +996,13 @@ private:
         const abbrev_entry *abbrev;
         // The beginning of this DIE, relative to the CU.
         section_offset offset;
-        // Offsets of attributes, relative to cu's subsection.  The
-        // vast majority of DIEs tend to have six or fewer attributes,
-        // so we reserve space in the DIE itself for six attributes.
+        // The offset of the first attribute, relative to cu's
+        // subsection.  The offsets of the leading fixed-size
+        // attributes (see abbrev_entry::nfixed) follow from this.
+        section_offset attr_base;
+        // Offsets of the remaining attributes, relative to cu's
+        // subsection.  Most attributes are fixed-size, so nearly all
+        // DIEs have six or fewer of these and this never allocates.
         small_vector<section_offset, 6> attrs;
         // The offset of the next DIE, relative to cu'd subsection.
         // This is set even for sibling list terminators.
@@ -452,6 +1014,12 @@ private:
          * Read this DIE from the given offset in cu.
          */
         void read(section_offset off);
+
+        /**
+         * Return the offset of attribute i, relative to cu's
+         * subsection.
+         */
+        section_offset attr_offset(unsigned i) const;
 };
 
 /**
@@ -666,7 +1234,17 @@ public:
          */
         bool as_flag() const;
 
-        // XXX loclistptr, macptr
+        // XXX macptr
+
+        /**
+         * Return this value as a location list.  Since location
+         * attributes may hold either a location list or a single
+         * location description, this also accepts exprloc values
+         * (and, prior to DWARF 4, block values), which it returns
+         * as a location list whose only location is valid at every
+         * PC.
+         */
+        loclist as_loclist() const;
 
         /**
          * Return this value as a rangelist.
@@ -701,14 +1279,32 @@ public:
          */
         const char *as_cstr(size_t *size_out = nullptr) const;
 
+#if __cplusplus >= 201703L
+        /**
+         * Return this value as a string_view.  Like as_cstr, this
+         * points directly into the section data rather than copying.
+         */
+        std::string_view as_string_view() const
+        {
+                size_t size;
+                const char *s = as_cstr(&size);
+                return std::string_view(s, size);
+        }
+#endif
+
         /**
          * Return this value as a section offset.  This is applicable
-         * to lineptr, loclistptr, macptr, and rangelistptr.
+         * to lineptr, loclistptr, macptr, and rangelistptr.  For the
+         * DWARF 5 DW_FORM::rnglistx and DW_FORM::loclistx forms, this
+         * looks up the index in the unit's offset table and returns
+         * the offset in .debug_rnglists or .debug_loclists.
          */
         section_offset as_sec_offset() const;
 
 private:
         friend class die;
+        friend class die::attribute_iterator;
+        friend class die_table;
 
         value(const unit *cu,
               const attribute_spec &spec, section_offset offset);
@@ -729,6 +1325,105 @@ to_string(value::type v);
 std::string
 to_string(const value &v);
 
+/**
+ * An iterator over the attributes of a DIE.  The pair returned by
+ * operator* is held by the iterator and replaced by operator++.
+ */
+class die::attribute_iterator
+{
+public:
+        typedef std::pair<DW_AT, value> value_type;
+        typedef std::ptrdiff_t difference_type;
+        typedef const value_type *pointer;
+        typedef const value_type &reference;
+        typedef std::forward_iterator_tag iterator_category;
+
+        attribute_iterator() : d(nullptr), i(0) { }
+
+        const value_type &operator*() const
+        {
+                return cur;
+        }
+
+        const value_type *operator->() const
+        {
+                return &cur;
+        }
+
+        bool operator==(const attribute_iterator &o) const
+        {
+                return i == o.i && d == o.d;
+        }
+
+        bool operator!=(const attribute_iterator &o) const
+        {
+                return !(*this == o);
+        }
+
+        attribute_iterator &operator++()
+        {
+                ++i;
+                load();
+                return *this;
+        }
+
+        attribute_iterator operator++(int)
+        {
+                attribute_iterator tmp(*this);
+                ++*this;
+                return tmp;
+        }
+
+private:
+        friend class die;
+
+        attribute_iterator(const die *d, unsigned i) : d(d), i(i)
+        {
+                load();
+        }
+
+        void load();
+
+        const die *d;
+        unsigned i;
+        value_type cur;
+};
+
+/**
+ * The attributes of a DIE, as returned by die::each_attribute.
+ */
+class die::attribute_range
+{
+public:
+        attribute_iterator begin() const
+        {
+                return attribute_iterator(d, 0);
+        }
+
+        attribute_iterator end() const
+        {
+                return attribute_iterator(d, n);
+        }
+
+        size_t size() const
+        {
+                return n;
+        }
+
+        bool empty() const
+        {
+                return n == 0;
+        }
+
+private:
+        friend class die;
+
+        attribute_range(const die *d, unsigned n) : d(d), n(n) { }
+
+        const die *d;
+        unsigned n;
+};
+
 //////////////////////////////////////////////////////////////////
 // Expressions and location descriptions
 //
@@ -746,7 +1441,11 @@ public:
 };
 
 /**
- * A DWARF expression or location description.
+ * A DWARF expression or location description.  Expressions from a
+ * unit (including its location lists) or from call frame information
+ * are decoded on their first evaluation and kept in compiled form by
+ * their unit or cfi, so evaluating the same expression again doesn't
+ * decode it again.
  */
 class expr
 {
@@ -774,51 +1473,128 @@ public:
          */
         expr_result evaluate(expr_context *ctx, const std::initializer_list<taddr> &arguments) const;
 
+        /**
+         * Decode this expression into a compiled_expr, which can be
+         * evaluated repeatedly without decoding it again.
+         */
+        compiled_expr compile() const;
+
 private:
         // XXX This will need more information for some operations
         expr(const unit *cu,
              section_offset offset, section_length len);
+        // An expression outside of any unit, such as in call frame
+        // information.  sec and cache, which may be null, must
+        // outlive this object.
+        expr(const section *sec,
+             section_offset offset, section_length len,
+             expr_cache *cache = nullptr);
+
+        // An expression in a location list.  sec must outlive this
+        // object.
+        expr(const unit *cu, const section *sec,
+             section_offset offset, section_length len);
 
         friend class value;
+        friend class cfi_rule;
+        friend class loclist;
+        friend struct expr_program;
+        friend struct expr_cache;
 
         const unit *cu;
+        const section *sec;
         section_offset offset;
         section_length len;
+        // Where to keep the compiled form of this expression, or
+        // nullptr to decode it on every evaluation
+        expr_cache *cache;
 };
 
 /**
- * An interface that provides contextual information for expression
- * evaluation.  Callers of expr::evaluate are expected to subclass
- * this in order to provide this information to the expression
- * evaluation engine.  The default implementation throws expr_error
- * for all methods.
+ * A DWARF expression decoded once into an array of operations with
+ * their operands and branch targets resolved, so that it can be
+ * evaluated many times, for example with different register values,
+ * without decoding it again.  Evaluation does not allocate unless the
+ * expression stack grows unusually deep.
+ *
+ * Evaluating a compiled_expr gives the same results and throws the
+ * same exceptions as evaluating the expr it was compiled from.
+ * Decoding errors, such as a truncated operand, are raised when
+ * evaluation reaches the malformed operation, just as for expr.
+ * Compiled expressions are immutable, so they may be evaluated
+ * concurrently, and copies share the decoded operations.
  */
-class expr_context
+class compiled_expr
 {
 public:
-        virtual ~expr_context() { }
+        /**
+         * Construct an empty expression, whose evaluation gives an
+         * empty location.
+         */
+        compiled_expr() = default;
 
         /**
-         * Return the value stored in register regnum.  This is used
-         * to implement DW_OP_breg* operations.
+         * Decode e.  This is equivalent to e.compile().
          */
-        virtual taddr reg(unsigned regnum)
-        {
-                throw expr_error("DW_OP_breg* operations not supported");
-        }
+        explicit compiled_expr(const expr &e);
 
         /**
-         * Implement DW_OP_deref_size.
+         * Short-hand for evaluate(ctx, {}).
          */
-        virtual taddr deref_size(taddr address, unsigned size)
-        {
-                throw expr_error("DW_OP_deref_size operations not supported");
-        }
+        expr_result evaluate(expr_context *ctx) const;
 
         /**
-         * Implement DW_OP_xderef_size.
+         * Short-hand for evaluate(ctx, {argument}).
          */
-        virtual taddr xderef_size(taddr address, taddr asid, unsigned size)
+        expr_result evaluate(expr_context *ctx, taddr argument) const;
+
+        /**
+         * Evaluate this expression like expr::evaluate.
+         */
+        expr_result evaluate(expr_context *ctx, const std::initializer_list<taddr> &arguments) const;
+
+        /**
+         * Return the number of decoded operations.
+         */
+        size_t size() const;
+
+private:
+        std::shared_ptr<const expr_program> m;
+};
+
+/**
+ * An interface that provides contextual information for expression
+ * evaluation.  Callers of expr::evaluate are expected to subclass
+ * this in order to provide this information to the expression
+ * evaluation engine.  The default implementation throws expr_error
+ * for all methods.
+ */
+class expr_context
+{
+public:
+        virtual ~expr_context() { }
+
+        /**
+         * Return the value stored in register regnum.  This is used
+         * to implement DW_OP_breg* operations.
+         */
+        virtual taddr reg(unsigned regnum)
+        {
+                throw expr_error("DW_OP_breg* operations not supported");
+        }
+
+        /**
+         * Implement DW_OP_deref_size.
+         */
+        virtual taddr deref_size(taddr address, unsigned size)
+        {
+                throw expr_error("DW_OP_deref_size operations not supported");
+        }
+
+        /**
+         * Implement DW_OP_xderef_size.
+         */
+        virtual taddr xderef_size(taddr address, taddr asid, unsigned size)
         {
                 throw expr_error("DW_OP_xderef_size operations not supported");
         }
@@ -830,6 +1606,15 @@ public:
         {
                 throw expr_error("DW_OP_form_tls_address operations not supported");
         }
+
+        /**
+         * Implement DW_OP_call_frame_cfa.  See cfi_expr_context for
+         * an implementation based on call frame information.
+         */
+        virtual taddr call_frame_cfa()
+        {
+                throw expr_error("DW_OP_call_frame_cfa operations not supported");
+        }
 };
 
 /**
@@ -923,10 +1708,13 @@ public:
          * DW_AT::low_pc attribute of the compilation unit containing
          * the referring DIE or 0 (this is used as the base address of
          * the range list).  is_dwarf5 indicates whether this uses
-         * DWARF 5 format (DW_RLE_* encodings).
+         * DWARF 5 format (DW_RLE_* encodings).  cu, if given, is the
+         * unit whose .debug_addr entries DWARF 5 indexed entries
+         * refer to; it must remain live as long as this range list.
          */
         rangelist(const std::shared_ptr<section> &sec, section_offset off,
-                  unsigned cu_addr_size, taddr cu_low_pc, bool is_dwarf5 = false);
+                  unsigned cu_addr_size, taddr cu_low_pc, bool is_dwarf5 = false,
+                  const unit *cu = nullptr);
 
         /**
          * Construct a range list from a sequence of {low, high}
@@ -976,6 +1764,7 @@ private:
         std::shared_ptr<section> sec;
         taddr base_addr;
         bool is_dwarf5;
+        const unit *cu;
 };
 
 /**
@@ -1004,15 +1793,18 @@ public:
         /**
          * \internal Construct an end iterator.
          */
-        iterator() : sec(nullptr), base_addr(0), pos(0), is_dwarf5(false) { }
+        iterator() : sec(nullptr), base_addr(0), pos(0), is_dwarf5(false),
+                     cu(nullptr) { }
 
         /**
          * \internal Construct an iterator that reads rangelist data
          * from the beginning of the given section and starts with the
          * given base address.  is_dwarf5 indicates whether to use
-         * DWARF 5 format parsing (DW_RLE_* encodings).
+         * DWARF 5 format parsing (DW_RLE_* encodings).  cu is used
+         * to resolve DWARF 5 address indexes.
          */
-        iterator(const std::shared_ptr<section> &sec, taddr base_addr, bool is_dwarf5 = false);
+        iterator(const std::shared_ptr<section> &sec, taddr base_addr, bool is_dwarf5 = false,
+                 const unit *cu = nullptr);
 
         /** Copy constructor */
         iterator(const iterator &o) = default;
@@ -1057,11 +1849,297 @@ public:
         iterator &operator++();
 
 private:
+        taddr get_addrx(std::uint64_t index) const;
+
         std::shared_ptr<section> sec;
         taddr base_addr;
         section_offset pos;
         rangelist::entry entry;
         bool is_dwarf5;
+        const unit *cu;
+};
+
+/**
+ * A decoded range list, stored as a sorted vector of disjoint,
+ * non-adjacent ranges.  Unlike rangelist, which decodes its entries
+ * on every traversal, this is decoded once and supports O(log n)
+ * queries.  The ranges are immutable and shared between copies, so
+ * copying is cheap and the object is safe to use from any number of
+ * threads.
+ */
+class compact_rangelist
+{
+public:
+        typedef rangelist::entry value_type;
+        typedef std::vector<rangelist::entry>::const_iterator iterator;
+
+        /**
+         * Construct an empty range list.
+         */
+        compact_rangelist() = default;
+
+        /**
+         * Decode rl, sorting its entries and merging entries that
+         * overlap or abut.  Empty entries are dropped.
+         */
+        explicit compact_rangelist(const rangelist &rl);
+
+        /**
+         * Construct a range list from a sequence of {low, high}
+         * pairs, which need not be sorted or disjoint.
+         */
+        compact_rangelist(const std::initializer_list<std::pair<taddr, taddr> > &ranges);
+
+        /**
+         * Construct a range list from a vector of entries, which need
+         * not be sorted or disjoint.
+         */
+        explicit compact_rangelist(std::vector<rangelist::entry> ranges);
+
+        iterator begin() const;
+        iterator end() const;
+
+        /**
+         * Return the number of disjoint ranges.
+         */
+        size_t size() const
+        {
+                return ranges ? ranges->size() : 0;
+        }
+
+        bool empty() const
+        {
+                return size() == 0;
+        }
+
+        /**
+         * Return the i'th range, in increasing address order.
+         */
+        const rangelist::entry &operator[](size_t i) const
+        {
+                return (*ranges)[i];
+        }
+
+        /**
+         * Return true if this range list contains the given address.
+         */
+        bool contains(taddr addr) const;
+
+        /**
+         * Return true if any range in this list intersects
+         * [low, high).
+         */
+        bool overlaps(taddr low, taddr high) const;
+
+        /**
+         * Return true if this range list and o have any address in
+         * common.  This takes time linear in the smaller list and
+         * logarithmic in the larger one.
+         */
+        bool overlaps(const compact_rangelist &o) const;
+
+        /**
+         * Return the addresses this range list and o have in common.
+         */
+        compact_rangelist intersect(const compact_rangelist &o) const;
+
+        /**
+         * Return the number of the n sorted addresses in addrs that
+         * this range list contains.  If out is non-null, set out[i]
+         * to whether addrs[i] is contained.  This makes one merged
+         * pass over addrs and the ranges.
+         */
+        size_t contains(const taddr *addrs, size_t n, bool *out = nullptr) const;
+
+private:
+        std::shared_ptr<const std::vector<rangelist::entry> > ranges;
+
+        void init(std::vector<rangelist::entry> &&ranges);
+};
+
+//////////////////////////////////////////////////////////////////
+// Location lists
+//
+
+/**
+ * A DWARF location list (DWARF4 section 2.6.2, DWARF5 section
+ * 2.6.2), which gives the location of an object as a function of the
+ * PC.  Each entry gives a location expression that is valid over a
+ * range of addresses.  A DWARF 5 list may also have a default
+ * location, which applies where no entry does.
+ *
+ * The list is decoded once on construction, resolving base address
+ * entries and address indexes the same way as rangelist, so lookups
+ * don't touch the encoded list.  Copies share the decoded entries.
+ */
+class loclist
+{
+public:
+        class entry;
+        typedef entry value_type;
+        typedef std::vector<entry>::const_iterator iterator;
+
+        /**
+         * Construct an empty location list, which gives no location
+         * at any PC.
+         */
+        loclist() = default;
+
+        /**
+         * \internal Decode the location list at offset off in
+         * cu's .debug_loc (DWARF 4 and earlier) or .debug_loclists
+         * (DWARF 5) section.
+         */
+        loclist(const unit *cu, section_offset off);
+
+        /**
+         * Construct a location list whose only location is loc,
+         * valid at every PC.
+         */
+        explicit loclist(const expr &loc);
+
+        /**
+         * Return an iterator over the bounded entries of this list,
+         * in list order.  Entries with empty ranges are omitted.
+         */
+        iterator begin() const;
+        iterator end() const;
+
+        /**
+         * Return the number of bounded entries.
+         */
+        size_t size() const;
+
+        /**
+         * Return the default location of this list, or nullptr if
+         * it has none.  For a list constructed from a single
+         * location, this is that location.
+         */
+        const expr *get_default() const;
+
+        /**
+         * Return the location expression valid at pc: that of the
+         * first entry in list order whose range contains pc, or the
+         * default location if there is no such entry.  Returns
+         * nullptr if the object has no location at pc.  This is a
+         * binary search for the usual case of sorted,
+         * non-overlapping entries.
+         */
+        const expr *find(taddr pc) const;
+
+private:
+        struct impl;
+        std::shared_ptr<const impl> m;
+};
+
+/**
+ * An entry in a location list.
+ */
+class loclist::entry
+{
+public:
+        /**
+         * The addresses over which location is valid, as [low,
+         * high).
+         */
+        taddr low, high;
+
+        /**
+         * The location expression.
+         */
+        expr location;
+
+        /**
+         * Return true if addr is within this entry's bounds.
+         */
+        bool contains(taddr addr) const
+        {
+                return low <= addr && addr < high;
+        }
+};
+
+/**
+ * The locations of the variables and formal parameters of a scope,
+ * for looking up where all of them are at a given PC.
+ *
+ * This collects the DW_TAG::variable and DW_TAG::formal_parameter
+ * DIEs with a DW_AT::location that belong to a scope DIE, such as a
+ * subprogram or inlined subroutine, including those of nested
+ * lexical blocks but not those of nested subprograms or inlined
+ * subroutines.  Each variable's location is decoded into a loclist
+ * once, so looking up a PC is a single pass over the variables with
+ * a binary search for each.
+ */
+class scope_locations
+{
+public:
+        class variable;
+        class location;
+
+        /**
+         * Collect the variables of scope.
+         */
+        explicit scope_locations(const die &scope);
+
+        // Variables point into blocks
+        scope_locations(const scope_locations &) = delete;
+        scope_locations &operator=(const scope_locations &) = delete;
+
+        /**
+         * Return the variables of this scope, in DIE order.
+         */
+        const std::vector<variable> &variables() const
+        {
+                return vars;
+        }
+
+        /**
+         * Store the variables that have a location at pc in *out,
+         * in DIE order, and return the number of them.  A variable
+         * of a nested lexical block only has a location at PCs in
+         * the block.
+         */
+        size_t find(taddr pc, std::vector<location> *out) const;
+
+private:
+        std::vector<variable> vars;
+        // The ranges of the lexical blocks variables belong to.
+        // This never reallocates after construction.
+        std::vector<compact_rangelist> blocks;
+};
+
+/**
+ * A variable or formal parameter of a scope.
+ */
+class scope_locations::variable
+{
+public:
+        /**
+         * The DIE of the variable.
+         */
+        die var;
+
+        /**
+         * The decoded DW_AT::location of the variable.
+         */
+        loclist locations;
+
+        /**
+         * The ranges of the innermost nested lexical block the
+         * variable belongs to, or nullptr if it directly belongs to
+         * the scope.
+         */
+        const compact_rangelist *block;
+};
+
+/**
+ * The location of a variable at a PC.
+ */
+class scope_locations::location
+{
+public:
+        const variable *var;
+        const expr *location;
 };
 
 //////////////////////////////////////////////////////////////////
@@ -1140,13 +2218,34 @@ public:
          * (roughly, the entry with the highest address less than or
          * equal to addr, but accounting for end_sequence entries).
          * Returns end() if there is no such entry.
+         *
+         * By default, this executes the line number program from the
+         * beginning on every call.  See use_address_index.
          */
         iterator find_address(taddr addr) const;
 
+        /**
+         * Enable or disable the address index used by find_address.
+         * When enabled, the next find_address executes the line
+         * number program once to build a sorted array of address
+         * ranges and the rows they map to, and every later
+         * find_address is a binary search over this array.  The
+         * index costs memory proportional to the number of rows in
+         * the table, so it is off by default.  Line table objects
+         * are handles to shared state, so this affects every copy of
+         * this line table.  This is the one method of line_table
+         * that must not be called concurrently with other methods
+         * of it.
+         */
+        void use_address_index(bool enable = true) const;
+
         /**
          * Return the index'th file in the line table.  These indexes
          * are typically used by declaration and call coordinates.  If
-         * index is out of range, throws out_of_range.
+         * index is out of range, throws out_of_range.  Files defined
+         * by DW_LNE::define_file in the line number program (before
+         * DWARF 5) follow those of the header, and are only known
+         * once an iterator has executed their definitions.
          */
         const file *get_file(unsigned index) const;
 
@@ -1164,9 +2263,21 @@ class line_table::file
 {
 public:
         /**
-         * The absolute path of this source file.
+         * The name of this source file as recorded in the line
+         * table.  Unless this is an absolute path, it is relative to
+         * include directory dir_index.  This points directly into
+         * the section data.
          */
-        std::string path;
+        const char *name;
+
+        /**
+         * The index of the include directory containing this source
+         * file.  For the implicit entry for the compilation unit's
+         * own source file, this may be past the end of the directory
+         * table, meaning that name is relative to the compilation
+         * directory.
+         */
+        unsigned dir_index;
 
         /**
          * The last modification time of this source file in an
@@ -1180,9 +2291,39 @@ public:
         uint64_t length;
 
         /**
-         * Construct a source file object.
+         * Return the absolute path of this source file.  The path is
+         * joined from its include directory and name when it is
+         * first requested and interned in a table shared by all line
+         * tables of the dwarf file, so each distinct path is stored
+         * once.  Two files have the same path exactly when path()
+         * returns the same string object or, equivalently, path_id()
+         * returns the same value.
+         */
+        const std::string &path() const;
+
+        /**
+         * Return the identifier of path() in the dwarf file's path
+         * table.  Identifiers are dense, starting at 0, in the order
+         * paths were first requested.
+         */
+        unsigned path_id() const;
+
+        /**
+         * \internal Construct a source file object of the given
+         * line table.
          */
-        file(std::string path = "", uint64_t mtime = 0, uint64_t length = 0);
+        file(const line_table::impl *table, const char *name,
+             unsigned dir_index, uint64_t mtime, uint64_t length);
+
+        file(const file &o);
+        file &operator=(const file &o);
+
+private:
+        const line_table::impl *table;
+        // The interned path, once joined, and its identifier.  The
+        // identifier is set before the path is published.
+        mutable std::atomic<const std::string *> joined;
+        mutable unsigned joined_id;
 };
 
 /**
@@ -1349,26 +2490,283 @@ public:
         }
 
 private:
+        friend class line_table;
+
         const line_table *table;
         line_table::entry entry, regs;
         section_offset pos;
 
+        /**
+         * Construct an iterator for the given line table that has
+         * just emitted entry and will continue at pos.
+         */
+        iterator(const line_table *table, const line_table::entry &entry,
+                 section_offset pos);
+
         /**
          * Process the next opcode.  If the opcode "adds a row to the
          * table", update entry to reflect the row and return true.
          */
-        bool step(cursor *cur);
+        template<typename Cursor> void advance();
+        template<typename Cursor> bool step(Cursor *cur);
 };
 
 //////////////////////////////////////////////////////////////////
-// Type-safe attribute getters
+// Call frame information
 //
 
-// XXX More
+/**
+ * A rule for recovering a register (or, for cfi_row::cfa, the
+ * canonical frame address) of the caller's frame (DWARF4 section
+ * 6.4.1).
+ */
+class cfi_rule
+{
+public:
+        enum class type : unsigned char
+        {
+                /**
+                 * No rule was given for this register.  How to
+                 * recover it is up to the ABI (usually "same value"
+                 * for callee-saved registers).
+                 */
+                unspecified,
+                /**
+                 * The register's previous value can't be recovered.
+                 */
+                undefined,
+                /**
+                 * The register has not been modified from the
+                 * previous frame.
+                 */
+                same_value,
+                /**
+                 * The previous value is saved at address CFA+offset.
+                 */
+                offset,
+                /**
+                 * The previous value is CFA+offset.
+                 */
+                val_offset,
+                /**
+                 * The previous value is stored in register reg.  For
+                 * the CFA rule, CFA = value of register reg + offset.
+                 */
+                reg,
+                /**
+                 * The previous value is saved at the address computed
+                 * by get_expr(), which is evaluated with the CFA on
+                 * the stack.
+                 */
+                expression,
+                /**
+                 * The previous value is the value computed by
+                 * get_expr(), which is evaluated with the CFA on the
+                 * stack.  For the CFA rule, CFA is the value computed
+                 * by get_expr() with an empty stack.
+                 */
+                val_expression,
+        };
 
-die at_abstract_origin(const die &d);
-DW_ACCESS at_accessibility(const die &d);
-uint64_t at_allocated(const die &d, expr_context *ctx);
+        cfi_rule()
+                : kind(type::unspecified), reg(0), offset(0),
+                  sec(nullptr), expr_offset(0), expr_len(0),
+                  exprs(nullptr) { }
+
+        type kind;
+        unsigned reg;
+        std::int64_t offset;
+
+        /**
+         * Return the DWARF expression of an expression or
+         * val_expression rule.
+         */
+        expr get_expr() const;
+
+private:
+        friend struct cfi_interp;
+
+        const section *sec;
+        section_offset expr_offset;
+        section_length expr_len;
+        // The cfi's compiled expressions
+        expr_cache *exprs;
+};
+
+/**
+ * A row of the call frame information table: the rules for
+ * recovering the caller's CFA and registers for every PC in [loc,
+ * end).  Only registers with explicit rules are stored.
+ */
+class cfi_row
+{
+public:
+        struct reg_rule
+        {
+                unsigned regnum;
+                cfi_rule rule;
+        };
+
+        /**
+         * The range of PCs this row applies to.
+         */
+        taddr loc, end;
+
+        /**
+         * The rule for computing the CFA.  This is always a reg or a
+         * val_expression rule.
+         */
+        cfi_rule cfa;
+
+        /**
+         * The register that holds the return address, from the CIE.
+         */
+        unsigned return_address_register;
+
+        /**
+         * True if this frame is a signal handler frame (the "S"
+         * augmentation), in which case the return address is the
+         * address of the next instruction to execute rather than a
+         * call's return address.
+         */
+        bool signal_frame;
+
+        cfi_row()
+                : loc(0), end(0), return_address_register(0),
+                  signal_frame(false) { }
+
+        /**
+         * Return the rule for register regnum.  If this row has no
+         * rule for regnum, returns a rule of type unspecified.
+         */
+        cfi_rule get_rule(unsigned regnum) const;
+
+        /**
+         * Return the registers that have explicit rules in this row.
+         */
+        const small_vector<reg_rule, 16> &rules() const
+        {
+                return regs;
+        }
+
+        /**
+         * Compute the CFA of this row using the register values in
+         * ctx.
+         */
+        taddr get_cfa(expr_context *ctx) const;
+
+private:
+        friend struct cfi_interp;
+
+        small_vector<reg_rule, 16> regs;
+
+        void set_rule(unsigned regnum, const cfi_rule &rule);
+};
+
+/**
+ * Call frame information from .eh_frame and .debug_frame (DWARF4
+ * section 6.4).
+ *
+ * FDEs covering a PC are found by binary search, using the sorted
+ * table in .eh_frame_hdr if there is one, or otherwise an index
+ * built from the FDE headers on first use.  CIEs are decoded, and
+ * their initial instructions executed, once each and cached, so a
+ * lookup only has to run the FDE's own instructions up to the PC.
+ * Lookups are thread-safe.
+ */
+class cfi
+{
+public:
+        /**
+         * Construct call frame information that is initially not
+         * valid.
+         */
+        cfi() = default;
+
+        bool valid() const
+        {
+                return !!m;
+        }
+
+        /**
+         * Find the row that applies to pc and store it in *row.  If
+         * no FDE covers pc, returns false.  Throws format_error if
+         * the call frame information is malformed.
+         */
+        bool find_row(taddr pc, cfi_row *row) const;
+
+        /**
+         * Return the CFA at pc, computed using the register values
+         * in ctx.  Throws out_of_range if no FDE covers pc.
+         */
+        taddr get_cfa(taddr pc, expr_context *ctx) const;
+
+private:
+        friend class dwarf;
+
+        struct impl;
+        std::shared_ptr<impl> m;
+
+        cfi(const std::shared_ptr<section> &eh_frame, taddr eh_frame_addr,
+            const std::shared_ptr<section> &eh_frame_hdr, taddr eh_frame_hdr_addr,
+            const std::shared_ptr<section> &debug_frame, unsigned addr_size);
+};
+
+/**
+ * An expression context that implements DW_OP_call_frame_cfa using
+ * call frame information at a given PC, forwarding all other
+ * requests to another context.
+ */
+class cfi_expr_context : public expr_context
+{
+        const cfi &frames;
+        taddr pc;
+        expr_context *inner;
+
+public:
+        /**
+         * Construct a context for evaluating expressions at pc.
+         * inner provides registers and memory; it must outlive this
+         * object.
+         */
+        cfi_expr_context(const cfi &frames, taddr pc, expr_context *inner)
+                : frames(frames), pc(pc), inner(inner) { }
+
+        taddr reg(unsigned regnum)
+        {
+                return inner->reg(regnum);
+        }
+
+        taddr deref_size(taddr address, unsigned size)
+        {
+                return inner->deref_size(address, size);
+        }
+
+        taddr xderef_size(taddr address, taddr asid, unsigned size)
+        {
+                return inner->xderef_size(address, asid, size);
+        }
+
+        taddr form_tls_address(taddr address)
+        {
+                return inner->form_tls_address(address);
+        }
+
+        taddr call_frame_cfa()
+        {
+                return frames.get_cfa(pc, inner);
+        }
+};
+
+//////////////////////////////////////////////////////////////////
+// Type-safe attribute getters
+//
+
+// XXX More
+
+die at_abstract_origin(const die &d);
+DW_ACCESS at_accessibility(const die &d);
+uint64_t at_allocated(const die &d, expr_context *ctx);
 bool at_artificial(const die &d);
 uint64_t at_associated(const die &d, expr_context *ctx);
 uint64_t at_bit_offset(const die &d, expr_context *ctx);
@@ -1396,6 +2794,7 @@ bool at_enum_class(const die &d);
 bool at_explicit(const die &d);
 die at_extension(const die &d);
 bool at_external(const die &d);
+expr_result at_frame_base(const die &d, expr_context *ctx, taddr pc);
 die at_friend(const die &d);
 taddr at_high_pc(const die &d);
 DW_ID at_identifier_case(const die &d);
@@ -1404,6 +2803,7 @@ DW_INL at_inline(const die &d);
 bool at_is_optional(const die &d);
 DW_LANG at_language(const die &d);
 std::string at_linkage_name(const die &d);
+expr_result at_location(const die &d, expr_context *ctx, taddr pc);
 taddr at_low_pc(const die &d);
 uint64_t at_lower_bound(const die &d, expr_context *ctx);
 bool at_main_subprogram(const die &d);
@@ -1431,6 +2831,48 @@ bool at_variable_parameter(const die &d);
 DW_VIRTUALITY at_virtuality(const die &d);
 DW_VIS at_visibility(const die &d);
 
+#if __cplusplus >= 201703L
+/**
+ * Variants of the string attribute getters that return a view of the
+ * string in the section data instead of copying it.
+ */
+inline std::string_view
+at_comp_dir_view(const die &d)
+{
+        return d[DW_AT::comp_dir].as_string_view();
+}
+
+inline std::string_view
+at_description_view(const die &d)
+{
+        return d[DW_AT::description].as_string_view();
+}
+
+inline std::string_view
+at_linkage_name_view(const die &d)
+{
+        return d[DW_AT::linkage_name].as_string_view();
+}
+
+inline std::string_view
+at_name_view(const die &d)
+{
+        return d[DW_AT::name].as_string_view();
+}
+
+inline std::string_view
+at_picture_string_view(const die &d)
+{
+        return d[DW_AT::picture_string].as_string_view();
+}
+
+inline std::string_view
+at_producer_view(const die &d)
+{
+        return d[DW_AT::producer].as_string_view();
+}
+#endif
+
 /**
  * Return the PC range spanned by the code of a DIE.  The DIE must
  * either have DW_AT::ranges or DW_AT::low_pc.  It may optionally have
@@ -1438,13 +2880,621 @@ DW_VIS at_visibility(const die &d);
  */
 rangelist die_pc_range(const die &d);
 
+/**
+ * Return the PC range spanned by the code of a DIE like
+ * die_pc_range, but decoded into a compact_rangelist.  Unlike
+ * die_pc_range, this returns an empty list if the DIE has neither
+ * DW_AT::ranges nor DW_AT::low_pc.
+ */
+compact_rangelist die_compact_pc_range(const die &d);
+
+//////////////////////////////////////////////////////////////////
+// PC symbolization
+//
+
+/**
+ * The source-level description of a PC, as returned by
+ * dwarf::symbolize.
+ */
+class pc_info
+{
+public:
+        /**
+         * The described PC.
+         */
+        taddr pc;
+
+        /**
+         * The compilation unit whose code contains pc, or nullptr if
+         * no unit covers it.  In the latter case, the other fields
+         * are empty.  For split DWARF, this is the skeleton unit,
+         * and the frame DIEs are in its split unit.
+         */
+        const compilation_unit *cu;
+
+        /**
+         * True if the unit's line table has a row covering pc.
+         */
+        bool has_line;
+
+        /**
+         * The line table row covering pc, which gives its file,
+         * line, and column.  This is only meaningful if has_line is
+         * true.
+         */
+        line_table::entry line;
+
+        pc_info() : pc(0), cu(nullptr), has_line(false), line() { }
+
+        /**
+         * Return the DW_TAG::subprogram and DW_TAG::inlined_subroutine
+         * DIEs containing pc, innermost first.  The first DIE is the
+         * inlined subroutine or subprogram pc is in; each following
+         * DIE is the one the previous was inlined into or nested in.
+         * The last is normally the DW_TAG::subprogram.  This is
+         * empty if no subprogram in the unit covers pc.
+         *
+         * All PCs whose innermost DIE is the same share one copy of
+         * this vector, so results for large PC sets take space
+         * proportional to the number of distinct functions.
+         */
+        const std::vector<die> &frames() const;
+
+        /**
+         * Return the outermost DIE in frames(), which is normally
+         * the DW_TAG::subprogram containing pc, or nullptr if
+         * frames() is empty.
+         */
+        const die *subprogram() const
+        {
+                const std::vector<die> &f = frames();
+                if (f.empty())
+                        return nullptr;
+                return &f.back();
+        }
+
+private:
+        friend struct die_sweep;
+
+        std::shared_ptr<const std::vector<die> > chain;
+};
+
+/**
+ * An index of the code scopes of a compilation unit: the address
+ * ranges of its DW_TAG::subprogram, DW_TAG::inlined_subroutine, and
+ * DW_TAG::lexical_block DIEs, arranged as a forest of nested
+ * intervals.  Finding the scopes that contain a PC takes
+ * O(log n + depth) time and decodes no DIEs.
+ *
+ * Indexes are retrieved with compilation_unit::get_scope_index and
+ * are kept live by their unit.  Indexes are immutable and hence safe
+ * to use from any number of threads.
+ */
+class scope_index
+{
+public:
+        class entry;
+
+        scope_index() : cu(nullptr) { }
+
+        /**
+         * \internal Build the scope index of cu.
+         */
+        explicit scope_index(const compilation_unit *cu);
+
+        // Entries point into scope_ranges
+        scope_index(const scope_index &) = delete;
+        scope_index &operator=(const scope_index &) = delete;
+
+        /**
+         * Return the number of address ranges in this index.
+         */
+        size_t size() const
+        {
+                return intervals.size();
+        }
+
+        /**
+         * Store the scopes containing pc in *out, innermost first,
+         * and return true if there are any.  The first scope is the
+         * innermost lexical block, inlined subroutine, or subprogram
+         * containing pc.  Skipping the lexical blocks gives the
+         * inline chain, ending with the subprogram.  Scopes are
+         * expected to nest.  If a range of a scope starts inside,
+         * but extends past, the range of another scope, the index
+         * clips it to the enclosing range.
+         */
+        bool find(taddr pc, std::vector<entry> *out) const;
+
+private:
+        typedef std::uint32_t index;
+        static const index npos = ~(index)0;
+
+        // An address range of a scope.  parent is the interval
+        // containing this one, or npos.
+        struct interval
+        {
+                taddr low, high;
+                index parent, scope;
+        };
+
+        static die to_die(const compilation_unit *cu,
+                          section_offset unit_offset);
+
+        const compilation_unit *cu;
+        // Sorted by low, then with enclosing intervals first
+        std::vector<interval> intervals;
+        // One per scope DIE, in DIE order.  The low and high fields
+        // are unused.
+        std::vector<entry> scopes;
+        // The merged ranges of each scope, indexed like scopes
+        std::vector<compact_rangelist> scope_ranges;
+};
+
+/**
+ * A code scope found by scope_index::find.
+ */
+class scope_index::entry
+{
+public:
+        /**
+         * The tag of the scope DIE: DW_TAG::subprogram,
+         * DW_TAG::inlined_subroutine, or DW_TAG::lexical_block.
+         */
+        DW_TAG tag;
+
+        /**
+         * The offset of the scope DIE within its unit.
+         */
+        section_offset unit_offset;
+
+        /**
+         * The address range of the scope DIE that contains the PC.
+         * Scopes may have several ranges.
+         */
+        taddr low, high;
+
+        /**
+         * The DW_AT::name and DW_AT::linkage_name of the scope,
+         * resolved through DW_AT::abstract_origin and
+         * DW_AT::specification like die::resolve does, or nullptr
+         * if it has none.  These point directly into the section
+         * data.
+         */
+        const char *name, *linkage_name;
+
+        /**
+         * For an inlined subroutine, the file, line, and column of
+         * the call it was inlined at (DW_AT::call_file,
+         * DW_AT::call_line, and DW_AT::call_column), or nullptr and
+         * 0 if unknown.
+         */
+        const line_table::file *call_file;
+        unsigned call_line, call_column;
+
+        /**
+         * All address ranges of the scope DIE, merged.  This is
+         * owned by the scope_index.
+         */
+        const compact_rangelist *ranges;
+
+        /**
+         * Return the scope DIE.
+         */
+        die get_die() const;
+
+private:
+        friend class scope_index;
+
+        const compilation_unit *cu;
+};
+
 //////////////////////////////////////////////////////////////////
 // Utilities
 //
 
+/**
+ * The DIE tree of a unit, decoded into flat struct-of-arrays form.
+ * DIEs are numbered in the order they appear in the unit, so index 0
+ * is the root DIE and the DIEs in any subtree have consecutive
+ * indexes.  Traversing the tree using this table reads only these
+ * arrays and never decodes the underlying DWARF.
+ *
+ * Tables are retrieved with unit::materialize and are kept live by
+ * their unit.  Tables are immutable and hence safe to use from any
+ * number of threads.
+ */
+class die_table
+{
+public:
+        /**
+         * The index of a DIE in this table.
+         */
+        typedef std::uint32_t index;
+
+        /**
+         * An index that denotes no DIE, returned by parent,
+         * first_child, and next_sibling when there is no such DIE
+         * and by find when the offset is not a DIE.
+         */
+        static const index npos = ~(index)0;
+
+        /**
+         * A lightweight handle to a DIE in a die_table.  This is a
+         * pair of a table and an index, and can be converted to a
+         * die if needed.
+         */
+        class node
+        {
+        public:
+                node() : table(nullptr), i(npos) { }
+                node(const die_table *table, index i)
+                        : table(table), i(i) { }
+
+                /**
+                 * Return true if this node refers to a DIE.
+                 */
+                bool valid() const
+                {
+                        return table && i != npos;
+                }
+
+                index get_index() const
+                {
+                        return i;
+                }
+
+                DW_TAG tag() const
+                {
+                        return table->tag(i);
+                }
+
+                section_offset get_unit_offset() const
+                {
+                        return table->get_unit_offset(i);
+                }
+
+                node parent() const
+                {
+                        return node(table, table->parent(i));
+                }
+
+                node first_child() const
+                {
+                        return node(table, table->first_child(i));
+                }
+
+                node next_sibling() const
+                {
+                        return node(table, table->next_sibling(i));
+                }
+
+                bool has(DW_AT attr) const
+                {
+                        return table->has(i, attr);
+                }
+
+                value operator[](DW_AT attr) const;
+
+                /**
+                 * Return the die for this node.
+                 */
+                die to_die() const
+                {
+                        return table->to_die(i);
+                }
+
+                operator die() const
+                {
+                        return to_die();
+                }
+
+                bool operator==(const node &o) const
+                {
+                        return table == o.table && i == o.i;
+                }
+
+                bool operator!=(const node &o) const
+                {
+                        return !(*this == o);
+                }
+
+        private:
+                const die_table *table;
+                index i;
+        };
+
+        die_table() : cu(nullptr) { }
+
+        /**
+         * \internal Decode the DIE tree of cu.
+         */
+        explicit die_table(const unit *cu);
+
+        /**
+         * Return the number of DIEs in this table, not counting
+         * sibling list terminators.
+         */
+        size_t size() const
+        {
+                return tags.size();
+        }
+
+        /**
+         * Return the root DIE of the unit, or an invalid node if the
+         * table is empty.
+         */
+        node root() const
+        {
+                return node(this, size() ? 0 : npos);
+        }
+
+        /**
+         * Return the node for DIE index i.
+         */
+        node operator[](index i) const
+        {
+                return node(this, i);
+        }
+
+        DW_TAG tag(index i) const
+        {
+                return tags[i];
+        }
+
+        section_offset get_unit_offset(index i) const
+        {
+                return offsets[i];
+        }
+
+        index parent(index i) const
+        {
+                return parents[i];
+        }
+
+        index first_child(index i) const
+        {
+                return first_children[i];
+        }
+
+        index next_sibling(index i) const
+        {
+                return next_siblings[i];
+        }
+
+        /**
+         * Return true if DIE index i has attribute attr.
+         */
+        bool has(index i, DW_AT attr) const;
+
+        /**
+         * Return the value of attribute attr of DIE index i.  Throws
+         * out_of_range if the DIE has no such attribute.
+         */
+        value get(index i, DW_AT attr) const;
+
+        /**
+         * Return the index of the DIE at the given offset within the
+         * unit, or npos if there is no DIE there.
+         */
+        index find(section_offset unit_offset) const;
+
+        /**
+         * Return the die for DIE index i.
+         */
+        die to_die(index i) const;
+
+private:
+        const unit *cu;
+
+        // Per-DIE arrays, indexed by DIE index
+        std::vector<DW_TAG> tags;
+        std::vector<const abbrev_entry *> abbrevs;
+        std::vector<std::uint32_t> offsets;
+        std::vector<index> parents, first_children, next_siblings;
+        // The unit-relative offset just past each DIE's attributes,
+        // which is where its children (if any) begin
+        std::vector<std::uint32_t> ends;
+        // attr_base[i] is the index in attr_offsets of DIE i's first
+        // attribute offset.  This has one extra element at the end.
+        std::vector<std::uint32_t> attr_base;
+        // The unit-relative offsets of every attribute of every DIE
+        std::vector<std::uint32_t> attr_offsets;
+};
+
+inline value
+die_table::node::operator[](DW_AT attr) const
+{
+        return table->get(i, attr);
+}
+
+/**
+ * A hash index from names to the DIEs of functions, variables, and
+ * types with those names, across all compilation units of a DWARF
+ * file.  Both the DW_AT::name and the DW_AT::linkage_name of each DIE
+ * are indexed.
+ *
+ * The index is built in one pass when it is first retrieved with
+ * dwarf::get_name_index.  Its sources are, in order of preference:
+ * .debug_names; .debug_pubnames together with .debug_pubtypes; and
+ * finally a walk of the DIE tree of each compilation unit not
+ * described by either.  Note that pubnames do not record linkage
+ * names.
+ *
+ * Pubnames need only list names visible outside their unit, so for
+ * units indexed by .debug_pubnames and .debug_pubtypes, static
+ * functions, file-scope static variables, and types local to the unit
+ * may be missing from the index.  .debug_names and the DIE walk index these too.  To look
+ * up such names in a file with pubnames, walk the unit's DIE tree.
+ *
+ * The index refers to names by their offsets in the string and info
+ * sections they were read from, and to units by index rather than by
+ * pointer, so it can be saved in an index file (see
+ * dwarf::save_index) and used in place from a mapping of that file.
+ * Lookups resolve names against the sections of the DWARF file, and
+ * for names in split units, of their split DWARF files.  It is
+ * immutable once built, so lookups are safe from any number of
+ * threads.
+ */
+class name_index
+{
+public:
+        /**
+         * A DIE with a given name.
+         */
+        struct entry
+        {
+                // The index of the DIE's unit in
+                // dwarf::compilation_units()
+                std::uint32_t unit;
+                DW_TAG tag;
+                section_offset unit_offset;
+
+                /**
+                 * Return the compilation unit of this entry in dw,
+                 * the file this index was built from.  For a
+                 * skeleton unit, this is its split unit.  Throws
+                 * format_error if dw has no such unit.
+                 */
+                const compilation_unit &get_unit(const dwarf &dw) const;
+
+                /**
+                 * Return the DIE this entry refers to in dw, the file
+                 * this index was built from.
+                 */
+                die get_die(const dwarf &dw) const;
+        };
+
+        /**
+         * A contiguous range of entries.
+         */
+        class range
+        {
+        public:
+                range() : b(nullptr), e(nullptr) { }
+                range(const entry *b, const entry *e) : b(b), e(e) { }
+
+                const entry *begin() const
+                {
+                        return b;
+                }
+
+                const entry *end() const
+                {
+                        return e;
+                }
+
+                size_t size() const
+                {
+                        return e - b;
+                }
+
+                bool empty() const
+                {
+                        return b == e;
+                }
+
+        private:
+                const entry *b, *e;
+        };
+
+        name_index();
+
+        /**
+         * \internal Build the name index of dw, using up to nthreads
+         * threads.
+         */
+        explicit name_index(const dwarf &dw, unsigned nthreads = 1);
+
+        /**
+         * \internal Use the name index of dw stored in file.
+         * Throws format_error if file lacks the name index sections.
+         */
+        name_index(const dwarf &dw, const std::shared_ptr<const index_file> &file);
+
+        // The tables may point into the vectors below
+        name_index(const name_index &) = delete;
+        name_index &operator=(const name_index &) = delete;
+
+        /**
+         * \internal Add the tables of this index to w, which must
+         * not outlive this index.
+         */
+        void save(index_writer *w) const;
+
+        /**
+         * Return the entries for all DIEs named name.  This does not
+         * allocate.  If there are no such DIEs, the range is empty.
+         */
+        range lookup(const char *name) const;
+
+        /**
+         * Short-hand for lookup(name.c_str()).
+         */
+        range lookup(const std::string &name) const
+        {
+                return lookup(name.c_str());
+        }
+
+        /**
+         * Return the number of distinct names in this index.
+         */
+        size_t size() const
+        {
+                return num_names;
+        }
+
+private:
+        // A distinct name.  The name is the NUL-terminated string
+        // at offset str of the section identified by source.  The
+        // low two bits of source select .debug_str, .debug_line_str,
+        // or .debug_info, and the rest are 0 for the sections of the
+        // DWARF file itself, or one more than the index of the
+        // skeleton unit whose split DWARF file holds the name.  The
+        // entries for this name are entries[first, first + count).
+        struct name
+        {
+                std::uint64_t str;
+                std::uint32_t hash;
+                std::uint32_t first, count;
+                std::uint32_t source;
+        };
+
+        // The tables of this index, which point either into the
+        // vectors below or into a mapped index file.  entries are
+        // grouped by name.  slots is an open-addressing hash table
+        // of indexes into names.  Its size is a power of two; empty
+        // slots are ~0.
+        const entry *entries;
+        const name *names;
+        const std::uint32_t *slots;
+        size_t num_entries, num_names, num_slots;
+
+        // Storage for an index built in memory
+        std::vector<entry> entry_vec;
+        std::vector<name> name_vec;
+        std::vector<std::uint32_t> slot_vec;
+
+        // The index file of an index used in place
+        std::shared_ptr<const index_file> file;
+
+        // The sections of the DWARF file that names are found in
+        // (indexed like the low bits of name::source; missing
+        // sections are null), and its compilation units, whose
+        // split units have the sections of the rest
+        std::shared_ptr<section> sections[3];
+        const std::vector<compilation_unit> *units;
+
+        void use_vectors();
+        void use_sections(const dwarf &dw);
+        const char *get_name(const name &n) const;
+};
+
 /**
  * An index of sibling DIEs by some string attribute.  This index is
- * lazily constructed and space-efficient.
+ * lazily constructed and space-efficient.  Because of this lazy
+ * construction, a die_str_map must not be used by more than one
+ * thread at a time.
  */
 class die_str_map
 {
@@ -1509,21 +3559,98 @@ namespace elf
          */
         const char *section_type_to_name(section_type type);
 
+        /**
+         * Open the split DWARF file dwo_name of the ELF file at path.
+         * An absolute dwo_name is used as is.  A relative one is
+         * looked for first in comp_dir and then in the directory of
+         * path.  Returns loaders for each of these that can be opened
+         * as an ELF file, in that order.
+         */
+        std::vector<std::shared_ptr<loader> >
+        open_dwo_file(const std::string &path, const std::string &dwo_name,
+                      const std::string &comp_dir);
+
+        /**
+         * Open the DWARF package path + ".dwp" of the ELF file at
+         * path.  Returns nullptr if there is no such file or it isn't
+         * an ELF file.
+         */
+        std::shared_ptr<loader> open_dwp_file(const std::string &path);
+
+        /**
+         * A DWARF section loader backed by an ELF file.  Compressed
+         * sections (SHF_COMPRESSED or legacy .zdebug_*) are
+         * decompressed when they are first loaded, using the ELF
+         * file's shared decompression cache.  The loader keeps every
+         * buffer it returns live for its own lifetime, and asks the
+         * ELF loader to read ahead sections that are parsed
+         * sequentially.  Sections are also found under their split
+         * DWARF names (.debug_info.dwo and so on), so this can load
+         * .dwo and .dwp files, too.
+         *
+         * If the loader knows the path of the ELF file, it finds
+         * split DWARF files and packages relative to it with
+         * open_dwo_file and open_dwp_file, which read them with
+         * libelf++.
+         */
         template<typename Elf>
         class elf_loader : public loader
         {
                 Elf f;
+                std::string path;
+                std::vector<std::shared_ptr<const void> > pinned;
 
         public:
-                elf_loader(const Elf &file) : f(file) { }
+                elf_loader(const Elf &file, const std::string &path = "")
+                        : f(file), path(path) { }
 
                 const void *load(section_type section, size_t *size_out)
                 {
-                        auto sec = f.get_section(section_type_to_name(section));
+                        const char *name = section_type_to_name(section);
+                        auto sec = f.get_section(name);
                         if (!sec.valid())
+                                sec = f.get_section(std::string(".z") + (name + 1));
+                        if (!sec.valid())
+                                sec = f.get_section(std::string(name) + ".dwo");
+                        if (!sec.valid())
+                                return nullptr;
+                        // The abbrev and line tables are always read
+                        // front to back soon after they're loaded
+                        if (section == section_type::abbrev ||
+                            section == section_type::line)
+                                sec.advise(Elf::access_advice::willneed);
+                        auto data = sec.decompressed_data(size_out);
+                        // Uncompressed data is owned by the ELF
+                        // loader.  Don't use data() to tell, since
+                        // that would load a compressed section's raw
+                        // bytes.
+                        if (sec.is_compressed())
+                                pinned.push_back(data);
+                        return data.get();
+                }
+
+                taddr get_address(section_type section)
+                {
+                        auto &sec = f.get_section(section_type_to_name(section));
+                        if (!sec.valid())
+                                return 0;
+                        return sec.get_hdr().addr;
+                }
+
+                std::vector<std::shared_ptr<loader> >
+                open_dwo(const std::string &dwo_name,
+                         const std::string &comp_dir)
+                {
+                        if (path.empty())
+                                return {};
+                        return open_dwo_file(path, dwo_name, comp_dir);
+                }
+
+                std::shared_ptr<loader> open_dwp()
+                {
+                        if (path.empty())
                                 return nullptr;
-                        *size_out = sec.size();
-                        return sec.data();
+                        return open_dwp_file(path);
                 }
         };
 
@@ -1531,12 +3658,15 @@ namespace elf
          * Create a DWARF section loader backed by the given ELF
          * file.  This is templatized to eliminate a static dependency
          * between the libelf++ and libdwarf++, though it can only
-         * reasonably be used with elf::elf from libelf++.
+         * reasonably be used with elf::elf from libelf++.  path is
+         * the file's path, which is needed to find its split DWARF
+         * files (see elf_loader).
          */
         template<typename Elf>
-        std::shared_ptr<elf_loader<Elf> > create_loader(const Elf &f)
+        std::shared_ptr<elf_loader<Elf> >
+        create_loader(const Elf &f, const std::string &path = "")
         {
-                return std::make_shared<elf_loader<Elf> >(f);
+                return std::make_shared<elf_loader<Elf> >(f, path);
         }
 };
 
@@ -4,6 +4,12 @@
 
 #include "internal.hh"
 
+#include <algorithm>
+#include <atomic>
+#include <exception>
+#include <mutex>
+#include <system_error>
+
 using namespace std;
 
 DWARFPP_BEGIN_NAMESPACE
@@ -12,26 +18,218 @@ DWARFPP_BEGIN_NAMESPACE
 // class dwarf
 //
 
+/**
+ * An address range covered by a compilation unit.  The compilation
+ * unit index is an array of these sorted by low.  unit is the index
+ * of the unit in compilation_units, so index files store these
+ * records as they are.
+ */
+struct cu_range
+{
+        taddr low, high;
+        uint64_t unit;
+
+        bool operator<(const cu_range &o) const
+        {
+                return low < o.low;
+        }
+};
+
+/**
+ * A parsed abbrev table.  If the abbrev codes are dense, entries are
+ * stored in vec, indexed by code; otherwise they are stored in map.
+ * Tables are immutable once built and shared between all units that
+ * refer to the same offset in .debug_abbrev.
+ */
+struct abbrev_table
+{
+        std::vector<abbrev_entry> vec;
+        std::unordered_map<abbrev_code, abbrev_entry> map;
+};
+
+/**
+ * The key of a shared abbrev table.  Abbrev layouts depend on the
+ * unit's format and address size, so units that share an abbrev
+ * offset but differ in these get separate tables.
+ */
+struct abbrev_table_key
+{
+        section_offset offset;
+        format fmt;
+        unsigned addr_size;
+
+        bool operator<(const abbrev_table_key &o) const
+        {
+                if (offset != o.offset)
+                        return offset < o.offset;
+                if (fmt != o.fmt)
+                        return fmt < o.fmt;
+                return addr_size < o.addr_size;
+        }
+};
+
+/**
+ * The location of the header of a type unit in the type unit index.
+ */
+struct type_unit_entry
+{
+        uint64_t signature;
+        section_offset offset;
+        section_type sec;
+};
+
+/**
+ * A type unit that is constructed the first time it is looked up.
+ */
+struct lazy_type_unit
+{
+        type_unit tu;
+        std::once_flag once;
+};
+
+/**
+ * The fields of a unit header (DWARF4 sections 7.5.1.1 and 7.5.1.2,
+ * DWARF5 section 7.5.1).
+ */
+struct unit_header
+{
+        uhalf version;
+        DW_UT unit_type;
+        section_offset debug_abbrev_offset;
+        ubyte address_size;
+
+        // Type units only
+        uint64_t type_signature;
+        section_offset type_offset;
+
+        // DWARF 5 skeleton and split compilation units only
+        uint64_t dwo_id;
+
+        bool is_type_unit() const
+        {
+                return unit_type == DW_UT::type ||
+                        unit_type == DW_UT::split_type;
+        }
+};
+
+/**
+ * Read the header of the unit that sub points to, which must be the
+ * beginning of a unit in .debug_info or .debug_types.  After, sub
+ * points to the unit's root DIE.
+ */
+static unit_header
+read_unit_header(cursor *sub)
+{
+        unit_header h = {};
+        sub->skip_initial_length();
+        h.version = sub->fixed<uhalf>();
+        if (sub->sec->type == section_type::types) {
+                if (h.version != 4)
+                        throw format_error("unknown type unit version " +
+                                           std::to_string(h.version));
+                h.unit_type = DW_UT::type;
+                h.debug_abbrev_offset = sub->offset();
+                h.address_size = sub->fixed<ubyte>();
+        } else if (h.version >= 5) {
+                if (h.version > 5)
+                        throw format_error("unknown compilation unit version " +
+                                           std::to_string(h.version));
+                h.unit_type = (DW_UT)sub->fixed<ubyte>();
+                h.address_size = sub->fixed<ubyte>();
+                h.debug_abbrev_offset = sub->offset();
+                if (h.unit_type == DW_UT::skeleton ||
+                    h.unit_type == DW_UT::split_compile)
+                        h.dwo_id = sub->fixed<uint64_t>();
+        } else {
+                h.unit_type = DW_UT::compile;
+                h.debug_abbrev_offset = sub->offset();
+                h.address_size = sub->fixed<ubyte>();
+        }
+        if (h.is_type_unit()) {
+                h.type_signature = sub->fixed<uint64_t>();
+                h.type_offset = sub->offset();
+        }
+        return h;
+}
+
 struct dwarf::impl
 {
-        impl(const std::shared_ptr<loader> &l)
-                : l(l), have_type_units(false) { }
+        impl(const std::shared_ptr<loader> &l,
+             const std::shared_ptr<stats_block> &stats)
+                : l(l), stats(stats), cu_ranges(nullptr), num_cu_ranges(0),
+                  have_section() { }
 
         std::shared_ptr<loader> l;
 
+        // Shared with the split DWARF files this file opens
+        std::shared_ptr<stats_block> stats;
+
         std::shared_ptr<section> sec_info;
         std::shared_ptr<section> sec_abbrev;
 
         std::vector<compilation_unit> compilation_units;
+        // The .debug_info offsets of the beginning and end of each
+        // compilation unit, in the same order.  Type units can sit
+        // between compilation units, so the ends aren't always the
+        // next beginning.
+        std::vector<section_offset> cu_offsets, cu_ends;
+
+        // Index of type units.  type_index lists every type unit
+        // header: DWARF 5 type units in .debug_info are added when
+        // reading the compilation units and DWARF 4 type units in
+        // .debug_types when the index is forced.  type_slots is an
+        // open-addressed hash table from signatures to one plus
+        // their index in type_index, with 0 marking an empty slot.
+        // type_units[i] holds the unit described by type_index[i].
+        std::vector<type_unit_entry> type_index;
+        std::vector<uint32_t> type_slots;
+        std::unique_ptr<lazy_type_unit[]> type_units;
+        std::once_flag type_units_once;
+
+        // Address index of compilation units, sorted by low.  This
+        // points either into cu_range_vec or into cu_ranges_file.
+        const cu_range *cu_ranges;
+        size_t num_cu_ranges;
+        std::vector<cu_range> cu_range_vec;
+        std::shared_ptr<const index_file> cu_ranges_file;
+        std::once_flag cu_ranges_once;
+
+        std::unique_ptr<name_index> names;
+        std::once_flag names_once;
+
+        cfi frames;
+        std::once_flag frames_once;
+
+        // Unit index of this file's DWARF package, if the loader
+        // provides one, read by the first find_split_unit
+        std::unique_ptr<package_index> package;
+        std::once_flag package_once;
 
-        std::unordered_map<uint64_t, type_unit> type_units;
-        bool have_type_units;
+        // Loaded sections, indexed by section_type.  sections[i] is
+        // immutable once have_section[i] is set.  loader_lock
+        // serializes all calls to the loader and all writes to
+        // sections.
+        std::shared_ptr<section> sections[num_section_types];
+        std::atomic<bool> have_section[num_section_types];
+        std::mutex loader_lock;
 
-        std::map<section_type, std::shared_ptr<section> > sections;
+        std::map<abbrev_table_key, std::shared_ptr<const abbrev_table> >
+        abbrev_tables;
+        std::mutex abbrev_tables_lock;
+
+        path_table paths;
+
+        void force_type_index(const dwarf &file);
 };
 
 dwarf::dwarf(const std::shared_ptr<loader> &l)
-        : m(make_shared<impl>(l))
+        : dwarf(l, make_shared<stats_block>())
+{
+}
+
+dwarf::dwarf(const std::shared_ptr<loader> &l,
+             const std::shared_ptr<stats_block> &stats)
+        : m(make_shared<impl>(l, stats))
 {
         const void *data;
         size_t size;
@@ -60,17 +258,34 @@ dwarf::dwarf(const std::shared_ptr<loader> &l)
         if (!data)
                 throw format_error("required .debug_abbrev section missing");
         m->sec_abbrev = make_shared<section>(section_type::abbrev, data, size, m->sec_info->ord);
+        m->sec_info->stats = m->sec_abbrev->stats = stats.get();
+        if (stats_on(stats.get())) {
+                stats->bytes_loaded[(unsigned)section_type::info] +=
+                        m->sec_info->size();
+                stats->bytes_loaded[(unsigned)section_type::abbrev] += size;
+        }
 
         // Get compilation units.  Everything derives from these, so
-        // there's no point in doing it lazily.
+        // there's no point in doing it lazily.  DWARF 5 puts type
+        // units in .debug_info, too; these just go in the type unit
+        // index.
         cursor infocur(m->sec_info);
         while (!infocur.end()) {
+                section_offset offset = infocur.get_section_offset();
+                section unit_sec = infocur.subsection_value();
+                cursor sub(&unit_sec);
+                unit_header hdr = read_unit_header(&sub);
+                if (hdr.is_type_unit()) {
+                        m->type_index.push_back(
+                                {hdr.type_signature, offset, section_type::info});
+                        continue;
+                }
                 // XXX Circular reference.  Given that we now require
                 // the dwarf object to stick around for DIEs, maybe we
                 // might as well require that for units, too.
-                m->compilation_units.emplace_back(
-                        *this, infocur.get_section_offset());
-                infocur.subsection();
+                m->compilation_units.emplace_back(*this, offset);
+                m->cu_offsets.push_back(offset);
+                m->cu_ends.push_back(infocur.get_section_offset());
         }
 }
 
@@ -87,38 +302,526 @@ dwarf::compilation_units() const
         return m->compilation_units;
 }
 
+static size_t
+hash_signature(uint64_t sig)
+{
+        return (sig * 0x9e3779b97f4a7c15ull) >> 32;
+}
+
+void
+dwarf::impl::force_type_index(const dwarf &file)
+{
+        call_once(type_units_once, [&]() {
+                phase_timer timer(stats.get(), phase::type_index);
+                // Only the headers are read here.  Constructing a
+                // type_unit allocates, and most programs only ever
+                // resolve a small fraction of their type units.
+                std::shared_ptr<section> types;
+                try {
+                        types = file.get_section(section_type::types);
+                } catch (format_error &e) {
+                }
+                if (types) {
+                        cursor tucur(types);
+                        while (!tucur.end()) {
+                                section_offset offset = tucur.get_section_offset();
+                                section unit_sec = tucur.subsection_value();
+                                cursor sub(&unit_sec);
+                                unit_header hdr = read_unit_header(&sub);
+                                type_index.push_back(
+                                        {hdr.type_signature, offset,
+                                         section_type::types});
+                        }
+                }
+                if (type_index.size() >= 0x7fffffff)
+                        throw format_error("too many type units");
+
+                // Signatures are already hashes, but mix them anyway
+                // in case a producer uses something simpler.  The
+                // linker usually discards duplicate type units, but
+                // if it doesn't, they're identical, so keep the
+                // first one.
+                size_t slots = 16;
+                while (slots < 2 * type_index.size())
+                        slots *= 2;
+                type_slots.assign(slots, 0);
+                for (size_t i = 0; i < type_index.size(); ++i) {
+                        uint64_t sig = type_index[i].signature;
+                        size_t h = hash_signature(sig);
+                        while (true) {
+                                uint32_t &slot = type_slots[h & (slots - 1)];
+                                if (slot == 0) {
+                                        slot = i + 1;
+                                        break;
+                                }
+                                if (type_index[slot - 1].signature == sig)
+                                        break;
+                                h++;
+                        }
+                }
+                type_units.reset(new lazy_type_unit[type_index.size()]);
+        });
+}
+
 const type_unit &
 dwarf::get_type_unit(uint64_t type_signature) const
 {
-        if (!m->have_type_units) {
-                cursor tucur(get_section(section_type::types));
-                while (!tucur.end()) {
-                        // XXX Circular reference
-                        type_unit tu(*this, tucur.get_section_offset());
-                        m->type_units[tu.get_type_signature()] = tu;
-                        tucur.subsection();
+        m->force_type_index(*this);
+        const auto &slots = m->type_slots;
+        size_t h = hash_signature(type_signature);
+        while (true) {
+                uint32_t slot = slots[h & (slots.size() - 1)];
+                if (slot == 0)
+                        throw out_of_range("type signature 0x" +
+                                           to_hex(type_signature));
+                const type_unit_entry &e = m->type_index[slot - 1];
+                if (e.signature == type_signature) {
+                        lazy_type_unit &lazy = m->type_units[slot - 1];
+                        bool constructed = false;
+                        call_once(lazy.once, [&]() {
+                                // XXX Circular reference
+                                lazy.tu = type_unit(*this, e.offset, e.sec);
+                                constructed = true;
+                        });
+                        count_stat(m->stats.get(), constructed ?
+                                   counter::type_unit_misses :
+                                   counter::type_unit_hits);
+                        return lazy.tu;
                 }
-                m->have_type_units = true;
+                h++;
         }
-        if (!m->type_units.count(type_signature))
-                throw out_of_range("type signature 0x" + to_hex(type_signature));
-        return m->type_units[type_signature];
 }
 
-std::shared_ptr<section>
+/**
+ * Return the compilation unit in cus whose header is at offset in
+ * .debug_info, or nullptr if there is none.
+ */
+static const compilation_unit *
+cu_at_offset(const std::vector<compilation_unit> &cus, section_offset offset)
+{
+        auto it = lower_bound(cus.begin(), cus.end(), offset,
+                              [](const compilation_unit &cu, section_offset off) {
+                                      return cu.get_section_offset() < off;
+                              });
+        if (it == cus.end() || it->get_section_offset() != offset)
+                return nullptr;
+        return &*it;
+}
+
+const compilation_unit *
+dwarf::find_cu_containing(section_offset off) const
+{
+        const auto &offsets = m->cu_offsets;
+        auto it = upper_bound(offsets.begin(), offsets.end(), off);
+        if (it == offsets.begin())
+                return nullptr;
+        size_t i = it - offsets.begin() - 1;
+        if (off >= m->cu_ends[i])
+                return nullptr;
+        return &m->compilation_units[i];
+}
+
+/**
+ * Add the address ranges in aranges to out.  Sets covered[i] for
+ * each compilation unit i described by aranges.
+ */
+static void
+read_aranges(const std::shared_ptr<section> &aranges,
+             const std::vector<compilation_unit> &cus,
+             std::vector<cu_range> *out, std::vector<bool> *covered)
+{
+        // DWARF4 section 6.1.2, DWARF5 section 6.1.2
+        cursor cur(aranges);
+        while (!cur.end()) {
+                std::shared_ptr<section> subsec = cur.subsection();
+                cursor sub(subsec);
+                sub.skip_initial_length();
+                uhalf version = sub.fixed<uhalf>();
+                if (version != 2)
+                        throw format_error("unknown address range table version " +
+                                           std::to_string(version));
+                section_offset info_offset = sub.offset();
+                ubyte address_size = sub.fixed<ubyte>();
+                ubyte segment_size = sub.fixed<ubyte>();
+                subsec->addr_size = address_size;
+
+                // The first tuple is aligned to twice the address
+                // size, relative to the beginning of the set.
+                section_offset tuple_size = 2 * address_size;
+                if (tuple_size == 0)
+                        throw format_error("address range table has zero address size");
+                section_offset pos = sub.get_section_offset();
+                if (pos % tuple_size)
+                        sub += tuple_size - pos % tuple_size;
+
+                const compilation_unit *cu = cu_at_offset(cus, info_offset);
+                while (!sub.end()) {
+                        // Segment selectors are not supported, but we
+                        // still have to get past them.
+                        sub += segment_size;
+                        taddr addr = sub.address();
+                        taddr length = sub.address();
+                        if (addr == 0 && length == 0)
+                                break;
+                        if (!cu || length == 0)
+                                continue;
+                        out->push_back(cu_range{addr, addr + length,
+                                                (uint64_t)(cu - cus.data())});
+                }
+                if (cu)
+                        (*covered)[cu - cus.data()] = true;
+        }
+}
+
+/**
+ * Split ranges, which must be sorted by low and then by decreasing
+ * high, into disjoint ranges sorted by low.  Where ranges overlap,
+ * the one that starts later wins, or the narrower one if they start
+ * together.  Nested ranges are usually a unit whose
+ * DW_AT::low_pc and DW_AT::high_pc span other units' code, or a
+ * discarded function whose range was zeroed, so the later, narrower
+ * range is the more specific one.  Adjacent pieces of the same unit
+ * are merged.
+ */
+static std::vector<cu_range>
+make_disjoint(const std::vector<cu_range> &ranges)
+{
+        std::vector<cu_range> out;
+        // The ranges covering pos, in order of increasing low.  The
+        // last one that hasn't ended yet wins.
+        std::vector<const cu_range*> open;
+        taddr pos = 0;
+
+        auto emit = [&](taddr low, taddr high, uint64_t unit) {
+                if (!out.empty() && out.back().high == low &&
+                    out.back().unit == unit)
+                        out.back().high = high;
+                else
+                        out.push_back(cu_range{low, high, unit});
+        };
+        // Emit the pieces of the open ranges below limit
+        auto advance = [&](taddr limit) {
+                while (!open.empty() && pos < limit) {
+                        const cu_range *top = open.back();
+                        if (top->high <= pos) {
+                                open.pop_back();
+                                continue;
+                        }
+                        taddr end = std::min(top->high, limit);
+                        emit(pos, end, top->unit);
+                        pos = end;
+                }
+        };
+
+        for (auto &r : ranges) {
+                advance(r.low);
+                if (open.empty() || pos < r.low)
+                        pos = r.low;
+                open.push_back(&r);
+        }
+        advance(~(taddr)0);
+        return out;
+}
+
+const compilation_unit *
+dwarf::find_cu(taddr pc) const
+{
+        call_once(m->cu_ranges_once, [this]() {
+                phase_timer timer(m->stats.get(), phase::cu_index);
+                const auto &cus = m->compilation_units;
+                std::vector<cu_range> ranges;
+                std::vector<bool> covered(cus.size());
+
+                std::shared_ptr<section> aranges;
+                try {
+                        aranges = get_section(section_type::aranges);
+                } catch (format_error &e) {
+                }
+                if (aranges)
+                        read_aranges(aranges, cus, &ranges, &covered);
+
+                // Fall back to the root DIE of any compilation unit
+                // .debug_aranges didn't tell us about.  Units with
+                // no code have no PC range, which isn't an error.
+                for (size_t i = 0; i < cus.size(); i++) {
+                        if (covered[i])
+                                continue;
+                        try {
+                                for (auto &ent : die_pc_range(cus[i].root()))
+                                        if (ent.low < ent.high)
+                                                ranges.push_back(
+                                                        cu_range{ent.low, ent.high, i});
+                        } catch (out_of_range &e) {
+                        } catch (value_type_mismatch &e) {
+                        }
+                }
+
+                std::stable_sort(ranges.begin(), ranges.end(),
+                                 [](const cu_range &a, const cu_range &b) {
+                                         if (a.low != b.low)
+                                                 return a.low < b.low;
+                                         return a.high > b.high;
+                                 });
+                ranges = make_disjoint(ranges);
+                m->cu_range_vec = move(ranges);
+                m->cu_ranges = m->cu_range_vec.data();
+                m->num_cu_ranges = m->cu_range_vec.size();
+        });
+
+        // Find the last range starting at or before pc
+        const cu_range *begin = m->cu_ranges,
+                *end = m->cu_ranges + m->num_cu_ranges;
+        const cu_range *it = upper_bound(begin, end, cu_range{pc, pc, 0});
+        if (it == begin)
+                return nullptr;
+        --it;
+        if (pc >= it->high)
+                return nullptr;
+        // A loaded index file was only checked against the number
+        // of units when it was opened
+        if (it->unit >= m->compilation_units.size())
+                throw format_error("address index refers to unit " +
+                                   std::to_string(it->unit) + " of " +
+                                   std::to_string(m->compilation_units.size()));
+        return &m->compilation_units[it->unit];
+}
+
+const name_index &
+dwarf::get_name_index() const
+{
+        call_once(m->names_once, [this]() {
+                phase_timer timer(m->stats.get(), phase::name_index);
+                m->names.reset(new name_index(*this));
+        });
+        return *m->names;
+}
+
+void
+dwarf::save_index(const std::string &path, const std::string &key) const
+{
+        find_cu(0);
+        const name_index &names = get_name_index();
+
+        index_writer w;
+        w.add(index_section::cu_ranges, m->cu_ranges, m->num_cu_ranges);
+        names.save(&w);
+        w.write(path, key, m->sec_info->size(), m->compilation_units.size());
+}
+
+bool
+dwarf::load_index(const std::string &path, const std::string &key) const
+{
+        auto file = index_file::open(path, key, m->sec_info->size(),
+                                     m->compilation_units.size());
+        if (!file)
+                return false;
+
+        // Use whichever indexes are in the file and haven't been
+        // built already.  call_once makes this safe to race with
+        // find_cu and get_name_index.
+        bool used = false;
+        const cu_range *ranges;
+        size_t num_ranges;
+        if (file->get(index_section::cu_ranges, &ranges, &num_ranges)) {
+                call_once(m->cu_ranges_once, [&]() {
+                        m->cu_ranges_file = file;
+                        m->cu_ranges = ranges;
+                        m->num_cu_ranges = num_ranges;
+                        used = true;
+                });
+        }
+
+        std::unique_ptr<name_index> names;
+        try {
+                names.reset(new name_index(*this, file));
+        } catch (format_error &e) {
+        }
+        if (names) {
+                call_once(m->names_once, [&]() {
+                        m->names = move(names);
+                        used = true;
+                });
+        }
+        return used;
+}
+
+bool
+dwarf::use_index_cache(const std::string &dir, const std::string &key) const
+{
+        if (key.empty())
+                return false;
+
+        static const char hex[] = "0123456789abcdef";
+        std::string path = dir + "/";
+        for (unsigned char c : key) {
+                path += hex[c >> 4];
+                path += hex[c & 0xf];
+        }
+        path += ".dwarf-index";
+
+        if (load_index(path, key))
+                return true;
+        try {
+                save_index(path, key);
+        } catch (std::system_error &e) {
+                // The cache is only an optimization
+        }
+        return false;
+}
+
+const cfi &
+dwarf::get_cfi() const
+{
+        call_once(m->frames_once, [this]() {
+                phase_timer timer(m->stats.get(), phase::cfi);
+                shared_ptr<section> secs[3];
+                taddr addrs[3] = {};
+                const section_type types[3] = {section_type::eh_frame,
+                                               section_type::eh_frame_hdr,
+                                               section_type::frame};
+                for (int i = 0; i < 3; i++) {
+                        try {
+                                secs[i] = get_section(types[i]);
+                        } catch (format_error &e) {
+                                continue;
+                        }
+                        lock_guard<mutex> lock(m->loader_lock);
+                        addrs[i] = m->l->get_address(types[i]);
+                }
+
+                // Call frame information doesn't record the address
+                // size, so take it from the first unit.
+                unsigned addr_size = 8;
+                if (!m->compilation_units.empty())
+                        addr_size = m->compilation_units[0].data()->addr_size;
+
+                m->frames = cfi(secs[0], addrs[0], secs[1], addrs[1],
+                                secs[2], addr_size);
+        });
+        return m->frames;
+}
+
+/**
+ * Return the compilation unit of split DWARF file, or an invalid
+ * unit if it has none with DWO ID dwo_id.  If !have_dwo_id, return
+ * its first compilation unit.
+ */
+static compilation_unit
+match_split_unit(const dwarf &file, bool have_dwo_id, uint64_t dwo_id)
+{
+        for (auto &cu : file.compilation_units()) {
+                if (!have_dwo_id)
+                        return cu;
+                uint64_t id;
+                if (cu.get_dwo_id(&id) && id == dwo_id)
+                        return cu;
+        }
+        return compilation_unit();
+}
+
+compilation_unit
+dwarf::find_split_unit(const std::string &dwo_name,
+                       const std::string &comp_dir,
+                       bool have_dwo_id, uint64_t dwo_id) const
+{
+        // A package replaces the .dwo files, so look there first.
+        // Units in a package can only be found by DWO ID.
+        call_once(m->package_once, [this]() {
+                shared_ptr<loader> pl;
+                {
+                        lock_guard<mutex> lock(m->loader_lock);
+                        pl = m->l->open_dwp();
+                }
+                if (pl)
+                        m->package.reset(new package_index(pl));
+        });
+        if (m->package && have_dwo_id) {
+                shared_ptr<loader> ul = m->package->get_unit_loader(dwo_id);
+                if (ul)
+                        return match_split_unit(dwarf(ul, m->stats), true,
+                                                dwo_id);
+        }
+
+        std::vector<shared_ptr<loader> > candidates;
+        {
+                lock_guard<mutex> lock(m->loader_lock);
+                candidates = m->l->open_dwo(dwo_name, comp_dir);
+        }
+        // Report a malformed file only if no other candidate has
+        // the unit
+        std::exception_ptr err;
+        for (auto &dl : candidates) {
+                try {
+                        compilation_unit cu = match_split_unit(
+                                dwarf(dl, m->stats), have_dwo_id, dwo_id);
+                        if (cu.valid())
+                                return cu;
+                } catch (format_error &e) {
+                        if (!err)
+                                err = std::current_exception();
+                }
+        }
+        if (err)
+                std::rethrow_exception(err);
+        return compilation_unit();
+}
+
+void
+dwarf::prefetch_all(unsigned nthreads) const
+{
+        if (nthreads == 0)
+                nthreads = std::max(1u, std::thread::hardware_concurrency());
+
+        const auto &cus = m->compilation_units;
+        parallel_for(cus.size(), nthreads, [&](size_t i) {
+                cus[i].root();
+                cus[i].get_line_table();
+        });
+
+        find_cu(0);
+        m->force_type_index(*this);
+        call_once(m->names_once, [&]() {
+                phase_timer timer(m->stats.get(), phase::name_index);
+                m->names.reset(new name_index(*this, nthreads));
+        });
+}
+
+const std::shared_ptr<section> &
 dwarf::get_section(section_type type) const
 {
-        if (type == section_type::info)
+        stats_block *stats = m->stats.get();
+        if (type == section_type::info) {
+                count_stat(stats, counter::section_hits);
                 return m->sec_info;
-        if (type == section_type::abbrev)
+        }
+        if (type == section_type::abbrev) {
+                count_stat(stats, counter::section_hits);
                 return m->sec_abbrev;
+        }
 
-        auto it = m->sections.find(type);
-        if (it != m->sections.end())
-                return it->second;
+        unsigned idx = (unsigned)type;
+        if (idx >= num_section_types)
+                throw format_error("unknown section type " + to_string(type));
+        if (m->have_section[idx].load(memory_order_acquire)) {
+                count_stat(stats, counter::section_hits);
+                return m->sections[idx];
+        }
+
+        lock_guard<mutex> lock(m->loader_lock);
+        if (m->have_section[idx].load(memory_order_relaxed)) {
+                count_stat(stats, counter::section_hits);
+                return m->sections[idx];
+        }
 
+        // Missing sections aren't remembered, so every lookup of
+        // one is a miss
+        count_stat(stats, counter::section_misses);
         size_t size;
-        const void *data = m->l->load(type, &size);
+        const void *data;
+        {
+                phase_timer timer(stats, phase::load_section);
+                data = m->l->load(type, &size);
+        }
         if (!data)
                 throw format_error(std::string(elf::section_type_to_name(type))
                                    + " section missing");
@@ -152,9 +855,129 @@ dwarf::get_section(section_type type) const
                 }
         }
 
-        m->sections[type] = std::make_shared<section>(type, data, size,
-                                                       m->sec_info->ord, fmt);
-        return m->sections[type];
+        m->sections[idx] = std::make_shared<section>(type, data, size,
+                                                      m->sec_info->ord, fmt);
+        m->sections[idx]->stats = stats;
+        if (stats_on(stats))
+                stats->bytes_loaded[idx] += size;
+        m->have_section[idx].store(true, memory_order_release);
+        return m->sections[idx];
+}
+
+std::shared_ptr<const abbrev_table>
+dwarf::get_abbrev_table(section_offset offset,
+                        const section &unit_sec) const
+{
+        abbrev_table_key key{offset, unit_sec.fmt, unit_sec.addr_size};
+        lock_guard<mutex> lock(m->abbrev_tables_lock);
+        auto it = m->abbrev_tables.find(key);
+        if (it != m->abbrev_tables.end()) {
+                count_stat(m->stats.get(), counter::abbrev_tables_shared);
+                return it->second;
+        }
+
+        // Section 7.5.3
+        phase_timer timer(m->stats.get(), phase::abbrev_table);
+        count_stat(m->stats.get(), counter::abbrev_tables_parsed);
+        auto table = make_shared<abbrev_table>();
+        cursor c(m->sec_abbrev, offset);
+        abbrev_entry entry;
+        abbrev_code highest = 0;
+        while (entry.read(&c)) {
+                entry.finalize(unit_sec.fmt, unit_sec.addr_size);
+                table->map[entry.code] = entry;
+                if (entry.code > highest)
+                        highest = entry.code;
+        }
+        count_decoded(m->stats.get(), section_type::abbrev,
+                      c.get_section_offset() - offset);
+
+        // Typically, abbrev codes are assigned linearly, so it's more
+        // space efficient and time efficient to store the table in a
+        // vector.  Convert to a vector if it's dense enough, by some
+        // rough estimate of "enough".
+        if (highest * 10 < table->map.size() * 15) {
+                // Move the map into the vector
+                table->vec.resize(highest + 1);
+                for (auto &entry : table->map)
+                        table->vec[entry.first] = move(entry.second);
+                table->map.clear();
+        }
+
+        m->abbrev_tables[key] = table;
+        return table;
+}
+
+path_table &
+dwarf::get_path_table() const
+{
+        return m->paths;
+}
+
+void
+dwarf::enable_stats(const std::shared_ptr<tracer> &t) const
+{
+#ifndef DWARFPP_DISABLE_STATS
+        stats_block *stats = m->stats.get();
+        if (stats->enabled.load(memory_order_relaxed))
+                return;
+        stats->t = t;
+
+        // Count the sections that are already loaded as loaded now
+        lock_guard<mutex> lock(m->loader_lock);
+        stats->bytes_loaded[(unsigned)section_type::info] += m->sec_info->size();
+        stats->bytes_loaded[(unsigned)section_type::abbrev] +=
+                m->sec_abbrev->size();
+        for (unsigned i = 0; i < num_section_types; i++)
+                if (m->have_section[i].load(memory_order_relaxed))
+                        stats->bytes_loaded[i] += m->sections[i]->size();
+        stats->enabled.store(true, memory_order_release);
+#endif
+}
+
+dwarf_stats
+dwarf::get_stats() const
+{
+        const stats_block &s = *m->stats;
+        auto get = [&](counter c) {
+                return s.counters[(unsigned)c].load(memory_order_relaxed);
+        };
+
+        dwarf_stats out;
+        out.dies_decoded = get(counter::dies_decoded);
+        for (unsigned i = 0; i < num_section_types; i++) {
+                out.bytes_loaded[i] = s.bytes_loaded[i].load(memory_order_relaxed);
+                out.bytes_decoded[i] = s.bytes_decoded[i].load(memory_order_relaxed);
+        }
+        out.abbrev_tables_parsed = get(counter::abbrev_tables_parsed);
+        out.abbrev_tables_shared = get(counter::abbrev_tables_shared);
+        out.line_programs_executed = get(counter::line_programs_executed);
+        out.line_lookups = {get(counter::line_lookup_hits),
+                            get(counter::line_lookup_misses)};
+        out.sibling_cache = {get(counter::sibling_cache_hits),
+                             get(counter::sibling_cache_misses)};
+        out.ref_targets = {get(counter::ref_target_hits),
+                           get(counter::ref_target_misses)};
+        out.sections = {get(counter::section_hits),
+                        get(counter::section_misses)};
+        out.type_units = {get(counter::type_unit_hits),
+                          get(counter::type_unit_misses)};
+        for (unsigned i = 0; i < num_phases; i++)
+                out.phases[i] = {s.phase_count[i].load(memory_order_relaxed),
+                                 s.phase_ns[i].load(memory_order_relaxed)};
+        return out;
+}
+
+void
+dwarf::reset_stats() const
+{
+        m->stats->reset();
+}
+
+stats_block *
+dwarf::get_stats_block() const
+{
+        return m->stats.get();
 }
 
 //////////////////////////////////////////////////////////////////
@@ -171,34 +994,118 @@ struct unit::impl
         const std::shared_ptr<section> subsec;
         const section_offset debug_abbrev_offset;
         const section_offset root_offset;
+        const unsigned version;
 
         // Type unit-only values
         const uint64_t type_signature;
         const section_offset type_offset;
 
+        // The header's unit type and, for DWARF 5 skeleton and split
+        // compilation units, its DWO ID
+        const DW_UT unit_type;
+        const uint64_t dwo_id;
+
+        // The skeleton unit of a split unit found by
+        // get_split_unit.  This is set before the split unit is
+        // returned and never changes after.
+        const compilation_unit *skeleton;
+
+        // Lazily found split unit of a skeleton unit
+        compilation_unit split;
+        std::once_flag split_once;
+
         // Lazily constructed root and type DIEs
         die root, type;
+        std::once_flag root_once, type_once;
 
         // Lazily constructed line table
         line_table lt;
+        std::once_flag lt_once;
+
+        // Lazily constructed flattened DIE tree
+        std::unique_ptr<die_table> dies;
+        std::once_flag dies_once;
+
+        // Lazily constructed scope index (compilation units only)
+        std::unique_ptr<scope_index> scopes;
+        std::once_flag scopes_once;
+
+        // The decoder instantiation for subsec
+        const unsigned cursor_kind;
+
+        // Map from abbrev code to abbrev, shared with other units
+        // that use the same abbrev table
+        std::shared_ptr<const abbrev_table> abbrevs;
+        std::once_flag abbrevs_once;
+
+        // Lock-free cache of subtree end offsets of DIEs that have
+        // children but no DW_AT::sibling, so die::iterator doesn't
+        // have to walk their children more than once.  Each slot
+        // packs a DIE offset in its high 32 bits and the offset
+        // following its subtree in its low 32 bits.  DIE offsets
+        // are never 0, so 0 marks an empty slot.  Units too large
+        // for 32-bit offsets don't get a cache.
+        std::unique_ptr<std::atomic<uint64_t>[]> sibling_cache;
+        size_t sibling_mask;
+        std::once_flag sibling_once;
+
+        // DWARF 5 bases of this unit's contributions to the indexed
+        // sections, from the root DIE's DW_AT::*_base attributes,
+        // and the sections themselves.  The sections are owned by
+        // file.  A section is only loaded here if the unit names a
+        // base in it; otherwise it's looked up on use.  ranges is
+        // the DW_AT::GNU_ranges_base of a DWARF 4 skeleton unit,
+        // which its split unit's range list offsets are relative to.
+        struct index_bases
+        {
+                section_offset str_offsets, addr, rnglists, loclists,
+                        ranges;
+                const section *str_offsets_sec, *str_sec, *addr_sec,
+                        *rnglists_sec, *loclists_sec;
+        } bases;
+        std::once_flag bases_once;
+
+        // Lazily read DW_AT::low_pc of the root DIE
+        taddr base_address;
+        std::once_flag base_address_once;
 
-        // Map from abbrev code to abbrev.  If the map is dense, it
-        // will be stored in the vector; otherwise it will be stored
-        // in the map.
-        bool have_abbrevs;
-        std::vector<abbrev_entry> abbrevs_vec;
-        std::unordered_map<abbrev_code, abbrev_entry> abbrevs_map;
+        // The units that DW_FORM::ref_addr references from this
+        // unit most recently resolved to.  Slots are replaced round
+        // robin.  These point into file's compilation unit list.
+        static const unsigned num_ref_targets = 4;
+        std::atomic<const compilation_unit*> ref_targets[num_ref_targets];
+        std::atomic<unsigned> next_ref_target;
+
+        // Compiled expressions of this unit and its location lists
+        expr_cache exprs;
 
         impl(const dwarf &file, section_offset offset,
              const std::shared_ptr<section> &subsec,
-             section_offset debug_abbrev_offset, section_offset root_offset,
-             uint64_t type_signature = 0, section_offset type_offset = 0)
+             section_offset root_offset, const unit_header &hdr)
                 : file(file), offset(offset), subsec(subsec),
-                  debug_abbrev_offset(debug_abbrev_offset),
-                  root_offset(root_offset), type_signature(type_signature),
-                  type_offset(type_offset), have_abbrevs(false) { }
+                  debug_abbrev_offset(hdr.debug_abbrev_offset),
+                  root_offset(root_offset), version(hdr.version),
+                  type_signature(hdr.type_signature),
+                  type_offset(hdr.type_offset), unit_type(hdr.unit_type),
+                  dwo_id(hdr.dwo_id), skeleton(nullptr),
+                  cursor_kind(select_cursor_kind(*subsec)), sibling_mask(0),
+                  bases(), base_address(0), next_ref_target(0),
+                  exprs(subsec->size())
+        {
+                for (auto &target : ref_targets)
+                        target.store(nullptr, memory_order_relaxed);
+        }
 
         void force_abbrevs();
+        void force_sibling_cache();
+        void force_bases(const unit *u);
+        const section *get_section(section_type type,
+                                   const section *cached) const;
+        std::uint64_t read_offset_table(const section *sec,
+                                        section_offset base,
+                                        std::uint64_t index,
+                                        unsigned entry_size,
+                                        const char *what) const;
 };
 
 unit::~unit()
@@ -220,36 +1127,53 @@ unit::get_section_offset() const
 const die&
 unit::root() const
 {
-        if (!m->root.valid()) {
+        call_once(m->root_once, [this]() {
                 m->force_abbrevs();
-                m->root = die(this);
-                m->root.read(m->root_offset);
-        }
+                die root(this);
+                root.read(m->root_offset);
+                m->root = move(root);
+        });
         return m->root;
 }
 
+const die_table &
+unit::materialize() const
+{
+        call_once(m->dies_once, [this]() {
+                phase_timer timer(m->subsec->stats, phase::die_table, this);
+                m->dies.reset(new die_table(this));
+        });
+        return *m->dies;
+}
+
 const std::shared_ptr<section> &
 unit::data() const
 {
         return m->subsec;
 }
 
+unsigned
+unit::get_cursor_kind() const
+{
+        return m->cursor_kind;
+}
+
 const abbrev_entry &
 unit::get_abbrev(abbrev_code acode) const
 {
-        if (!m->have_abbrevs)
-                m->force_abbrevs();
+        m->force_abbrevs();
 
-        if (!m->abbrevs_vec.empty()) {
-                if (acode >= m->abbrevs_vec.size())
+        const abbrev_table &table = *m->abbrevs;
+        if (!table.vec.empty()) {
+                if (acode >= table.vec.size())
                         goto unknown;
-                const abbrev_entry &entry = m->abbrevs_vec[acode];
+                const abbrev_entry &entry = table.vec[acode];
                 if (entry.code == 0)
                         goto unknown;
                 return entry;
         } else {
-                auto it = m->abbrevs_map.find(acode);
-                if (it == m->abbrevs_map.end())
+                auto it = table.map.find(acode);
+                if (it == table.map.end())
                         goto unknown;
                 return it->second;
         }
@@ -261,35 +1185,324 @@ unknown:
 void
 unit::impl::force_abbrevs()
 {
-        // XXX Compilation units can share abbrevs.  Parse each table
-        // at most once.
-        if (have_abbrevs)
+        call_once(abbrevs_once, [this]() {
+                abbrevs = file.get_abbrev_table(debug_abbrev_offset,
+                                                *subsec);
+        });
+}
+
+// Maximum number of slots to probe in the sibling cache
+static const unsigned sibling_cache_probes = 16;
+
+static size_t
+hash_sibling(section_offset off)
+{
+        return (off * 0x9e3779b97f4a7c15ull) >> 32;
+}
+
+void
+unit::impl::force_sibling_cache()
+{
+        call_once(sibling_once, [this]() {
+                size_t size = subsec->size();
+                if (size > 0xffffffff)
+                        return;
+                // Usually, only a small fraction of DIEs have
+                // children and no sibling pointer.  If the cache
+                // fills up, later entries are simply dropped.
+                size_t slots = 64;
+                while (slots < size / 32)
+                        slots *= 2;
+                sibling_cache.reset(new std::atomic<uint64_t>[slots]);
+                for (size_t i = 0; i < slots; ++i)
+                        sibling_cache[i].store(0, memory_order_relaxed);
+                sibling_mask = slots - 1;
+        });
+}
+
+section_offset
+unit::get_cached_sibling(section_offset off) const
+{
+        m->force_sibling_cache();
+        if (!m->sibling_cache)
+                return 0;
+        stats_block *stats = m->subsec->stats;
+        size_t h = hash_sibling(off);
+        for (unsigned i = 0; i < sibling_cache_probes; ++i) {
+                uint64_t slot = m->sibling_cache[(h + i) & m->sibling_mask]
+                        .load(memory_order_relaxed);
+                if (slot == 0)
+                        break;
+                if ((slot >> 32) == off) {
+                        count_stat(stats, counter::sibling_cache_hits);
+                        return slot & 0xffffffff;
+                }
+        }
+        count_stat(stats, counter::sibling_cache_misses);
+        return 0;
+}
+
+void
+unit::cache_sibling(section_offset off, section_offset next) const
+{
+        m->force_sibling_cache();
+        if (!m->sibling_cache)
                 return;
+        uint64_t entry = ((uint64_t)off << 32) | next;
+        size_t h = hash_sibling(off);
+        for (unsigned i = 0; i < sibling_cache_probes; ++i) {
+                auto &slot = m->sibling_cache[(h + i) & m->sibling_mask];
+                uint64_t cur = 0;
+                if (slot.compare_exchange_strong(cur, entry,
+                                                 memory_order_relaxed))
+                        return;
+                // Another thread may have recorded this DIE first
+                if ((cur >> 32) == off)
+                        return;
+        }
+}
 
-        // Section 7.5.3
-        cursor c(file.get_section(section_type::abbrev),
-                 debug_abbrev_offset);
-        abbrev_entry entry;
-        abbrev_code highest = 0;
-        while (entry.read(&c)) {
-                abbrevs_map[entry.code] = entry;
-                if (entry.code > highest)
-                        highest = entry.code;
+unsigned
+unit::get_version() const
+{
+        return m->version;
+}
+
+const compilation_unit *
+unit::get_skeleton_unit() const
+{
+        return m->skeleton;
+}
+
+bool
+unit::is_split() const
+{
+        if (m->skeleton)
+                return true;
+        if (m->version >= 5)
+                return m->unit_type == DW_UT::split_compile ||
+                        m->unit_type == DW_UT::split_type;
+        // DWARF 4 split units carry the DWO ID their skeleton has,
+        // but not the DWO name
+        const die &d = root();
+        return d.has(DW_AT::GNU_dwo_id) && !d.has(DW_AT::GNU_dwo_name);
+}
+
+bool
+unit::get_dwo_id(uint64_t *out) const
+{
+        if (m->version >= 5) {
+                *out = m->dwo_id;
+                return m->unit_type == DW_UT::skeleton ||
+                        m->unit_type == DW_UT::split_compile;
         }
+        const die &d = root();
+        if (!d.has(DW_AT::GNU_dwo_id))
+                return false;
+        *out = d[DW_AT::GNU_dwo_id].as_uconstant();
+        return true;
+}
 
-        // Typically, abbrev codes are assigned linearly, so it's more
-        // space efficient and time efficient to store the table in a
-        // vector.  Convert to a vector if it's dense enough, by some
-        // rough estimate of "enough".
-        if (highest * 10 < abbrevs_map.size() * 15) {
-                // Move the map into the vector
-                abbrevs_vec.resize(highest + 1);
-                for (auto &entry : abbrevs_map)
-                        abbrevs_vec[entry.first] = move(entry.second);
-                abbrevs_map.clear();
+taddr
+unit::get_base_address() const
+{
+        call_once(m->base_address_once, [this]() {
+                const die &d = root();
+                if (d.has(DW_AT::low_pc))
+                        m->base_address = at_low_pc(d);
+                else if (m->skeleton)
+                        // Split units leave the unit's addresses to
+                        // the skeleton
+                        m->base_address = m->skeleton->get_base_address();
+        });
+        return m->base_address;
+}
+
+const compilation_unit &
+unit::find_ref_target(section_offset off) const
+{
+        for (auto &slot : m->ref_targets) {
+                const compilation_unit *cu = slot.load(memory_order_relaxed);
+                if (!cu)
+                        break;
+                section_offset start = cu->get_section_offset();
+                if (off >= start && off - start < cu->data()->size()) {
+                        count_stat(m->subsec->stats, counter::ref_target_hits);
+                        return *cu;
+                }
         }
 
-        have_abbrevs = true;
+        count_stat(m->subsec->stats, counter::ref_target_misses);
+        const compilation_unit *cu = m->file.find_cu_containing(off);
+        if (!cu)
+                throw format_error("reference to .debug_info offset 0x" +
+                                   to_hex(off) + " is not in any compilation unit");
+        unsigned next = m->next_ref_target.fetch_add(1, memory_order_relaxed);
+        m->ref_targets[next % impl::num_ref_targets].store(
+                cu, memory_order_relaxed);
+        return *cu;
+}
+
+void
+unit::impl::force_bases(const unit *u)
+{
+        call_once(bases_once, [&]() {
+                // Reading the base attributes themselves doesn't
+                // depend on the bases, so it's safe to read the root
+                // DIE here.
+                const die &d = u->root();
+                index_bases b = {};
+
+                // Without a base attribute, assume the unit's
+                // contribution is the first in its section, so the
+                // base is just past that section's header (DWARF5
+                // sections 7.26 to 7.29).  Before DWARF 5, these
+                // sections have no headers.
+                bool dwarf64 = subsec->fmt == format::dwarf64;
+                if (version >= 5) {
+                        b.str_offsets = b.addr = dwarf64 ? 16 : 8;
+                        b.rnglists = b.loclists = dwarf64 ? 20 : 12;
+                }
+
+                auto get = [&](DW_AT name, section_type type,
+                               section_offset *base, const section **sec) {
+                        if (!d.has(name))
+                                return;
+                        *base = d[name].as_sec_offset();
+                        *sec = file.get_section(type).get();
+                };
+                get(DW_AT::str_offsets_base, section_type::str_offsets,
+                    &b.str_offsets, &b.str_offsets_sec);
+                get(DW_AT::addr_base, section_type::addr,
+                    &b.addr, &b.addr_sec);
+                get(DW_AT::rnglists_base, section_type::rnglists,
+                    &b.rnglists, &b.rnglists_sec);
+                get(DW_AT::loclists_base, section_type::loclists,
+                    &b.loclists, &b.loclists_sec);
+                if (version < 5) {
+                        // The GNU split DWARF extension to DWARF 4
+                        get(DW_AT::GNU_addr_base, section_type::addr,
+                            &b.addr, &b.addr_sec);
+                        if (d.has(DW_AT::GNU_ranges_base))
+                                b.ranges = d[DW_AT::GNU_ranges_base].as_sec_offset();
+                }
+                if (b.str_offsets_sec)
+                        b.str_sec = file.get_section(section_type::str).get();
+                bases = b;
+        });
+}
+
+/**
+ * Return cached if it's non-null and otherwise the given section of
+ * this unit's file.  Throws format_error if the file lacks the
+ * section.
+ */
+const section *
+unit::impl::get_section(section_type type, const section *cached) const
+{
+        if (cached)
+                return cached;
+        return file.get_section(type).get();
+}
+
+/**
+ * Return entry index of the table of entry_size-byte values that
+ * begins at offset base in sec.  what names the table for error
+ * messages.
+ */
+uint64_t
+unit::impl::read_offset_table(const section *sec, section_offset base,
+                              uint64_t index, unsigned entry_size,
+                              const char *what) const
+{
+        size_t size = sec->size();
+        if (base > size || index >= (size - base) / entry_size)
+                throw format_error(std::string(what) + " index " +
+                                   std::to_string(index) + " out of range");
+        cursor cur(sec, base + index * entry_size);
+        switch (entry_size) {
+        case 4:
+                return cur.fixed<uint32_t>();
+        case 8:
+                return cur.fixed<uint64_t>();
+        case 2:
+                return cur.fixed<uint16_t>();
+        case 1:
+                return cur.fixed<uint8_t>();
+        }
+        throw format_error("unsupported " + std::string(what) +
+                           " entry size " + std::to_string(entry_size));
+}
+
+const char *
+unit::get_strx(uint64_t index, size_t *size_out) const
+{
+        m->force_bases(this);
+        const auto &b = m->bases;
+        const section *offsets = m->get_section(section_type::str_offsets,
+                                                b.str_offsets_sec);
+        unsigned entry_size = m->subsec->fmt == format::dwarf64 ? 8 : 4;
+        section_offset off = m->read_offset_table(
+                offsets, b.str_offsets, index, entry_size, "string");
+        cursor scur(m->get_section(section_type::str, b.str_sec), off);
+        return scur.cstr(size_out);
+}
+
+taddr
+unit::get_addrx(uint64_t index) const
+{
+        // Split units have no .debug_addr of their own; their
+        // indexes are into the skeleton's contribution
+        if (m->skeleton)
+                return m->skeleton->get_addrx(index);
+        m->force_bases(this);
+        const auto &b = m->bases;
+        const section *addrs = m->get_section(section_type::addr, b.addr_sec);
+        return m->read_offset_table(addrs, b.addr, index,
+                                    m->subsec->addr_size, "address");
+}
+
+section_offset
+unit::get_rnglistx(uint64_t index) const
+{
+        m->force_bases(this);
+        const auto &b = m->bases;
+        const section *sec = m->get_section(section_type::rnglists,
+                                            b.rnglists_sec);
+        unsigned entry_size = m->subsec->fmt == format::dwarf64 ? 8 : 4;
+        // Offsets are relative to the base (DWARF5 section 7.28)
+        return b.rnglists + m->read_offset_table(
+                sec, b.rnglists, index, entry_size, "range list");
+}
+
+section_offset
+unit::get_loclistx(uint64_t index) const
+{
+        m->force_bases(this);
+        const auto &b = m->bases;
+        const section *sec = m->get_section(section_type::loclists,
+                                            b.loclists_sec);
+        unsigned entry_size = m->subsec->fmt == format::dwarf64 ? 8 : 4;
+        return b.loclists + m->read_offset_table(
+                sec, b.loclists, index, entry_size, "location list");
+}
+
+const std::shared_ptr<section> &
+unit::get_ranges_section(section_offset *base) const
+{
+        if (m->skeleton) {
+                m->skeleton->m->force_bases(m->skeleton);
+                *base = m->skeleton->m->bases.ranges;
+                return m->skeleton->get_dwarf().get_section(section_type::ranges);
+        }
+        *base = 0;
+        return m->file.get_section(section_type::ranges);
+}
+
+expr_cache &
+unit::get_expr_cache() const
+{
+        return m->exprs;
 }
 
 //////////////////////////////////////////////////////////////////
@@ -298,83 +1511,124 @@ unit::impl::force_abbrevs()
 
 compilation_unit::compilation_unit(const dwarf &file, section_offset offset)
 {
-        // Read the CU header (DWARF4 section 7.5.1.1)
         cursor cur(file.get_section(section_type::info), offset);
         std::shared_ptr<section> subsec = cur.subsection();
         cursor sub(subsec);
-        sub.skip_initial_length();
-        uhalf version = sub.fixed<uhalf>();
-        (void)version;
-        if (version > 5)
-                throw format_error("unknown compilation unit version " + std::to_string(version));
-        // .debug_abbrev-relative offset of this unit's abbrevs
-        section_offset debug_abbrev_offset;
-        if(version >= 5)
-        {
-            sub.skip_unit_type();
-            ubyte address_size = sub.fixed<ubyte>();
-            subsec->addr_size = address_size;
-            debug_abbrev_offset = sub.offset();
-        }
-        else {
-            debug_abbrev_offset = sub.offset();
-            ubyte address_size = sub.fixed<ubyte>();
-            subsec->addr_size = address_size;
-        }
+        unit_header hdr = read_unit_header(&sub);
+        subsec->addr_size = hdr.address_size;
 
-        m = make_shared<impl>(file, offset, subsec, debug_abbrev_offset,
-                              sub.get_section_offset());
+        m = make_shared<impl>(file, offset, subsec,
+                              sub.get_section_offset(), hdr);
 }
 
 const line_table &
 compilation_unit::get_line_table() const
 {
-        if (!m->lt.valid()) {
+        call_once(m->lt_once, [this]() {
                 const die &d = root();
-                if (!d.has(DW_AT::stmt_list) || !d.has(DW_AT::name))
-                        goto done;
+                // Split units usually use their skeleton's line
+                // table
+                if (m->skeleton && !d.has(DW_AT::stmt_list)) {
+                        m->lt = m->skeleton->get_line_table();
+                        return;
+                }
+                if (!d.has(DW_AT::stmt_list))
+                        return;
+                // Skeleton units leave the name to their split unit,
+                // but their line tables are complete without it
+                std::string name;
+                if (d.has(DW_AT::name)) {
+                        name = at_name(d);
+                } else if (d.has(DW_AT::dwo_name) ||
+                           d.has(DW_AT::GNU_dwo_name)) {
+                        const compilation_unit *split = get_split_unit();
+                        if (split && split->root().has(DW_AT::name))
+                                name = at_name(split->root());
+                } else {
+                        return;
+                }
 
                 shared_ptr<section> sec;
                 try {
                         sec = m->file.get_section(section_type::line);
                 } catch (format_error &e) {
-                        goto done;
+                        return;
                 }
 
                 auto comp_dir = d.has(DW_AT::comp_dir) ? at_comp_dir(d) : "";
-                
+
+                phase_timer timer(m->subsec->stats, phase::line_table, this);
                 m->lt = line_table(sec, d[DW_AT::stmt_list].as_sec_offset(),
                                    m->subsec->addr_size, comp_dir,
-                                   at_name(d), &m->file);
-        }
-done:
+                                   name, &m->file);
+        });
         return m->lt;
 }
 
+const scope_index &
+compilation_unit::get_scope_index() const
+{
+        if (const compilation_unit *split = get_split_unit())
+                return split->get_scope_index();
+        call_once(m->scopes_once, [this]() {
+                phase_timer timer(m->subsec->stats, phase::scope_index, this);
+                m->scopes.reset(new scope_index(this));
+        });
+        return *m->scopes;
+}
+
+const compilation_unit *
+compilation_unit::get_split_unit() const
+{
+        call_once(m->split_once, [this]() {
+                const die &d = root();
+                std::string dwo_name;
+                if (m->version >= 5) {
+                        if (m->unit_type != DW_UT::skeleton ||
+                            !d.has(DW_AT::dwo_name))
+                                return;
+                        dwo_name = d[DW_AT::dwo_name].as_string();
+                } else {
+                        if (!d.has(DW_AT::GNU_dwo_name))
+                                return;
+                        dwo_name = d[DW_AT::GNU_dwo_name].as_string();
+                }
+                std::string comp_dir = d.has(DW_AT::comp_dir) ?
+                        at_comp_dir(d) : "";
+                phase_timer timer(m->subsec->stats, phase::split_unit, this);
+                uint64_t dwo_id = 0;
+                bool have_dwo_id = get_dwo_id(&dwo_id);
+
+                compilation_unit split = m->file.find_split_unit(
+                        dwo_name, comp_dir, have_dwo_id, dwo_id);
+                if (!split.valid())
+                        return;
+                // The split unit refers back to the skeleton in the
+                // file's unit list, since this may be a copy
+                split.m->skeleton = m->file.find_cu_containing(m->offset);
+                m->split = move(split);
+        });
+        return m->split.valid() ? &m->split : nullptr;
+}
+
 //////////////////////////////////////////////////////////////////
 // class type_unit
 //
 
-type_unit::type_unit(const dwarf &file, section_offset offset)
+type_unit::type_unit(const dwarf &file, section_offset offset,
+                     section_type sec)
 {
-        // Read the type unit header (DWARF4 section 7.5.1.2)
-        cursor cur(file.get_section(section_type::types), offset);
+        cursor cur(file.get_section(sec), offset);
         std::shared_ptr<section> subsec = cur.subsection();
         cursor sub(subsec);
-        sub.skip_initial_length();
-        uhalf version = sub.fixed<uhalf>();
-        if (version != 4)
-                throw format_error("unknown type unit version " + std::to_string(version));
-        // .debug_abbrev-relative offset of this unit's abbrevs
-        section_offset debug_abbrev_offset = sub.offset();
-        ubyte address_size = sub.fixed<ubyte>();
-        subsec->addr_size = address_size;
-        uint64_t type_signature = sub.fixed<uint64_t>();
-        section_offset type_offset = sub.offset();
-
-        m = make_shared<impl>(file, offset, subsec, debug_abbrev_offset,
-                              sub.get_section_offset(), type_signature,
-                              type_offset);
+        unit_header hdr = read_unit_header(&sub);
+        if (!hdr.is_type_unit())
+                throw format_error("unit at 0x" + to_hex(offset) +
+                                   " is not a type unit");
+        subsec->addr_size = hdr.address_size;
+
+        m = make_shared<impl>(file, offset, subsec,
+                              sub.get_section_offset(), hdr);
 }
 
 uint64_t
@@ -386,11 +1640,12 @@ type_unit::get_type_signature() const
 const die &
 type_unit::type() const
 {
-        if (!m->type.valid()) {
+        call_once(m->type_once, [this]() {
                 m->force_abbrevs();
-                m->type = die(this);
-                m->type.read(m->type_offset);
-        }
+                die type(this);
+                type.read(m->type_offset);
+                m->type = move(type);
+        });
         return m->type;
 }
 
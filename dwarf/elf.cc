@@ -3,8 +3,13 @@
 // that can be found in the LICENSE file.
 
 #include "dwarf++.hh"
+#include "../elf/elf++.hh"
 
 #include <cstring>
+#include <system_error>
+
+#include <fcntl.h>
+#include <unistd.h>
 
 using namespace std;
 
@@ -18,29 +23,43 @@ static const struct
         {".debug_abbrev",      section_type::abbrev},
         {".debug_addr",        section_type::addr},
         {".debug_aranges",     section_type::aranges},
+        {".debug_cu_index",    section_type::cu_index},
         {".debug_frame",       section_type::frame},
         {".debug_info",        section_type::info},
         {".debug_line",        section_type::line},
         {".debug_line_str",    section_type::line_str},
         {".debug_loc",         section_type::loc},
+        {".debug_loclists",    section_type::loclists},
         {".debug_macinfo",     section_type::macinfo},
+        {".debug_names",       section_type::names},
         {".debug_pubnames",    section_type::pubnames},
         {".debug_pubtypes",    section_type::pubtypes},
         {".debug_ranges",      section_type::ranges},
         {".debug_rnglists",    section_type::rnglists},
         {".debug_str",         section_type::str},
         {".debug_str_offsets", section_type::str_offsets},
+        {".debug_tu_index",    section_type::tu_index},
         {".debug_types",       section_type::types},
+        {".eh_frame",          section_type::eh_frame},
+        {".eh_frame_hdr",      section_type::eh_frame_hdr},
 };
 
 bool
 elf::section_name_to_type(const char *name, section_type *out)
 {
-        for (auto &sec : sections) {
-                if (strcmp(sec.name, name) == 0) {
-                        *out = sec.type;
+        // sections is sorted by name
+        size_t lo = 0, hi = sizeof(sections) / sizeof(sections[0]);
+        while (lo < hi) {
+                size_t mid = lo + (hi - lo) / 2;
+                int cmp = strcmp(sections[mid].name, name);
+                if (cmp == 0) {
+                        *out = sections[mid].type;
                         return true;
                 }
+                if (cmp < 0)
+                        lo = mid + 1;
+                else
+                        hi = mid;
         }
         return false;
 }
@@ -48,11 +67,76 @@ elf::section_name_to_type(const char *name, section_type *out)
 const char *
 elf::section_type_to_name(section_type type)
 {
-        for (auto &sec : sections) {
-                if (sec.type == type)
-                        return sec.name;
+        static const unsigned ntypes = (unsigned)section_type::types + 1;
+        // Invert sections on first use
+        static const struct names
+        {
+                const char *by_type[ntypes];
+                names() : by_type()
+                {
+                        for (auto &sec : sections)
+                                by_type[(unsigned)sec.type] = sec.name;
+                }
+        } names;
+
+        if ((unsigned)type >= ntypes)
+                return nullptr;
+        return names.by_type[(unsigned)type];
+}
+
+/**
+ * Return a loader for the ELF file at path, or nullptr if it can't be
+ * opened or isn't an ELF file.
+ */
+static shared_ptr<loader>
+open_elf(const string &path)
+{
+        int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0)
+                return nullptr;
+        try {
+                ::elf::elf f(::elf::create_mmap_loader(fd));
+                return elf::create_loader(f, path);
+        } catch (::elf::format_error &e) {
+        } catch (std::system_error &e) {
+                // The mmap loader only takes fd once it's mapped
+                close(fd);
         }
         return nullptr;
 }
 
+vector<shared_ptr<loader> >
+elf::open_dwo_file(const string &path, const string &dwo_name,
+                   const string &comp_dir)
+{
+        vector<shared_ptr<loader> > res;
+        if (dwo_name.empty())
+                return res;
+
+        // DWARF5 section 7.3.2.  The DWO name is usually relative to
+        // the compilation directory, but binaries are often moved
+        // away from where they were built along with their .dwo
+        // files.
+        vector<string> paths;
+        if (dwo_name[0] == '/') {
+                paths.push_back(dwo_name);
+        } else {
+                if (!comp_dir.empty())
+                        paths.push_back(comp_dir + "/" + dwo_name);
+                size_t slash = path.rfind('/');
+                string dir = slash == string::npos ? "." : path.substr(0, slash);
+                paths.push_back(dir + "/" + dwo_name);
+        }
+        for (auto &p : paths)
+                if (auto l = open_elf(p))
+                        res.push_back(l);
+        return res;
+}
+
+shared_ptr<loader>
+elf::open_dwp_file(const string &path)
+{
+        return open_elf(path + ".dwp");
+}
+
 DWARFPP_END_NAMESPACE
@@ -4,6 +4,9 @@
 
 #include "internal.hh"
 
+#include <algorithm>
+#include <exception>
+
 using namespace std;
 
 DWARFPP_BEGIN_NAMESPACE
@@ -12,7 +15,21 @@ expr_context no_expr_context;
 
 expr::expr(const unit *cu,
            section_offset offset, section_length len)
-        : cu(cu), offset(offset), len(len)
+        : cu(cu), sec(cu->data().get()), offset(offset), len(len),
+          cache(&cu->get_expr_cache())
+{
+}
+
+expr::expr(const section *sec,
+           section_offset offset, section_length len, expr_cache *cache)
+        : cu(nullptr), sec(sec), offset(offset), len(len), cache(cache)
+{
+}
+
+expr::expr(const unit *cu, const section *sec,
+           section_offset offset, section_length len)
+        : cu(cu), sec(sec), offset(offset), len(len),
+          cache(&cu->get_expr_cache())
 {
 }
 
@@ -28,8 +45,358 @@ expr::evaluate(expr_context *ctx, taddr argument) const
         return evaluate(ctx, {argument});
 }
 
+//////////////////////////////////////////////////////////////////
+// class expr_program
+//
+
+/**
+ * A decoded expression operation.  Operations that have equivalent
+ * decoded forms are canonicalized so evaluation has fewer cases:
+ * all constant pushes become DW_OP::constu, DW_OP::breg* becomes
+ * DW_OP::bregx, DW_OP::reg* becomes DW_OP::regx, and DW_OP::deref
+ * and DW_OP::xderef become their _size forms.
+ */
+struct expr_op
+{
+        DW_OP op;
+        // Operands.  For DW_OP::skip and DW_OP::bra, a is the index
+        // of the target operation, or bad_target.  For
+        // DW_OP::implicit_value, a is the length of the value and b
+        // is its offset in the expression.
+        uint64_t a, b;
+};
+
+// The branch target of a skip or bra into the middle of an operation
+// or before the expression
+static const uint64_t bad_target = ~(uint64_t)0;
+
+// A pseudo-operation that raises expr_program::error.  0 is not a
+// valid DWARF operation.
+static const DW_OP op_error = (DW_OP)0;
+
+/**
+ * A decoded DWARF expression.  This is the state behind
+ * compiled_expr, and expr::evaluate decodes into a temporary one.
+ */
+struct expr_program
+{
+        // The expression bytes, for implicit values
+        const char *data;
+        section_length len;
+        unsigned addr_size;
+        small_vector<expr_op, 8> ops;
+        // The exception raised by decoding the operation at which
+        // decoding stopped.  If set, the last operation is op_error.
+        exception_ptr error;
+
+        /**
+         * Decode e, with the cursor specialized for e's unit or
+         * section.
+         */
+        void compile(const expr &e);
+        template<typename Cursor> void decode(const expr &e);
+        expr_result evaluate(expr_context *ctx,
+                             const std::initializer_list<taddr> &arguments) const;
+};
+
+void
+expr_program::compile(const expr &e)
+{
+        static void (expr_program::*const decoders[])(const expr &) =
+                CURSOR_KERNELS(&expr_program::decode);
+        unsigned kind = e.cu ? e.cu->get_cursor_kind() :
+                select_cursor_kind(*e.sec);
+        (this->*decoders[kind])(e);
+}
+
+template<typename Cursor>
+void
+expr_program::decode(const expr &e)
+{
+        // Create a subsection for just this expression so we can
+        // easily detect the end (including premature end).
+        section subsec(e.sec->type, e.sec->begin + e.offset, e.len,
+                       e.sec->ord, e.sec->fmt, e.sec->addr_size);
+        Cursor cur(&subsec);
+        data = subsec.begin;
+        len = e.len;
+        addr_size = subsec.addr_size;
+
+        // The offset of each operation, for resolving branches
+        small_vector<section_offset, 8> starts;
+
+        try {
+                while (!cur.end()) {
+                        starts.push_back(cur.get_section_offset());
+                        expr_op o{(DW_OP)cur.template fixed<ubyte>(), 0, 0};
+
+                        // Tell GCC to warn us about missing switch
+                        // cases, even though we have a default case.
+#pragma GCC diagnostic push
+#pragma GCC diagnostic warning "-Wswitch-enum"
+                        switch (o.op) {
+                                // 2.5.1.1 Literal encodings
+                        case DW_OP::lit0...DW_OP::lit31:
+                                o.a = (unsigned)o.op - (unsigned)DW_OP::lit0;
+                                o.op = DW_OP::constu;
+                                break;
+                        case DW_OP::addr:
+                                o.a = cur.address();
+                                o.op = DW_OP::constu;
+                                break;
+                        case DW_OP::const1u:
+                                o.a = cur.template fixed<uint8_t>();
+                                o.op = DW_OP::constu;
+                                break;
+                        case DW_OP::const2u:
+                                o.a = cur.template fixed<uint16_t>();
+                                o.op = DW_OP::constu;
+                                break;
+                        case DW_OP::const4u:
+                                o.a = cur.template fixed<uint32_t>();
+                                o.op = DW_OP::constu;
+                                break;
+                        case DW_OP::const8u:
+                                o.a = cur.template fixed<uint64_t>();
+                                o.op = DW_OP::constu;
+                                break;
+                        case DW_OP::const1s:
+                                o.a = cur.template fixed<int8_t>();
+                                o.op = DW_OP::constu;
+                                break;
+                        case DW_OP::const2s:
+                                o.a = cur.template fixed<int16_t>();
+                                o.op = DW_OP::constu;
+                                break;
+                        case DW_OP::const4s:
+                                o.a = cur.template fixed<int32_t>();
+                                o.op = DW_OP::constu;
+                                break;
+                        case DW_OP::const8s:
+                                o.a = cur.template fixed<int64_t>();
+                                o.op = DW_OP::constu;
+                                break;
+                        case DW_OP::constu:
+                                o.a = cur.uleb128();
+                                break;
+                        case DW_OP::consts:
+                                o.a = cur.sleb128();
+                                o.op = DW_OP::constu;
+                                break;
+                        case DW_OP::addrx:
+                        case DW_OP::constx:
+                        case DW_OP::GNU_addr_index:
+                        case DW_OP::GNU_const_index:
+                                // DWARF5 section 2.5.1.1.  These are
+                                // resolved once here rather than on
+                                // every evaluation.
+                                if (!e.cu)
+                                        throw expr_error(to_string(o.op) + " outside of a unit");
+                                o.a = e.cu->get_addrx(cur.uleb128());
+                                o.op = DW_OP::constu;
+                                break;
+
+                                // 2.5.1.2 Register based addressing
+                        case DW_OP::fbreg:
+                                o.b = cur.sleb128();
+                                break;
+                        case DW_OP::breg0...DW_OP::breg31:
+                                o.a = (unsigned)o.op - (unsigned)DW_OP::breg0;
+                                o.b = cur.sleb128();
+                                o.op = DW_OP::bregx;
+                                break;
+                        case DW_OP::bregx:
+                                o.a = cur.uleb128();
+                                o.b = cur.sleb128();
+                                break;
+
+                                // 2.5.1.3 Stack operations
+                        case DW_OP::pick:
+                                o.a = cur.template fixed<uint8_t>();
+                                break;
+                        case DW_OP::deref:
+                                o.a = addr_size;
+                                o.op = DW_OP::deref_size;
+                                break;
+                        case DW_OP::deref_size:
+                                o.a = cur.template fixed<uint8_t>();
+                                break;
+                        case DW_OP::xderef:
+                                o.a = addr_size;
+                                o.op = DW_OP::xderef_size;
+                                break;
+                        case DW_OP::xderef_size:
+                                o.a = cur.template fixed<uint8_t>();
+                                break;
+                        case DW_OP::dup:
+                        case DW_OP::drop:
+                        case DW_OP::over:
+                        case DW_OP::swap:
+                        case DW_OP::rot:
+                        case DW_OP::push_object_address:
+                        case DW_OP::form_tls_address:
+                        case DW_OP::call_frame_cfa:
+                                break;
+
+                                // 2.5.1.4 Arithmetic and logical operations
+                        case DW_OP::plus_uconst:
+                                o.a = cur.uleb128();
+                                break;
+                        case DW_OP::abs:
+                        case DW_OP::and_:
+                        case DW_OP::div:
+                        case DW_OP::minus:
+                        case DW_OP::mod:
+                        case DW_OP::mul:
+                        case DW_OP::neg:
+                        case DW_OP::not_:
+                        case DW_OP::or_:
+                        case DW_OP::plus:
+                        case DW_OP::shl:
+                        case DW_OP::shr:
+                        case DW_OP::shra:
+                        case DW_OP::xor_:
+                                break;
+
+                                // 2.5.1.5 Control flow operations
+                        case DW_OP::le:
+                        case DW_OP::ge:
+                        case DW_OP::eq:
+                        case DW_OP::lt:
+                        case DW_OP::gt:
+                        case DW_OP::ne:
+                                break;
+                        case DW_OP::skip:
+                        case DW_OP::bra: {
+                                // Resolved to an operation index
+                                // below
+                                int64_t delta = cur.template fixed<int16_t>();
+                                o.b = (int64_t)cur.get_section_offset() + delta;
+                                break;
+                        }
+                        case DW_OP::call2:
+                                o.a = cur.template fixed<uint16_t>();
+                                break;
+                        case DW_OP::call4:
+                                o.a = cur.template fixed<uint32_t>();
+                                break;
+                        case DW_OP::call_ref:
+                                o.a = cur.offset();
+                                break;
+
+                                // 2.5.1.6 Special operations
+                        case DW_OP::nop:
+                                break;
+
+                                // 2.6.1.1.2 Register location descriptions
+                        case DW_OP::reg0...DW_OP::reg31:
+                                o.a = (unsigned)o.op - (unsigned)DW_OP::reg0;
+                                o.op = DW_OP::regx;
+                                break;
+                        case DW_OP::regx:
+                                o.a = cur.uleb128();
+                                break;
+
+                                // 2.6.1.1.3 Implicit location descriptions
+                        case DW_OP::implicit_value:
+                                o.a = cur.uleb128();
+                                cur.ensure(o.a);
+                                o.b = cur.get_section_offset();
+                                cur += o.a;
+                                break;
+                        case DW_OP::stack_value:
+                                break;
+
+                                // 2.6.1.2 Composite location descriptions
+                        case DW_OP::piece:
+                                o.a = cur.uleb128();
+                                break;
+                        case DW_OP::bit_piece:
+                                o.a = cur.uleb128();
+                                o.b = cur.uleb128();
+                                break;
+
+                                // DWARF5 operations that aren't
+                                // implemented.  Decode their
+                                // operands so later operations can
+                                // still be reached by branches.
+                        case DW_OP::implicit_pointer:
+                                o.a = cur.offset();
+                                o.b = cur.sleb128();
+                                break;
+                        case DW_OP::entry_value:
+                                o.a = cur.uleb128();
+                                cur.ensure(o.a);
+                                cur += o.a;
+                                break;
+                        case DW_OP::const_type:
+                                o.a = cur.uleb128();
+                                o.b = cur.template fixed<uint8_t>();
+                                cur.ensure(o.b);
+                                cur += o.b;
+                                break;
+                        case DW_OP::regval_type:
+                                o.a = cur.uleb128();
+                                o.b = cur.uleb128();
+                                break;
+                        case DW_OP::deref_type:
+                        case DW_OP::xderef_type:
+                                o.a = cur.template fixed<uint8_t>();
+                                o.b = cur.uleb128();
+                                break;
+                        case DW_OP::convert:
+                        case DW_OP::reinterpret:
+                                o.a = cur.uleb128();
+                                break;
+
+                                // The size of the operands of
+                                // anything else is unknown, so nothing
+                                // after it can be decoded.  Evaluation
+                                // raises the error upon reaching it.
+                        case DW_OP::lo_user:
+                        case DW_OP::hi_user:
+                        default:
+                                // XXX We could let the context
+                                // evaluate user ops, but it would
+                                // need access to the cursor.
+                                if (o.op >= DW_OP::lo_user)
+                                        throw expr_error("unknown user op " + to_string(o.op));
+                                throw expr_error("bad operation " + to_string(o.op));
+                        }
+#pragma GCC diagnostic pop
+                        ops.push_back(o);
+                }
+        } catch (...) {
+                // Raise this when evaluation reaches the operation
+                // that failed to decode
+                error = current_exception();
+                ops.push_back(expr_op{op_error, 0, 0});
+        }
+
+        // Resolve branch targets to operation indexes.  A branch to
+        // or past the end of the expression ends it.
+        for (size_t i = 0; i < ops.size(); i++) {
+                expr_op &o = ops[i];
+                if (o.op != DW_OP::skip && o.op != DW_OP::bra)
+                        continue;
+                int64_t target = o.b;
+                if (target >= (int64_t)e.len) {
+                        o.a = ops.size();
+                } else if (target < 0) {
+                        o.a = bad_target;
+                } else {
+                        const section_offset *first = &starts[0];
+                        const section_offset *last = first + starts.size();
+                        const section_offset *it = lower_bound(first, last, (section_offset)target);
+                        o.a = (it != last && *it == (section_offset)target) ?
+                                it - first : bad_target;
+                }
+        }
+}
+
 expr_result
-expr::evaluate(expr_context *ctx, const std::initializer_list<taddr> &arguments) const
+expr_program::evaluate(expr_context *ctx,
+                       const std::initializer_list<taddr> &arguments) const
 {
         // The stack machine's stack.  The top of the stack is
         // stack.back().
@@ -41,19 +408,8 @@ expr::evaluate(expr_context *ctx, const std::initializer_list<taddr> &arguments)
         // Create the initial stack.  arguments are in reverse order
         // (that is, element 0 is TOS), so reverse it.
         stack.reserve(arguments.size());
-        for (const taddr *elt = arguments.end() - 1;
-             elt >= arguments.begin(); elt--)
-                stack.push_back(*elt);
-
-        // Create a subsection for just this expression so we can
-        // easily detect the end (including premature end).
-        auto cusec = cu->data();
-        shared_ptr<section> subsec
-                (make_shared<section>(cusec->type,
-                                      cusec->begin + offset, len,
-                                      cusec->ord, cusec->fmt,
-                                      cusec->addr_size));
-        cursor cur(subsec);
+        for (size_t i = arguments.size(); i-- > 0; )
+                stack.push_back(arguments.begin()[i]);
 
         // Prepare the expression result.  Some location descriptions
         // create the result directly, rather than using the top of
@@ -61,7 +417,7 @@ expr::evaluate(expr_context *ctx, const std::initializer_list<taddr> &arguments)
         expr_result result;
 
         // 2.6.1.1.4 Empty location descriptions
-        if (cur.end()) {
+        if (ops.empty()) {
                 result.location_type = expr_result::type::empty;
                 result.value = 0;
                 return result;
@@ -72,7 +428,8 @@ expr::evaluate(expr_context *ctx, const std::initializer_list<taddr> &arguments)
         result.location_type = expr_result::type::address;
 
         // Execute!
-        while (!cur.end()) {
+        size_t pc = 0, nops = ops.size();
+        while (pc < nops) {
 #define CHECK() do { if (stack.empty()) goto underflow; } while (0)
 #define CHECKN(n) do { if (stack.size() < n) goto underflow; } while (0)
                 union
@@ -82,63 +439,19 @@ expr::evaluate(expr_context *ctx, const std::initializer_list<taddr> &arguments)
                 } tmp1, tmp2, tmp3;
                 static_assert(sizeof(tmp1) == sizeof(taddr), "taddr is not 64 bits");
 
-                // Tell GCC to warn us about missing switch cases,
-                // even though we have a default case.
-#pragma GCC diagnostic push
-#pragma GCC diagnostic warning "-Wswitch-enum"
-                DW_OP op = (DW_OP)cur.fixed<ubyte>();
-                switch (op) {
+                const expr_op &o = ops[pc++];
+                switch (o.op) {
                         // 2.5.1.1 Literal encodings
-                case DW_OP::lit0...DW_OP::lit31:
-                        stack.push_back((unsigned)op - (unsigned)DW_OP::lit0);
-                        break;
-                case DW_OP::addr:
-                        stack.push_back(cur.address());
-                        break;
-                case DW_OP::const1u:
-                        stack.push_back(cur.fixed<uint8_t>());
-                        break;
-                case DW_OP::const2u:
-                        stack.push_back(cur.fixed<uint16_t>());
-                        break;
-                case DW_OP::const4u:
-                        stack.push_back(cur.fixed<uint32_t>());
-                        break;
-                case DW_OP::const8u:
-                        stack.push_back(cur.fixed<uint64_t>());
-                        break;
-                case DW_OP::const1s:
-                        stack.push_back(cur.fixed<int8_t>());
-                        break;
-                case DW_OP::const2s:
-                        stack.push_back(cur.fixed<int16_t>());
-                        break;
-                case DW_OP::const4s:
-                        stack.push_back(cur.fixed<int32_t>());
-                        break;
-                case DW_OP::const8s:
-                        stack.push_back(cur.fixed<int64_t>());
-                        break;
                 case DW_OP::constu:
-                        stack.push_back(cur.uleb128());
-                        break;
-                case DW_OP::consts:
-                        stack.push_back(cur.sleb128());
+                        stack.push_back(o.a);
                         break;
 
                         // 2.5.1.2 Register based addressing
                 case DW_OP::fbreg:
                         // XXX
                         throw runtime_error("DW_OP_fbreg not implemented");
-                case DW_OP::breg0...DW_OP::breg31:
-                        tmp1.u = (unsigned)op - (unsigned)DW_OP::breg0;
-                        tmp2.s = cur.sleb128();
-                        stack.push_back((int64_t)ctx->reg(tmp1.u) + tmp2.s);
-                        break;
                 case DW_OP::bregx:
-                        tmp1.u = cur.uleb128();
-                        tmp2.s = cur.sleb128();
-                        stack.push_back((int64_t)ctx->reg(tmp1.u) + tmp2.s);
+                        stack.push_back((int64_t)ctx->reg(o.a) + (int64_t)o.b);
                         break;
 
                         // 2.5.1.3 Stack operations
@@ -151,9 +464,9 @@ expr::evaluate(expr_context *ctx, const std::initializer_list<taddr> &arguments)
                         stack.pop_back();
                         break;
                 case DW_OP::pick:
-                        tmp1.u = cur.fixed<uint8_t>();
-                        CHECKN(tmp1.u);
-                        stack.push_back(stack.revat(tmp1.u));
+                        // Index 0 is the top of the stack
+                        CHECKN(o.a + 1);
+                        stack.push_back(stack.revat(o.a));
                         break;
                 case DW_OP::over:
                         CHECKN(2);
@@ -172,29 +485,19 @@ expr::evaluate(expr_context *ctx, const std::initializer_list<taddr> &arguments)
                         stack.revat(1) = stack.revat(2);
                         stack.revat(2) = tmp1.u;
                         break;
-                case DW_OP::deref:
-                        tmp1.u = subsec->addr_size;
-                        goto deref_common;
                 case DW_OP::deref_size:
-                        tmp1.u = cur.fixed<uint8_t>();
-                        if (tmp1.u > subsec->addr_size)
+                        if (o.a > addr_size)
                                 throw expr_error("DW_OP_deref_size operand exceeds address size");
-                deref_common:
                         CHECK();
-                        stack.back() = ctx->deref_size(stack.back(), tmp1.u);
+                        stack.back() = ctx->deref_size(stack.back(), o.a);
                         break;
-                case DW_OP::xderef:
-                        tmp1.u = subsec->addr_size;
-                        goto xderef_common;
                 case DW_OP::xderef_size:
-                        tmp1.u = cur.fixed<uint8_t>();
-                        if (tmp1.u > subsec->addr_size)
+                        if (o.a > addr_size)
                                 throw expr_error("DW_OP_xderef_size operand exceeds address size");
-                xderef_common:
                         CHECKN(2);
                         tmp2.u = stack.back();
                         stack.pop_back();
-                        stack.back() = ctx->xderef_size(tmp2.u, stack.back(), tmp1.u);
+                        stack.back() = ctx->xderef_size(tmp2.u, stack.back(), o.a);
                         break;
                 case DW_OP::push_object_address:
                         // XXX
@@ -204,8 +507,8 @@ expr::evaluate(expr_context *ctx, const std::initializer_list<taddr> &arguments)
                         stack.back() = ctx->form_tls_address(stack.back());
                         break;
                 case DW_OP::call_frame_cfa:
-                        // XXX
-                        throw runtime_error("DW_OP_call_frame_cfa not implemented");
+                        stack.push_back(ctx->call_frame_cfa());
+                        break;
 
                         // 2.5.1.4 Arithmetic and logical operations
 #define UBINOP(binop)                                                   \
@@ -220,24 +523,35 @@ expr::evaluate(expr_context *ctx, const std::initializer_list<taddr> &arguments)
                         CHECK();
                         tmp1.u = stack.back();
                         if (tmp1.s < 0)
-                                tmp1.s = -tmp1.s;
+                                tmp1.u = -tmp1.u;
                         stack.back() = tmp1.u;
                         break;
                 case DW_OP::and_:
                         UBINOP(&);
                         break;
                 case DW_OP::div:
+                        // The second entry divided by the top entry,
+                        // using signed division
                         CHECKN(2);
                         tmp1.u = stack.back();
                         stack.pop_back();
                         tmp2.u = stack.back();
-                        tmp3.s = tmp1.s / tmp2.s;
+                        if (tmp1.s == 0)
+                                throw expr_error("DW_OP_div by zero");
+                        // Avoid the overflow of INT64_MIN / -1
+                        if (tmp1.s == -1)
+                                tmp3.u = -tmp2.u;
+                        else
+                                tmp3.s = tmp2.s / tmp1.s;
                         stack.back() = tmp3.u;
                         break;
                 case DW_OP::minus:
                         UBINOP(-);
                         break;
                 case DW_OP::mod:
+                        CHECKN(2);
+                        if (stack.back() == 0)
+                                throw expr_error("DW_OP_mod by zero");
                         UBINOP(%);
                         break;
                 case DW_OP::mul:
@@ -245,9 +559,7 @@ expr::evaluate(expr_context *ctx, const std::initializer_list<taddr> &arguments)
                         break;
                 case DW_OP::neg:
                         CHECK();
-                        tmp1.u = stack.back();
-                        tmp1.s = -tmp1.s;
-                        stack.back() = tmp1.u;
+                        stack.back() = -stack.back();
                         break;
                 case DW_OP::not_:
                         CHECK();
@@ -260,9 +572,8 @@ expr::evaluate(expr_context *ctx, const std::initializer_list<taddr> &arguments)
                         UBINOP(+);
                         break;
                 case DW_OP::plus_uconst:
-                        tmp1.u = cur.uleb128();
                         CHECK();
-                        stack.back() += tmp1.u;
+                        stack.back() += o.a;
                         break;
                 case DW_OP::shl:
                         CHECKN(2);
@@ -320,7 +631,7 @@ expr::evaluate(expr_context *ctx, const std::initializer_list<taddr> &arguments)
                                 tmp1.u = stack.back();                  \
                                 stack.pop_back();                       \
                                 tmp2.u = stack.back();                  \
-                                stack.back() = (tmp2.s <= tmp1.s) ? 1 : 0; \
+                                stack.back() = (tmp2.s relop tmp1.s) ? 1 : 0; \
                         } while (0)
                 case DW_OP::le:
                         SRELOP(<=);
@@ -340,46 +651,35 @@ expr::evaluate(expr_context *ctx, const std::initializer_list<taddr> &arguments)
                 case DW_OP::ne:
                         SRELOP(!=);
                         break;
-                case DW_OP::skip:
-                        tmp1.s = cur.fixed<int16_t>();
-                        goto skip_common;
+#undef SRELOP
                 case DW_OP::bra:
-                        tmp1.s = cur.fixed<int16_t>();
                         CHECK();
-                        tmp2.u = stack.back();
+                        tmp1.u = stack.back();
                         stack.pop_back();
-                        if (tmp2.u == 0)
+                        if (tmp1.u == 0)
                                 break;
-                skip_common:
-                        cur = cursor(subsec, (int64_t)cur.get_section_offset() + tmp1.s);
+                        // Fall through
+                case DW_OP::skip:
+                        if (o.a == bad_target)
+                                throw expr_error(to_string(o.op) + " target is not an operation");
+                        pc = o.a;
                         break;
-                case DW_OP::call2:
-                case DW_OP::call4:
-                case DW_OP::call_ref:
-                        // XXX
-                        throw runtime_error(to_string(op) + " not implemented");
-#undef SRELOP
 
                         // 2.5.1.6 Special operations
                 case DW_OP::nop:
                         break;
 
                         // 2.6.1.1.2 Register location descriptions
-                case DW_OP::reg0...DW_OP::reg31:
-                        result.location_type = expr_result::type::reg;
-                        result.value = (unsigned)op - (unsigned)DW_OP::reg0;
-                        break;
                 case DW_OP::regx:
                         result.location_type = expr_result::type::reg;
-                        result.value = cur.uleb128();
+                        result.value = o.a;
                         break;
 
                         // 2.6.1.1.3 Implicit location descriptions
                 case DW_OP::implicit_value:
                         result.location_type = expr_result::type::implicit;
-                        result.implicit_len = cur.uleb128();
-                        cur.ensure(result.implicit_len);
-                        result.implicit = cur.pos;
+                        result.implicit_len = o.a;
+                        result.implicit = data + o.b;
                         break;
                 case DW_OP::stack_value:
                         CHECK();
@@ -387,21 +687,27 @@ expr::evaluate(expr_context *ctx, const std::initializer_list<taddr> &arguments)
                         result.value = stack.back();
                         break;
 
+                case DW_OP::call2:
+                case DW_OP::call4:
+                case DW_OP::call_ref:
                         // 2.6.1.2 Composite location descriptions
                 case DW_OP::piece:
                 case DW_OP::bit_piece:
+                case DW_OP::implicit_pointer:
+                case DW_OP::entry_value:
+                case DW_OP::const_type:
+                case DW_OP::regval_type:
+                case DW_OP::deref_type:
+                case DW_OP::xderef_type:
+                case DW_OP::convert:
+                case DW_OP::reinterpret:
                         // XXX
-                        throw runtime_error(to_string(op) + " not implemented");
-
-                case DW_OP::lo_user...DW_OP::hi_user:
-                        // XXX We could let the context evaluate this,
-                        // but it would need access to the cursor.
-                        throw expr_error("unknown user op " + to_string(op));
+                        throw runtime_error(to_string(o.op) + " not implemented");
 
                 default:
-                        throw expr_error("bad operation " + to_string(op));
+                        // The operation that stopped decoding
+                        rethrow_exception(error);
                 }
-#pragma GCC diagnostic pop
 #undef CHECK
 #undef CHECKN
         }
@@ -420,4 +726,119 @@ underflow:
         throw expr_error("stack underflow evaluating DWARF expression");
 }
 
+expr_result
+expr::evaluate(expr_context *ctx, const std::initializer_list<taddr> &arguments) const
+{
+        if (cache)
+                if (const expr_program *prog = cache->get(*this))
+                        return prog->evaluate(ctx, arguments);
+        expr_program prog;
+        prog.compile(*this);
+        return prog.evaluate(ctx, arguments);
+}
+
+compiled_expr
+expr::compile() const
+{
+        return compiled_expr(*this);
+}
+
+//////////////////////////////////////////////////////////////////
+// class compiled_expr
+//
+
+compiled_expr::compiled_expr(const expr &e)
+{
+        auto prog = make_shared<expr_program>();
+        prog->compile(e);
+        m = prog;
+}
+
+expr_result
+compiled_expr::evaluate(expr_context *ctx) const
+{
+        return evaluate(ctx, {});
+}
+
+expr_result
+compiled_expr::evaluate(expr_context *ctx, taddr argument) const
+{
+        return evaluate(ctx, {argument});
+}
+
+expr_result
+compiled_expr::evaluate(expr_context *ctx, const std::initializer_list<taddr> &arguments) const
+{
+        if (!m) {
+                expr_result result;
+                result.location_type = expr_result::type::empty;
+                result.value = 0;
+                return result;
+        }
+        return m->evaluate(ctx, arguments);
+}
+
+size_t
+compiled_expr::size() const
+{
+        return m ? m->ops.size() : 0;
+}
+
+//////////////////////////////////////////////////////////////////
+// struct expr_cache
+//
+
+// Maximum number of slots to probe in an expression cache
+static const unsigned expr_cache_probes = 16;
+
+expr_cache::expr_cache(size_t section_size)
+        : section_size(section_size), mask(0)
+{
+}
+
+expr_cache::~expr_cache()
+{
+        if (slots)
+                for (size_t i = 0; i <= mask; i++)
+                        delete slots[i].load(memory_order_relaxed);
+}
+
+const expr_program *
+expr_cache::get(const expr &e)
+{
+        call_once(slots_once, [this]() {
+                // Location expressions are a few bytes each, and
+                // usually only some of them are evaluated
+                size_t n = 16;
+                while (n < section_size / 64)
+                        n *= 2;
+                slots.reset(new atomic<expr_program*>[n]);
+                for (size_t i = 0; i < n; i++)
+                        slots[i].store(nullptr, memory_order_relaxed);
+                mask = n - 1;
+        });
+
+        const char *data = e.sec->begin + e.offset;
+        size_t h = ((uintptr_t)data * 0x9e3779b97f4a7c15ull) >> 32;
+        unique_ptr<expr_program> prog;
+        for (unsigned i = 0; i < expr_cache_probes; i++) {
+                auto &slot = slots[(h + i) & mask];
+                expr_program *cur = slot.load(memory_order_acquire);
+                if (!cur) {
+                        if (!prog) {
+                                prog.reset(new expr_program());
+                                prog->compile(e);
+                        }
+                        if (slot.compare_exchange_strong(
+                                    cur, prog.get(), memory_order_acq_rel))
+                                return prog.release();
+                        // Another thread filled the slot; cur is
+                        // its program
+                }
+                if (cur->data == data && cur->len == e.len)
+                        return cur;
+        }
+        return nullptr;
+}
+
 DWARFPP_END_NAMESPACE
@@ -0,0 +1,243 @@
+// Copyright (c) 2013 Austin T. Clements. All rights reserved.
+// Use of this source code is governed by an MIT license
+// that can be found in the LICENSE file.
+
+#include "internal.hh"
+
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <system_error>
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+using namespace std;
+
+DWARFPP_BEGIN_NAMESPACE
+
+// An index file begins with an index_file_header, followed by the
+// key, then a table of num_sections index_file_section entries
+// aligned to 8 bytes, then the sections, each aligned to 8 bytes.
+// Everything is in the byte order of the machine that wrote the file,
+// and records have the same layout they have in memory, so readers
+// can use them in place.  Readers reject files written in another
+// byte order rather than swapping them.
+
+static const char index_magic[8] = {'E', 'L', 'F', 'I', 'N', 'I', 'D', 'X'};
+
+// Bump this when the layout of the header or of any existing section
+// changes, or what it means.  Version 2 made the address ranges of
+// cu_ranges disjoint.  Version 3 replaced the copied name strings
+// with references to the DWARF's own sections.
+static const uint32_t index_version = 3;
+
+static const uint32_t index_byte_order_mark = 0x01020304;
+
+struct index_file_header
+{
+        char magic[8];
+        uint32_t version;
+        uint32_t byte_order_mark;
+        uint64_t info_size;
+        uint64_t num_units;
+        uint32_t key_size;
+        uint32_t num_sections;
+};
+
+struct index_file_section
+{
+        uint32_t type;
+        uint32_t record_size;
+        uint64_t offset;
+        uint64_t size;
+};
+
+static uint64_t
+align8(uint64_t x)
+{
+        return (x + 7) & ~(uint64_t)7;
+}
+
+//////////////////////////////////////////////////////////////////
+// struct index_writer
+//
+
+/**
+ * Write size bytes of data to out, throwing std::system_error on
+ * failure.
+ */
+static void
+write_all(FILE *out, const void *data, size_t size, const string &path)
+{
+        if (size && fwrite(data, 1, size, out) != size)
+                throw system_error(errno, system_category(),
+                                   "writing " + path);
+}
+
+/**
+ * Pad out with zeros up to offset *pos rounded up to 8 bytes.
+ */
+static void
+pad8(FILE *out, uint64_t *pos, const string &path)
+{
+        static const char zeros[8] = {};
+        uint64_t aligned = align8(*pos);
+        write_all(out, zeros, aligned - *pos, path);
+        *pos = aligned;
+}
+
+void
+index_writer::write(const string &path, const string &key,
+                    uint64_t info_size, uint64_t num_units) const
+{
+        index_file_header hdr = {};
+        memcpy(hdr.magic, index_magic, sizeof(hdr.magic));
+        hdr.version = index_version;
+        hdr.byte_order_mark = index_byte_order_mark;
+        hdr.info_size = info_size;
+        hdr.num_units = num_units;
+        hdr.key_size = key.size();
+        hdr.num_sections = secs.size();
+
+        vector<index_file_section> table(secs.size());
+        uint64_t pos = align8(sizeof(hdr) + key.size()) +
+                secs.size() * sizeof(index_file_section);
+        for (size_t i = 0; i < secs.size(); i++) {
+                pos = align8(pos);
+                table[i].type = (uint32_t)secs[i].type;
+                table[i].record_size = secs[i].record_size;
+                table[i].offset = pos;
+                table[i].size = secs[i].size;
+                pos += secs[i].size;
+        }
+
+        string tmp = path + ".XXXXXX";
+        int fd = mkstemp(&tmp[0]);
+        if (fd < 0)
+                throw system_error(errno, system_category(),
+                                   "creating " + tmp);
+        // mkstemp makes the file private, but index caches are
+        // usually shared
+        fchmod(fd, 0644);
+        FILE *out = fdopen(fd, "wb");
+        if (!out) {
+                int err = errno;
+                close(fd);
+                unlink(tmp.c_str());
+                throw system_error(err, system_category(), "opening " + tmp);
+        }
+
+        try {
+                pos = 0;
+                write_all(out, &hdr, sizeof(hdr), tmp);
+                write_all(out, key.data(), key.size(), tmp);
+                pos += sizeof(hdr) + key.size();
+                pad8(out, &pos, tmp);
+                write_all(out, table.data(),
+                          table.size() * sizeof(index_file_section), tmp);
+                pos += table.size() * sizeof(index_file_section);
+                for (auto &sec : secs) {
+                        pad8(out, &pos, tmp);
+                        write_all(out, sec.data, sec.size, tmp);
+                        pos += sec.size;
+                }
+                if (fflush(out) != 0)
+                        throw system_error(errno, system_category(),
+                                           "writing " + tmp);
+        } catch (...) {
+                fclose(out);
+                unlink(tmp.c_str());
+                throw;
+        }
+        if (fclose(out) != 0) {
+                int err = errno;
+                unlink(tmp.c_str());
+                throw system_error(err, system_category(), "writing " + tmp);
+        }
+        if (rename(tmp.c_str(), path.c_str()) != 0) {
+                int err = errno;
+                unlink(tmp.c_str());
+                throw system_error(err, system_category(),
+                                   "renaming " + tmp + " to " + path);
+        }
+}
+
+//////////////////////////////////////////////////////////////////
+// class index_file
+//
+
+shared_ptr<const index_file>
+index_file::open(const string &path, const string &key,
+                 uint64_t info_size, uint64_t num_units)
+{
+        int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0)
+                return nullptr;
+        struct stat st;
+        if (fstat(fd, &st) < 0 || (uint64_t)st.st_size < sizeof(index_file_header)) {
+                close(fd);
+                return nullptr;
+        }
+        size_t size = st.st_size;
+        void *base = mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+        close(fd);
+        if (base == MAP_FAILED)
+                return nullptr;
+        shared_ptr<index_file> file(new index_file((const char*)base, size));
+
+        // Check everything the offsets depend on here, so lookups
+        // only have to check the contents of the sections
+        const index_file_header *hdr = (const index_file_header*)base;
+        if (memcmp(hdr->magic, index_magic, sizeof(hdr->magic)) != 0 ||
+            hdr->version != index_version ||
+            hdr->byte_order_mark != index_byte_order_mark ||
+            hdr->info_size != info_size || hdr->num_units != num_units ||
+            hdr->key_size != key.size() ||
+            size - sizeof(*hdr) < key.size() ||
+            memcmp(hdr + 1, key.data(), key.size()) != 0)
+                return nullptr;
+
+        uint64_t table_offset = align8(sizeof(*hdr) + key.size());
+        if (table_offset > size ||
+            hdr->num_sections > (size - table_offset) / sizeof(index_file_section))
+                return nullptr;
+        file->table = (const index_file_section*)(file->base + table_offset);
+        file->num_sections = hdr->num_sections;
+        for (size_t i = 0; i < file->num_sections; i++) {
+                const index_file_section &sec = file->table[i];
+                if (sec.offset % 8 != 0 || sec.offset > size ||
+                    sec.size > size - sec.offset)
+                        return nullptr;
+        }
+        return file;
+}
+
+index_file::~index_file()
+{
+        munmap((void*)base, size);
+}
+
+bool
+index_file::find(index_section type, size_t record_size,
+                 const void **data, size_t *size_out) const
+{
+        for (size_t i = 0; i < num_sections; i++) {
+                const index_file_section &sec = table[i];
+                if (sec.type != (uint32_t)type)
+                        continue;
+                // A section of some other layout is as good as
+                // missing, so callers can fall back to building it
+                if (sec.record_size != record_size ||
+                    sec.size % record_size != 0)
+                        return false;
+                *data = base + sec.offset;
+                *size_out = sec.size;
+                return true;
+        }
+        return false;
+}
+
+DWARFPP_END_NAMESPACE
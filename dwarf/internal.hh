@@ -8,7 +8,13 @@
 #include "dwarf++.hh"
 #include "../elf/to_hex.hh"
 
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <exception>
+#include <mutex>
 #include <stdexcept>
+#include <thread>
 #include <type_traits>
 #include <unordered_map>
 #include <vector>
@@ -28,21 +34,198 @@ enum class byte_order
         msb
 };
 
+// This system's native byte order, known at compile time so
+// reading a host-order section needs no byte swapping
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+static const byte_order host_order = byte_order::msb;
+#else
+static const byte_order host_order = byte_order::lsb;
+#endif
+
 /**
  * Return this system's native byte order.
  */
 static inline byte_order
 native_order()
 {
-        static const union
+        return host_order;
+}
+
+/**
+ * The unsigned integer type of N bytes.
+ */
+template<unsigned N> struct uint_of_size;
+template<> struct uint_of_size<1> { typedef std::uint8_t type; };
+template<> struct uint_of_size<2> { typedef std::uint16_t type; };
+template<> struct uint_of_size<4> { typedef std::uint32_t type; };
+template<> struct uint_of_size<8> { typedef std::uint64_t type; };
+
+static inline std::uint8_t bswap(std::uint8_t x) { return x; }
+static inline std::uint16_t bswap(std::uint16_t x) { return __builtin_bswap16(x); }
+static inline std::uint32_t bswap(std::uint32_t x) { return __builtin_bswap32(x); }
+static inline std::uint64_t bswap(std::uint64_t x) { return __builtin_bswap64(x); }
+
+/**
+ * Load an integer of type T stored in byte order Ord at p, which
+ * need not be aligned.  This compiles to a single load, plus a byte
+ * swap if Ord isn't the host's order.
+ */
+template<typename T, byte_order Ord>
+static inline T
+load_unaligned(const char *p)
+{
+        typedef typename uint_of_size<sizeof(T)>::type U;
+        U val;
+        memcpy(&val, p, sizeof(U));
+        if (Ord != host_order)
+                val = bswap(val);
+        return (T)val;
+}
+
+// The number of section types.  This relies on types being the last
+// section_type.
+static const unsigned num_section_types = (unsigned)section_type::types + 1;
+
+static const unsigned num_phases = (unsigned)phase::split_unit + 1;
+
+//////////////////////////////////////////////////////////////////
+// Statistics
+//
+
+/**
+ * The counters of a stats_block.  See dwarf_stats.
+ */
+enum class counter
+{
+        dies_decoded,
+        abbrev_tables_parsed,
+        abbrev_tables_shared,
+        line_programs_executed,
+        line_lookup_hits,
+        line_lookup_misses,
+        sibling_cache_hits,
+        sibling_cache_misses,
+        ref_target_hits,
+        ref_target_misses,
+        section_hits,
+        section_misses,
+        type_unit_hits,
+        type_unit_misses,
+        max
+};
+
+/**
+ * The statistics of a dwarf file and the split DWARF files it opens.
+ * Sections and units keep a pointer to their file's block so hot
+ * paths can check enabled without chasing pointers through the
+ * dwarf.
+ */
+struct stats_block
+{
+        std::atomic<bool> enabled;
+        // Set before enabled and never changed after
+        std::shared_ptr<tracer> t;
+        std::atomic<std::uint64_t> counters[(unsigned)counter::max];
+        std::atomic<std::uint64_t> bytes_loaded[num_section_types];
+        std::atomic<std::uint64_t> bytes_decoded[num_section_types];
+        std::atomic<std::uint64_t> phase_count[num_phases];
+        std::atomic<std::uint64_t> phase_ns[num_phases];
+
+        stats_block() : enabled(false)
         {
-                int i;
-                char c[sizeof(int)];
-        } test = {1};
+                reset();
+        }
 
-        return test.c[0] == 1 ? byte_order::lsb : byte_order::msb;
+        void reset()
+        {
+                for (auto &c : counters)
+                        c.store(0, std::memory_order_relaxed);
+                for (unsigned i = 0; i < num_section_types; i++) {
+                        bytes_loaded[i].store(0, std::memory_order_relaxed);
+                        bytes_decoded[i].store(0, std::memory_order_relaxed);
+                }
+                for (unsigned i = 0; i < num_phases; i++) {
+                        phase_count[i].store(0, std::memory_order_relaxed);
+                        phase_ns[i].store(0, std::memory_order_relaxed);
+                }
+        }
+};
+
+/**
+ * Return true if s is non-null and collecting statistics.
+ */
+static inline bool
+stats_on(const stats_block *s)
+{
+#ifdef DWARFPP_DISABLE_STATS
+        return false;
+#else
+        return s && s->enabled.load(std::memory_order_relaxed);
+#endif
 }
 
+/**
+ * Add n to counter c of s, if s is collecting statistics.
+ */
+static inline void
+count_stat(stats_block *s, counter c, std::uint64_t n = 1)
+{
+        if (stats_on(s))
+                s->counters[(unsigned)c].fetch_add(n, std::memory_order_relaxed);
+}
+
+/**
+ * Count n bytes of a section of type type as decoded, if s is
+ * collecting statistics.
+ */
+static inline void
+count_decoded(stats_block *s, section_type type, std::uint64_t n)
+{
+        if (stats_on(s))
+                s->bytes_decoded[(unsigned)type].fetch_add(
+                        n, std::memory_order_relaxed);
+}
+
+/**
+ * Times a phase from construction to destruction and reports it to
+ * the tracer, if s is collecting statistics.
+ */
+class phase_timer
+{
+public:
+        phase_timer(stats_block *s, phase p, const unit *u = nullptr)
+                : s(stats_on(s) ? s : nullptr), p(p), u(u)
+        {
+                if (!this->s)
+                        return;
+                if (this->s->t)
+                        this->s->t->begin(p, u);
+                start = std::chrono::steady_clock::now();
+        }
+
+        ~phase_timer()
+        {
+                if (!s)
+                        return;
+                std::uint64_t ns =
+                        std::chrono::duration_cast<std::chrono::nanoseconds>(
+                                std::chrono::steady_clock::now() - start).count();
+                s->phase_count[(unsigned)p].fetch_add(1, std::memory_order_relaxed);
+                s->phase_ns[(unsigned)p].fetch_add(ns, std::memory_order_relaxed);
+                if (s->t)
+                        s->t->end(p, u, ns);
+        }
+
+        phase_timer(const phase_timer &) = delete;
+        phase_timer &operator=(const phase_timer &) = delete;
+
+private:
+        stats_block *s;
+        phase p;
+        const unit *u;
+        std::chrono::steady_clock::time_point start;
+};
+
 /**
  * A single DWARF section or a slice of a section.  This also tracks
  * dynamic information necessary to decode values in this section.
@@ -54,13 +237,16 @@ struct section
         const format fmt;
         const byte_order ord;
         unsigned addr_size;
+        // The statistics of the file this section belongs to, or
+        // nullptr
+        stats_block *stats;
 
         section(section_type type, const void *begin,
                 section_length length,
                 byte_order ord, format fmt = format::unknown,
                 unsigned addr_size = 0)
                 : type(type), begin((char*)begin), end((char*)begin + length),
-                  fmt(fmt), ord(ord), addr_size(addr_size) { }
+                  fmt(fmt), ord(ord), addr_size(addr_size), stats(nullptr) { }
 
         section(const section &o) = default;
 
@@ -73,10 +259,12 @@ struct section
                 if (addr_size == 0)
                         addr_size = this->addr_size;
 
-                return std::make_shared<section>(
+                auto sec = std::make_shared<section>(
                         type, begin+start,
                         std::min(len, (section_length)(end-begin)),
                         ord, fmt, addr_size);
+                sec->stats = stats;
+                return sec;
         }
 
         size_t size() const
@@ -91,18 +279,19 @@ struct section
  */
 struct cursor
 {
-        // XXX There's probably a lot of overhead to maintaining the
-        // shared pointer to the section from this.  Perhaps the rule
-        // should be that all objects keep the dwarf::impl alive
-        // (directly or indirectly) and that keeps the loader alive,
-        // so a cursor just needs a regular section*.
-
-        std::shared_ptr<section> sec;
+        // The section this cursor points into.  Cursors don't own
+        // their section: every section is owned by the dwarf::impl
+        // or by the unit, line table, or range list whose data it
+        // holds, and cursors never outlive their owner.  This keeps
+        // cursor construction free of reference count traffic.
+        const section *sec;
         const char *pos;
 
         cursor()
-                : pos(nullptr) { }
-        cursor(const std::shared_ptr<section> sec, section_offset offset = 0)
+                : sec(nullptr), pos(nullptr) { }
+        cursor(const std::shared_ptr<section> &sec, section_offset offset = 0)
+                : sec(sec.get()), pos(sec->begin + offset) { }
+        cursor(const section *sec, section_offset offset = 0)
                 : sec(sec), pos(sec->begin + offset) { }
 
         /**
@@ -114,6 +303,14 @@ struct cursor
          * skip_initial_length).
          */
         std::shared_ptr<section> subsection();
+
+        /**
+         * Like subsection, but return the subsection by value.  This
+         * avoids an allocation when the subsection is only needed
+         * briefly, such as to read a unit header.
+         */
+        section subsection_value();
+
         std::int64_t sleb128();
         section_offset offset();
         void string(std::string &out);
@@ -126,41 +323,54 @@ struct cursor
                         underflow();
         }
 
-        template<typename T>
+        /**
+         * Read a T in byte order Ord, without checking the
+         * section's byte order.
+         */
+        template<typename T, byte_order Ord>
         T fixed()
         {
                 ensure(sizeof(T));
-                static_assert(sizeof(T) <= 8, "T too big");
-                uint64_t val = 0;
-                const unsigned char *p = (const unsigned char*)pos;
-                if (sec->ord == byte_order::lsb) {
-                        for (unsigned i = 0; i < sizeof(T); i++)
-                                val |= ((uint64_t)p[i]) << (i * 8);
-                } else {
-                        for (unsigned i = 0; i < sizeof(T); i++)
-                                val = (val << 8) | (uint64_t)p[i];
-                }
+                T val = load_unaligned<T, Ord>(pos);
                 pos += sizeof(T);
-                return (T)val;
+                return val;
+        }
+
+        template<typename T>
+        T fixed()
+        {
+                if (sec->ord == host_order)
+                        return fixed<T, host_order>();
+                return fixed<T, host_order == byte_order::lsb ?
+                                byte_order::msb : byte_order::lsb>();
         }
 
         std::uint64_t uleb128()
         {
-                // Appendix C
-                // XXX Pre-compute all two byte ULEB's
-                std::uint64_t result = 0;
-                int shift = 0;
-                while (pos < sec->end) {
-                        uint8_t byte = *(uint8_t*)(pos++);
-                        result |= (uint64_t)(byte & 0x7f) << shift;
-                        if ((byte & 0x80) == 0)
-                                return result;
-                        shift += 7;
+                // Appendix C.  Nearly all LEB128 values in DWARF are
+                // abbrev codes, attribute names and forms, small
+                // constants, and line program operands, which fit
+                // in one or two bytes, so decode those inline.
+                if (sec->end - pos >= 2) {
+                        std::uint8_t b0 = pos[0];
+                        if (!(b0 & 0x80)) {
+                                pos++;
+                                return b0;
+                        }
+                        std::uint8_t b1 = pos[1];
+                        if (!(b1 & 0x80)) {
+                                pos += 2;
+                                return (b0 & 0x7f) | ((std::uint64_t)b1 << 7);
+                        }
                 }
-                underflow();
-                return 0;
+                return uleb128_slow();
         }
 
+        /**
+         * Skip n consecutive LEB128 values, signed or unsigned.
+         */
+        void skip_leb128(unsigned n = 1);
+
         taddr address()
         {
                 switch (sec->addr_size) {
@@ -178,7 +388,6 @@ struct cursor
         }
 
         void skip_initial_length();
-        void skip_unit_type();
         void skip_form(DW_FORM form);
 
         cursor &operator+=(section_offset offset)
@@ -213,12 +422,147 @@ struct cursor
         }
 
 private:
-        cursor(const std::shared_ptr<section> sec, const char *pos)
+        cursor(const section *sec, const char *pos)
                 : sec(sec), pos(pos) { }
 
+        std::uint64_t uleb128_slow();
         void underflow();
 };
 
+/**
+ * A cursor into a section whose byte order, format, and address size
+ * are known at compile time to be Ord, Fmt, and AddrSize, so reading
+ * fixed-size values, offsets, and addresses and skipping attributes
+ * doesn't check them.  Decoders of DIEs, line programs, and
+ * expressions are instantiated for each combination, and each unit
+ * or line table picks its instantiation once (see
+ * select_cursor_kind).
+ */
+template<byte_order Ord, format Fmt, unsigned AddrSize>
+struct specialized_cursor : public cursor
+{
+        specialized_cursor(const std::shared_ptr<section> &sec,
+                           section_offset offset = 0)
+                : cursor(sec, offset) { }
+        specialized_cursor(const section *sec, section_offset offset = 0)
+                : cursor(sec, offset) { }
+
+        template<typename T>
+        T fixed()
+        {
+                return cursor::fixed<T, Ord>();
+        }
+
+        section_offset offset()
+        {
+                if (Fmt == format::dwarf64)
+                        return fixed<std::uint64_t>();
+                return fixed<std::uint32_t>();
+        }
+
+        taddr address()
+        {
+                if (AddrSize == 8)
+                        return fixed<std::uint64_t>();
+                return fixed<std::uint32_t>();
+        }
+
+        void skip_form(DW_FORM form)
+        {
+                // Section 7.5.4.  The rarely used forms are left to
+                // cursor::skip_form.
+                switch (form) {
+                case DW_FORM::addr:
+                        pos += AddrSize;
+                        break;
+                case DW_FORM::sec_offset:
+                case DW_FORM::ref_addr:
+                case DW_FORM::strp:
+                case DW_FORM::line_strp:
+                        pos += Fmt == format::dwarf64 ? 8 : 4;
+                        break;
+                case DW_FORM::block1:
+                        pos += fixed<ubyte>();
+                        break;
+                case DW_FORM::block2:
+                        pos += fixed<uhalf>();
+                        break;
+                case DW_FORM::block4:
+                        pos += fixed<uword>();
+                        break;
+                case DW_FORM::block:
+                case DW_FORM::exprloc:
+                        pos += uleb128();
+                        break;
+                case DW_FORM::flag_present:
+                case DW_FORM::implicit_const:
+                        break;
+                case DW_FORM::flag:
+                case DW_FORM::data1:
+                case DW_FORM::ref1:
+                case DW_FORM::strx1:
+                        pos += 1;
+                        break;
+                case DW_FORM::data2:
+                case DW_FORM::ref2:
+                case DW_FORM::strx2:
+                        pos += 2;
+                        break;
+                case DW_FORM::data4:
+                case DW_FORM::ref4:
+                case DW_FORM::strx4:
+                        pos += 4;
+                        break;
+                case DW_FORM::data8:
+                case DW_FORM::ref8:
+                case DW_FORM::ref_sig8:
+                        pos += 8;
+                        break;
+                case DW_FORM::sdata:
+                case DW_FORM::udata:
+                case DW_FORM::strx:
+                case DW_FORM::addrx:
+                case DW_FORM::loclistx:
+                case DW_FORM::rnglistx:
+                        skip_leb128();
+                        break;
+                default:
+                        cursor::skip_form(form);
+                        break;
+                }
+        }
+};
+
+/**
+ * Return the index of the decoder instantiation to use for sec in a
+ * table built with CURSOR_KERNELS.  Sections of unknown format or an
+ * address size other than 4 or 8 use the instantiation for plain
+ * cursor, which checks them on each read.
+ */
+static inline unsigned
+select_cursor_kind(const section &sec)
+{
+        if (sec.fmt == format::unknown ||
+            (sec.addr_size != 4 && sec.addr_size != 8))
+                return 8;
+        return (sec.ord == byte_order::msb) * 4 +
+                (sec.fmt == format::dwarf64) * 2 + (sec.addr_size == 8);
+}
+
+// A table of the instantiations of the function template kernel for
+// each cursor kind, indexed by select_cursor_kind
+#define CURSOR_KERNELS(kernel) {                                        \
+        kernel<specialized_cursor<byte_order::lsb, format::dwarf32, 4> >, \
+        kernel<specialized_cursor<byte_order::lsb, format::dwarf32, 8> >, \
+        kernel<specialized_cursor<byte_order::lsb, format::dwarf64, 4> >, \
+        kernel<specialized_cursor<byte_order::lsb, format::dwarf64, 8> >, \
+        kernel<specialized_cursor<byte_order::msb, format::dwarf32, 4> >, \
+        kernel<specialized_cursor<byte_order::msb, format::dwarf32, 8> >, \
+        kernel<specialized_cursor<byte_order::msb, format::dwarf64, 4> >, \
+        kernel<specialized_cursor<byte_order::msb, format::dwarf64, 8> >, \
+        kernel<cursor>,                                                 \
+}
+
 /**
  * An attribute specification in an abbrev.
  */
@@ -248,11 +592,68 @@ struct abbrev_entry
         bool children;
         std::vector<attribute_spec> attributes;
 
-        abbrev_entry() : code(0) { }
+        // Precomputed attribute layout, filled in by finalize.  The
+        // first nfixed attributes have sizes that depend only on the
+        // unit's format and address size, so their offsets relative
+        // to the first attribute are known in advance.
+        // fixed_offsets holds these nfixed offsets, followed by the
+        // offset just past the last of them.  If all attributes are
+        // fixed-size, fixed_size is true and this last entry is the
+        // total size of the attribute data.
+        unsigned nfixed;
+        bool fixed_size;
+        std::vector<section_length> fixed_offsets;
+
+        // Open-addressing hash table from attribute name to index in
+        // attributes.  The size is a power of two at least twice the
+        // number of attributes; empty slots have index -1.
+        struct attr_slot
+        {
+                DW_AT name;
+                int index;
+        };
+        std::vector<attr_slot> attr_slots;
+
+        abbrev_entry() : code(0), nfixed(0), fixed_size(false) { }
 
         bool read(cursor *cur);
+
+        /**
+         * Precompute the attribute layout of this abbrev for a unit
+         * with the given format and address size.
+         */
+        void finalize(format fmt, unsigned addr_size);
+
+        /**
+         * Return the index in attributes of the attribute with the
+         * given name, or -1 if this abbrev has no such attribute.
+         */
+        int find(DW_AT name) const
+        {
+                if (attr_slots.empty())
+                        return -1;
+                size_t mask = attr_slots.size() - 1;
+                for (size_t i = hash_attr(name) & mask; ; i = (i + 1) & mask) {
+                        const attr_slot &slot = attr_slots[i];
+                        if (slot.index < 0 || slot.name == name)
+                                return slot.index;
+                }
+        }
+
+        static size_t hash_attr(DW_AT name)
+        {
+                return ((unsigned)name * 0x9e3779b1u) >> 16;
+        }
 };
 
+inline section_offset
+die::attr_offset(unsigned i) const
+{
+        if (i < abbrev->nfixed)
+                return attr_base + abbrev->fixed_offsets[i];
+        return attrs[i - abbrev->nfixed];
+}
+
 /**
  * A section header in .debug_pubnames or .debug_pubtypes.
  */
@@ -261,6 +662,8 @@ struct name_unit
         uhalf version;
         section_offset debug_info_offset;
         section_length debug_info_length;
+        // The section data of this unit, which entries points into
+        std::shared_ptr<section> subsec;
         // Cursor to the first name_entry in this unit.  This cursor's
         // section is limited to this unit.
         cursor entries;
@@ -268,7 +671,7 @@ struct name_unit
         void read(cursor *cur)
         {
                 // Section 7.19
-                std::shared_ptr<section> subsec = cur->subsection();
+                subsec = cur->subsection();
                 cursor sub(subsec);
                 sub.skip_initial_length();
                 version = sub.fixed<uhalf>();
@@ -295,6 +698,247 @@ struct name_entry
         }
 };
 
+/**
+ * A set of interned source file paths, shared by the line tables of
+ * a dwarf file.  Each distinct path is stored once and has a dense
+ * identifier.  Interned strings are never moved or freed, so
+ * references to them remain valid as long as the table.
+ */
+struct path_table
+{
+        std::mutex lock;
+        std::unordered_map<std::string, unsigned> ids;
+
+        /**
+         * Return the interned copy of path and set *id_out to its
+         * identifier.  The caller must hold lock.
+         */
+        const std::string *intern(std::string &&path, unsigned *id_out)
+        {
+                auto it = ids.emplace(std::move(path), ids.size()).first;
+                *id_out = it->second;
+                return &it->first;
+        }
+};
+
+/**
+ * A lock-free cache of compiled expressions, so an expression that is
+ * evaluated repeatedly is only decoded once.  Expressions are
+ * identified by the address and length of their bytes, since exprs
+ * for the same expression may refer to different slices of its
+ * section.  Each cache belongs to a single unit or cfi, so everything
+ * else that affects decoding is the same for all of its expressions.
+ * Entries are never removed; once the cache fills up, expressions
+ * that don't fit are decoded on every evaluation.
+ */
+struct expr_cache
+{
+        /**
+         * Construct an empty cache for the expressions of a unit or
+         * call frame section of the given size.  The table itself is
+         * allocated by the first get.
+         */
+        explicit expr_cache(size_t section_size);
+        ~expr_cache();
+
+        expr_cache(const expr_cache &) = delete;
+        expr_cache &operator=(const expr_cache &) = delete;
+
+        /**
+         * Return the compiled form of e, decoding it if this is the
+         * first request for its location.  Returns nullptr if e
+         * isn't cached and there's no room for it.
+         */
+        const expr_program *get(const expr &e);
+
+private:
+        size_t section_size;
+        std::unique_ptr<std::atomic<expr_program*>[]> slots;
+        size_t mask;
+        std::once_flag slots_once;
+};
+
+/**
+ * Call f(i) for each i in [0, n) using up to nthreads threads
+ * (including the calling thread).  f must be safe to call
+ * concurrently.  If any call throws, the remaining calls are
+ * abandoned and the first exception is rethrown in the calling
+ * thread once all threads are done.
+ */
+template<typename F>
+void
+parallel_for(size_t n, unsigned nthreads, const F &f)
+{
+        std::atomic<size_t> next(0);
+        std::exception_ptr error;
+        std::mutex error_lock;
+
+        auto worker = [&]() {
+                size_t i;
+                while ((i = next.fetch_add(1, std::memory_order_relaxed)) < n) {
+                        try {
+                                f(i);
+                        } catch (...) {
+                                std::lock_guard<std::mutex> lock(error_lock);
+                                if (!error)
+                                        error = std::current_exception();
+                                next.store(n, std::memory_order_relaxed);
+                        }
+                }
+        };
+
+        if (nthreads > n)
+                nthreads = n;
+        std::vector<std::thread> threads;
+        for (unsigned t = 1; t < nthreads; t++)
+                threads.emplace_back(worker);
+        worker();
+        for (auto &thread : threads)
+                thread.join();
+        if (error)
+                std::rethrow_exception(error);
+}
+
+/**
+ * The types of the sections of an index file (see
+ * dwarf::save_index).  Readers ignore sections they don't know, so
+ * new types can be added without changing the file version.
+ */
+enum class index_section : std::uint32_t
+{
+        cu_ranges    = 1,       // Address index of compilation units
+        names        = 2,       // name_index names
+        name_entries = 3,       // name_index entries
+        name_slots   = 4,       // name_index hash table
+        // 5 held copies of the names before version 3
+};
+
+struct index_file_section;
+
+/**
+ * An index file being assembled for writing.  Each section is an
+ * array of fixed-size records, which must stay live until write.
+ */
+struct index_writer
+{
+        template<typename T>
+        void add(index_section type, const T *data, size_t count)
+        {
+                secs.push_back(sec{type, sizeof(T), data, count * sizeof(T)});
+        }
+
+        /**
+         * Write the index file to path.  The file identifies the
+         * DWARF it indexes by key, the size of its .debug_info
+         * section, and its number of compilation units.  This writes
+         * a temporary file in the same directory and renames it to
+         * path, so readers see either the complete file or none.
+         * Throws std::system_error if writing fails.
+         */
+        void write(const std::string &path, const std::string &key,
+                   std::uint64_t info_size, std::uint64_t num_units) const;
+
+private:
+        struct sec
+        {
+                index_section type;
+                size_t record_size;
+                const void *data;
+                size_t size;
+        };
+        std::vector<sec> secs;
+};
+
+/**
+ * A read-only mapping of an index file.  Sections are used in place.
+ */
+class index_file
+{
+public:
+        /**
+         * Map the index file at path.  Returns nullptr if the file
+         * can't be opened, was written by a different version of the
+         * format or on a machine of different byte order, or doesn't
+         * match key, info_size, and num_units (see
+         * index_writer::write).
+         */
+        static std::shared_ptr<const index_file>
+        open(const std::string &path, const std::string &key,
+             std::uint64_t info_size, std::uint64_t num_units);
+
+        ~index_file();
+
+        index_file(const index_file &) = delete;
+        index_file &operator=(const index_file &) = delete;
+
+        /**
+         * Set *data and *count to the records of the given section
+         * type and return true.  If the file has no such section,
+         * or its records aren't of type T, return false.
+         */
+        template<typename T>
+        bool get(index_section type, const T **data, size_t *count) const
+        {
+                const void *p;
+                size_t size;
+                if (!find(type, sizeof(T), &p, &size))
+                        return false;
+                *data = (const T*)p;
+                *count = size / sizeof(T);
+                return true;
+        }
+
+private:
+        index_file(const char *base, size_t size)
+                : base(base), size(size), table(nullptr), num_sections(0) { }
+
+        bool find(index_section type, size_t record_size,
+                  const void **data, size_t *size_out) const;
+
+        const char *base;
+        size_t size;
+        const index_file_section *table;
+        size_t num_sections;
+};
+
+/**
+ * The unit index of a DWARF package (.dwp), which locates the
+ * contributions of each split compilation unit to the package's
+ * sections (DWARF5 section 7.3.5).  This reads both the DWARF 5
+ * format and the version 2 format of the GNU extension to DWARF 4.
+ */
+class package_index
+{
+public:
+        /**
+         * Read the .debug_cu_index of the package loaded by l.
+         * Throws format_error if the package has no unit index or
+         * it is malformed.
+         */
+        explicit package_index(const std::shared_ptr<loader> &l);
+
+        /**
+         * Return a loader for the sections of the compilation unit
+         * with the given DWO ID, which serves the unit's
+         * contributions in place of whole sections.  Returns nullptr
+         * if the package has no such unit.
+         */
+        std::shared_ptr<loader> get_unit_loader(std::uint64_t dwo_id) const;
+
+private:
+        std::shared_ptr<loader> l;
+        std::shared_ptr<section> index;
+        unsigned version;
+        std::uint32_t num_columns, num_units, num_slots;
+        // The section each column of the offset and size tables
+        // describes, or num_section_types for sections that aren't
+        // read
+        std::vector<unsigned> columns;
+        // Whole package sections, indexed by section_type
+        const void *data[num_section_types];
+        size_t sizes[num_section_types];
+};
+
 DWARFPP_END_NAMESPACE
 
 #endif
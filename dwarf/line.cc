@@ -4,7 +4,12 @@
 
 #include "internal.hh"
 
+#include <algorithm>
+#include <atomic>
 #include <cassert>
+#include <deque>
+#include <mutex>
+#include <set>
 
 using namespace std;
 
@@ -30,10 +35,18 @@ struct line_table::impl
         };
 
         shared_ptr<section> sec;
+        // The line program decoder instantiation for sec
+        unsigned cursor_kind;
         const dwarf *dw;
         shared_ptr<section> line_str_sec;
         shared_ptr<section> str_sec;
-        string comp_dir;
+        // The compilation directory, with a trailing slash if not
+        // empty, and the compilation unit's name
+        string comp_dir, cu_name;
+        // The table that file paths are interned in: the dwarf
+        // file's, or own_paths if there is no dwarf file
+        path_table *paths;
+        unique_ptr<path_table> own_paths;
 
         // Header information
         uhalf version;
@@ -46,36 +59,76 @@ struct line_table::impl
         ubyte opcode_base;
         unsigned file_index_base;
         vector<ubyte> standard_opcode_lengths;
-        vector<string> include_directories;
+        // Include directories as recorded in the header.  An empty
+        // directory is the compilation directory.  Paths are joined
+        // only when file::path is first called.
+        vector<const char *> include_directories;
+        // The files in the header, which never change once the
+        // table is constructed
         vector<file> file_names;
         vector<entry_format> file_entry_formats;
 
-        // The offset in sec following the last read file name entry.
-        // File name entries can appear both in the line table header
-        // and in the line number program itself.  Since we can
-        // iterate over the line number program repeatedly, this keeps
-        // track of how far we've gotten so we don't add the same
-        // entry twice.
-        section_offset last_file_name_end;
-        // If an iterator has traversed the entire program, then we
-        // know we've gathered all file names.
-        bool file_names_complete;
-
-        impl() : dw(nullptr), version(0), file_index_base(1),
-                 last_file_name_end(0),
-                 file_names_complete(false) {};
-
+        // The files defined by DW_LNE::define_file (before DWARF 5),
+        // numbered after file_names in program order.  These are
+        // recorded the first time an iterator executes each
+        // define_file, so that reading the header doesn't require
+        // decoding the whole program.  Iterators start at the
+        // beginning of the program, or at a row of the address
+        // index, which is built by a full pass, so the define_files
+        // before an iterator's position have always been recorded;
+        // program_files_end is the offset just past the last one.
+        // A deque never moves its elements, so pointers to them
+        // remain valid.  program_files_lock protects both.
+        deque<file> program_files;
+        section_offset program_files_end;
+        mutex program_files_lock;
+
+        // Address index for find_address.  Each address range maps
+        // to the row that find_address's linear scan would return
+        // for any address in that range.  Ranges are disjoint and
+        // sorted by low.  Rows record the emitted entry and the
+        // program offset following it, which is enough to
+        // reconstruct an iterator at that row.
+        struct addr_range {
+                taddr low, high;
+                unsigned row;
+
+                bool operator<(const addr_range &o) const
+                {
+                        return low < o.low;
+                }
+        };
+        struct addr_row {
+                line_table::entry entry;
+                section_offset pos;
+        };
+        // addr_index and addr_rows are immutable once
+        // have_addr_index is set.  addr_index_lock serializes
+        // building the index.
+        atomic<bool> use_addr_index, have_addr_index;
+        vector<addr_range> addr_index;
+        vector<addr_row> addr_rows;
+        mutex addr_index_lock;
+
+        impl() : cursor_kind(0), dw(nullptr), version(0), file_index_base(1),
+                 program_files_end(0),
+                 use_addr_index(false), have_addr_index(false) {};
+
+        void build_addr_index(const line_table *lt);
+        void define_file(cursor *cur);
+        const file *find_file(unsigned index);
         bool read_file_entry(cursor *cur, bool in_header);
-        void add_include_directory(const string &dir);
-        void add_file_entry(string file_name, uint64_t dir_index,
-                            uint64_t mtime, uint64_t length);
+        void add_file_entry(const char *file_name, uint64_t dir_index,
+                            uint64_t mtime, uint64_t length,
+                            bool in_header = true);
+        string join_path(const file &f) const;
         vector<entry_format> read_entry_formats(cursor *cur);
         void read_v5_directory_table(cursor *cur);
         void read_v5_file_table(cursor *cur);
         void read_file_entry_v5(cursor *cur);
-        string read_form_string(cursor *cur, DW_FORM form);
+        const char *read_form_string(cursor *cur, DW_FORM form);
         uint64_t read_form_unsigned(cursor *cur, DW_FORM form);
-        string read_string_from_section(section_type type, section_offset off);
+        const char *read_string_from_section(section_type type, section_offset off);
 };
 
 line_table::line_table(const shared_ptr<section> &sec, section_offset offset,
@@ -84,14 +137,19 @@ line_table::line_table(const shared_ptr<section> &sec, section_offset offset,
         : m(make_shared<impl>())
 {
         m->dw = dw;
+        if (dw && dw->valid()) {
+                m->paths = &dw->get_path_table();
+        } else {
+                m->own_paths.reset(new path_table());
+                m->paths = m->own_paths.get();
+        }
 
         // XXX DWARF2 and 3 give a weird specification for DW_AT_comp_dir
-        string comp_dir, abs_path;
         if (cu_comp_dir.empty() || cu_comp_dir.back() == '/')
-                comp_dir = cu_comp_dir;
+                m->comp_dir = cu_comp_dir;
         else
-                comp_dir = cu_comp_dir + '/';
-        m->comp_dir = comp_dir;
+                m->comp_dir = cu_comp_dir + '/';
+        m->cu_name = cu_name;
 
         // Read the line table header (DWARF2 section 6.2.4, DWARF3
         // section 6.2.4, DWARF4 section 6.2.3, DWARF5 section 6.2.4)
@@ -112,6 +170,7 @@ line_table::line_table(const shared_ptr<section> &sec, section_offset offset,
         } else {
                 m->sec->addr_size = cu_addr_size;
         }
+        m->cursor_kind = select_cursor_kind(*m->sec);
         m->file_index_base = (m->version >= 5) ? 0 : 1;
         section_length header_length = cur.offset();
         m->program_offset = cur.get_section_offset() + header_length;
@@ -152,44 +211,35 @@ line_table::line_table(const shared_ptr<section> &sec, section_offset offset,
 
         // Include directories list
         m->include_directories.clear();
-        if (m->version < 5)
-                m->include_directories.push_back(m->comp_dir);
         if (m->version >= 5) {
                 m->read_v5_directory_table(&cur);
         } else {
-                string incdir;
+                // Directory 0 is implicitly the compilation directory
+                m->include_directories.push_back("");
                 while (true) {
-                        cur.string(incdir);
-                        if (incdir.empty())
+                        const char *incdir = cur.cstr();
+                        if (!*incdir)
                                 break;
-                        if (incdir.back() != '/')
-                                incdir += '/';
-                        if (incdir[0] == '/')
-                                m->include_directories.push_back(move(incdir));
-                        else
-                                m->include_directories.push_back(comp_dir + incdir);
+                        m->include_directories.push_back(incdir);
                 }
         }
 
-        // File name list
-        string file_name;
+        // File name list.  If there is no entry for the compilation
+        // unit's own file (which is implicitly file 0 before DWARF
+        // 5), the name is relative to the compilation directory,
+        // which is what an out of range directory index means.
+        // cu_name can also be absolute.
         if (m->version >= 5) {
                 m->read_v5_file_table(&cur);
-                if (m->file_names.empty()) {
-                        if (!cu_name.empty() && cu_name[0] == '/')
-                                m->file_names.emplace_back(cu_name);
-                        else
-                                m->file_names.emplace_back(comp_dir + cu_name);
-                }
+                if (m->file_names.empty())
+                        m->file_names.emplace_back(
+                                m.get(), m->cu_name.c_str(),
+                                m->include_directories.size(), 0, 0);
         } else {
-                // File name 0 is implicitly the compilation unit file name.
-                // cu_name can be relative to comp_dir or absolute.
-                if (!cu_name.empty() && cu_name[0] == '/')
-                        m->file_names.emplace_back(cu_name);
-                else
-                        m->file_names.emplace_back(comp_dir + cu_name);
+                m->file_names.emplace_back(m.get(), m->cu_name.c_str(), 0, 0, 0);
                 while (m->read_file_entry(&cur, true));
         }
+        m->program_files_end = m->program_offset;
 }
 
 line_table::iterator
@@ -197,6 +247,7 @@ line_table::begin() const
 {
         if (!valid())
                 return iterator(nullptr, 0);
+        count_stat(m->sec->stats, counter::line_programs_executed);
         return iterator(this, m->program_offset);
 }
 
@@ -211,6 +262,31 @@ line_table::end() const
 line_table::iterator
 line_table::find_address(taddr addr) const
 {
+        if (valid() && m->use_addr_index.load(memory_order_relaxed)) {
+                if (!m->have_addr_index.load(memory_order_acquire)) {
+                        lock_guard<mutex> lock(m->addr_index_lock);
+                        if (!m->have_addr_index.load(memory_order_relaxed)) {
+                                phase_timer timer(m->sec->stats,
+                                                  phase::line_index);
+                                m->build_addr_index(this);
+                        }
+                }
+                count_stat(m->sec->stats, counter::line_lookup_hits);
+
+                auto &index = m->addr_index;
+                impl::addr_range key{addr, 0, 0};
+                auto it = upper_bound(index.begin(), index.end(), key);
+                if (it == index.begin())
+                        return end();
+                --it;
+                if (addr >= it->high)
+                        return end();
+                const impl::addr_row &row = m->addr_rows[it->row];
+                return iterator(this, row.entry, row.pos);
+        }
+
+        if (valid())
+                count_stat(m->sec->stats, counter::line_lookup_misses);
         iterator prev = begin(), e = end();
         if (prev == e)
                 return prev;
@@ -225,91 +301,202 @@ line_table::find_address(taddr addr) const
         return prev;
 }
 
+void
+line_table::use_address_index(bool enable) const
+{
+        if (!valid())
+                return;
+        lock_guard<mutex> lock(m->addr_index_lock);
+        m->use_addr_index.store(enable, memory_order_relaxed);
+        if (!enable) {
+                m->have_addr_index.store(false, memory_order_relaxed);
+                m->addr_index.clear();
+                m->addr_index.shrink_to_fit();
+                m->addr_rows.clear();
+                m->addr_rows.shrink_to_fit();
+        }
+}
+
+void
+line_table::impl::build_addr_index(const line_table *lt)
+{
+        // Collect the candidate rows, in program order.  A row
+        // covers [its address, the next row's address) unless it
+        // ends a sequence, exactly as in the linear find_address.
+        vector<addr_range> spans;
+        addr_rows.clear();
+        iterator prev = lt->begin(), e = lt->end();
+        if (prev != e) {
+                iterator it = prev;
+                for (++it; it != e; prev = it++) {
+                        if (prev->end_sequence ||
+                            prev->address >= it->address)
+                                continue;
+                        spans.push_back({prev->address, it->address,
+                                         (unsigned)addr_rows.size()});
+                        addr_rows.push_back({*prev, prev.pos});
+                }
+        }
+
+        // Sequences may overlap (e.g., after linker garbage
+        // collection of sections).  The linear scan returns the
+        // first matching row in program order, so resolve overlaps
+        // by sweeping over range boundaries and keeping the
+        // lowest-numbered active row.  In the common case of
+        // disjoint ranges, at most one row is ever active.
+        struct event {
+                taddr addr;
+                bool start;
+                unsigned row;
+
+                bool operator<(const event &o) const
+                {
+                        if (addr != o.addr)
+                                return addr < o.addr;
+                        // Process ends before starts
+                        return start < o.start;
+                }
+        };
+        vector<event> events;
+        events.reserve(spans.size() * 2);
+        for (auto &span : spans) {
+                events.push_back({span.low, true, span.row});
+                events.push_back({span.high, false, span.row});
+        }
+        spans.clear();
+        spans.shrink_to_fit();
+        sort(events.begin(), events.end());
+
+        addr_index.clear();
+        set<unsigned> active;
+        for (size_t i = 0; i < events.size(); ) {
+                taddr here = events[i].addr;
+                for (; i < events.size() && events[i].addr == here; ++i) {
+                        if (events[i].start)
+                                active.insert(events[i].row);
+                        else
+                                active.erase(events[i].row);
+                }
+                if (active.empty() || i == events.size())
+                        continue;
+                taddr next = events[i].addr;
+                unsigned row = *active.begin();
+                if (!addr_index.empty() && addr_index.back().high == here &&
+                    addr_index.back().row == row)
+                        addr_index.back().high = next;
+                else
+                        addr_index.push_back({here, next, row});
+        }
+        addr_index.shrink_to_fit();
+        have_addr_index.store(true, memory_order_release);
+}
+
+void
+line_table::impl::define_file(cursor *cur)
+{
+        // DWARF 5 removed DW_LNE::define_file
+        if (version >= 5)
+                return;
+
+        lock_guard<mutex> lock(program_files_lock);
+        if (cur->get_section_offset() < program_files_end)
+                return;
+        read_file_entry(cur, false);
+        program_files_end = cur->get_section_offset();
+}
+
+const line_table::file *
+line_table::impl::find_file(unsigned index)
+{
+        if (index < file_names.size())
+                return &file_names[index];
+        lock_guard<mutex> lock(program_files_lock);
+        index -= file_names.size();
+        if (index < program_files.size())
+                return &program_files[index];
+        return nullptr;
+}
+
 const line_table::file *
 line_table::get_file(unsigned index) const
 {
-        if (index >= m->file_names.size()) {
-                // It could be declared in the line table program.
-                // This is unlikely, so we don't have to be
-                // super-efficient about this.  Just force our way
-                // through the whole line table program.
-                if (!m->file_names_complete) {
-                        for (auto &ent : *this)
-                                (void)ent;
+        const file *f = m->find_file(index);
+        if (!f) {
+                size_t size;
+                {
+                        lock_guard<mutex> lock(m->program_files_lock);
+                        size = m->file_names.size() +
+                                m->program_files.size();
                 }
-                if (index >= m->file_names.size())
-                        throw out_of_range
-                                ("file name index " + std::to_string(index) +
-                                 " exceeds file table size of " +
-                                 std::to_string(m->file_names.size()));
+                throw out_of_range
+                        ("file name index " + std::to_string(index) +
+                         " exceeds file table size of " +
+                         std::to_string(size));
         }
-        return &m->file_names[index];
+        return f;
 }
 
 bool
 line_table::impl::read_file_entry(cursor *cur, bool in_header)
 {
-        assert(cur->sec == sec);
+        assert(cur->sec == sec.get());
 
         if (version >= 5) {
                 read_file_entry_v5(cur);
                 return true;
         }
 
-        string file_name;
-        cur->string(file_name);
-        if (in_header && file_name.empty())
+        const char *file_name = cur->cstr();
+        if (in_header && !*file_name)
                 return false;
         uint64_t dir_index = cur->uleb128();
         uint64_t mtime = cur->uleb128();
         uint64_t length = cur->uleb128();
 
-        // Have we already processed this file entry?
-        if (cur->get_section_offset() <= last_file_name_end)
-                return true;
-        last_file_name_end = cur->get_section_offset();
-
-        if (file_name.empty())
+        if (!*file_name)
                 return false;
 
-        add_file_entry(move(file_name), dir_index, mtime, length);
+        add_file_entry(file_name, dir_index, mtime, length, in_header);
 
         return true;
 }
 
 void
-line_table::impl::add_include_directory(const string &dir)
-{
-        string resolved = dir;
-        if (!resolved.empty() && resolved.back() != '/')
-                resolved += '/';
-        if (!resolved.empty() && resolved[0] != '/' && !comp_dir.empty())
-                resolved = comp_dir + resolved;
-        if (resolved.empty())
-                resolved = comp_dir;
-        include_directories.push_back(move(resolved));
-}
-
-void
-line_table::impl::add_file_entry(string file_name, uint64_t dir_index,
-                                 uint64_t mtime, uint64_t length)
+line_table::impl::add_file_entry(const char *file_name, uint64_t dir_index,
+                                 uint64_t mtime, uint64_t length,
+                                 bool in_header)
 {
-        if (file_name.empty())
+        if (!*file_name)
                 throw format_error("file entry missing file name");
-        if (file_name[0] == '/') {
-                file_names.emplace_back(move(file_name), mtime, length);
-                return;
-        }
-
-        const string *base = nullptr;
-        if (dir_index < include_directories.size())
-                base = &include_directories[dir_index];
-        else if (dir_index == 0 && version < 5 && !comp_dir.empty())
-                base = &comp_dir;
-        if (!base)
+        if (file_name[0] != '/' && dir_index >= include_directories.size())
                 throw format_error("file name directory index out of range: " +
                                    std::to_string(dir_index));
-        file_names.emplace_back(*base + file_name, mtime, length);
+        if (in_header)
+                file_names.emplace_back(this, file_name, dir_index, mtime,
+                                        length);
+        else
+                program_files.emplace_back(this, file_name, dir_index, mtime,
+                                           length);
+}
+
+string
+line_table::impl::join_path(const file &f) const
+{
+        if (f.name[0] == '/')
+                return f.name;
+        if (f.dir_index >= include_directories.size())
+                return comp_dir + f.name;
+
+        const char *dir = include_directories[f.dir_index];
+        if (!*dir)
+                return comp_dir + f.name;
+        string res;
+        if (dir[0] != '/')
+                res = comp_dir;
+        res += dir;
+        if (res.back() != '/')
+                res += '/';
+        return res += f.name;
 }
 
 vector<line_table::impl::entry_format>
@@ -333,7 +520,7 @@ line_table::impl::read_v5_directory_table(cursor *cur)
         auto formats = read_entry_formats(cur);
         uint64_t count = cur->uleb128();
         for (uint64_t i = 0; i < count; ++i) {
-                string path;
+                const char *path = "";
                 for (auto &fmt : formats) {
                         switch (fmt.content) {
                         case DW_LNCT::path:
@@ -344,7 +531,7 @@ line_table::impl::read_v5_directory_table(cursor *cur)
                                 break;
                         }
                 }
-                add_include_directory(path);
+                include_directories.push_back(path);
         }
 }
 
@@ -354,7 +541,7 @@ line_table::impl::read_v5_file_table(cursor *cur)
         file_entry_formats = read_entry_formats(cur);
         uint64_t count = cur->uleb128();
         for (uint64_t i = 0; i < count; ++i) {
-                string file_name;
+                const char *file_name = "";
                 uint64_t dir_index = 0;
                 uint64_t mtime = 0;
                 uint64_t length = 0;
@@ -377,8 +564,8 @@ line_table::impl::read_v5_file_table(cursor *cur)
                                 break;
                         }
                 }
-                if (!file_name.empty())
-                        add_file_entry(move(file_name), dir_index, mtime, length);
+                if (*file_name)
+                        add_file_entry(file_name, dir_index, mtime, length);
         }
 }
 
@@ -388,7 +575,7 @@ line_table::impl::read_file_entry_v5(cursor *cur)
         if (file_entry_formats.empty())
                 throw format_error("line table missing file name entry formats");
 
-        string file_name;
+        const char *file_name = "";
         uint64_t dir_index = 0;
         uint64_t mtime = 0;
         uint64_t length = 0;
@@ -412,24 +599,16 @@ line_table::impl::read_file_entry_v5(cursor *cur)
                 }
         }
 
-        section_offset entry_end = cur->get_section_offset();
-        if (entry_end <= last_file_name_end)
-                return;
-        last_file_name_end = entry_end;
-
-        if (!file_name.empty())
-                add_file_entry(move(file_name), dir_index, mtime, length);
+        if (*file_name)
+                add_file_entry(file_name, dir_index, mtime, length);
 }
 
-string
+const char *
 line_table::impl::read_form_string(cursor *cur, DW_FORM form)
 {
         switch (form) {
-        case DW_FORM::string: {
-                string res;
-                cur->string(res);
-                return res;
-        }
+        case DW_FORM::string:
+                return cur->cstr();
         case DW_FORM::line_strp:
                 return read_string_from_section(section_type::line_str,
                                                 cur->offset());
@@ -464,7 +643,7 @@ line_table::impl::read_form_unsigned(cursor *cur, DW_FORM form)
         }
 }
 
-string
+const char *
 line_table::impl::read_string_from_section(section_type type,
                                            section_offset off)
 {
@@ -487,14 +666,60 @@ line_table::impl::read_string_from_section(section_type type,
         }
 
         cursor scur(*cache, off);
-        string res;
-        scur.string(res);
-        return res;
+        return scur.cstr();
+}
+
+line_table::file::file(const line_table::impl *table, const char *name,
+                       unsigned dir_index, uint64_t mtime, uint64_t length)
+        : name(name), dir_index(dir_index), mtime(mtime), length(length),
+          table(table), joined(nullptr), joined_id(0)
+{
 }
 
-line_table::file::file(string path, uint64_t mtime, uint64_t length)
-        : path(path), mtime(mtime), length(length)
+line_table::file::file(const file &o)
+        : joined(nullptr)
 {
+        *this = o;
+}
+
+line_table::file &
+line_table::file::operator=(const file &o)
+{
+        name = o.name;
+        dir_index = o.dir_index;
+        mtime = o.mtime;
+        length = o.length;
+        table = o.table;
+        const string *p = o.joined.load(memory_order_acquire);
+        joined_id = p ? o.joined_id : 0;
+        joined.store(p, memory_order_relaxed);
+        return *this;
+}
+
+const string &
+line_table::file::path() const
+{
+        const string *p = joined.load(memory_order_acquire);
+        if (p)
+                return *p;
+
+        // Join and intern under the path table's lock, so the
+        // identifier is written once and published by joined
+        path_table &paths = *table->paths;
+        lock_guard<mutex> lock(paths.lock);
+        p = joined.load(memory_order_relaxed);
+        if (!p) {
+                p = paths.intern(table->join_path(*this), &joined_id);
+                joined.store(p, memory_order_release);
+        }
+        return *p;
+}
+
+unsigned
+line_table::file::path_id() const
+{
+        path();
+        return joined_id;
 }
 
 void
@@ -513,7 +738,7 @@ line_table::entry::reset(bool is_stmt, unsigned default_file_index)
 string
 line_table::entry::get_description() const
 {
-        string res = file->path;
+        string res = file->path();
         if (line) {
                 res.append(":").append(std::to_string(line));
                 if (column)
@@ -531,10 +756,34 @@ line_table::iterator::iterator(const line_table *table, section_offset pos)
         }
 }
 
+line_table::iterator::iterator(const line_table *table,
+                               const line_table::entry &ent,
+                               section_offset pos)
+        : table(table), entry(ent), regs(ent), pos(pos)
+{
+        // This is the register state immediately after emitting a
+        // row that does not end a sequence (see step)
+        regs.basic_block = regs.prologue_end =
+                regs.epilogue_begin = false;
+        regs.discriminator = 0;
+
+        entry.file = table->m->find_file(entry.file_index);
+}
+
 line_table::iterator &
 line_table::iterator::operator++()
 {
-        cursor cur(table->m->sec, pos);
+        static void (iterator::*const advances[])() =
+                CURSOR_KERNELS(&iterator::advance);
+        (this->*advances[table->m->cursor_kind])();
+        return *this;
+}
+
+template<typename Cursor>
+void
+line_table::iterator::advance()
+{
+        Cursor cur(table->m->sec, pos);
 
         // Execute opcodes until we reach the end of the stream or an
         // opcode emits a line table row
@@ -545,31 +794,29 @@ line_table::iterator::operator++()
         }
         if (stepped && !output)
                 throw format_error("unexpected end of line table");
-        if (stepped && cur.end()) {
-                // Record that all file names must be known now
-                table->m->file_names_complete = true;
-        }
         if (output) {
                 // Resolve file name of entry
                 if (entry.file_index < table->m->file_names.size())
                         entry.file = &table->m->file_names[entry.file_index];
-                else
+                else if (!(entry.file = table->m->find_file(entry.file_index)))
                         throw format_error("bad file index " +
                                            std::to_string(entry.file_index) +
                                            " in line table");
         }
 
+        count_decoded(table->m->sec->stats, section_type::line,
+                      cur.get_section_offset() - pos);
         pos = cur.get_section_offset();
-        return *this;
 }
 
+template<typename Cursor>
 bool
-line_table::iterator::step(cursor *cur)
+line_table::iterator::step(Cursor *cur)
 {
         struct line_table::impl *m = table->m.get();
 
         // Read the opcode (DWARF4 section 6.2.3)
-        ubyte opcode = cur->fixed<ubyte>();
+        ubyte opcode = cur->template fixed<ubyte>();
         if (opcode >= m->opcode_base) {
                 // Special opcode (DWARF4 section 6.2.5.1)
                 ubyte adjusted_opcode = opcode - m->opcode_base;
@@ -638,7 +885,7 @@ line_table::iterator::step(cursor *cur)
                         uarg = (255 - m->opcode_base) / m->line_range;
                         goto advance_pc;
                 case DW_LNS::fixed_advance_pc:
-                        regs.address += cur->fixed<uhalf>();
+                        regs.address += cur->template fixed<uhalf>();
                         regs.op_index = 0;
                         break;
                 case DW_LNS::set_prologue_end:
@@ -661,7 +908,7 @@ line_table::iterator::step(cursor *cur)
                 assert(opcode == 0);
                 uint64_t length = cur->uleb128();
                 section_offset end = cur->get_section_offset() + length;
-                opcode = cur->fixed<ubyte>();
+                opcode = cur->template fixed<ubyte>();
                 switch ((DW_LNE)opcode) {
                 case DW_LNE::end_sequence:
                         regs.end_sequence = true;
@@ -673,7 +920,7 @@ line_table::iterator::step(cursor *cur)
                         regs.op_index = 0;
                         break;
                 case DW_LNE::define_file:
-                        m->read_file_entry(cur, false);
+                        m->define_file(cur);
                         break;
                 case DW_LNE::set_discriminator:
                         // XXX Only DWARF4
@@ -693,7 +940,7 @@ line_table::iterator::step(cursor *cur)
 #pragma GCC diagnostic pop
                 if (cur->get_section_offset() > end)
                         throw format_error("extended line number opcode exceeded its size");
-                cur += end - cur->get_section_offset();
+                *cur += end - cur->get_section_offset();
                 return ((DW_LNE)opcode == DW_LNE::end_sequence);
         }
 }
@@ -0,0 +1,340 @@
+// Copyright (c) 2013 Austin T. Clements. All rights reserved.
+// Use of this source code is governed by an MIT license
+// that can be found in the LICENSE file.
+
+#include "internal.hh"
+
+#include <algorithm>
+
+using namespace std;
+
+DWARFPP_BEGIN_NAMESPACE
+
+struct loclist::impl
+{
+        // The location list section, with the unit's address size
+        shared_ptr<section> sec;
+        vector<entry> entries;
+        unique_ptr<expr> default_location;
+        // True if entries are sorted by low and don't overlap
+        bool sorted = true;
+
+        /**
+         * Read a location expression of len bytes at cur.
+         */
+        expr read_expr(const unit *cu, cursor &cur, section_length len)
+        {
+                section_offset off = cur.get_section_offset();
+                if (len)
+                        cur.ensure(len);
+                cur += len;
+                return expr(cu, sec.get(), off, len);
+        }
+
+        void add(taddr low, taddr high, const expr &loc)
+        {
+                if (low >= high)
+                        return;
+                if (!entries.empty() && low < entries.back().high)
+                        sorted = false;
+                entries.push_back(entry{low, high, loc});
+        }
+
+        void read_dwarf5(const unit *cu, cursor &cur);
+        void read_dwarf4(const unit *cu, cursor &cur);
+        void read_dwarf4_split(const unit *cu, cursor &cur);
+};
+
+loclist::loclist(const unit *cu, section_offset off)
+{
+        shared_ptr<impl> mi = make_shared<impl>();
+        auto cusec = cu->data();
+
+        bool is_dwarf5 = cu->get_version() >= 5;
+        const auto &sec = cu->get_dwarf().get_section(
+                is_dwarf5 ? section_type::loclists : section_type::loc);
+        mi->sec = sec->slice(0, ~0, cusec->fmt, cusec->addr_size);
+        if (off >= mi->sec->size())
+                throw format_error("location list offset " + to_hex(off) +
+                                   " out of range");
+
+        cursor cur(mi->sec, off);
+        if (is_dwarf5)
+                mi->read_dwarf5(cu, cur);
+        else if (cu->is_split())
+                mi->read_dwarf4_split(cu, cur);
+        else
+                mi->read_dwarf4(cu, cur);
+        count_decoded(mi->sec->stats, mi->sec->type,
+                      cur.get_section_offset() - off);
+        m = mi;
+}
+
+loclist::loclist(const expr &loc)
+{
+        shared_ptr<impl> mi = make_shared<impl>();
+        mi->default_location.reset(new expr(loc));
+        m = mi;
+}
+
+void
+loclist::impl::read_dwarf5(const unit *cu, cursor &cur)
+{
+        // DWARF5 section 2.6.2.  As for range lists, offsets are
+        // relative to the unit's base address until a base address
+        // entry changes it.
+        taddr base = cu->get_base_address();
+        taddr low, high;
+        while (true) {
+                if (cur.end())
+                        throw format_error("unterminated location list");
+
+                DW_LLE lle = (DW_LLE)cur.fixed<ubyte>();
+                switch (lle) {
+                case DW_LLE::end_of_list:
+                        return;
+
+                case DW_LLE::base_addressx:
+                        base = cu->get_addrx(cur.uleb128());
+                        continue;
+
+                case DW_LLE::base_address:
+                        base = cur.address();
+                        continue;
+
+                case DW_LLE::GNU_view_pair:
+                        // View numbers don't affect the ranges
+                        cur.uleb128();
+                        cur.uleb128();
+                        continue;
+
+                case DW_LLE::startx_endx:
+                        low = cu->get_addrx(cur.uleb128());
+                        high = cu->get_addrx(cur.uleb128());
+                        break;
+
+                case DW_LLE::startx_length:
+                        low = cu->get_addrx(cur.uleb128());
+                        high = low + cur.uleb128();
+                        break;
+
+                case DW_LLE::offset_pair:
+                        low = base + cur.uleb128();
+                        high = base + cur.uleb128();
+                        break;
+
+                case DW_LLE::start_end:
+                        low = cur.address();
+                        high = cur.address();
+                        break;
+
+                case DW_LLE::start_length:
+                        low = cur.address();
+                        high = low + cur.uleb128();
+                        break;
+
+                case DW_LLE::default_location:
+                        default_location.reset(
+                                new expr(read_expr(cu, cur, cur.uleb128())));
+                        continue;
+
+                default:
+                        throw format_error("unknown DW_LLE encoding " + to_string(lle));
+                }
+
+                // A counted location description follows every
+                // bounded entry
+                add(low, high, read_expr(cu, cur, cur.uleb128()));
+        }
+}
+
+void
+loclist::impl::read_dwarf4(const unit *cu, cursor &cur)
+{
+        // DWARF4 section 2.6.2
+        taddr base = cu->get_base_address();
+        taddr largest_offset = ~(taddr)0;
+        if (sec->addr_size < sizeof(taddr))
+                largest_offset = ((taddr)1 << (8 * sec->addr_size)) - 1;
+
+        while (true) {
+                taddr low = cur.address();
+                taddr high = cur.address();
+
+                if (low == 0 && high == 0) {
+                        // End of list
+                        return;
+                } else if (low == largest_offset) {
+                        // Base address selection
+                        base = high;
+                } else {
+                        expr loc = read_expr(cu, cur, cur.fixed<uhalf>());
+                        add(base + low, base + high, loc);
+                }
+        }
+}
+
+void
+loclist::impl::read_dwarf4_split(const unit *cu, cursor &cur)
+{
+        // The GNU split DWARF extension to DWARF 4 uses the DWARF 5
+        // entry kinds, but with fixed size lengths and offsets
+        taddr base = cu->get_base_address();
+        taddr low, high;
+        while (true) {
+                if (cur.end())
+                        throw format_error("unterminated location list");
+
+                DW_LLE lle = (DW_LLE)cur.fixed<ubyte>();
+                switch (lle) {
+                case DW_LLE::end_of_list:
+                        return;
+
+                case DW_LLE::base_addressx:
+                        base = cu->get_addrx(cur.uleb128());
+                        continue;
+
+                case DW_LLE::startx_endx:
+                        low = cu->get_addrx(cur.uleb128());
+                        high = cu->get_addrx(cur.uleb128());
+                        break;
+
+                case DW_LLE::startx_length:
+                        low = cu->get_addrx(cur.uleb128());
+                        high = low + cur.fixed<uword>();
+                        break;
+
+                case DW_LLE::offset_pair:
+                        low = base + cur.fixed<uword>();
+                        high = base + cur.fixed<uword>();
+                        break;
+
+                default:
+                        throw format_error("unknown split location list entry " +
+                                           to_string(lle));
+                }
+
+                add(low, high, read_expr(cu, cur, cur.fixed<uhalf>()));
+        }
+}
+
+// The entries of every empty loclist
+static const vector<loclist::entry> no_entries;
+
+loclist::iterator
+loclist::begin() const
+{
+        return m ? m->entries.begin() : no_entries.begin();
+}
+
+loclist::iterator
+loclist::end() const
+{
+        return m ? m->entries.end() : no_entries.end();
+}
+
+size_t
+loclist::size() const
+{
+        return m ? m->entries.size() : 0;
+}
+
+const expr *
+loclist::get_default() const
+{
+        return m ? m->default_location.get() : nullptr;
+}
+
+const expr *
+loclist::find(taddr pc) const
+{
+        if (!m)
+                return nullptr;
+
+        auto &ents = m->entries;
+        if (m->sorted) {
+                auto it = upper_bound(ents.begin(), ents.end(), pc,
+                                      [](taddr pc, const entry &e) {
+                                              return pc < e.high;
+                                      });
+                if (it != ents.end() && it->low <= pc)
+                        return &it->location;
+        } else {
+                for (auto &e : ents)
+                        if (e.contains(pc))
+                                return &e.location;
+        }
+        return m->default_location.get();
+}
+
+//////////////////////////////////////////////////////////////////
+// scope_locations
+//
+
+/**
+ * A walk of a scope's DIE tree that collects its variables.
+ */
+struct scope_locations_builder
+{
+        vector<scope_locations::variable> *vars;
+        vector<compact_rangelist> *blocks;
+        // The index in blocks of each variable's block, or -1
+        vector<ptrdiff_t> var_blocks;
+
+        void walk(const die &d, ptrdiff_t block)
+        {
+                for (auto &child : d) {
+                        switch (child.tag) {
+                        case DW_TAG::variable:
+                        case DW_TAG::formal_parameter:
+                                if (child.has(DW_AT::location)) {
+                                        vars->push_back(scope_locations::variable{
+                                                child, child[DW_AT::location].as_loclist(),
+                                                nullptr});
+                                        var_blocks.push_back(block);
+                                }
+                                break;
+
+                        case DW_TAG::lexical_block:
+                                if (child.has(DW_AT::ranges) || child.has(DW_AT::low_pc)) {
+                                        blocks->push_back(die_compact_pc_range(child));
+                                        walk(child, blocks->size() - 1);
+                                } else {
+                                        // A block without ranges
+                                        // covers its parent
+                                        walk(child, block);
+                                }
+                                break;
+
+                        default:
+                                // Nested subprograms and inlined
+                                // subroutines are separate scopes
+                                break;
+                        }
+                }
+        }
+};
+
+scope_locations::scope_locations(const die &scope)
+{
+        scope_locations_builder b{&vars, &blocks};
+        b.walk(scope, -1);
+        for (size_t i = 0; i < vars.size(); i++)
+                if (b.var_blocks[i] >= 0)
+                        vars[i].block = &blocks[b.var_blocks[i]];
+}
+
+size_t
+scope_locations::find(taddr pc, vector<location> *out) const
+{
+        out->clear();
+        for (auto &v : vars) {
+                if (v.block && !v.block->contains(pc))
+                        continue;
+                if (const expr *loc = v.locations.find(pc))
+                        out->push_back(location{&v, loc});
+        }
+        return out->size();
+}
+
+DWARFPP_END_NAMESPACE
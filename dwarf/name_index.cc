@@ -0,0 +1,677 @@
+// Copyright (c) 2013 Austin T. Clements. All rights reserved.
+// Use of this source code is governed by an MIT license
+// that can be found in the LICENSE file.
+
+#include "internal.hh"
+
+#include <algorithm>
+#include <cstring>
+#include <unordered_map>
+
+using namespace std;
+
+DWARFPP_BEGIN_NAMESPACE
+
+/**
+ * The DJB hash of a name.  This is the hash function used by
+ * .debug_names (DWARF5 section 6.1.1.4.5).
+ */
+static uint32_t
+hash_name(const char *s)
+{
+        uint32_t h = 5381;
+        for (; *s; ++s)
+                h = h * 33 + (unsigned char)*s;
+        return h;
+}
+
+/**
+ * The sections names can be read from, in the order of the low bits
+ * of name_index::name::source.
+ */
+static const section_type name_sections[3] = {
+        section_type::str, section_type::line_str, section_type::info,
+};
+
+/**
+ * A name and the DIE it names, before grouping by name.  source and
+ * offset locate str as in name_index::name.
+ */
+struct raw_entry
+{
+        const char *str;
+        uint32_t hash;
+        uint32_t source;
+        uint64_t offset;
+        name_index::entry ent;
+};
+
+/**
+ * The sections that hold the names of one unit's DIEs.
+ */
+struct unit_names
+{
+        uint32_t source;
+        shared_ptr<section> secs[3];
+
+        /**
+         * Use the sections of cu's DIEs, where cu is or is the
+         * split unit of cus[unit].
+         */
+        unit_names(const vector<compilation_unit> &cus, uint32_t unit,
+                   const compilation_unit &cu)
+                : source(&cu == &cus[unit] ? 0 : (unit + 1) << 2)
+        {
+                const dwarf &dw = cu.get_dwarf();
+                for (int i = 0; i < 3; i++) {
+                        try {
+                                secs[i] = dw.get_section(name_sections[i]);
+                        } catch (format_error &e) {
+                        }
+                }
+        }
+
+        /**
+         * Set *source_out and *offset to the location of str, which
+         * was read from one of these sections.
+         */
+        void locate(const char *str, uint32_t *source_out,
+                    uint64_t *offset) const
+        {
+                for (uint32_t i = 0; i < 3; i++) {
+                        if (secs[i] && str >= secs[i]->begin &&
+                            str < secs[i]->end) {
+                                *source_out = source | i;
+                                *offset = str - secs[i]->begin;
+                                return;
+                        }
+                }
+                throw format_error("name is not in a string or info section");
+        }
+};
+
+static const compilation_unit *
+cu_at_offset(const vector<compilation_unit> &cus, section_offset offset)
+{
+        auto it = lower_bound(cus.begin(), cus.end(), offset,
+                              [](const compilation_unit &cu, section_offset off) {
+                                      return cu.get_section_offset() < off;
+                              });
+        if (it == cus.end() || it->get_section_offset() != offset)
+                return nullptr;
+        return &*it;
+}
+
+static void
+add_name(vector<raw_entry> *out, const char *str, uint32_t source,
+         uint64_t str_offset, uint32_t unit, section_offset off, DW_TAG tag)
+{
+        if (!*str)
+                return;
+        out->push_back(raw_entry{str, hash_name(str), source, str_offset,
+                                 {unit, tag, off}});
+}
+
+static void
+add_name(vector<raw_entry> *out, const char *str, const unit_names &names,
+         uint32_t unit, section_offset off, DW_TAG tag)
+{
+        if (!*str)
+                return;
+        uint32_t source;
+        uint64_t str_offset;
+        names.locate(str, &source, &str_offset);
+        add_name(out, str, source, str_offset, unit, off, tag);
+}
+
+/**
+ * Return true if DIEs with the given tag are functions, variables, or
+ * types that should be indexed.
+ */
+static bool
+indexed_tag(DW_TAG tag)
+{
+        switch (tag) {
+        case DW_TAG::structure_type:
+        case DW_TAG::class_type:
+        case DW_TAG::union_type:
+        case DW_TAG::interface_type:
+        case DW_TAG::subprogram:
+        case DW_TAG::variable:
+        case DW_TAG::constant:
+        case DW_TAG::base_type:
+        case DW_TAG::typedef_:
+        case DW_TAG::enumeration_type:
+        case DW_TAG::unspecified_type:
+                return true;
+        default:
+                return false;
+        }
+}
+
+/**
+ * Add the name and linkage name of d to out, if d is a definition of
+ * an indexed tag.  names are the sections of d's unit.
+ */
+static void
+index_die(uint32_t unit, const unit_names &names, const die &d,
+          vector<raw_entry> *out)
+{
+        if (!indexed_tag(d.tag))
+                return;
+        if (d.has(DW_AT::declaration) && d[DW_AT::declaration].as_flag())
+                return;
+
+        // Out-of-line definitions and concrete instances get their
+        // names from the DIE they complete
+        value name = d.resolve(DW_AT::name);
+        const char *name_str = nullptr;
+        if (name.valid()) {
+                name_str = name.as_cstr();
+                add_name(out, name_str, names, unit, d.get_unit_offset(),
+                         d.tag);
+        }
+        value linkage = d.resolve(DW_AT::linkage_name);
+        if (linkage.valid()) {
+                const char *linkage_str = linkage.as_cstr();
+                if (!name_str || strcmp(name_str, linkage_str) != 0)
+                        add_name(out, linkage_str, names, unit,
+                                 d.get_unit_offset(), d.tag);
+        }
+}
+
+//////////////////////////////////////////////////////////////////
+// .debug_names
+//
+
+/**
+ * An abbrev in a .debug_names name index.
+ */
+struct name_abbrev
+{
+        DW_TAG tag;
+        vector<pair<DW_IDX, DW_FORM> > attrs;
+};
+
+/**
+ * Read a constant or reference attribute value in a .debug_names
+ * entry.  Values of other forms are skipped and read as 0.
+ */
+static uint64_t
+read_idx_value(cursor *cur, DW_FORM form)
+{
+        switch (form) {
+        case DW_FORM::flag_present:
+                return 1;
+        case DW_FORM::flag:
+        case DW_FORM::data1:
+        case DW_FORM::ref1:
+                return cur->fixed<ubyte>();
+        case DW_FORM::data2:
+        case DW_FORM::ref2:
+                return cur->fixed<uhalf>();
+        case DW_FORM::data4:
+        case DW_FORM::ref4:
+                return cur->fixed<uword>();
+        case DW_FORM::data8:
+        case DW_FORM::ref8:
+        case DW_FORM::ref_sig8:
+                return cur->fixed<uint64_t>();
+        case DW_FORM::udata:
+        case DW_FORM::ref_udata:
+                return cur->uleb128();
+        case DW_FORM::sdata:
+                return cur->sleb128();
+        default:
+                cur->skip_form(form);
+                return 0;
+        }
+}
+
+/**
+ * Add the names in the .debug_names section sec to out.  Sets
+ * covered[i] for each compilation unit i that sec indexes.
+ */
+static void
+read_debug_names(const dwarf &dw, const shared_ptr<section> &sec,
+                 const vector<compilation_unit> &cus,
+                 vector<raw_entry> *out, vector<bool> *covered)
+{
+        const shared_ptr<section> &str = dw.get_section(section_type::str);
+
+        // DWARF5 section 6.1.1.4.1
+        cursor cur(sec);
+        while (!cur.end()) {
+                shared_ptr<section> subsec = cur.subsection();
+                cursor sub(subsec);
+                sub.skip_initial_length();
+                uhalf version = sub.fixed<uhalf>();
+                if (version != 5)
+                        throw format_error("unknown name index version " +
+                                           std::to_string(version));
+                sub.fixed<uhalf>();     // Padding
+                uword cu_count = sub.fixed<uword>();
+                uword local_tu_count = sub.fixed<uword>();
+                uword foreign_tu_count = sub.fixed<uword>();
+                uword bucket_count = sub.fixed<uword>();
+                uword name_count = sub.fixed<uword>();
+                uword abbrev_table_size = sub.fixed<uword>();
+                uword augmentation_size = sub.fixed<uword>();
+                sub += augmentation_size;
+                section_offset offset_size =
+                        subsec->fmt == format::dwarf64 ? 8 : 4;
+
+                // Compilation unit list
+                vector<const compilation_unit *> units(cu_count);
+                for (auto &unit : units) {
+                        unit = cu_at_offset(cus, sub.offset());
+                        if (unit)
+                                (*covered)[unit - cus.data()] = true;
+                }
+
+                // Skip the type unit lists and the hash table.  We
+                // build our own hash table over all name indexes.
+                sub += local_tu_count * offset_size;
+                sub += foreign_tu_count * 8;
+                sub += bucket_count * 4;
+                if (bucket_count)
+                        sub += name_count * 4;
+
+                cursor str_offsets = sub;
+                sub += name_count * offset_size;
+                cursor entry_offsets = sub;
+                sub += name_count * offset_size;
+
+                // Abbreviation table (DWARF5 section 6.1.1.4.7)
+                section_offset pool = sub.get_section_offset() +
+                        abbrev_table_size;
+                unordered_map<uint64_t, name_abbrev> abbrevs;
+                while (true) {
+                        uint64_t code = sub.uleb128();
+                        if (code == 0)
+                                break;
+                        name_abbrev &abbrev = abbrevs[code];
+                        abbrev.tag = (DW_TAG)sub.uleb128();
+                        while (true) {
+                                DW_IDX idx = (DW_IDX)sub.uleb128();
+                                DW_FORM form = (DW_FORM)sub.uleb128();
+                                if (idx == (DW_IDX)0 && form == (DW_FORM)0)
+                                        break;
+                                abbrev.attrs.push_back(make_pair(idx, form));
+                        }
+                }
+
+                // Name table and entry pool (DWARF5 sections
+                // 6.1.1.4.6 and 6.1.1.4.8)
+                for (uword i = 0; i < name_count; i++) {
+                        section_offset str_off = str_offsets.offset();
+                        section_offset entry_off = entry_offsets.offset();
+                        if (str_off >= str->size())
+                                throw format_error("name index string offset out of range");
+                        const char *name = str->begin + str_off;
+
+                        cursor ent(subsec, pool + entry_off);
+                        while (true) {
+                                uint64_t code = ent.uleb128();
+                                if (code == 0)
+                                        break;
+                                auto it = abbrevs.find(code);
+                                if (it == abbrevs.end())
+                                        throw format_error("unknown name index abbrev code 0x" +
+                                                           to_hex(code));
+                                // If there is only one compilation
+                                // unit, entries may omit it
+                                uint64_t unit = cu_count == 1 ? 0 : ~0ull;
+                                uint64_t die_offset = 0;
+                                bool have_die = false, type_unit = false;
+                                for (auto &attr : it->second.attrs) {
+                                        uint64_t val = read_idx_value(&ent, attr.second);
+                                        switch (attr.first) {
+                                        case DW_IDX::compile_unit:
+                                                unit = val;
+                                                break;
+                                        case DW_IDX::type_unit:
+                                                type_unit = true;
+                                                break;
+                                        case DW_IDX::die_offset:
+                                                die_offset = val;
+                                                have_die = true;
+                                                break;
+                                        default:
+                                                break;
+                                        }
+                                }
+                                // XXX Type units are not indexed
+                                if (type_unit || !have_die || unit >= cu_count ||
+                                    !units[unit])
+                                        continue;
+                                add_name(out, name, 0, str_off,
+                                         units[unit] - cus.data(),
+                                         die_offset, it->second.tag);
+                        }
+                }
+        }
+}
+
+//////////////////////////////////////////////////////////////////
+// .debug_pubnames and .debug_pubtypes
+//
+
+/**
+ * Add the names of the DIEs listed in the .debug_pubnames or
+ * .debug_pubtypes section sec to out.  Sets covered[i] for each
+ * compilation unit i that sec describes.
+ *
+ * Pubnames record qualified names and include declarations, while
+ * .debug_names and the DIE walk use DW_AT::name and
+ * DW_AT::linkage_name.  For a consistent index, this only uses
+ * pubnames to find DIEs, and takes the names from the DIEs.  Units
+ * described here are not walked, so only their global names are
+ * indexed (see name_index).
+ */
+static void
+read_pubnames(const dwarf &dw, const shared_ptr<section> &sec,
+              const vector<compilation_unit> &cus,
+              vector<raw_entry> *out, vector<bool> *covered)
+{
+        // DWARF4 section 6.1.1
+        cursor cur(sec);
+        while (!cur.end()) {
+                name_unit unit;
+                unit.read(&cur);
+                const compilation_unit *cu =
+                        cu_at_offset(cus, unit.debug_info_offset);
+                unique_ptr<unit_names> names;
+                if (cu) {
+                        (*covered)[cu - cus.data()] = true;
+                        uint32_t cu_index = cu - cus.data();
+                        names.reset(new unit_names(
+                                cus, cu_index,
+                                name_index::entry{cu_index}.get_unit(dw)));
+                }
+                while (true) {
+                        section_offset off = unit.entries.offset();
+                        if (off == 0)
+                                break;
+                        unit.entries.cstr();
+                        if (!cu)
+                                continue;
+                        uint32_t cu_index = cu - cus.data();
+                        die d = name_index::entry{cu_index, (DW_TAG)0, off}.get_die(dw);
+                        if (!d.valid())
+                                throw format_error("pubnames entry refers to a null DIE");
+                        index_die(cu_index, *names, d, out);
+                }
+        }
+}
+
+//////////////////////////////////////////////////////////////////
+// DIE tree walk
+//
+
+/**
+ * Add the names of the functions, variables, and types among the
+ * descendants of scope to out.  This searches through namespaces and
+ * aggregate types, but not into function bodies.
+ */
+static void
+walk_scope(uint32_t unit, const unit_names &names, const die &scope,
+           vector<raw_entry> *out)
+{
+        for (auto &d : scope) {
+                index_die(unit, names, d, out);
+                switch (d.tag) {
+                case DW_TAG::namespace_:
+                case DW_TAG::structure_type:
+                case DW_TAG::class_type:
+                case DW_TAG::union_type:
+                case DW_TAG::interface_type:
+                        walk_scope(unit, names, d, out);
+                        break;
+                default:
+                        break;
+                }
+        }
+}
+
+//////////////////////////////////////////////////////////////////
+// class name_index
+//
+
+const compilation_unit &
+name_index::entry::get_unit(const dwarf &dw) const
+{
+        const vector<compilation_unit> &cus = dw.compilation_units();
+        if (unit >= cus.size())
+                throw format_error("name index unit " + std::to_string(unit) +
+                                   " out of range");
+        // The DIEs of a skeleton unit are in its split unit
+        if (const compilation_unit *split = cus[unit].get_split_unit())
+                return *split;
+        return cus[unit];
+}
+
+die
+name_index::entry::get_die(const dwarf &dw) const
+{
+        die d(&get_unit(dw));
+        d.read(unit_offset);
+        return d;
+}
+
+name_index::name_index()
+        : entries(nullptr), names(nullptr), slots(nullptr),
+          num_entries(0), num_names(0), num_slots(0), units(nullptr)
+{
+}
+
+name_index::name_index(const dwarf &dw, unsigned nthreads)
+        : name_index()
+{
+        const vector<compilation_unit> &cus = dw.compilation_units();
+        if (cus.size() >= (1u << 30))
+                throw format_error("too many units to index");
+        vector<raw_entry> raw;
+        vector<bool> covered(cus.size());
+
+        // Prefer .debug_names
+        shared_ptr<section> names_sec;
+        try {
+                names_sec = dw.get_section(section_type::names);
+        } catch (format_error &e) {
+        }
+        if (names_sec)
+                read_debug_names(dw, names_sec, cus, &raw, &covered);
+
+        // Next, use .debug_pubnames and .debug_pubtypes for units
+        // both describe
+        shared_ptr<section> pubnames_sec, pubtypes_sec;
+        try {
+                pubnames_sec = dw.get_section(section_type::pubnames);
+                pubtypes_sec = dw.get_section(section_type::pubtypes);
+        } catch (format_error &e) {
+        }
+        if (pubnames_sec && pubtypes_sec) {
+                vector<raw_entry> pub;
+                vector<bool> in_names(cus.size()), in_types(cus.size());
+                read_pubnames(dw, pubnames_sec, cus, &pub, &in_names);
+                read_pubnames(dw, pubtypes_sec, cus, &pub, &in_types);
+                for (auto &ent : pub) {
+                        size_t i = ent.ent.unit;
+                        if (!covered[i] && in_names[i] && in_types[i])
+                                raw.push_back(ent);
+                }
+                for (size_t i = 0; i < cus.size(); i++)
+                        if (in_names[i] && in_types[i])
+                                covered[i] = true;
+        }
+
+        // Walk the DIE trees of everything else.  Units are
+        // independent, so this can walk them in parallel.
+        vector<size_t> uncovered;
+        for (size_t i = 0; i < cus.size(); i++)
+                if (!covered[i])
+                        uncovered.push_back(i);
+        vector<vector<raw_entry> > walked(uncovered.size());
+        parallel_for(uncovered.size(), nthreads, [&](size_t i) {
+                const compilation_unit *cu = &cus[uncovered[i]];
+                if (const compilation_unit *split = cu->get_split_unit())
+                        cu = split;
+                walk_scope(uncovered[i], unit_names(cus, uncovered[i], *cu),
+                           cu->root(), &walked[i]);
+        });
+        for (auto &w : walked) {
+                raw.insert(raw.end(), w.begin(), w.end());
+                vector<raw_entry>().swap(w);
+        }
+
+        // Group entries by name and drop duplicates
+        sort(raw.begin(), raw.end(),
+             [](const raw_entry &a, const raw_entry &b) {
+                     if (a.hash != b.hash)
+                             return a.hash < b.hash;
+                     int cmp = strcmp(a.str, b.str);
+                     if (cmp != 0)
+                             return cmp < 0;
+                     if (a.ent.unit != b.ent.unit)
+                             return a.ent.unit < b.ent.unit;
+                     return a.ent.unit_offset < b.ent.unit_offset;
+             });
+        entry_vec.reserve(raw.size());
+        for (size_t i = 0; i < raw.size(); i++) {
+                const raw_entry &r = raw[i];
+                bool new_name = i == 0 || r.hash != raw[i-1].hash ||
+                        strcmp(r.str, raw[i-1].str) != 0;
+                if (new_name) {
+                        if (entry_vec.size() >= ~(uint32_t)0)
+                                throw format_error("too many names to index");
+                        name_vec.push_back(name{r.offset, r.hash,
+                                                (uint32_t)entry_vec.size(), 0,
+                                                r.source});
+                } else if (r.ent.unit == raw[i-1].ent.unit &&
+                           r.ent.unit_offset == raw[i-1].ent.unit_offset) {
+                        continue;
+                }
+                entry_vec.push_back(r.ent);
+                name_vec.back().count++;
+        }
+        raw.clear();
+        raw.shrink_to_fit();
+        entry_vec.shrink_to_fit();
+        name_vec.shrink_to_fit();
+
+        // Build the hash table
+        size_t nslots = 16;
+        while (nslots < name_vec.size() * 2)
+                nslots *= 2;
+        slot_vec.assign(nslots, ~(uint32_t)0);
+        size_t mask = nslots - 1;
+        for (uint32_t i = 0; i < name_vec.size(); i++) {
+                size_t h = name_vec[i].hash & mask;
+                while (slot_vec[h] != ~(uint32_t)0)
+                        h = (h + 1) & mask;
+                slot_vec[h] = i;
+        }
+        use_vectors();
+        use_sections(dw);
+}
+
+name_index::name_index(const dwarf &dw, const shared_ptr<const index_file> &file)
+        : name_index()
+{
+        if (!file->get(index_section::name_entries, &entries, &num_entries) ||
+            !file->get(index_section::names, &names, &num_names) ||
+            !file->get(index_section::name_slots, &slots, &num_slots))
+                throw format_error("index file has no name index");
+        // Lookups check the indexes they follow, but rely on this
+        if (num_slots < 1 || (num_slots & (num_slots - 1)) != 0)
+                throw format_error("index file name table size is not a power of two");
+        this->file = file;
+        use_sections(dw);
+}
+
+void
+name_index::use_vectors()
+{
+        entries = entry_vec.data();
+        num_entries = entry_vec.size();
+        names = name_vec.data();
+        num_names = name_vec.size();
+        slots = slot_vec.data();
+        num_slots = slot_vec.size();
+}
+
+void
+name_index::use_sections(const dwarf &dw)
+{
+        for (int i = 0; i < 3; i++) {
+                try {
+                        sections[i] = dw.get_section(name_sections[i]);
+                } catch (format_error &e) {
+                }
+        }
+        units = &dw.compilation_units();
+}
+
+const char *
+name_index::get_name(const name &n) const
+{
+        // The names may come from an index file, so check where
+        // they point
+        uint32_t kind = n.source & 3, unit = n.source >> 2;
+        if (kind >= 3)
+                throw format_error("name index string section out of range");
+        shared_ptr<section> sec;
+        if (unit == 0) {
+                sec = sections[kind];
+        } else {
+                if (unit > units->size())
+                        throw format_error("name index unit " +
+                                           std::to_string(unit - 1) +
+                                           " out of range");
+                const compilation_unit *split =
+                        (*units)[unit - 1].get_split_unit();
+                if (!split)
+                        throw format_error("name index refers to a missing split unit");
+                sec = split->get_dwarf().get_section(name_sections[kind]);
+        }
+        if (!sec || n.str >= sec->size())
+                throw format_error("name index string offset out of range");
+        cursor cur(sec, n.str);
+        return cur.cstr();
+}
+
+void
+name_index::save(index_writer *w) const
+{
+        w->add(index_section::name_entries, entries, num_entries);
+        w->add(index_section::names, names, num_names);
+        w->add(index_section::name_slots, slots, num_slots);
+}
+
+name_index::range
+name_index::lookup(const char *str) const
+{
+        if (num_slots == 0)
+                return range();
+        uint32_t hash = hash_name(str);
+        size_t mask = num_slots - 1;
+        // The tables may come from an index file, so check every
+        // index before following it.  This bounds the probe in case
+        // the table has no empty slots.
+        size_t h = hash & mask;
+        for (size_t probes = 0; probes < num_slots && slots[h] != ~(uint32_t)0;
+             probes++, h = (h + 1) & mask) {
+                if (slots[h] >= num_names)
+                        throw format_error("name index slot out of range");
+                const name &n = names[slots[h]];
+                if (n.hash != hash || strcmp(get_name(n), str) != 0)
+                        continue;
+                if (n.first > num_entries || n.count > num_entries - n.first)
+                        throw format_error("name index entries out of range");
+                return range(entries + n.first, entries + n.first + n.count);
+        }
+        return range();
+}
+
+DWARFPP_END_NAMESPACE
@@ -4,20 +4,23 @@
 
 #include "internal.hh"
 
+#include <algorithm>
+
 using namespace std;
 
 DWARFPP_BEGIN_NAMESPACE
 
 rangelist::rangelist(const std::shared_ptr<section> &sec, section_offset off,
-                     unsigned cu_addr_size, taddr cu_low_pc, bool is_dwarf5)
+                     unsigned cu_addr_size, taddr cu_low_pc, bool is_dwarf5,
+                     const unit *cu)
         : sec(sec->slice(off, ~0, format::unknown, cu_addr_size)),
           base_addr(cu_low_pc),
-          is_dwarf5(is_dwarf5)
+          is_dwarf5(is_dwarf5), cu(cu)
 {
 }
 
 rangelist::rangelist(const initializer_list<pair<taddr, taddr> > &ranges)
-        : is_dwarf5(false)
+        : is_dwarf5(false), cu(nullptr)
 {
         synthetic.reserve(ranges.size() * 2 + 2);
         for (auto &range : ranges) {
@@ -39,7 +42,7 @@ rangelist::iterator
 rangelist::begin() const
 {
         if (sec)
-                return iterator(sec, base_addr, is_dwarf5);
+                return iterator(sec, base_addr, is_dwarf5, cu);
         return end();
 }
 
@@ -58,17 +61,47 @@ rangelist::contains(taddr addr) const
         return false;
 }
 
-rangelist::iterator::iterator(const std::shared_ptr<section> &sec, taddr base_addr, bool is_dwarf5)
-        : sec(sec), base_addr(base_addr), pos(0), is_dwarf5(is_dwarf5)
+rangelist::iterator::iterator(const std::shared_ptr<section> &sec, taddr base_addr, bool is_dwarf5,
+                              const unit *cu)
+        : sec(sec), base_addr(base_addr), pos(0), is_dwarf5(is_dwarf5), cu(cu)
 {
         // Read in the first entry
         ++(*this);
 }
 
+taddr
+rangelist::iterator::get_addrx(uint64_t index) const
+{
+        if (!cu)
+                throw format_error("range list address index without a unit");
+        return cu->get_addrx(index);
+}
+
+/**
+ * Counts the bytes a cursor advances over as decoded when it goes
+ * out of scope.  This keeps the cursor's section live, since the
+ * iterator drops its reference at the end of the list.
+ */
+struct decode_counter
+{
+        std::shared_ptr<section> sec;
+        const cursor *cur;
+        section_offset start;
+
+        ~decode_counter()
+        {
+                if (sec)
+                        count_decoded(sec->stats, sec->type,
+                                      cur->get_section_offset() - start);
+        }
+};
+
 rangelist::iterator &
 rangelist::iterator::operator++()
 {
         cursor cur(sec, pos);
+        decode_counter counted{stats_on(sec->stats) ? sec : nullptr,
+                               &cur, pos};
 
         if (is_dwarf5) {
                 // DWARF 5 range list entries (Section 2.17.3)
@@ -88,23 +121,20 @@ rangelist::iterator::operator++()
                                 return *this;
 
                         case DW_RLE::base_addressx:
-                                // Index into .debug_addr - for now, skip this
-                                cur.uleb128();
+                                base_addr = get_addrx(cur.uleb128());
                                 break;
 
                         case DW_RLE::startx_endx:
-                                // Both start and end are indices into .debug_addr
-                                cur.uleb128();
-                                cur.uleb128();
-                                // Skip for now - would need .debug_addr lookup
-                                break;
+                                entry.low = get_addrx(cur.uleb128());
+                                entry.high = get_addrx(cur.uleb128());
+                                pos = cur.get_section_offset();
+                                return *this;
 
                         case DW_RLE::startx_length:
-                                // Start is index, length is ULEB128
-                                cur.uleb128();
-                                cur.uleb128();
-                                // Skip for now - would need .debug_addr lookup
-                                break;
+                                entry.low = get_addrx(cur.uleb128());
+                                entry.high = entry.low + cur.uleb128();
+                                pos = cur.get_section_offset();
+                                return *this;
 
                         case DW_RLE::offset_pair:
                                 // Two ULEB128 offsets from base address
@@ -171,4 +201,160 @@ rangelist::iterator::operator++()
         return *this;
 }
 
+//////////////////////////////////////////////////////////////////
+// compact_rangelist
+//
+
+compact_rangelist::compact_rangelist(const rangelist &rl)
+{
+        vector<rangelist::entry> ents;
+        for (auto &ent : rl)
+                ents.push_back(ent);
+        init(move(ents));
+}
+
+compact_rangelist::compact_rangelist(const initializer_list<pair<taddr, taddr> > &ranges)
+{
+        vector<rangelist::entry> ents;
+        ents.reserve(ranges.size());
+        for (auto &range : ranges)
+                ents.push_back({range.first, range.second});
+        init(move(ents));
+}
+
+compact_rangelist::compact_rangelist(vector<rangelist::entry> ranges)
+{
+        init(move(ranges));
+}
+
+void
+compact_rangelist::init(vector<rangelist::entry> &&ents)
+{
+        ents.erase(remove_if(ents.begin(), ents.end(),
+                             [](const rangelist::entry &e) {
+                                     return e.low >= e.high;
+                             }), ents.end());
+        if (ents.empty())
+                return;
+
+        sort(ents.begin(), ents.end(),
+             [](const rangelist::entry &a, const rangelist::entry &b) {
+                     return a.low < b.low;
+             });
+
+        // Merge overlapping and abutting ranges in place
+        size_t out = 0;
+        for (size_t i = 1; i < ents.size(); i++) {
+                if (ents[i].low <= ents[out].high) {
+                        if (ents[i].high > ents[out].high)
+                                ents[out].high = ents[i].high;
+                } else {
+                        ents[++out] = ents[i];
+                }
+        }
+        ents.resize(out + 1);
+        ents.shrink_to_fit();
+        ranges = make_shared<const vector<rangelist::entry> >(move(ents));
+}
+
+// The entries of every empty compact_rangelist
+static const vector<rangelist::entry> no_ranges;
+
+compact_rangelist::iterator
+compact_rangelist::begin() const
+{
+        return ranges ? ranges->begin() : no_ranges.begin();
+}
+
+compact_rangelist::iterator
+compact_rangelist::end() const
+{
+        return ranges ? ranges->end() : no_ranges.end();
+}
+
+/**
+ * Return the first range in [first, last) whose high is greater than
+ * addr.  Since ranges are sorted and disjoint, this is the only range
+ * that can contain addr.
+ */
+static compact_rangelist::iterator
+first_above(compact_rangelist::iterator first,
+            compact_rangelist::iterator last, taddr addr)
+{
+        return upper_bound(first, last, addr,
+                           [](taddr addr, const rangelist::entry &e) {
+                                   return addr < e.high;
+                           });
+}
+
+bool
+compact_rangelist::contains(taddr addr) const
+{
+        auto it = first_above(begin(), end(), addr);
+        return it != end() && it->low <= addr;
+}
+
+bool
+compact_rangelist::overlaps(taddr low, taddr high) const
+{
+        if (low >= high)
+                return false;
+        auto it = first_above(begin(), end(), low);
+        return it != end() && it->low < high;
+}
+
+bool
+compact_rangelist::overlaps(const compact_rangelist &o) const
+{
+        const compact_rangelist &small = size() <= o.size() ? *this : o;
+        const compact_rangelist &large = size() <= o.size() ? o : *this;
+        // Each search starts where the previous one ended
+        auto it = large.begin(), end = large.end();
+        for (auto &r : small) {
+                it = first_above(it, end, r.low);
+                if (it == end)
+                        return false;
+                if (it->low < r.high)
+                        return true;
+        }
+        return false;
+}
+
+compact_rangelist
+compact_rangelist::intersect(const compact_rangelist &o) const
+{
+        vector<rangelist::entry> res;
+        auto a = begin(), aend = end();
+        auto b = o.begin(), bend = o.end();
+        while (a != aend && b != bend) {
+                taddr low = std::max(a->low, b->low);
+                taddr high = std::min(a->high, b->high);
+                if (low < high)
+                        res.push_back({low, high});
+                if (a->high < b->high)
+                        ++a;
+                else
+                        ++b;
+        }
+        // The pieces are already sorted and disjoint, so init's sort
+        // and merge leave them as they are
+        return compact_rangelist(move(res));
+}
+
+size_t
+compact_rangelist::contains(const taddr *addrs, size_t n, bool *out) const
+{
+        size_t count = 0;
+        auto it = begin(), e = end();
+        for (size_t i = 0; i < n; i++) {
+                while (it != e && it->high <= addrs[i])
+                        ++it;
+                bool in = it != e && it->low <= addrs[i];
+                if (out)
+                        out[i] = in;
+                count += in;
+        }
+        return count;
+}
+
 DWARFPP_END_NAMESPACE
@@ -0,0 +1,186 @@
+// Copyright (c) 2013 Austin T. Clements. All rights reserved.
+// Use of this source code is governed by an MIT license
+// that can be found in the LICENSE file.
+
+#include "internal.hh"
+
+#include <algorithm>
+
+using namespace std;
+
+DWARFPP_BEGIN_NAMESPACE
+
+/**
+ * A DIE tree walk that collects scopes and their address ranges.
+ */
+struct scope_builder
+{
+        const compilation_unit *cu;
+        const line_table &lt;
+        vector<scope_index::entry> *scopes;
+        vector<compact_rangelist> *scope_ranges;
+        // Address ranges as (low, high, scope) before nesting
+        vector<pair<pair<taddr, taddr>, uint32_t> > ranges;
+
+        scope_builder(const compilation_unit *cu,
+                      vector<scope_index::entry> *scopes,
+                      vector<compact_rangelist> *scope_ranges)
+                : cu(cu), lt(cu->get_line_table()), scopes(scopes),
+                  scope_ranges(scope_ranges) { }
+
+        void walk(const die &d);
+        void add(const die &d, const scope_index::entry &ent);
+};
+
+static const char *
+resolve_cstr(const die &d, DW_AT attr)
+{
+        value v = d.resolve(attr);
+        if (v.get_type() != value::type::string)
+                return nullptr;
+        return v.as_cstr();
+}
+
+void
+scope_builder::walk(const die &d)
+{
+        switch (d.tag) {
+        case DW_TAG::subprogram:
+        case DW_TAG::inlined_subroutine:
+        case DW_TAG::lexical_block: {
+                if (!d.has(DW_AT::ranges) && !d.has(DW_AT::low_pc))
+                        break;
+
+                scope_index::entry ent{};
+                ent.tag = d.tag;
+                ent.unit_offset = d.get_unit_offset();
+                if (d.tag != DW_TAG::lexical_block) {
+                        ent.name = resolve_cstr(d, DW_AT::name);
+                        ent.linkage_name = resolve_cstr(d, DW_AT::linkage_name);
+                }
+                if (d.tag == DW_TAG::inlined_subroutine) {
+                        if (d.has(DW_AT::call_file) && lt.valid()) {
+                                try {
+                                        ent.call_file = lt.get_file(
+                                                d[DW_AT::call_file].as_uconstant());
+                                } catch (out_of_range &e) {
+                                }
+                        }
+                        if (d.has(DW_AT::call_line))
+                                ent.call_line = d[DW_AT::call_line].as_uconstant();
+                        if (d.has(DW_AT::call_column))
+                                ent.call_column = d[DW_AT::call_column].as_uconstant();
+                }
+                add(d, ent);
+                break;
+        }
+        default:
+                break;
+        }
+
+        for (auto &child : d)
+                walk(child);
+}
+
+void
+scope_builder::add(const die &d, const scope_index::entry &ent)
+{
+        compact_rangelist rl;
+        try {
+                rl = die_compact_pc_range(d);
+        } catch (out_of_range &e) {
+        } catch (value_type_mismatch &e) {
+        }
+        if (rl.empty())
+                return;
+
+        uint32_t scope = scopes->size();
+        for (auto &r : rl)
+                ranges.push_back({{r.low, r.high}, scope});
+        scopes->push_back(ent);
+        scope_ranges->push_back(move(rl));
+}
+
+scope_index::scope_index(const compilation_unit *cu)
+        : cu(cu)
+{
+        scope_builder b(cu, &scopes, &scope_ranges);
+        b.walk(cu->root());
+        for (size_t i = 0; i < scopes.size(); i++) {
+                scopes[i].cu = cu;
+                scopes[i].ranges = &scope_ranges[i];
+        }
+
+        // Sort by low, putting enclosing ranges before the ranges
+        // they enclose.  Scopes with identical ranges are ordered by
+        // DIE order, which puts parents first.
+        auto &ranges = b.ranges;
+        sort(ranges.begin(), ranges.end(),
+             [](const pair<pair<taddr, taddr>, uint32_t> &a,
+                const pair<pair<taddr, taddr>, uint32_t> &b) {
+                     if (a.first.first != b.first.first)
+                             return a.first.first < b.first.first;
+                     if (a.first.second != b.first.second)
+                             return a.first.second > b.first.second;
+                     return a.second < b.second;
+             });
+
+        // Link each range to the range enclosing it.  stack holds the
+        // chain of ranges enclosing the current range.
+        intervals.reserve(ranges.size());
+        vector<index> stack;
+        for (auto &r : ranges) {
+                interval iv{r.first.first, r.first.second, npos, r.second};
+                while (!stack.empty() && intervals[stack.back()].high <= iv.low)
+                        stack.pop_back();
+                if (!stack.empty()) {
+                        iv.parent = stack.back();
+                        if (iv.high > intervals[iv.parent].high)
+                                iv.high = intervals[iv.parent].high;
+                }
+                stack.push_back(intervals.size());
+                intervals.push_back(iv);
+        }
+}
+
+bool
+scope_index::find(taddr pc, vector<entry> *out) const
+{
+        out->clear();
+
+        // Find the last range starting at or before pc.  Any range
+        // containing pc either is this range or encloses it.
+        auto it = upper_bound(intervals.begin(), intervals.end(), pc,
+                              [](taddr pc, const interval &iv) {
+                                      return pc < iv.low;
+                              });
+        if (it == intervals.begin())
+                return false;
+        index i = (it - intervals.begin()) - 1;
+        while (i != npos && intervals[i].high <= pc)
+                i = intervals[i].parent;
+
+        for (; i != npos; i = intervals[i].parent) {
+                const interval &iv = intervals[i];
+                out->push_back(scopes[iv.scope]);
+                out->back().low = iv.low;
+                out->back().high = iv.high;
+        }
+        return !out->empty();
+}
+
+die
+scope_index::to_die(const compilation_unit *cu, section_offset unit_offset)
+{
+        die d(cu);
+        d.read(unit_offset);
+        return d;
+}
+
+die
+scope_index::entry::get_die() const
+{
+        return scope_index::to_die(cu, unit_offset);
+}
+
+DWARFPP_END_NAMESPACE
@@ -96,8 +96,8 @@ public:
                 char *newbuf = new char[sizeof(T[target])];
                 T *src = base, *dest = (T*)newbuf;
                 for (; src < end; src++, dest++) {
-                        new(dest) T(*src);
-                        dest->~T();
+                        new(dest) T(std::move(*src));
+                        src->~T();
                 }
                 if ((char*)base != buf)
                         delete[] (char*)base;
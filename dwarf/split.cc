@@ -0,0 +1,193 @@
+// Copyright (c) 2013 Austin T. Clements. All rights reserved.
+// Use of this source code is governed by an MIT license
+// that can be found in the LICENSE file.
+
+#include "internal.hh"
+
+using namespace std;
+
+DWARFPP_BEGIN_NAMESPACE
+
+// The sections that DW_SECT identifiers 1 through 8 in a unit index
+// name.  Identifiers that neither version uses, and .debug_macro,
+// which libelfin doesn't read, map to num_section_types.
+static const unsigned no_sect = num_section_types;
+
+static const unsigned dwarf5_sects[] = {
+        (unsigned)section_type::info,
+        no_sect,
+        (unsigned)section_type::abbrev,
+        (unsigned)section_type::line,
+        (unsigned)section_type::loclists,
+        (unsigned)section_type::str_offsets,
+        no_sect,                // DW_SECT_MACRO
+        (unsigned)section_type::rnglists,
+};
+
+static const unsigned gnu_sects[] = {
+        (unsigned)section_type::info,
+        (unsigned)section_type::types,
+        (unsigned)section_type::abbrev,
+        (unsigned)section_type::line,
+        (unsigned)section_type::loc,
+        (unsigned)section_type::str_offsets,
+        (unsigned)section_type::macinfo,
+        no_sect,                // DW_SECT_MACRO
+};
+
+/**
+ * A loader that serves one unit's contributions to the sections of
+ * a DWARF package.  Sections the unit index doesn't describe, like
+ * .debug_str.dwo, are served whole.
+ */
+class package_unit_loader : public loader
+{
+        // Keeps the package's sections live
+        shared_ptr<loader> package;
+        const void *data[num_section_types];
+        size_t sizes[num_section_types];
+
+public:
+        package_unit_loader(const shared_ptr<loader> &package,
+                            const void * const *data_in,
+                            const size_t *sizes_in)
+                : package(package)
+        {
+                for (unsigned i = 0; i < num_section_types; i++) {
+                        data[i] = data_in[i];
+                        sizes[i] = sizes_in[i];
+                }
+        }
+
+        const void *load(section_type section, size_t *size_out)
+        {
+                unsigned i = (unsigned)section;
+                if (i >= num_section_types || !data[i])
+                        return nullptr;
+                *size_out = sizes[i];
+                return data[i];
+        }
+};
+
+package_index::package_index(const shared_ptr<loader> &l)
+        : l(l), data(), sizes()
+{
+        for (unsigned i = 0; i < num_section_types; i++) {
+                section_type type = (section_type)i;
+                // The type unit index isn't read, and the package
+                // has no sections of these types
+                if (type == section_type::tu_index ||
+                    type == section_type::eh_frame ||
+                    type == section_type::eh_frame_hdr)
+                        continue;
+                data[i] = l->load(type, &sizes[i]);
+        }
+
+        unsigned ci = (unsigned)section_type::cu_index;
+        if (!data[ci] || sizes[ci] < 4)
+                throw format_error("DWARF package has no .debug_cu_index");
+
+        // The DWARF 5 index starts with a 2 byte version and 2 bytes
+        // of padding, and the GNU index with a 4 byte version 2.
+        // Either way, the first byte is non-zero in little-endian
+        // files.
+        byte_order ord = *(const char*)data[ci] ? byte_order::lsb :
+                byte_order::msb;
+        index = make_shared<section>(section_type::cu_index, data[ci],
+                                     sizes[ci], ord, format::dwarf32);
+        cursor cur(index);
+        version = cur.fixed<uhalf>();
+        if (version == 5) {
+                cur.fixed<uhalf>();
+        } else {
+                cur = cursor(index);
+                version = cur.fixed<uword>();
+                if (version != 2)
+                        throw format_error("unknown DWARF package index version " +
+                                           std::to_string(version));
+        }
+        num_columns = cur.fixed<uword>();
+        num_units = cur.fixed<uword>();
+        num_slots = cur.fixed<uword>();
+        if (num_slots & (num_slots - 1))
+                throw format_error("DWARF package index size " +
+                                   std::to_string(num_slots) +
+                                   " is not a power of two");
+
+        // Check that the tables fit, so lookups don't have to
+        uint64_t table_size = (uint64_t)num_slots * 12 +
+                (uint64_t)(2 * num_units + 1) * num_columns * 4;
+        if (table_size > index->size() - cur.get_section_offset())
+                throw format_error("DWARF package index is truncated");
+
+        const unsigned *sects = version == 5 ? dwarf5_sects : gnu_sects;
+        cur += num_slots * 12;
+        for (uint32_t i = 0; i < num_columns; i++) {
+                uword id = cur.fixed<uword>();
+                if (id >= 1 && id <= 8)
+                        columns.push_back(sects[id - 1]);
+                else
+                        columns.push_back(no_sect);
+        }
+}
+
+shared_ptr<loader>
+package_index::get_unit_loader(uint64_t dwo_id) const
+{
+        if (num_slots == 0)
+                return nullptr;
+
+        // DWARF5 section 7.3.5.3
+        section_offset signatures = 16;
+        section_offset rows = signatures + num_slots * 8;
+        uint32_t mask = num_slots - 1;
+        uint32_t h = dwo_id & mask;
+        uint32_t step = ((dwo_id >> 32) & mask) | 1;
+        uint32_t row = 0;
+        for (uint32_t probe = 0; probe < num_slots; probe++) {
+                uint32_t slot = (h + probe * step) & mask;
+                cursor rcur(index, rows + slot * 4);
+                uint32_t r = rcur.fixed<uword>();
+                if (r == 0)
+                        return nullptr;
+                cursor scur(index, signatures + slot * 8);
+                if (scur.fixed<uint64_t>() == dwo_id) {
+                        row = r;
+                        break;
+                }
+        }
+        if (row == 0)
+                return nullptr;
+        if (row > num_units)
+                throw format_error("DWARF package index row " +
+                                   std::to_string(row) + " out of range");
+
+        // Replace each section the unit contributes to with its
+        // contribution
+        const void *udata[num_section_types];
+        size_t usizes[num_section_types];
+        for (unsigned i = 0; i < num_section_types; i++) {
+                udata[i] = data[i];
+                usizes[i] = sizes[i];
+        }
+        section_offset offsets = rows + num_slots * 4 + num_columns * 4;
+        section_offset lengths = offsets + num_units * num_columns * 4;
+        cursor ocur(index, offsets + (row - 1) * num_columns * 4);
+        cursor lcur(index, lengths + (row - 1) * num_columns * 4);
+        for (uint32_t col = 0; col < num_columns; col++) {
+                uword off = ocur.fixed<uword>(), len = lcur.fixed<uword>();
+                unsigned sec = columns[col];
+                if (sec == no_sect)
+                        continue;
+                if (!data[sec] || off > sizes[sec] || len > sizes[sec] - off)
+                        throw format_error(
+                                std::string("DWARF package contribution to ") +
+                                elf::section_type_to_name((section_type)sec) +
+                                " out of range");
+                udata[sec] = (const char*)data[sec] + off;
+                usizes[sec] = len;
+        }
+        return make_shared<package_unit_loader>(l, udata, usizes);
+}
+
+DWARFPP_END_NAMESPACE
@@ -0,0 +1,214 @@
+// Copyright (c) 2013 Austin T. Clements. All rights reserved.
+// Use of this source code is governed by an MIT license
+// that can be found in the LICENSE file.
+
+#include "internal.hh"
+
+#include <algorithm>
+
+using namespace std;
+
+DWARFPP_BEGIN_NAMESPACE
+
+/**
+ * Set the line table rows of the n sorted PCs in pcs from lt, making
+ * a single pass over the line program.  As in
+ * line_table::find_address, each PC gets the first row in program
+ * order that covers it.
+ */
+static void
+sweep_lines(const line_table &lt, const taddr *pcs, pc_info *out, size_t n)
+{
+        size_t remaining = n;
+        line_table::iterator prev = lt.begin(), e = lt.end();
+        if (prev == e)
+                return;
+
+        line_table::iterator it = prev;
+        for (++it; it != e && remaining; prev = it++) {
+                if (prev->end_sequence || prev->address >= it->address)
+                        continue;
+                const taddr *p = lower_bound(pcs, pcs + n, prev->address);
+                for (; p < pcs + n && *p < it->address; ++p) {
+                        pc_info &info = out[p - pcs];
+                        if (info.has_line)
+                                continue;
+                        info.has_line = true;
+                        info.line = *prev;
+                        --remaining;
+                }
+        }
+}
+
+/**
+ * A post-order walk of a unit's DIE tree that sets the frames of a
+ * sorted set of PCs.
+ *
+ * A search for a single PC that scans a DIE's children before the
+ * DIE itself and stops at the first match ends at the first DIE
+ * covering the PC in post-order.  Hence, walking the tree once in
+ * post-order and giving each PC the chain of the first DIE that
+ * covers it yields the same frames as searching for every PC
+ * separately.
+ */
+struct die_sweep
+{
+        const taddr *pcs;
+        pc_info *out;
+        size_t n, remaining;
+        // The subprogram and inlined subroutine DIEs enclosing the
+        // current DIE, outermost first
+        vector<die> stack;
+        // The frames of the PCs claimed by the current DIE, shared
+        // between all of them
+        shared_ptr<const vector<die> > chain;
+
+        die_sweep(const taddr *pcs, pc_info *out, size_t n)
+                : pcs(pcs), out(out), n(n), remaining(n) { }
+
+        void walk(const die &d)
+        {
+                bool frame = (d.tag == DW_TAG::subprogram ||
+                              d.tag == DW_TAG::inlined_subroutine);
+                if (frame)
+                        stack.push_back(d);
+                for (auto &child : d) {
+                        if (!remaining)
+                                break;
+                        walk(child);
+                }
+                if (frame) {
+                        if (remaining)
+                                claim(d);
+                        stack.pop_back();
+                }
+        }
+
+        /**
+         * Give the PCs covered by d that don't have frames yet the
+         * current stack, which ends with d.
+         */
+        void claim(const die &d)
+        {
+                chain.reset();
+                // This is die_pc_range, but avoids building a range
+                // list for the common case of low_pc/high_pc.
+                try {
+                        if (d.has(DW_AT::ranges)) {
+                                for (auto &ent : at_ranges(d))
+                                        claim_range(ent.low, ent.high);
+                        } else if (d.has(DW_AT::low_pc)) {
+                                taddr low = at_low_pc(d);
+                                taddr high = d.has(DW_AT::high_pc) ?
+                                        at_high_pc(d) : low + 1;
+                                claim_range(low, high);
+                        }
+                } catch (out_of_range &e) {
+                } catch (value_type_mismatch &e) {
+                }
+        }
+
+        void claim_range(taddr low, taddr high)
+        {
+                const taddr *p = lower_bound(pcs, pcs + n, low);
+                for (; p < pcs + n && *p < high; ++p) {
+                        pc_info &info = out[p - pcs];
+                        if (info.chain)
+                                continue;
+                        if (!chain)
+                                chain = make_shared<vector<die> >(
+                                        stack.rbegin(), stack.rend());
+                        info.chain = chain;
+                        --remaining;
+                }
+        }
+};
+
+const vector<die> &
+pc_info::frames() const
+{
+        static const vector<die> empty;
+        if (!chain)
+                return empty;
+        return *chain;
+}
+
+vector<pc_info>
+dwarf::symbolize(const taddr *pcs, size_t n, unsigned nthreads) const
+{
+        if (nthreads == 0)
+                nthreads = std::max(1u, std::thread::hardware_concurrency());
+
+        vector<taddr> sorted(pcs, pcs + n);
+        std::sort(sorted.begin(), sorted.end());
+        sorted.erase(std::unique(sorted.begin(), sorted.end()), sorted.end());
+
+        // Group the PCs by unit.  A unit's address ranges may be
+        // interleaved with those of other units, so its PCs aren't
+        // necessarily contiguous in sorted.  Counting sort them by
+        // unit, which keeps each unit's PCs sorted.  PCs that no unit
+        // covers go in an extra group at the end.
+        const auto &cus = compilation_units();
+        size_t ngroups = cus.size() + 1;
+        vector<size_t> group(sorted.size());
+        vector<size_t> starts(ngroups + 1);
+        for (size_t i = 0; i < sorted.size(); i++) {
+                const compilation_unit *cu = find_cu(sorted[i]);
+                group[i] = cu ? cu - cus.data() : cus.size();
+                starts[group[i] + 1]++;
+        }
+        for (size_t g = 0; g < ngroups; g++)
+                starts[g + 1] += starts[g];
+
+        // pos[i] is the index of sorted[i] in grouped and infos
+        vector<taddr> grouped(sorted.size());
+        vector<size_t> pos(sorted.size());
+        {
+                vector<size_t> next(starts.begin(), starts.end() - 1);
+                for (size_t i = 0; i < sorted.size(); i++) {
+                        pos[i] = next[group[i]]++;
+                        grouped[pos[i]] = sorted[i];
+                }
+        }
+        vector<size_t>().swap(group);
+
+        vector<pc_info> infos(grouped.size());
+        for (size_t i = 0; i < grouped.size(); i++)
+                infos[i].pc = grouped[i];
+
+        vector<size_t> work;
+        for (size_t g = 0; g < cus.size(); g++)
+                if (starts[g] != starts[g + 1])
+                        work.push_back(g);
+
+        parallel_for(work.size(), nthreads, [&](size_t w) {
+                size_t g = work[w];
+                const compilation_unit &cu = cus[g];
+                size_t begin = starts[g], count = starts[g + 1] - begin;
+                const taddr *upcs = &grouped[begin];
+                pc_info *uinfos = &infos[begin];
+
+                for (size_t i = 0; i < count; i++)
+                        uinfos[i].cu = &cu;
+                sweep_lines(cu.get_line_table(), upcs, uinfos, count);
+                const compilation_unit *split = cu.get_split_unit();
+                die_sweep(upcs, uinfos, count).walk(
+                        split ? split->root() : cu.root());
+        });
+
+        vector<pc_info> res(n);
+        for (size_t i = 0; i < n; i++) {
+                size_t s = lower_bound(sorted.begin(), sorted.end(), pcs[i]) -
+                        sorted.begin();
+                res[i] = infos[pos[s]];
+        }
+        return res;
+}
+
+vector<pc_info>
+dwarf::symbolize(const vector<taddr> &pcs, unsigned nthreads) const
+{
+        return symbolize(pcs.data(), pcs.size(), nthreads);
+}
+
+DWARFPP_END_NAMESPACE
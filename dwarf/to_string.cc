@@ -1,4 +1,4 @@
-// Automatically generated by make at Sat Nov 29 03:46:33 PM EST 2025
+// Automatically generated by make at Wed Oct 14 07:07:50 UTC 2026
 // DO NOT EDIT
 
 #include "internal.hh"
@@ -12,22 +12,48 @@ to_string(section_type v)
         case section_type::abbrev: return "section_type::abbrev";
         case section_type::addr: return "section_type::addr";
         case section_type::aranges: return "section_type::aranges";
+        case section_type::cu_index: return "section_type::cu_index";
+        case section_type::eh_frame: return "section_type::eh_frame";
+        case section_type::eh_frame_hdr: return "section_type::eh_frame_hdr";
         case section_type::frame: return "section_type::frame";
         case section_type::info: return "section_type::info";
         case section_type::line: return "section_type::line";
         case section_type::line_str: return "section_type::line_str";
         case section_type::loc: return "section_type::loc";
+        case section_type::loclists: return "section_type::loclists";
         case section_type::macinfo: return "section_type::macinfo";
+        case section_type::names: return "section_type::names";
         case section_type::pubnames: return "section_type::pubnames";
         case section_type::pubtypes: return "section_type::pubtypes";
         case section_type::ranges: return "section_type::ranges";
+        case section_type::rnglists: return "section_type::rnglists";
         case section_type::str: return "section_type::str";
         case section_type::str_offsets: return "section_type::str_offsets";
+        case section_type::tu_index: return "section_type::tu_index";
         case section_type::types: return "section_type::types";
         }
         return "(section_type)" + std::to_string((int)v);
 }
 
+std::string
+to_string(phase v)
+{
+        switch (v) {
+        case phase::load_section: return "phase::load_section";
+        case phase::abbrev_table: return "phase::abbrev_table";
+        case phase::line_table: return "phase::line_table";
+        case phase::line_index: return "phase::line_index";
+        case phase::die_table: return "phase::die_table";
+        case phase::scope_index: return "phase::scope_index";
+        case phase::name_index: return "phase::name_index";
+        case phase::cu_index: return "phase::cu_index";
+        case phase::type_index: return "phase::type_index";
+        case phase::cfi: return "phase::cfi";
+        case phase::split_unit: return "phase::split_unit";
+        }
+        return "(phase)" + std::to_string((int)v);
+}
+
 std::string
 to_string(value::type v)
 {
@@ -127,6 +153,7 @@ to_string(DW_TAG v)
         case DW_TAG::type_unit: return "DW_TAG_type_unit";
         case DW_TAG::rvalue_reference_type: return "DW_TAG_rvalue_reference_type";
         case DW_TAG::template_alias: return "DW_TAG_template_alias";
+        case DW_TAG::skeleton_unit: return "DW_TAG_skeleton_unit";
         case DW_TAG::lo_user: break;
         case DW_TAG::hi_user: break;
         }
@@ -239,7 +266,42 @@ to_string(DW_AT v)
         case DW_AT::const_expr: return "DW_AT_const_expr";
         case DW_AT::enum_class: return "DW_AT_enum_class";
         case DW_AT::linkage_name: return "DW_AT_linkage_name";
+        case DW_AT::string_length_bit_size: return "DW_AT_string_length_bit_size";
+        case DW_AT::string_length_byte_size: return "DW_AT_string_length_byte_size";
+        case DW_AT::rank: return "DW_AT_rank";
+        case DW_AT::str_offsets_base: return "DW_AT_str_offsets_base";
+        case DW_AT::addr_base: return "DW_AT_addr_base";
+        case DW_AT::rnglists_base: return "DW_AT_rnglists_base";
+        case DW_AT::dwo_name: return "DW_AT_dwo_name";
+        case DW_AT::reference: return "DW_AT_reference";
+        case DW_AT::rvalue_reference: return "DW_AT_rvalue_reference";
+        case DW_AT::macros: return "DW_AT_macros";
+        case DW_AT::call_all_calls: return "DW_AT_call_all_calls";
+        case DW_AT::call_all_source_calls: return "DW_AT_call_all_source_calls";
+        case DW_AT::call_all_tail_calls: return "DW_AT_call_all_tail_calls";
+        case DW_AT::call_return_pc: return "DW_AT_call_return_pc";
+        case DW_AT::call_value: return "DW_AT_call_value";
+        case DW_AT::call_origin: return "DW_AT_call_origin";
+        case DW_AT::call_parameter: return "DW_AT_call_parameter";
+        case DW_AT::call_pc: return "DW_AT_call_pc";
+        case DW_AT::call_tail_call: return "DW_AT_call_tail_call";
+        case DW_AT::call_target: return "DW_AT_call_target";
+        case DW_AT::call_target_clobbered: return "DW_AT_call_target_clobbered";
+        case DW_AT::call_data_location: return "DW_AT_call_data_location";
+        case DW_AT::call_data_value: return "DW_AT_call_data_value";
+        case DW_AT::noreturn: return "DW_AT_noreturn";
+        case DW_AT::alignment: return "DW_AT_alignment";
+        case DW_AT::export_symbols: return "DW_AT_export_symbols";
+        case DW_AT::deleted: return "DW_AT_deleted";
+        case DW_AT::defaulted: return "DW_AT_defaulted";
+        case DW_AT::loclists_base: return "DW_AT_loclists_base";
         case DW_AT::lo_user: break;
+        case DW_AT::GNU_dwo_name: return "DW_AT_GNU_dwo_name";
+        case DW_AT::GNU_dwo_id: return "DW_AT_GNU_dwo_id";
+        case DW_AT::GNU_ranges_base: return "DW_AT_GNU_ranges_base";
+        case DW_AT::GNU_addr_base: return "DW_AT_GNU_addr_base";
+        case DW_AT::GNU_pubnames: return "DW_AT_GNU_pubnames";
+        case DW_AT::GNU_pubtypes: return "DW_AT_GNU_pubtypes";
         case DW_AT::hi_user: break;
         }
         return "(DW_AT)0x" + to_hex((int)v);
@@ -273,9 +335,27 @@ to_string(DW_FORM v)
         case DW_FORM::sec_offset: return "DW_FORM_sec_offset";
         case DW_FORM::exprloc: return "DW_FORM_exprloc";
         case DW_FORM::flag_present: return "DW_FORM_flag_present";
+        case DW_FORM::strx: return "DW_FORM_strx";
+        case DW_FORM::addrx: return "DW_FORM_addrx";
+        case DW_FORM::ref_sup4: return "DW_FORM_ref_sup4";
+        case DW_FORM::strp_sup: return "DW_FORM_strp_sup";
+        case DW_FORM::data16: return "DW_FORM_data16";
         case DW_FORM::line_strp: return "DW_FORM_line_strp";
-        case DW_FORM::implicit_const: return "DW_FORM_implicit_const";
         case DW_FORM::ref_sig8: return "DW_FORM_ref_sig8";
+        case DW_FORM::implicit_const: return "DW_FORM_implicit_const";
+        case DW_FORM::loclistx: return "DW_FORM_loclistx";
+        case DW_FORM::rnglistx: return "DW_FORM_rnglistx";
+        case DW_FORM::ref_sup8: return "DW_FORM_ref_sup8";
+        case DW_FORM::strx1: return "DW_FORM_strx1";
+        case DW_FORM::strx2: return "DW_FORM_strx2";
+        case DW_FORM::strx3: return "DW_FORM_strx3";
+        case DW_FORM::strx4: return "DW_FORM_strx4";
+        case DW_FORM::addrx1: return "DW_FORM_addrx1";
+        case DW_FORM::addrx2: return "DW_FORM_addrx2";
+        case DW_FORM::addrx3: return "DW_FORM_addrx3";
+        case DW_FORM::addrx4: return "DW_FORM_addrx4";
+        case DW_FORM::GNU_addr_index: return "DW_FORM_GNU_addr_index";
+        case DW_FORM::GNU_str_index: return "DW_FORM_GNU_str_index";
         }
         return "(DW_FORM)0x" + to_hex((int)v);
 }
@@ -348,7 +428,19 @@ to_string(DW_OP v)
         case DW_OP::bit_piece: return "DW_OP_bit_piece";
         case DW_OP::implicit_value: return "DW_OP_implicit_value";
         case DW_OP::stack_value: return "DW_OP_stack_value";
+        case DW_OP::implicit_pointer: return "DW_OP_implicit_pointer";
+        case DW_OP::addrx: return "DW_OP_addrx";
+        case DW_OP::constx: return "DW_OP_constx";
+        case DW_OP::entry_value: return "DW_OP_entry_value";
+        case DW_OP::const_type: return "DW_OP_const_type";
+        case DW_OP::regval_type: return "DW_OP_regval_type";
+        case DW_OP::deref_type: return "DW_OP_deref_type";
+        case DW_OP::xderef_type: return "DW_OP_xderef_type";
+        case DW_OP::convert: return "DW_OP_convert";
+        case DW_OP::reinterpret: return "DW_OP_reinterpret";
         case DW_OP::lo_user: break;
+        case DW_OP::GNU_addr_index: return "DW_OP_GNU_addr_index";
+        case DW_OP::GNU_const_index: return "DW_OP_GNU_const_index";
         case DW_OP::hi_user: break;
         }
         return "(DW_OP)0x" + to_hex((int)v);
@@ -575,6 +667,45 @@ to_string(DW_LNCT v)
         return "(DW_LNCT)0x" + to_hex((int)v);
 }
 
+std::string
+to_string(DW_CFA v)
+{
+        switch (v) {
+        case DW_CFA::advance_loc: return "DW_CFA_advance_loc";
+        case DW_CFA::offset: return "DW_CFA_offset";
+        case DW_CFA::restore: return "DW_CFA_restore";
+        case DW_CFA::nop: return "DW_CFA_nop";
+        case DW_CFA::set_loc: return "DW_CFA_set_loc";
+        case DW_CFA::advance_loc1: return "DW_CFA_advance_loc1";
+        case DW_CFA::advance_loc2: return "DW_CFA_advance_loc2";
+        case DW_CFA::advance_loc4: return "DW_CFA_advance_loc4";
+        case DW_CFA::offset_extended: return "DW_CFA_offset_extended";
+        case DW_CFA::restore_extended: return "DW_CFA_restore_extended";
+        case DW_CFA::undefined: return "DW_CFA_undefined";
+        case DW_CFA::same_value: return "DW_CFA_same_value";
+        case DW_CFA::register_: return "DW_CFA_register";
+        case DW_CFA::remember_state: return "DW_CFA_remember_state";
+        case DW_CFA::restore_state: return "DW_CFA_restore_state";
+        case DW_CFA::def_cfa: return "DW_CFA_def_cfa";
+        case DW_CFA::def_cfa_register: return "DW_CFA_def_cfa_register";
+        case DW_CFA::def_cfa_offset: return "DW_CFA_def_cfa_offset";
+        case DW_CFA::def_cfa_expression: return "DW_CFA_def_cfa_expression";
+        case DW_CFA::expression: return "DW_CFA_expression";
+        case DW_CFA::offset_extended_sf: return "DW_CFA_offset_extended_sf";
+        case DW_CFA::def_cfa_sf: return "DW_CFA_def_cfa_sf";
+        case DW_CFA::def_cfa_offset_sf: return "DW_CFA_def_cfa_offset_sf";
+        case DW_CFA::val_offset: return "DW_CFA_val_offset";
+        case DW_CFA::val_offset_sf: return "DW_CFA_val_offset_sf";
+        case DW_CFA::val_expression: return "DW_CFA_val_expression";
+        case DW_CFA::lo_user: break;
+        case DW_CFA::GNU_window_save: return "DW_CFA_GNU_window_save";
+        case DW_CFA::GNU_args_size: return "DW_CFA_GNU_args_size";
+        case DW_CFA::GNU_negative_offset_extended: return "DW_CFA_GNU_negative_offset_extended";
+        case DW_CFA::hi_user: break;
+        }
+        return "(DW_CFA)0x" + to_hex((int)v);
+}
+
 std::string
 to_string(DW_RLE v)
 {
@@ -591,4 +722,53 @@ to_string(DW_RLE v)
         return "(DW_RLE)0x" + to_hex((int)v);
 }
 
+std::string
+to_string(DW_LLE v)
+{
+        switch (v) {
+        case DW_LLE::end_of_list: return "DW_LLE_end_of_list";
+        case DW_LLE::base_addressx: return "DW_LLE_base_addressx";
+        case DW_LLE::startx_endx: return "DW_LLE_startx_endx";
+        case DW_LLE::startx_length: return "DW_LLE_startx_length";
+        case DW_LLE::offset_pair: return "DW_LLE_offset_pair";
+        case DW_LLE::default_location: return "DW_LLE_default_location";
+        case DW_LLE::base_address: return "DW_LLE_base_address";
+        case DW_LLE::start_end: return "DW_LLE_start_end";
+        case DW_LLE::start_length: return "DW_LLE_start_length";
+        case DW_LLE::GNU_view_pair: return "DW_LLE_GNU_view_pair";
+        }
+        return "(DW_LLE)0x" + to_hex((int)v);
+}
+
+std::string
+to_string(DW_UT v)
+{
+        switch (v) {
+        case DW_UT::compile: return "DW_UT_compile";
+        case DW_UT::type: return "DW_UT_type";
+        case DW_UT::partial: return "DW_UT_partial";
+        case DW_UT::skeleton: return "DW_UT_skeleton";
+        case DW_UT::split_compile: return "DW_UT_split_compile";
+        case DW_UT::split_type: return "DW_UT_split_type";
+        case DW_UT::lo_user: break;
+        case DW_UT::hi_user: break;
+        }
+        return "(DW_UT)0x" + to_hex((int)v);
+}
+
+std::string
+to_string(DW_IDX v)
+{
+        switch (v) {
+        case DW_IDX::compile_unit: return "DW_IDX_compile_unit";
+        case DW_IDX::type_unit: return "DW_IDX_type_unit";
+        case DW_IDX::die_offset: return "DW_IDX_die_offset";
+        case DW_IDX::parent: return "DW_IDX_parent";
+        case DW_IDX::type_hash: return "DW_IDX_type_hash";
+        case DW_IDX::lo_user: break;
+        case DW_IDX::hi_user: break;
+        }
+        return "(DW_IDX)0x" + to_hex((int)v);
+}
+
 DWARFPP_END_NAMESPACE
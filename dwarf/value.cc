@@ -28,51 +28,60 @@ value::get_section_offset() const
         return cu->get_section_offset() + offset;
 }
 
+/**
+ * Read the index of an indexed form (DWARF5 section 7.5.5) from cur.
+ */
+static uint64_t
+read_index(cursor *cur, DW_FORM form)
+{
+        switch (form) {
+        case DW_FORM::strx:
+        case DW_FORM::addrx:
+        case DW_FORM::rnglistx:
+        case DW_FORM::loclistx:
+        case DW_FORM::GNU_addr_index:
+        case DW_FORM::GNU_str_index:
+                return cur->uleb128();
+        case DW_FORM::strx1:
+        case DW_FORM::addrx1:
+                return cur->fixed<uint8_t>();
+        case DW_FORM::strx2:
+        case DW_FORM::addrx2:
+                return cur->fixed<uint16_t>();
+        case DW_FORM::strx3:
+        case DW_FORM::addrx3: {
+                cur->ensure(3);
+                const unsigned char *p = (const unsigned char*)cur->pos;
+                *cur += 3;
+                if (cur->sec->ord == byte_order::lsb)
+                        return p[0] | (p[1] << 8) | (p[2] << 16);
+                return (p[0] << 16) | (p[1] << 8) | p[2];
+        }
+        case DW_FORM::strx4:
+        case DW_FORM::addrx4:
+                return cur->fixed<uint32_t>();
+        default:
+                throw logic_error("not an indexed form: " + to_string(form));
+        }
+}
+
 taddr
 value::as_address() const
 {
         cursor cur(cu->data(), offset);
-
-        if (form == DW_FORM::addr) {
-                return cur.address();
-        }
-
-        // DWARF 5 address index forms
-        uint64_t index;
         switch (form) {
+        case DW_FORM::addr:
+                return cur.address();
         case DW_FORM::addrx:
-                index = cur.uleb128();
-                break;
         case DW_FORM::addrx1:
-                index = cur.fixed<uint8_t>();
-                break;
         case DW_FORM::addrx2:
-                index = cur.fixed<uint16_t>();
-                break;
         case DW_FORM::addrx3:
-                index = cur.fixed<uint8_t>() | (cur.fixed<uint16_t>() << 8);
-                break;
         case DW_FORM::addrx4:
-                index = cur.fixed<uint32_t>();
-                break;
+        case DW_FORM::GNU_addr_index:
+                return cu->get_addrx(read_index(&cur, form));
         default:
                 throw value_type_mismatch("cannot read " + to_string(typ) + " as address");
         }
-
-        // Look up address in .debug_addr section
-        // DWARF 5 .debug_addr has a header: length (4 or 12 bytes), version (2), addr_size (1), segment_selector_size (1)
-        auto addr_sec = cu->get_dwarf().get_section(section_type::addr);
-        section_offset header_size = 8;  // Simplified: assume 32-bit DWARF (4 + 2 + 1 + 1)
-        unsigned addr_size = cu->data()->addr_size;
-        cursor addr_cur(addr_sec, header_size + index * addr_size);
-        // Read address directly using the CU's addr_size (not the section's)
-        if (addr_size == 4) {
-                return addr_cur.fixed<uint32_t>();
-        } else if (addr_size == 8) {
-                return addr_cur.fixed<uint64_t>();
-        } else {
-                throw format_error("unsupported address size " + std::to_string(addr_size));
-        }
 }
 
 const void *
@@ -188,6 +197,20 @@ value::as_flag() const
         }
 }
 
+loclist
+value::as_loclist() const
+{
+        switch (typ) {
+        case type::exprloc:
+        case type::block:
+                return loclist(as_exprloc());
+        case type::loclist:
+                return loclist(cu, as_sec_offset());
+        default:
+                throw value_type_mismatch("cannot read " + to_string(typ) + " as loclist");
+        }
+}
+
 rangelist
 value::as_rangelist() const
 {
@@ -195,70 +218,21 @@ value::as_rangelist() const
         // case, the first entry in the range list must be a base
         // address entry, but we'll just assume 0 for the initial base
         // address.
-        die cudie = cu->root();
-        taddr cu_low_pc = cudie.has(DW_AT::low_pc) ? at_low_pc(cudie) : 0;
+        taddr cu_low_pc = cu->get_base_address();
         auto cusec = cu->data();
 
-        // DWARF 5 uses rnglistx form with .debug_rnglists section
-        if (form == DW_FORM::rnglistx) {
-                cursor cur(cu->data(), offset);
-                uint64_t index = cur.uleb128();
-
-                // Get .debug_rnglists section
-                auto rnglists_sec = cu->get_dwarf().get_section(section_type::rnglists);
-
-                // Parse the rnglists header to find the offsets table
-                // Header format: unit_length (4/12), version (2), addr_size (1),
-                // segment_selector_size (1), offset_entry_count (4)
-                cursor hdr(rnglists_sec, (section_offset)0);
-
-                // Read unit length to determine format
-                uint32_t unit_length32 = hdr.fixed<uint32_t>();
-                format fmt;
-                section_offset header_size;
-                if (unit_length32 == 0xffffffff) {
-                        // 64-bit DWARF
-                        hdr.fixed<uint64_t>(); // actual length
-                        fmt = format::dwarf64;
-                        header_size = 20; // 12 + 2 + 1 + 1 + 4
-                } else {
-                        fmt = format::dwarf32;
-                        header_size = 12; // 4 + 2 + 1 + 1 + 4
-                }
-
-                uint16_t version = hdr.fixed<uint16_t>();
-                (void)version; // Should be 5
-                uint8_t addr_size = hdr.fixed<uint8_t>();
-                (void)addr_size;
-                uint8_t segment_selector_size = hdr.fixed<uint8_t>();
-                (void)segment_selector_size;
-                uint32_t offset_entry_count = hdr.fixed<uint32_t>();
-
-                if (index >= offset_entry_count) {
-                        throw format_error("rnglistx index out of bounds");
-                }
-
-                // Read the offset from the offsets table
-                section_offset offset_size = (fmt == format::dwarf64) ? 8 : 4;
-                cursor offsets_cur(rnglists_sec, header_size + index * offset_size);
-                section_offset range_offset;
-                if (fmt == format::dwarf64) {
-                        range_offset = offsets_cur.fixed<uint64_t>();
-                } else {
-                        range_offset = offsets_cur.fixed<uint32_t>();
-                }
-
-                // The offset is relative to the first range list entry (after offsets table)
-                section_offset base_offset = header_size + offset_entry_count * offset_size;
-                section_offset absolute_offset = base_offset + range_offset;
-
-                return rangelist(rnglists_sec, absolute_offset, cusec->addr_size, cu_low_pc, true);
+        // DWARF 5 range lists are in .debug_rnglists, whether the
+        // attribute is an index or an offset
+        section_offset off = as_sec_offset();
+        if (cu->get_version() >= 5) {
+                const auto &sec = cu->get_dwarf().get_section(section_type::rnglists);
+                return rangelist(sec, off, cusec->addr_size, cu_low_pc, true, cu);
         }
 
         // DWARF 4 and earlier: direct offset into .debug_ranges
-        section_offset off = as_sec_offset();
-        auto sec = cu->get_dwarf().get_section(section_type::ranges);
-        return rangelist(sec, off, cusec->addr_size, cu_low_pc, false);
+        section_offset base;
+        const auto &sec = cu->get_ranges_section(&base);
+        return rangelist(sec, base + off, cusec->addr_size, cu_low_pc, false);
 }
 
 die
@@ -287,17 +261,11 @@ value::as_reference() const
 
         case DW_FORM::ref_addr: {
                 off = cur.offset();
-                // These seem to be extremely rare in practice (I
-                // haven't been able to get gcc to produce a
-                // ref_addr), so it's not worth caching this lookup.
-                const compilation_unit *base_cu = nullptr;
-                for (auto &file_cu : cu->get_dwarf().compilation_units()) {
-                        if (file_cu.get_section_offset() > off)
-                                break;
-                        base_cu = &file_cu;
-                }
-                die d(base_cu);
-                d.read(off - base_cu->get_section_offset());
+                // GCC rarely produces these, but LTO and dwz use
+                // them for most cross-unit references.
+                const compilation_unit &base_cu = cu->find_ref_target(off);
+                die d(&base_cu);
+                d.read(off - base_cu.get_section_offset());
                 return d;
         }
 
@@ -357,42 +325,9 @@ value::as_cstr(size_t *size_out) const
         case DW_FORM::strx1:
         case DW_FORM::strx2:
         case DW_FORM::strx3:
-        case DW_FORM::strx4: {
-                // DWARF 5: Read string index, look up in .debug_str_offsets, then read from .debug_str
-                uint64_t index;
-                switch (form) {
-                case DW_FORM::strx:
-                        index = cur.uleb128();
-                        break;
-                case DW_FORM::strx1:
-                        index = cur.fixed<uint8_t>();
-                        break;
-                case DW_FORM::strx2:
-                        index = cur.fixed<uint16_t>();
-                        break;
-                case DW_FORM::strx3:
-                        index = cur.fixed<uint8_t>() | (cur.fixed<uint16_t>() << 8);
-                        break;
-                case DW_FORM::strx4:
-                        index = cur.fixed<uint32_t>();
-                        break;
-                default:
-                        index = 0;
-                        break;
-                }
-                // Get str_offsets_base from CU root DIE's DW_AT_str_offsets_base
-                // For now, we use a simplified approach: read from start of section + header
-                // DWARF 5 .debug_str_offsets has a header (length + version + padding)
-                // We skip the 8-byte header (4-byte length + 2-byte version + 2-byte padding for 32-bit DWARF)
-                auto str_offsets_sec = cu->get_dwarf().get_section(section_type::str_offsets);
-                section_offset header_size = 8;  // Simplified: assume 32-bit DWARF
-                unsigned offset_size = (str_offsets_sec->addr_size == 8) ? 8 : 4;
-                cursor offsets_cur(str_offsets_sec,
-                                   header_size + index * offset_size);
-                section_offset str_off = offsets_cur.offset();
-                cursor scur(cu->get_dwarf().get_section(section_type::str), str_off);
-                return scur.cstr(size_out);
-        }
+        case DW_FORM::strx4:
+        case DW_FORM::GNU_str_index:
+                return cu->get_strx(read_index(&cur, form), size_out);
         default:
                 throw value_type_mismatch("cannot read " + to_string(typ) + " as string");
         }
@@ -411,6 +346,10 @@ value::as_sec_offset() const
                 return cur.fixed<uint64_t>();
         case DW_FORM::sec_offset:
                 return cur.offset();
+        case DW_FORM::rnglistx:
+                return cu->get_rnglistx(cur.uleb128());
+        case DW_FORM::loclistx:
+                return cu->get_loclistx(cur.uleb128());
         default:
                 throw value_type_mismatch("cannot read " + to_string(typ) + " as sec_offset");
         }
@@ -473,8 +412,7 @@ to_string(const value &v)
                 return "<rangelist 0x" + to_hex(v.as_sec_offset()) + ">";
         case value::type::reference: {
                 die d = v.as_reference();
-                auto tu = dynamic_cast<const type_unit*>(&d.get_unit());
-                if (tu)
+                if (d.get_unit().data()->type == section_type::types)
                         return "<.debug_types+0x" + to_hex(d.get_section_offset()) + ">";
                 return "<0x" + to_hex(d.get_section_offset()) + ">";
         }
@@ -208,6 +208,7 @@ enum class sht : ElfTypes::Word
         shlib    = 10,          // Reserved
         dynsym   = 11,          // Contains a dynamic loader symbol table
         loos     = 0x60000000,  // Environment-specific use
+        gnu_hash = 0x6FFFFFF6,  // GNU-style symbol hash table
         hios     = 0x6FFFFFFF,
         loproc   = 0x70000000,  // Processor-specific use
         hiproc   = 0x7FFFFFFF,
@@ -225,6 +226,7 @@ enum class shf : Elf64::Xword
         write     = 0x1,        // Section contains writable data
         alloc     = 0x2,        // Section is allocated in memory image of program
         execinstr = 0x4,        // Section contains executable instructions
+        compressed = 0x800,     // Section data is compressed (see Chdr)
         maskos    = 0x0F000000, // Environment-specific use
         maskproc  = 0xF0000000, // Processor-specific use
 };
@@ -309,6 +311,65 @@ struct Shdr
         }
 };
 
+// Compression types for SHF_COMPRESSED sections (gABI ch_type)
+enum class elfcompress : ElfTypes::Word
+{
+        zlib   = 1,             // ZLIB/DEFLATE
+        zstd   = 2,             // Zstandard
+        loos   = 0x60000000,    // Environment-specific use
+        hios   = 0x6FFFFFFF,
+        loproc = 0x70000000,    // Processor-specific use
+        hiproc = 0x7FFFFFFF,
+};
+
+std::string
+to_string(elfcompress v);
+
+// Compression header at the beginning of SHF_COMPRESSED sections
+// (gABI "Compressed Sections")
+template<typename E = Elf64, byte_order Order = byte_order::native>
+struct Chdr;
+
+template<byte_order Order>
+struct Chdr<Elf32, Order>
+{
+        typedef Elf32 types;
+        static const byte_order order = Order;
+
+        elfcompress   type;      // Compression algorithm
+        Elf32::Word   size;      // Uncompressed data size
+        Elf32::Word   addralign; // Uncompressed data alignment
+
+        template<typename E2>
+        void from(const E2 &o)
+        {
+                type      = swizzle(o.type, o.order, order);
+                size      = swizzle(o.size, o.order, order);
+                addralign = swizzle(o.addralign, o.order, order);
+        }
+};
+
+template<byte_order Order>
+struct Chdr<Elf64, Order>
+{
+        typedef Elf64 types;
+        static const byte_order order = Order;
+
+        elfcompress   type;      // Compression algorithm
+        Elf64::Word   reserved;
+        Elf64::Xword  size;      // Uncompressed data size
+        Elf64::Xword  addralign; // Uncompressed data alignment
+
+        template<typename E2>
+        void from(const E2 &o)
+        {
+                type      = swizzle(o.type, o.order, order);
+                reserved  = 0;
+                size      = swizzle(o.size, o.order, order);
+                addralign = swizzle(o.addralign, o.order, order);
+        }
+};
+
 // Segment types (ELF64 table 16)
 enum class pt : ElfTypes::Word
 {
@@ -569,6 +630,28 @@ struct Sym<Elf64, Order>
         }
 };
 
+// Note header (ELF32 figure 2-3, ELF64 section 5).  Both classes use
+// 4-byte words.  The name and descriptor follow, each padded to the
+// note alignment.
+template<typename E = Elf64, byte_order Order = byte_order::native>
+struct Nhdr
+{
+        typedef E types;
+        static const byte_order order = Order;
+
+        typename E::Word namesz; // Size of name, including the NUL
+        typename E::Word descsz; // Size of descriptor
+        typename E::Word type;   // Note type
+
+        template<typename E2>
+        void from(const E2 &o)
+        {
+                namesz = swizzle(o.namesz, o.order, order);
+                descsz = swizzle(o.descsz, o.order, order);
+                type   = swizzle(o.type, o.order, order);
+        }
+};
+
 ELFPP_END_NAMESPACE
 
 #endif
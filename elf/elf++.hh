@@ -37,6 +37,51 @@ public:
                 : std::runtime_error(what_arg) { }
 };
 
+/**
+ * Expected access patterns for a range of an ELF file, used as hints
+ * to loaders.
+ */
+enum class access_advice
+{
+        // No special treatment
+        normal,
+        // Expect sequential access; read ahead aggressively
+        sequential,
+        // Expect random access; don't read ahead
+        random,
+        // Expect access soon; start reading the range in the
+        // background
+        willneed,
+        // Read the range into memory before returning
+        populate,
+};
+
+/**
+ * A snapshot of the statistics of an ELF file, returned by
+ * elf::get_stats.  These count the work done through the file and
+ * its sections while statistics were enabled.
+ */
+struct elf_stats
+{
+        // Sections whose data was read from the loader, and their
+        // total size
+        std::uint64_t sections_loaded, bytes_loaded;
+
+        // get_section(name) calls that found a section, and that
+        // didn't
+        std::uint64_t name_lookup_hits, name_lookup_misses;
+
+        // Sections decompressed by section::decompressed_data, their
+        // total compressed and decompressed sizes, and the
+        // nanoseconds decompressing took
+        std::uint64_t decompressions, compressed_bytes, decompressed_bytes,
+                decompression_ns;
+
+        // decompressed_data calls answered by the decompression
+        // cache
+        std::uint64_t decompression_cache_hits;
+};
+
 /**
  * An ELF file.
  *
@@ -70,6 +115,13 @@ public:
 
         elf& operator=(const elf &o) = default;
 
+        /**
+         * The access hint type taken by loader::advise and
+         * section::advise.  This lets code that is templated on the
+         * ELF file type (like dwarf::elf::elf_loader) name it.
+         */
+        typedef ::elf::access_advice access_advice;
+
         bool valid() const
         {
                 return !!m;
@@ -87,7 +139,10 @@ public:
         std::shared_ptr<loader> get_loader() const;
 
         /**
-         * Return the segments in this file.
+         * Return the segments in this file.  Segment objects are
+         * created on demand, so the first call to this canonicalizes
+         * every program header; prefer get_segment when only a few
+         * are needed.
          */
         const std::vector<segment> &segments() const;
 
@@ -98,13 +153,17 @@ public:
         const segment &get_segment(unsigned index) const;
 
         /**
-         * Return the sections in this file.
+         * Return the sections in this file.  As with segments(), the
+         * first call canonicalizes every section header.
          */
         const std::vector<section> &sections() const;
 
         /**
          * Return the section with the specified name. If no such
-         * section is found, return an invalid section.
+         * section is found, return an invalid section.  If several
+         * sections have this name, return the first.  This uses a
+         * hash table over the section names that is built on the
+         * first call, and only canonicalizes the returned section.
          */
         const section &get_section(const std::string &name) const;
 
@@ -114,7 +173,47 @@ public:
          */
         const section &get_section(unsigned index) const;
 
+        /**
+         * Set the maximum number of bytes of decompressed section
+         * data this file keeps cached for section::decompressed_data.
+         * The cache is shared by every copy of this elf object and
+         * evicts least recently used sections first.  Evicting a
+         * section only drops the cache's reference; buffers already
+         * returned remain valid.  The default is 64 MiB.
+         */
+        void set_decompression_cache_limit(size_t bytes);
+
+        /**
+         * Start collecting statistics (see get_stats) for this file
+         * and its sections.  Until this is called, statistics cost
+         * one predictable branch where they would be counted.  If
+         * libelf++ was built with ELFPP_DISABLE_STATS, this does
+         * nothing.
+         */
+        void enable_stats() const;
+
+        /**
+         * Return the statistics collected since enable_stats or the
+         * last reset_stats.
+         */
+        elf_stats get_stats() const;
+
+        /**
+         * Zero the collected statistics.
+         */
+        void reset_stats() const;
+
+        /**
+         * Return the raw bytes of this file's GNU build ID, from its
+         * NT_GNU_BUILD_ID note.  This searches the note sections, or
+         * the note segments if the file has no section headers.
+         * Returns an empty string if the file has no build ID.
+         */
+        std::string get_build_id() const;
+
 private:
+        friend class section;
+
         struct impl;
         std::shared_ptr<impl> m;
 };
@@ -130,20 +229,61 @@ public:
         /**
          * Load the requested file section into memory and return a
          * pointer to the beginning of it.  This memory must remain
-         * valid and unchanged until the loader is destroyed.  If the
-         * loader cannot satisfy the full request for any reason
-         * (including a premature EOF), it must throw an exception.
+         * valid and unchanged until the loader is destroyed or the
+         * range is passed to release.  If the loader cannot satisfy
+         * the full request for any reason (including a premature
+         * EOF), it must throw an exception.
          */
         virtual const void *load(off_t offset, size_t size) = 0;
+
+        /**
+         * Hint how the given range of the file will be accessed.
+         * The default implementation ignores the hint.
+         */
+        virtual void advise(off_t offset, size_t size, access_advice advice) { }
+
+        /**
+         * Indicate that a range previously returned by load(offset,
+         * size) is no longer needed, balancing one call to load.
+         * Depending on the loader, the returned memory may become
+         * invalid.  The default implementation does nothing.
+         */
+        virtual void release(off_t offset, size_t size) { }
 };
 
 /**
  * An mmap-based loader that maps requested sections on demand.  This
  * will close fd when done, so the caller should dup the file
  * descriptor if it intends to continue using it.
+ *
+ * This loader applies advice with madvise.  Releasing a range drops
+ * its pages from memory (MADV_DONTNEED), but pointers into it remain
+ * valid and will fault the data back in from the file.
  */
 std::shared_ptr<loader> create_mmap_loader(int fd);
 
+/**
+ * Like create_mmap_loader(int), but apply advice to the whole file
+ * up front.  For example, access_advice::random disables readahead,
+ * which helps with large files on slow storage that are accessed
+ * sparsely.
+ */
+std::shared_ptr<loader> create_mmap_loader(int fd, access_advice advice);
+
+/**
+ * A loader that reads the file with pread instead of mapping it.
+ * Each load reads the page_size-aligned range that covers it.  A
+ * range stays in memory as long as it has loads that haven't been
+ * released.  Released ranges are kept in an LRU cache of at most
+ * cache_limit bytes, and loads that hit the cache are served from it.
+ * Hence memory use is bounded by the live loads plus cache_limit.
+ * Memory returned by load becomes invalid once all loads of its range
+ * are released.  This will close fd when done.
+ */
+std::shared_ptr<loader> create_pread_loader(int fd,
+                                            size_t cache_limit = 64 << 20,
+                                            size_t page_size = 64 << 10);
+
 /**
  * An exception indicating that a section is not of the requested type.
  */
@@ -176,6 +316,9 @@ public:
        segment(const segment &o) = default;
        segment(segment &&o) = default;
 
+       segment &operator=(const segment &o) = default;
+       segment &operator=(segment &&o) = default;
+
        /**
         * Return true if this segment is valid and corresponds to a
         * segment in the ELF file.
@@ -233,6 +376,9 @@ public:
         section(const section &o) = default;
         section(section &&o) = default;
 
+        section &operator=(const section &o) = default;
+        section &operator=(section &&o) = default;
+
         /**
          * Return true if this section is valid and corresponds to a
          * section in the ELF file.
@@ -260,9 +406,49 @@ public:
 
         /**
          * Return this section's data.  If this is a NOBITS section,
-         * return nullptr.
+         * return nullptr.  For compressed sections, this is the raw,
+         * compressed data.
          */
         const void *data() const;
+
+        /**
+         * Pass an access pattern hint for this section's data to the
+         * loader.
+         */
+        void advise(access_advice advice) const;
+
+        /**
+         * Tell the loader this section's data is no longer needed.
+         * The next data() call loads it again.  Depending on the
+         * loader, pointers previously returned by data() may become
+         * invalid, so the caller must ensure nothing still uses
+         * them.  This does not affect decompressed_data buffers.
+         */
+        void release() const;
+
+        /**
+         * Return true if this section's data is compressed, either
+         * because it is an SHF_COMPRESSED section or because it is a
+         * legacy GNU .zdebug_* section.
+         */
+        bool is_compressed() const;
+
+        /**
+         * Return this section's uncompressed data and set *size_out
+         * to its size.  If this section is not compressed, this is
+         * just data() and size().  Otherwise, the data is
+         * decompressed on the first call and kept in a bounded cache
+         * shared by all users of this ELF file.  The returned pointer
+         * keeps the buffer (or, for uncompressed sections, the
+         * loader) live.
+         *
+         * zlib and zstd support are only available if libelf++ is
+         * built with them (the LIBELFIN_ZLIB and LIBELFIN_ZSTD CMake
+         * options, which define ELFPP_HAVE_ZLIB and ELFPP_HAVE_ZSTD).
+         * Sections using an unsupported compression type throw
+         * format_error.
+         */
+        std::shared_ptr<const void> decompressed_data(size_t *size_out) const;
         /**
          * Return the size of this section in bytes.
          */
@@ -423,12 +609,12 @@ public:
                         return *this;
                 }
 
-                bool operator==(iterator &o) const
+                bool operator==(const iterator &o) const
                 {
                         return pos == o.pos;
                 }
 
-                bool operator!=(iterator &o) const
+                bool operator!=(const iterator &o) const
                 {
                         return pos != o.pos;
                 }
@@ -444,6 +630,31 @@ public:
          */
         iterator end() const;
 
+        /**
+         * Return an iterator to the defined function or object symbol
+         * whose [value, value+size) range contains addr, or end() if
+         * there is none.  If several symbols contain addr, this
+         * returns the one with the greatest value, and the first in
+         * the table among those.
+         *
+         * The first call builds a sorted address index over this
+         * table; later calls are a binary search.
+         */
+        iterator find_address(Elf64::Addr addr) const;
+
+        /**
+         * Return an iterator to the defined symbol with the given
+         * name, or end() if there is none.  If several symbols have
+         * this name, this prefers global over weak over local
+         * bindings.
+         *
+         * This uses the .gnu.hash or .hash section linked to this
+         * table if there is one; otherwise the first call builds a
+         * hash table over the symbol names.
+         */
+        iterator find_name(const char *name) const;
+        iterator find_name(const std::string &name) const;
+
 private:
         struct impl;
         std::shared_ptr<impl> m;
@@ -4,7 +4,19 @@
 
 #include "elf++.hh"
 
+#include <algorithm>
+#include <atomic>
+#include <chrono>
 #include <cstring>
+#include <list>
+#include <mutex>
+
+#ifdef ELFPP_HAVE_ZLIB
+#include <zlib.h>
+#endif
+#ifdef ELFPP_HAVE_ZSTD
+#include <zstd.h>
+#endif
 
 using namespace std;
 
@@ -41,20 +53,140 @@ void canon_hdr(Hdr<Elf64, byte_order::native> *out, const void *data,
 // class elf
 //
 
+/**
+ * The counters of an elf file's statistics.  See elf_stats.
+ */
+enum class elf_counter
+{
+        sections_loaded,
+        bytes_loaded,
+        name_lookup_hits,
+        name_lookup_misses,
+        decompressions,
+        compressed_bytes,
+        decompressed_bytes,
+        decompression_ns,
+        decompression_cache_hits,
+        max
+};
+
 struct elf::impl
 {
         impl(const shared_ptr<loader> &l)
-                : l(l) { }
+                : l(l), seg_data(nullptr), sec_data(nullptr),
+                  stats_enabled(false)
+        {
+                for (auto &c : stats)
+                        c.store(0, memory_order_relaxed);
+        }
 
         const shared_ptr<loader> l;
         Ehdr<> hdr;
-        vector<section> sections;
+
+        // Raw (uncanonicalized) program and section header tables.
+        const char *seg_data, *sec_data;
+
+        // Segment and section objects are materialized from the raw
+        // headers on first access.  segments[i] and sections[i] are
+        // invalid until the corresponding once flag has run.
         vector<segment> segments;
+        vector<section> sections;
+        unique_ptr<once_flag[]> segment_once, section_once;
+        once_flag all_segments_once, all_sections_once;
+
+        // Open-addressed hash table from section name to section
+        // index, built from the raw section headers on the first
+        // lookup by name.  Empty slots are ~0.
+        vector<const char *> names;
+        vector<size_t> name_lens;
+        vector<unsigned> name_slots;
+        once_flag names_once;
 
         section invalid_section;
         segment invalid_segment;
+
+        // Decompressed section data, most recently used first, keyed
+        // by the section's file offset.
+        struct decompressed_section
+        {
+                Elf64::Off offset;
+                shared_ptr<const void> data;
+                size_t size;
+        };
+        mutex decompressed_lock;
+        list<decompressed_section> decompressed;
+        size_t decompressed_bytes = 0;
+        size_t decompressed_limit = 64 << 20;
+
+        // Statistics, only counted once stats_enabled is set
+        atomic<bool> stats_enabled;
+        atomic<uint64_t> stats[(unsigned)elf_counter::max];
+
+        void build_name_index(const elf &f);
+
+        bool stats_on() const
+        {
+#ifdef ELFPP_DISABLE_STATS
+                return false;
+#else
+                return stats_enabled.load(memory_order_relaxed);
+#endif
+        }
+
+        void count_stat(elf_counter c, uint64_t n = 1)
+        {
+                if (stats_on())
+                        stats[(unsigned)c].fetch_add(n, memory_order_relaxed);
+        }
 };
 
+static uint32_t
+hash_name(const char *name, size_t len)
+{
+        // FNV-1a
+        uint32_t h = 2166136261u;
+        for (size_t i = 0; i < len; i++)
+                h = (h ^ (unsigned char)name[i]) * 16777619u;
+        return h;
+}
+
+void
+elf::impl::build_name_index(const elf &f)
+{
+        if (hdr.shnum == 0)
+                return;
+
+        // Read names directly out of the raw section headers so
+        // that a lookup by name only canonicalizes the header of the
+        // section it returns (and the section name table).
+        strtab shstrtab = f.get_section(hdr.shstrndx).as_strtab();
+        names.resize(hdr.shnum);
+        name_lens.resize(hdr.shnum);
+        for (unsigned i = 0; i < hdr.shnum; i++) {
+                Shdr<> shdr{};
+                canon_hdr(&shdr, sec_data + i * hdr.shentsize,
+                          hdr.ei_class, hdr.ei_data);
+                names[i] = shstrtab.get(shdr.name, &name_lens[i]);
+        }
+
+        size_t nslots = 8;
+        while (nslots < 2 * (size_t)hdr.shnum)
+                nslots *= 2;
+        name_slots.assign(nslots, ~0u);
+        for (unsigned i = 0; i < hdr.shnum; i++) {
+                size_t slot = hash_name(names[i], name_lens[i]) & (nslots - 1);
+                for (; name_slots[slot] != ~0u; slot = (slot + 1) & (nslots - 1)) {
+                        unsigned o = name_slots[slot];
+                        // On duplicate names, the first section wins
+                        if (name_lens[o] == name_lens[i] &&
+                            memcmp(names[o], names[i], name_lens[i]) == 0)
+                                break;
+                }
+                if (name_slots[slot] == ~0u)
+                        name_slots[slot] = i;
+        }
+}
+
 elf::elf(const std::shared_ptr<loader> &l)
         : m(make_shared<impl>(l))
 {
@@ -92,24 +224,17 @@ elf::elf(const std::shared_ptr<loader> &l)
         if (m->hdr.shnum && m->hdr.shstrndx >= m->hdr.shnum)
                 throw format_error("bad section name string table index");
 
-        // Load segments
-        const void *seg_data = l->load(m->hdr.phoff,
-                                       m->hdr.phentsize * m->hdr.phnum);
-        for (unsigned i = 0; i < m->hdr.phnum; i++) {
-                const void *seg = ((const char*)seg_data) + i * m->hdr.phentsize;
-                m->segments.push_back(segment(*this, seg));
-        }
+        // Map the segment and section header tables, but don't
+        // canonicalize them until they're needed.
+        m->seg_data = (const char*)l->load(m->hdr.phoff,
+                                           m->hdr.phentsize * m->hdr.phnum);
+        m->segments.resize(m->hdr.phnum);
+        m->segment_once.reset(new once_flag[m->hdr.phnum]);
 
-        // Load sections
-        const void *sec_data = l->load(m->hdr.shoff,
-                                       m->hdr.shentsize * m->hdr.shnum);
-        for (unsigned i = 0; i < m->hdr.shnum; i++) {
-                const void *sec = ((const char*)sec_data) + i * m->hdr.shentsize;
-                // XXX Circular reference.  Maybe this should be
-                // constructed on the fly?  Canonicalizing the header
-                // isn't super-cheap.
-                m->sections.push_back(section(*this, sec));
-        }
+        m->sec_data = (const char*)l->load(m->hdr.shoff,
+                                           m->hdr.shentsize * m->hdr.shnum);
+        m->sections.resize(m->hdr.shnum);
+        m->section_once.reset(new once_flag[m->hdr.shnum]);
 }
 
 const Ehdr<> &
@@ -127,38 +252,176 @@ elf::get_loader() const
 const std::vector<section> &
 elf::sections() const
 {
+        call_once(m->all_sections_once, [&]() {
+                        for (unsigned i = 0; i < m->sections.size(); i++)
+                                get_section(i);
+                });
         return m->sections;
 }
 
 const std::vector<segment> &
 elf::segments() const
 {
+        call_once(m->all_segments_once, [&]() {
+                        for (unsigned i = 0; i < m->segments.size(); i++)
+                                get_segment(i);
+                });
         return m->segments;
 }
 
 const section &
 elf::get_section(const std::string &name) const
 {
-        for (auto &sec : sections())
-                if (name == sec.get_name(nullptr))
-                        return sec;
+        call_once(m->names_once, [&]() { m->build_name_index(*this); });
+
+        size_t nslots = m->name_slots.size();
+        if (nslots == 0) {
+                m->count_stat(elf_counter::name_lookup_misses);
+                return m->invalid_section;
+        }
+        size_t slot = hash_name(name.data(), name.size()) & (nslots - 1);
+        for (; m->name_slots[slot] != ~0u; slot = (slot + 1) & (nslots - 1)) {
+                unsigned i = m->name_slots[slot];
+                if (m->name_lens[i] == name.size() &&
+                    memcmp(m->names[i], name.data(), name.size()) == 0) {
+                        m->count_stat(elf_counter::name_lookup_hits);
+                        return get_section(i);
+                }
+        }
+        m->count_stat(elf_counter::name_lookup_misses);
         return m->invalid_section;
 }
 
 const section &
 elf::get_section(unsigned index) const
 {
-        if (index >= sections().size())
+        if (index >= m->sections.size())
                 return m->invalid_section;
-        return sections().at(index);
+        // XXX Circular reference.  Maybe this should be constructed
+        // on the fly?
+        call_once(m->section_once[index], [&]() {
+                        m->sections[index] = section(
+                                *this, m->sec_data + index * m->hdr.shentsize);
+                });
+        return m->sections[index];
 }
 
 const segment&
 elf::get_segment(unsigned index) const
 {
-        if (index >= segments().size())
+        if (index >= m->segments.size())
                 return m->invalid_segment;
-        return segments().at(index);
+        call_once(m->segment_once[index], [&]() {
+                        m->segments[index] = segment(
+                                *this, m->seg_data + index * m->hdr.phentsize);
+                });
+        return m->segments[index];
+}
+
+void
+elf::set_decompression_cache_limit(size_t bytes)
+{
+        lock_guard<mutex> lock(m->decompressed_lock);
+        m->decompressed_limit = bytes;
+        while (m->decompressed_bytes > bytes) {
+                m->decompressed_bytes -= m->decompressed.back().size;
+                m->decompressed.pop_back();
+        }
+}
+
+void
+elf::enable_stats() const
+{
+        m->stats_enabled.store(true, memory_order_relaxed);
+}
+
+elf_stats
+elf::get_stats() const
+{
+        auto get = [&](elf_counter c) {
+                return m->stats[(unsigned)c].load(memory_order_relaxed);
+        };
+
+        elf_stats out;
+        out.sections_loaded = get(elf_counter::sections_loaded);
+        out.bytes_loaded = get(elf_counter::bytes_loaded);
+        out.name_lookup_hits = get(elf_counter::name_lookup_hits);
+        out.name_lookup_misses = get(elf_counter::name_lookup_misses);
+        out.decompressions = get(elf_counter::decompressions);
+        out.compressed_bytes = get(elf_counter::compressed_bytes);
+        out.decompressed_bytes = get(elf_counter::decompressed_bytes);
+        out.decompression_ns = get(elf_counter::decompression_ns);
+        out.decompression_cache_hits = get(elf_counter::decompression_cache_hits);
+        return out;
+}
+
+void
+elf::reset_stats() const
+{
+        for (auto &c : m->stats)
+                c.store(0, memory_order_relaxed);
+}
+
+// The note type of a GNU build ID, in notes named "GNU"
+static const unsigned nt_gnu_build_id = 3;
+
+/**
+ * Search the notes in data for a GNU build ID.  align is the
+ * alignment of the notes, which is 8 for notes in sections or
+ * segments aligned to 8 and otherwise 4.  If a build ID is found,
+ * store it in *out and return true.
+ */
+static bool
+find_build_id(const Ehdr<> &ehdr, const char *data, size_t size,
+              size_t align, string *out)
+{
+        const size_t hdr_size = sizeof(Nhdr<>);
+        size_t pos = 0;
+        while (size - pos >= hdr_size) {
+                Nhdr<> nhdr{};
+                canon_hdr(&nhdr, data + pos, ehdr.ei_class, ehdr.ei_data);
+                size_t name = pos + hdr_size;
+                size_t desc = (name + nhdr.namesz + align - 1) & ~(align - 1);
+                if (desc > size || nhdr.descsz > size - desc)
+                        return false;
+                if (nhdr.type == nt_gnu_build_id && nhdr.namesz == 4 &&
+                    memcmp(data + name, "GNU", 4) == 0) {
+                        out->assign(data + desc, nhdr.descsz);
+                        return true;
+                }
+                pos = (desc + nhdr.descsz + align - 1) & ~(align - 1);
+                if (pos > size)
+                        return false;
+        }
+        return false;
+}
+
+string
+elf::get_build_id() const
+{
+        string id;
+        const Ehdr<> &ehdr = get_hdr();
+        if (ehdr.shnum) {
+                for (auto &sec : sections()) {
+                        auto &hdr = sec.get_hdr();
+                        if (hdr.type != sht::note || hdr.size == 0)
+                                continue;
+                        if (find_build_id(ehdr, (const char*)sec.data(),
+                                          hdr.size, hdr.addralign == 8 ? 8 : 4,
+                                          &id))
+                                return id;
+                }
+                return id;
+        }
+        for (auto &seg : segments()) {
+                auto &hdr = seg.get_hdr();
+                if (hdr.type != pt::note || hdr.filesz == 0)
+                        continue;
+                if (find_build_id(ehdr, (const char*)seg.data(), hdr.filesz,
+                                  hdr.align == 8 ? 8 : 4, &id))
+                        return id;
+        }
+        return id;
 }
 
 //////////////////////////////////////////////////////////////////
@@ -171,7 +434,7 @@ struct segment::impl {
 
         const elf f;
         Phdr<> hdr;
-        const void *data;
+        atomic<const void *> data;
 };
 
 segment::segment(const elf &f, const void *hdr)
@@ -227,7 +490,7 @@ struct section::impl
         Shdr<> hdr;
         const char *name;
         size_t name_len;
-        const void *data;
+        atomic<const void *> data;
 };
 
 section::section(const elf &f, const void *hdr)
@@ -265,9 +528,21 @@ section::data() const
 {
         if (m->hdr.type == sht::nobits)
                 return nullptr;
-        if (!m->data)
-                m->data = m->f.get_loader()->load(m->hdr.offset, m->hdr.size);
-        return m->data;
+        const void *data = m->data;
+        if (!data) {
+                auto l = m->f.get_loader();
+                const void *loaded = l->load(m->hdr.offset, m->hdr.size);
+                if (m->data.compare_exchange_strong(data, loaded)) {
+                        data = loaded;
+                        m->f.m->count_stat(elf_counter::sections_loaded);
+                        m->f.m->count_stat(elf_counter::bytes_loaded,
+                                           m->hdr.size);
+                } else
+                        // Another thread loaded it first; balance our
+                        // load
+                        l->release(m->hdr.offset, m->hdr.size);
+        }
+        return data;
 }
 
 size_t
@@ -276,6 +551,202 @@ section::size() const
         return m->hdr.size;
 }
 
+void
+section::advise(access_advice advice) const
+{
+        if (m->hdr.type == sht::nobits)
+                return;
+        m->f.get_loader()->advise(m->hdr.offset, m->hdr.size, advice);
+}
+
+void
+section::release() const
+{
+        if (m->data.exchange(nullptr))
+                m->f.get_loader()->release(m->hdr.offset, m->hdr.size);
+}
+
+// Legacy GNU compressed sections start with this magic followed by
+// the 64-bit big-endian uncompressed size and a zlib stream.
+static const char zdebug_magic[4] = {'Z', 'L', 'I', 'B'};
+static const size_t zdebug_hdr_size = 12;
+
+bool
+section::is_compressed() const
+{
+        if ((m->hdr.flags & shf::compressed) == shf::compressed)
+                return true;
+        if (m->hdr.type == sht::nobits || m->hdr.size < zdebug_hdr_size ||
+            strncmp(get_name(nullptr), ".zdebug", 7) != 0)
+                return false;
+        return memcmp(data(), zdebug_magic, sizeof zdebug_magic) == 0;
+}
+
+/**
+ * Return whether this build can decompress sections compressed with
+ * type.
+ */
+static bool
+compression_supported(elfcompress type)
+{
+        switch (type) {
+#ifdef ELFPP_HAVE_ZLIB
+        case elfcompress::zlib:
+                return true;
+#endif
+#ifdef ELFPP_HAVE_ZSTD
+        case elfcompress::zstd:
+                return true;
+#endif
+        default:
+                return false;
+        }
+}
+
+/**
+ * Return an upper bound on the decompressed size of src_size bytes
+ * compressed with type, so a corrupt header can't make us allocate
+ * an arbitrarily large buffer.  Deflate expands at most 1032:1.
+ * Zstandard's run-length blocks can do far better, so allow it a
+ * much larger, but still bounded, ratio.
+ */
+static uint64_t
+max_decompressed_size(elfcompress type, size_t src_size)
+{
+        uint64_t ratio = type == elfcompress::zlib ? 1032 : 32768;
+        return (uint64_t)src_size * ratio + 4096;
+}
+
+static void
+decompress(elfcompress type, const void *src, size_t src_size,
+           void *dst, size_t dst_size)
+{
+        switch (type) {
+        case elfcompress::zlib: {
+#ifdef ELFPP_HAVE_ZLIB
+                uLongf out_size = dst_size;
+                int err = uncompress((Bytef*)dst, &out_size,
+                                     (const Bytef*)src, src_size);
+                if (err != Z_OK || out_size != dst_size)
+                        throw format_error("corrupt zlib-compressed section");
+                return;
+#else
+                break;
+#endif
+        }
+
+        case elfcompress::zstd: {
+#ifdef ELFPP_HAVE_ZSTD
+                size_t out_size = ZSTD_decompress(dst, dst_size, src, src_size);
+                if (ZSTD_isError(out_size) || out_size != dst_size)
+                        throw format_error("corrupt zstd-compressed section");
+                return;
+#else
+                break;
+#endif
+        }
+
+        default:
+                break;
+        }
+        throw format_error("unsupported section compression type " +
+                           to_string(type));
+}
+
+shared_ptr<const void>
+section::decompressed_data(size_t *size_out) const
+{
+        if (!is_compressed()) {
+                *size_out = size();
+                // Share ownership of the loader, which owns the data
+                return shared_ptr<const void>(m->f.get_loader(), data());
+        }
+
+        elf::impl &fm = *m->f.m;
+        {
+                lock_guard<mutex> lock(fm.decompressed_lock);
+                for (auto it = fm.decompressed.begin();
+                     it != fm.decompressed.end(); ++it) {
+                        if (it->offset == m->hdr.offset) {
+                                fm.decompressed.splice(
+                                        fm.decompressed.begin(),
+                                        fm.decompressed, it);
+                                fm.count_stat(elf_counter::decompression_cache_hits);
+                                *size_out = it->size;
+                                return it->data;
+                        }
+                }
+        }
+
+        // Decode the compression header.  Decompression happens
+        // without the cache lock so unrelated sections don't
+        // serialize.
+        const char *src = (const char*)data();
+        size_t src_size = size();
+        elfcompress type;
+        size_t out_size;
+        if ((m->hdr.flags & shf::compressed) == shf::compressed) {
+                auto &ehdr = m->f.get_hdr();
+                size_t chdr_size = (ehdr.ei_class == elfclass::_32 ?
+                                    sizeof(Chdr<Elf32>) : sizeof(Chdr<Elf64>));
+                if (src_size < chdr_size)
+                        throw format_error("compressed section is truncated");
+                Chdr<> chdr{};
+                canon_hdr(&chdr, src, ehdr.ei_class, ehdr.ei_data);
+                type = chdr.type;
+                out_size = chdr.size;
+                src += chdr_size;
+                src_size -= chdr_size;
+        } else {
+                type = elfcompress::zlib;
+                uint64_t size_be;
+                memcpy(&size_be, src + sizeof zdebug_magic, sizeof size_be);
+                out_size = swizzle(size_be, byte_order::msb,
+                                   byte_order::native);
+                src += zdebug_hdr_size;
+                src_size -= zdebug_hdr_size;
+        }
+
+        // Check the header before trusting its size
+        if (!compression_supported(type))
+                throw format_error("unsupported section compression type " +
+                                   to_string(type));
+        if (out_size > max_decompressed_size(type, src_size))
+                throw format_error("compressed section claims implausible "
+                                   "decompressed size " +
+                                   std::to_string(out_size));
+
+        shared_ptr<char> buf(new char[out_size], default_delete<char[]>());
+        if (fm.stats_on()) {
+                auto start = chrono::steady_clock::now();
+                decompress(type, src, src_size, buf.get(), out_size);
+                fm.count_stat(elf_counter::decompression_ns,
+                              chrono::duration_cast<chrono::nanoseconds>(
+                                      chrono::steady_clock::now() - start).count());
+                fm.count_stat(elf_counter::decompressions);
+                fm.count_stat(elf_counter::compressed_bytes, src_size);
+                fm.count_stat(elf_counter::decompressed_bytes, out_size);
+        } else {
+                decompress(type, src, src_size, buf.get(), out_size);
+        }
+        *size_out = out_size;
+
+        lock_guard<mutex> lock(fm.decompressed_lock);
+        for (auto &ent : fm.decompressed)
+                if (ent.offset == m->hdr.offset)
+                        // Lost a race with another decompression
+                        return ent.data;
+        if (out_size > fm.decompressed_limit)
+                return buf;
+        while (fm.decompressed_bytes + out_size > fm.decompressed_limit) {
+                fm.decompressed_bytes -= fm.decompressed.back().size;
+                fm.decompressed.pop_back();
+        }
+        fm.decompressed.push_front({m->hdr.offset, buf, out_size});
+        fm.decompressed_bytes += out_size;
+        return buf;
+}
+
 strtab
 section::as_strtab() const
 {
@@ -366,13 +837,270 @@ sym::get_name() const
 struct symtab::impl
 {
         impl(const elf &f, const char *data, const char *end, strtab strs)
-                : f(f), data(data), end(end), strs(strs) { }
+                : f(f), data(data), end(end), strs(strs),
+                  ei_class(f.get_hdr().ei_class), ei_data(f.get_hdr().ei_data)
+        {
+                stride = (ei_class == elfclass::_32 ?
+                          sizeof(Sym<Elf32>) : sizeof(Sym<Elf64>));
+                nsyms = (end - data) / stride;
+        }
 
         const elf f;
         const char *data, *end;
         const strtab strs;
+        elfclass ei_class;
+        elfdata ei_data;
+        size_t stride, nsyms;
+
+        // Address index: the defined function and object symbols with
+        // a non-zero size, sorted by value.  max_end[i] is the
+        // greatest value+size of addrs[0..i], which bounds how far
+        // back find_address has to search for an enclosing symbol.
+        struct addr_entry
+        {
+                Elf64::Addr value;
+                Elf64::Xword size;
+                uint32_t index;
+        };
+        vector<addr_entry> addrs;
+        vector<Elf64::Addr> max_end;
+        once_flag addrs_once;
+
+        // Name index.  If this symbol table has a .gnu.hash or .hash
+        // section, this points directly at its data.  Otherwise,
+        // name_slots is an open-addressed table of symbol indexes
+        // built from the symbol table (empty slots are ~0).
+        enum class hash_kind { none, gnu, sysv } hash_type;
+        const char *hash_data;
+        size_t hash_size;
+        vector<uint32_t> name_slots;
+        once_flag names_once;
+
+        Sym<> get_sym(size_t index) const
+        {
+                Sym<> out;
+                canon_hdr(&out, data + index * stride, ei_class, ei_data);
+                return out;
+        }
+
+        uint32_t word(size_t index) const
+        {
+                return swizzle(((const uint32_t*)hash_data)[index],
+                               ei_data == elfdata::lsb ?
+                               byte_order::lsb : byte_order::msb,
+                               byte_order::native);
+        }
+
+        void build_addrs();
+        void build_names();
+        bool name_matches(const Sym<> &sym, const char *name, size_t len) const;
+        size_t find_name(const char *name, size_t len);
 };
 
+// Return true if sym a is a better match for a name lookup than b,
+// preferring global over weak over local bindings.
+static bool
+better_sym(const Sym<> &a, const Sym<> &b)
+{
+        auto rank = [](stb bind) {
+                return bind == stb::global ? 0 : bind == stb::weak ? 1 : 2;
+        };
+        return rank(a.binding()) < rank(b.binding());
+}
+
+static uint32_t
+gnu_hash(const char *name, size_t len)
+{
+        uint32_t h = 5381;
+        for (size_t i = 0; i < len; i++)
+                h = h * 33 + (unsigned char)name[i];
+        return h;
+}
+
+static uint32_t
+sysv_hash(const char *name, size_t len)
+{
+        uint32_t h = 0, g;
+        for (size_t i = 0; i < len; i++) {
+                h = (h << 4) + (unsigned char)name[i];
+                if ((g = h & 0xf0000000))
+                        h ^= g >> 24;
+                h &= ~g;
+        }
+        return h;
+}
+
+void
+symtab::impl::build_addrs()
+{
+        for (size_t i = 0; i < nsyms; i++) {
+                Sym<> sym = get_sym(i);
+                if (sym.type() != stt::func && sym.type() != stt::object)
+                        continue;
+                if (sym.shnxd == shn::undef || sym.size == 0)
+                        continue;
+                addrs.push_back(addr_entry{sym.value, sym.size, (uint32_t)i});
+        }
+        // Among symbols at the same address, keep symbol table
+        // order so lookups are deterministic.
+        sort(addrs.begin(), addrs.end(),
+             [](const addr_entry &a, const addr_entry &b) {
+                     if (a.value != b.value)
+                             return a.value < b.value;
+                     return a.index > b.index;
+             });
+        addrs.shrink_to_fit();
+
+        max_end.resize(addrs.size());
+        Elf64::Addr end = 0;
+        for (size_t i = 0; i < addrs.size(); i++) {
+                end = max(end, addrs[i].value + addrs[i].size);
+                max_end[i] = end;
+        }
+}
+
+void
+symtab::impl::build_names()
+{
+        hash_type = hash_kind::none;
+
+        // Look for a hash section that is linked to this symbol
+        // table.  Prefer .gnu.hash, since it has shorter chains.
+        for (auto &sec : f.sections()) {
+                sht type = sec.get_hdr().type;
+                if (type != sht::gnu_hash && type != sht::hash)
+                        continue;
+                if (f.get_section(sec.get_hdr().link).data() != data)
+                        continue;
+                if (hash_type == hash_kind::gnu && type == sht::hash)
+                        continue;
+                hash_data = (const char*)sec.data();
+                hash_size = sec.size();
+                hash_type = type == sht::gnu_hash ? hash_kind::gnu :
+                        hash_kind::sysv;
+        }
+
+        // Validate the fixed parts of the table so lookups only have
+        // to check chain indexes
+        if (hash_type == hash_kind::sysv) {
+                if (hash_size < 8 ||
+                    hash_size / 4 < 2 + (size_t)word(0) + word(1))
+                        throw format_error(".hash section is truncated");
+        } else if (hash_type == hash_kind::gnu) {
+                size_t bloom_words = ei_class == elfclass::_32 ? 1 : 2;
+                if (hash_size < 16 ||
+                    hash_size / 4 < 4 + (size_t)bloom_words * word(2) + word(0))
+                        throw format_error(".gnu.hash section is truncated");
+                if (word(0) == 0)
+                        hash_type = hash_kind::none;
+        }
+        if (hash_type != hash_kind::none)
+                return;
+
+        size_t nslots = 8;
+        while (nslots < 2 * nsyms)
+                nslots *= 2;
+        name_slots.assign(nslots, ~0u);
+        for (size_t i = 1; i < nsyms; i++) {
+                Sym<> sym = get_sym(i);
+                size_t len;
+                if (sym.shnxd == shn::undef)
+                        continue;
+                const char *name = strs.get(sym.name, &len);
+                if (len == 0)
+                        continue;
+                size_t slot = gnu_hash(name, len) & (nslots - 1);
+                for (; name_slots[slot] != ~0u; slot = (slot + 1) & (nslots - 1)) {
+                        Sym<> o = get_sym(name_slots[slot]);
+                        if (name_matches(o, name, len)) {
+                                if (better_sym(sym, o))
+                                        name_slots[slot] = i;
+                                break;
+                        }
+                }
+                if (name_slots[slot] == ~0u)
+                        name_slots[slot] = i;
+        }
+}
+
+bool
+symtab::impl::name_matches(const Sym<> &sym, const char *name, size_t len) const
+{
+        size_t symlen;
+        const char *symname = strs.get(sym.name, &symlen);
+        return symlen == len && memcmp(symname, name, len) == 0;
+}
+
+size_t
+symtab::impl::find_name(const char *name, size_t len)
+{
+        call_once(names_once, [&]() { build_names(); });
+
+        size_t best = 0;
+        Sym<> best_sym{};
+        auto consider = [&](size_t index) {
+                if (index >= nsyms)
+                        throw format_error("symbol hash chain index out of range");
+                Sym<> sym = get_sym(index);
+                // .gnu.hash omits undefined symbols, so skip them in
+                // .hash chains as well
+                if (sym.shnxd == shn::undef || !name_matches(sym, name, len))
+                        return;
+                if (best == 0 || better_sym(sym, best_sym)) {
+                        best = index;
+                        best_sym = sym;
+                }
+        };
+
+        switch (hash_type) {
+        case hash_kind::sysv: {
+                uint32_t nbucket = word(0), nchain = word(1);
+                if (nbucket == 0)
+                        break;
+                uint32_t h = sysv_hash(name, len);
+                size_t steps = 0;
+                for (uint32_t i = word(2 + h % nbucket); i != 0;
+                     i = word(2 + nbucket + i)) {
+                        if (i >= nchain || ++steps > nchain)
+                                throw format_error("bad .hash chain");
+                        consider(i);
+                }
+                break;
+        }
+
+        case hash_kind::gnu: {
+                uint32_t nbucket = word(0), symoffset = word(1);
+                size_t bloom_words = (ei_class == elfclass::_32 ? 1 : 2) * word(2);
+                size_t buckets = 4 + bloom_words, chains = buckets + nbucket;
+                uint32_t h = gnu_hash(name, len);
+                uint32_t i = word(buckets + h % nbucket);
+                if (i < symoffset)
+                        break;
+                for (;; i++) {
+                        if (chains + (i - symoffset) >= hash_size / 4)
+                                throw format_error("bad .gnu.hash chain");
+                        uint32_t h2 = word(chains + (i - symoffset));
+                        if ((h | 1) == (h2 | 1))
+                                consider(i);
+                        if (h2 & 1)
+                                break;
+                }
+                break;
+        }
+
+        case hash_kind::none: {
+                size_t nslots = name_slots.size();
+                size_t slot = gnu_hash(name, len) & (nslots - 1);
+                for (; name_slots[slot] != ~0u; slot = (slot + 1) & (nslots - 1)) {
+                        if (name_matches(get_sym(name_slots[slot]), name, len))
+                                return name_slots[slot];
+                }
+                break;
+        }
+        }
+        return best;
+}
+
 symtab::symtab(elf f, const void *data, size_t size, strtab strs)
         : m(make_shared<impl>(f, (const char*)data, (const char *)data + size,
                               strs))
@@ -380,12 +1108,8 @@ symtab::symtab(elf f, const void *data, size_t size, strtab strs)
 }
 
 symtab::iterator::iterator(const symtab &tab, const char *pos)
-        : f(tab.m->f), strs(tab.m->strs), pos(pos)
+        : f(tab.m->f), strs(tab.m->strs), pos(pos), stride(tab.m->stride)
 {
-        if (f.get_hdr().ei_class == elfclass::_32)
-                stride = sizeof(Sym<Elf32>);
-        else
-                stride = sizeof(Sym<Elf64>);
 }
 
 symtab::iterator
@@ -400,4 +1124,43 @@ symtab::end() const
         return iterator(*this, m->end);
 }
 
+symtab::iterator
+symtab::find_address(Elf64::Addr addr) const
+{
+        call_once(m->addrs_once, [&]() { m->build_addrs(); });
+
+        // Find the last symbol starting at or before addr, then walk
+        // back over symbols that could still enclose addr.
+        auto it = upper_bound(m->addrs.begin(), m->addrs.end(), addr,
+                              [](Elf64::Addr addr, const impl::addr_entry &e) {
+                                      return addr < e.value;
+                              });
+        for (size_t i = it - m->addrs.begin(); i > 0; i--) {
+                if (m->max_end[i - 1] <= addr)
+                        break;
+                const impl::addr_entry &e = m->addrs[i - 1];
+                if (addr - e.value < e.size)
+                        return iterator(*this, m->data + e.index * m->stride);
+        }
+        return end();
+}
+
+symtab::iterator
+symtab::find_name(const char *name) const
+{
+        size_t index = m->find_name(name, strlen(name));
+        if (index == 0)
+                return end();
+        return iterator(*this, m->data + index * m->stride);
+}
+
+symtab::iterator
+symtab::find_name(const std::string &name) const
+{
+        size_t index = m->find_name(name.data(), name.size());
+        if (index == 0)
+                return end();
+        return iterator(*this, m->data + index * m->stride);
+}
+
 ELFPP_END_NAMESPACE
@@ -22,8 +22,19 @@ class mmap_loader : public loader
         void *base;
         size_t lim;
 
+        // Round [offset, offset+size) out to page boundaries for
+        // madvise.
+        void page_range(off_t offset, size_t size, char **start, size_t *len)
+        {
+                static const size_t page = sysconf(_SC_PAGESIZE);
+                size_t s = offset - offset % page;
+                size_t e = min(lim, offset + size);
+                *start = (char*)base + s;
+                *len = e > s ? e - s : 0;
+        }
+
 public:
-        mmap_loader(int fd)
+        mmap_loader(int fd, access_advice advice)
         {
                 off_t end = lseek(fd, 0, SEEK_END);
                 if (end == (off_t)-1)
@@ -36,6 +47,9 @@ public:
                         throw system_error(errno, system_category(),
                                            "mmap'ing file");
                 close(fd);
+
+                if (advice != access_advice::normal)
+                        this->advise(0, lim, advice);
         }
 
         ~mmap_loader()
@@ -49,12 +63,62 @@ public:
                         throw range_error("offset exceeds file size");
                 return (const char*)base + offset;
         }
+
+        void advise(off_t offset, size_t size, access_advice advice)
+        {
+                char *start;
+                size_t len;
+                page_range(offset, size, &start, &len);
+                if (len == 0)
+                        return;
+                // These are only hints, so ignore failures
+                switch (advice) {
+                case access_advice::normal:
+                        madvise(start, len, MADV_NORMAL);
+                        break;
+                case access_advice::sequential:
+                        madvise(start, len, MADV_SEQUENTIAL);
+                        break;
+                case access_advice::random:
+                        madvise(start, len, MADV_RANDOM);
+                        break;
+                case access_advice::willneed:
+                        madvise(start, len, MADV_WILLNEED);
+                        break;
+                case access_advice::populate:
+#ifdef MADV_POPULATE_READ
+                        if (madvise(start, len, MADV_POPULATE_READ) == 0)
+                                break;
+#endif
+                        madvise(start, len, MADV_WILLNEED);
+                        break;
+                }
+        }
+
+        void release(off_t offset, size_t size)
+        {
+                // The mapping is read-only and file-backed, so this
+                // only drops the pages from our RSS.  Pointers stay
+                // valid, and touching them again faults the pages
+                // back in from the file.
+                char *start;
+                size_t len;
+                page_range(offset, size, &start, &len);
+                if (len)
+                        madvise(start, len, MADV_DONTNEED);
+        }
 };
 
 std::shared_ptr<loader>
 create_mmap_loader(int fd)
 {
-        return make_shared<mmap_loader>(fd);
+        return make_shared<mmap_loader>(fd, access_advice::normal);
+}
+
+std::shared_ptr<loader>
+create_mmap_loader(int fd, access_advice advice)
+{
+        return make_shared<mmap_loader>(fd, advice);
 }
 
 ELFPP_END_NAMESPACE
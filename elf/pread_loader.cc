@@ -0,0 +1,206 @@
+// Copyright (c) 2013 Austin T. Clements. All rights reserved.
+// Use of this source code is governed by an MIT license
+// that can be found in the LICENSE file.
+
+#include "elf++.hh"
+
+#include <list>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <system_error>
+
+#include <sys/types.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+using namespace std;
+
+ELFPP_BEGIN_NAMESPACE
+
+class pread_loader : public loader
+{
+        // A page-aligned range of the file read into memory.  An
+        // extent is pinned while it has outstanding loads; unpinned
+        // extents stay cached (most recently released first) until
+        // they exceed cache_limit.
+        struct extent
+        {
+                off_t offset;
+                size_t size;
+                unique_ptr<char[]> data;
+                unsigned refs;
+        };
+
+        int fd;
+        off_t lim;
+        size_t page_size, cache_limit;
+
+        mutex lock;
+        list<extent> pinned, unpinned;
+        size_t unpinned_bytes;
+
+        // Outstanding loads by (offset, size), so release drops the
+        // reference on the same extent load took it on even if
+        // extents overlap.  Each value is the extent and the number
+        // of loads of that range.
+        map<pair<off_t, size_t>, pair<list<extent>::iterator, unsigned> > loads;
+
+        static bool contains(const extent &e, off_t offset, size_t size)
+        {
+                return e.offset <= offset &&
+                        (size_t)(offset - e.offset) + size <= e.size;
+        }
+
+        void read_extent(extent *e)
+        {
+                e->data.reset(new char[e->size]);
+                size_t pos = 0;
+                while (pos < e->size) {
+                        ssize_t n = ::pread(fd, e->data.get() + pos,
+                                            e->size - pos, e->offset + pos);
+                        if (n < 0 && errno == EINTR)
+                                continue;
+                        if (n < 0)
+                                throw system_error(errno, system_category(),
+                                                   "reading file");
+                        if (n == 0)
+                                throw range_error("unexpected end of file");
+                        pos += n;
+                }
+        }
+
+        // Find or read the extent covering [offset, offset+size),
+        // move it to the pinned list, and return it.  lock must be
+        // held.
+        list<extent>::iterator acquire(off_t offset, size_t size)
+        {
+                for (auto it = pinned.begin(); it != pinned.end(); ++it)
+                        if (contains(*it, offset, size))
+                                return it;
+                for (auto it = unpinned.begin(); it != unpinned.end(); ++it) {
+                        if (contains(*it, offset, size)) {
+                                unpinned_bytes -= it->size;
+                                pinned.splice(pinned.begin(), unpinned, it);
+                                return it;
+                        }
+                }
+
+                off_t start = offset - offset % page_size;
+                off_t end = offset + size;
+                end = end + (page_size - end % page_size) % page_size;
+                if (end > lim)
+                        end = lim;
+                pinned.push_front(extent{start, (size_t)(end - start),
+                                         nullptr, 0});
+                try {
+                        read_extent(&pinned.front());
+                } catch (...) {
+                        pinned.pop_front();
+                        throw;
+                }
+                return pinned.begin();
+        }
+
+        // Move an extent with no outstanding loads to the unpinned
+        // list, evicting older extents past the cache limit.  lock
+        // must be held.
+        void unpin(list<extent>::iterator it)
+        {
+                unpinned_bytes += it->size;
+                unpinned.splice(unpinned.begin(), pinned, it);
+                while (unpinned_bytes > cache_limit) {
+                        unpinned_bytes -= unpinned.back().size;
+                        unpinned.pop_back();
+                }
+        }
+
+public:
+        pread_loader(int fd, size_t cache_limit, size_t page_size)
+                : fd(fd), page_size(page_size), cache_limit(cache_limit),
+                  unpinned_bytes(0)
+        {
+                lim = lseek(fd, 0, SEEK_END);
+                if (lim == (off_t)-1) {
+                        int err = errno;
+                        close(fd);
+                        throw system_error(err, system_category(),
+                                           "finding file length");
+                }
+                if (this->page_size == 0)
+                        this->page_size = 64 << 10;
+        }
+
+        ~pread_loader()
+        {
+                close(fd);
+        }
+
+        const void *load(off_t offset, size_t size)
+        {
+                if (offset < 0 || offset + size > (size_t)lim)
+                        throw range_error("offset exceeds file size");
+                lock_guard<mutex> guard(lock);
+                auto ld = loads.find(make_pair(offset, size));
+                if (ld == loads.end()) {
+                        auto it = acquire(offset, size);
+                        ld = loads.insert(make_pair(make_pair(offset, size),
+                                                    make_pair(it, 0u))).first;
+                }
+                auto it = ld->second.first;
+                ld->second.second++;
+                it->refs++;
+                return it->data.get() + (offset - it->offset);
+        }
+
+        void advise(off_t offset, size_t size, access_advice advice)
+        {
+                if (offset < 0 || offset + size > (size_t)lim)
+                        return;
+                switch (advice) {
+                case access_advice::normal:
+                        posix_fadvise(fd, offset, size, POSIX_FADV_NORMAL);
+                        break;
+                case access_advice::sequential:
+                        posix_fadvise(fd, offset, size, POSIX_FADV_SEQUENTIAL);
+                        break;
+                case access_advice::random:
+                        posix_fadvise(fd, offset, size, POSIX_FADV_RANDOM);
+                        break;
+                case access_advice::willneed:
+                        posix_fadvise(fd, offset, size, POSIX_FADV_WILLNEED);
+                        break;
+                case access_advice::populate: {
+                        // Read the range into the cache now, but
+                        // don't pin it
+                        lock_guard<mutex> guard(lock);
+                        auto it = acquire(offset, size);
+                        if (it->refs == 0)
+                                unpin(it);
+                        break;
+                }
+                }
+        }
+
+        void release(off_t offset, size_t size)
+        {
+                lock_guard<mutex> guard(lock);
+                auto ld = loads.find(make_pair(offset, size));
+                if (ld == loads.end())
+                        return;
+                auto it = ld->second.first;
+                if (--ld->second.second == 0)
+                        loads.erase(ld);
+                if (--it->refs == 0)
+                        unpin(it);
+        }
+};
+
+std::shared_ptr<loader>
+create_pread_loader(int fd, size_t cache_limit, size_t page_size)
+{
+        return make_shared<pread_loader>(fd, cache_limit, page_size);
+}
+
+ELFPP_END_NAMESPACE
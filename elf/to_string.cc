@@ -1,4 +1,4 @@
-// Automatically generated by make at Sat Nov 29 03:46:27 PM EST 2025
+// Automatically generated by make at Wed Oct 14 05:09:29 UTC 2026
 // DO NOT EDIT
 
 #include "data.hh"
@@ -71,6 +71,7 @@ to_string(sht v)
         case sht::shlib: return "shlib";
         case sht::dynsym: return "dynsym";
         case sht::loos: break;
+        case sht::gnu_hash: return "gnu_hash";
         case sht::hios: break;
         case sht::loproc: break;
         case sht::hiproc: break;
@@ -85,6 +86,7 @@ to_string(shf v)
         if ((v & shf::write) == shf::write) { res += "write|"; v &= ~shf::write; }
         if ((v & shf::alloc) == shf::alloc) { res += "alloc|"; v &= ~shf::alloc; }
         if ((v & shf::execinstr) == shf::execinstr) { res += "execinstr|"; v &= ~shf::execinstr; }
+        if ((v & shf::compressed) == shf::compressed) { res += "compressed|"; v &= ~shf::compressed; }
         if ((v & shf::maskos) == shf::maskos) { res += "maskos|"; v &= ~shf::maskos; }
         if ((v & shf::maskproc) == shf::maskproc) { res += "maskproc|"; v &= ~shf::maskproc; }
         if (res.empty() || v != (shf)0) res += "(shf)0x" + to_hex((int)v);
@@ -92,6 +94,20 @@ to_string(shf v)
         return res;
 }
 
+std::string
+to_string(elfcompress v)
+{
+        switch (v) {
+        case elfcompress::zlib: return "zlib";
+        case elfcompress::zstd: return "zstd";
+        case elfcompress::loos: break;
+        case elfcompress::hios: break;
+        case elfcompress::loproc: break;
+        case elfcompress::hiproc: break;
+        }
+        return "(elfcompress)0x" + to_hex((int)v);
+}
+
 std::string
 to_string(pt v)
 {
@@ -0,0 +1,114 @@
+#include "elf++.hh"
+#include "dwarf++.hh"
+
+#include <algorithm>
+#include <errno.h>
+#include <fcntl.h>
+#include <inttypes.h>
+#include <string>
+#include <tuple>
+#include <vector>
+
+using namespace std;
+
+string
+rule_to_string(const dwarf::cfi_rule &rule)
+{
+        typedef dwarf::cfi_rule::type type;
+        char buf[64];
+        switch (rule.kind) {
+        case type::unspecified:
+                return "unspecified";
+        case type::undefined:
+                return "undefined";
+        case type::same_value:
+                return "same";
+        case type::offset:
+                snprintf(buf, sizeof buf, "[cfa%+" PRId64 "]", rule.offset);
+                return buf;
+        case type::val_offset:
+                snprintf(buf, sizeof buf, "cfa%+" PRId64, rule.offset);
+                return buf;
+        case type::reg:
+                snprintf(buf, sizeof buf, "r%u%+" PRId64, rule.reg,
+                         rule.offset);
+                return buf;
+        case type::expression:
+                snprintf(buf, sizeof buf, "[expr(%zu ops)]",
+                         rule.get_expr().compile().size());
+                return buf;
+        case type::val_expression:
+                snprintf(buf, sizeof buf, "expr(%zu ops)",
+                         rule.get_expr().compile().size());
+                return buf;
+        }
+        return "?";
+}
+
+void
+dump_row(const dwarf::cfi_row &row)
+{
+        printf("  %016" PRIx64 "-%016" PRIx64 " cfa=%s ra=r%u",
+               row.loc, row.end, rule_to_string(row.cfa).c_str(),
+               row.return_address_register);
+        if (row.signal_frame)
+                printf(" signal");
+        auto &rules = row.rules();
+        for (size_t i = 0; i < rules.size(); i++)
+                printf(" r%u=%s", rules[i].regnum,
+                       rule_to_string(rules[i].rule).c_str());
+        printf("\n");
+}
+
+int
+main(int argc, char **argv)
+{
+        if (argc != 2) {
+                fprintf(stderr, "usage: %s elf-file\n", argv[0]);
+                return 2;
+        }
+
+        int fd = open(argv[1], O_RDONLY);
+        if (fd < 0) {
+                fprintf(stderr, "%s: %s\n", argv[1], strerror(errno));
+                return 1;
+        }
+
+        elf::elf ef(elf::create_mmap_loader(fd));
+        dwarf::dwarf dw(dwarf::elf::create_loader(ef, argv[1]));
+
+        // Look up the rows covering each function in the symbol
+        // table, in address order
+        vector<tuple<elf::Elf64::Addr, elf::Elf64::Xword, string> > funcs;
+        for (auto &sec : ef.sections()) {
+                if (sec.get_hdr().type != elf::sht::symtab)
+                        continue;
+                for (auto sym : sec.as_symtab()) {
+                        auto &d = sym.get_data();
+                        if (d.type() == elf::stt::func && d.size)
+                                funcs.emplace_back(d.value, d.size,
+                                                   sym.get_name());
+                }
+        }
+        sort(funcs.begin(), funcs.end());
+
+        const dwarf::cfi &frames = dw.get_cfi();
+        for (auto &fn : funcs) {
+                dwarf::taddr pc = get<0>(fn), end = pc + get<1>(fn);
+                printf("--- %s %016" PRIx64 "-%016" PRIx64 "\n",
+                       get<2>(fn).c_str(), pc, end);
+                dwarf::cfi_row row;
+                while (pc < end) {
+                        if (!frames.find_row(pc, &row)) {
+                                printf("  %016" PRIx64 " no FDE\n", pc);
+                                break;
+                        }
+                        dump_row(row);
+                        if (row.end <= pc)
+                                break;
+                        pc = row.end;
+                }
+        }
+
+        return 0;
+}
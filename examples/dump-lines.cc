@@ -14,7 +14,7 @@ dump_line_table(const dwarf::line_table &lt)
                 if (line.end_sequence)
                         printf("\n");
                 else
-                        printf("%-40s%8d%#20" PRIx64 "\n", line.file->path.c_str(),
+                        printf("%-40s%8d%#20" PRIx64 "\n", line.file->path().c_str(),
                                line.line, line.address);
         }
 }
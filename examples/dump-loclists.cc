@@ -0,0 +1,89 @@
+#include "elf++.hh"
+#include "dwarf++.hh"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <inttypes.h>
+
+using namespace std;
+
+// Registers read as zero, so register-relative locations print as
+// their offsets
+class zero_regs : public dwarf::expr_context
+{
+public:
+        dwarf::taddr reg(unsigned regnum)
+        {
+                return 0;
+        }
+};
+
+void
+dump_location(const dwarf::expr &loc)
+{
+        zero_regs ctx;
+        try {
+                dwarf::expr_result r = loc.evaluate(&ctx);
+                printf("%s 0x%" PRIx64 "\n",
+                       to_string(r.location_type).c_str(), r.value);
+        } catch (exception &e) {
+                printf("error: %s\n", e.what());
+        }
+}
+
+void
+dump_loclists(const dwarf::die &node)
+{
+        for (auto &attr : node.each_attribute()) {
+                if (attr.second.get_type() != dwarf::value::type::loclist)
+                        continue;
+                printf("<%" PRIx64 "> %s", node.get_section_offset(),
+                       to_string(node.tag).c_str());
+                if (node.has(dwarf::DW_AT::name))
+                        printf(" %s", at_name(node).c_str());
+                printf(" %s\n", to_string(attr.first).c_str());
+
+                dwarf::loclist list = attr.second.as_loclist();
+                for (auto &ent : list) {
+                        printf("      %016" PRIx64 "-%016" PRIx64 " ",
+                               ent.low, ent.high);
+                        dump_location(ent.location);
+                }
+                if (const dwarf::expr *def = list.get_default()) {
+                        printf("      default ");
+                        dump_location(*def);
+                }
+        }
+        for (auto &child : node)
+                dump_loclists(child);
+}
+
+int
+main(int argc, char **argv)
+{
+        if (argc != 2) {
+                fprintf(stderr, "usage: %s elf-file\n", argv[0]);
+                return 2;
+        }
+
+        int fd = open(argv[1], O_RDONLY);
+        if (fd < 0) {
+                fprintf(stderr, "%s: %s\n", argv[1], strerror(errno));
+                return 1;
+        }
+
+        elf::elf ef(elf::create_mmap_loader(fd));
+        dwarf::dwarf dw(dwarf::elf::create_loader(ef, argv[1]));
+
+        for (auto cu : dw.compilation_units()) {
+                printf("--- <%" PRIx64 ">\n", cu.get_section_offset());
+                dump_loclists(cu.root());
+                if (auto split = cu.get_split_unit()) {
+                        printf("--- split <%" PRIx64 ">\n",
+                               split->get_section_offset());
+                        dump_loclists(split->root());
+                }
+        }
+
+        return 0;
+}
@@ -13,7 +13,7 @@ dump_tree(const dwarf::die &node, int depth = 0)
         printf("%*.s<%" PRIx64 "> %s\n", depth, "",
                node.get_section_offset(),
                to_string(node.tag).c_str());
-        for (auto &attr : node.attributes())
+        for (auto &attr : node.each_attribute())
                 printf("%*.s      %s %s\n", depth, "",
                        to_string(attr.first).c_str(),
                        to_string(attr.second).c_str());
@@ -36,11 +36,16 @@ main(int argc, char **argv)
         }
 
         elf::elf ef(elf::create_mmap_loader(fd));
-        dwarf::dwarf dw(dwarf::elf::create_loader(ef));
+        dwarf::dwarf dw(dwarf::elf::create_loader(ef, argv[1]));
 
         for (auto cu : dw.compilation_units()) {
                 printf("--- <%" PRIx64 ">\n", cu.get_section_offset());
                 dump_tree(cu.root());
+                if (auto split = cu.get_split_unit()) {
+                        printf("--- split <%" PRIx64 ">\n",
+                               split->get_section_offset());
+                        dump_tree(split->root());
+                }
         }
 
         return 0;
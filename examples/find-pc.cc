@@ -11,46 +11,17 @@ using namespace std;
 void
 usage(const char *cmd) 
 {
-        fprintf(stderr, "usage: %s elf-file pc\n", cmd);
+        fprintf(stderr, "usage: %s elf-file pc...\n", cmd);
         exit(2);
 }
 
-bool
-find_pc(const dwarf::die &d, dwarf::taddr pc, vector<dwarf::die> *stack)
-{
-        using namespace dwarf;
-
-        // Scan children first to find most specific DIE
-        bool found = false;
-        for (auto &child : d) {
-                if ((found = find_pc(child, pc, stack)))
-                        break;
-        }
-        switch (d.tag) {
-        case DW_TAG::subprogram:
-        case DW_TAG::inlined_subroutine:
-                try {
-                        if (found || die_pc_range(d).contains(pc)) {
-                                found = true;
-                                stack->push_back(d);
-                        }
-                } catch (out_of_range &e) {
-                } catch (value_type_mismatch &e) {
-                }
-                break;
-        default:
-                break;
-        }
-        return found;
-}
-
 void
 dump_die(const dwarf::die &node)
 {
         printf("<%" PRIx64 "> %s\n",
                node.get_section_offset(),
                to_string(node.tag).c_str());
-        for (auto &attr : node.attributes())
+        for (auto &attr : node.each_attribute())
                 printf("      %s %s\n",
                        to_string(attr.first).c_str(),
                        to_string(attr.second).c_str());
@@ -59,16 +30,18 @@ dump_die(const dwarf::die &node)
 int
 main(int argc, char **argv)
 {
-        if (argc != 3)
+        if (argc < 3)
                 usage(argv[0]);
 
-        dwarf::taddr pc;
-        try {
-                pc = stoll(argv[2], nullptr, 0);
-        } catch (invalid_argument &e) {
-                usage(argv[0]);
-        } catch (out_of_range &e) {
-                usage(argv[0]);
+        vector<dwarf::taddr> pcs;
+        for (int i = 2; i < argc; i++) {
+                try {
+                        pcs.push_back(stoll(argv[i], nullptr, 0));
+                } catch (invalid_argument &e) {
+                        usage(argv[0]);
+                } catch (out_of_range &e) {
+                        usage(argv[0]);
+                }
         }
 
         int fd = open(argv[1], O_RDONLY);
@@ -78,35 +51,28 @@ main(int argc, char **argv)
         }
 
         elf::elf ef(elf::create_mmap_loader(fd));
-        dwarf::dwarf dw(dwarf::elf::create_loader(ef));
+        dwarf::dwarf dw(dwarf::elf::create_loader(ef, argv[1]));
+
+        // Map each PC to its CU, line, and enclosing functions
+        auto infos = dw.symbolize(pcs);
+        for (size_t i = 0; i < infos.size(); i++) {
+                const dwarf::pc_info &info = infos[i];
+                if (pcs.size() > 1)
+                        printf("== %s\n", argv[i + 2]);
+                if (!info.cu)
+                        continue;
 
-        // Find the CU containing pc
-        // XXX Use .debug_aranges
-        for (auto &cu : dw.compilation_units()) {
-                if (die_pc_range(cu.root()).contains(pc)) {
-                        // Map PC to a line
-                        auto &lt = cu.get_line_table();
-                        auto it = lt.find_address(pc);
-                        if (it == lt.end())
-                                printf("UNKNOWN\n");
-                        else
-                                printf("%s\n",
-                                       it->get_description().c_str());
+                if (info.has_line)
+                        printf("%s\n", info.line.get_description().c_str());
+                else
+                        printf("UNKNOWN\n");
 
-                        // Map PC to an object
-                        // XXX Index/helper/something for looking up PCs
-                        // XXX DW_AT_specification and DW_AT_abstract_origin
-                        vector<dwarf::die> stack;
-                        if (find_pc(cu.root(), pc, &stack)) {
-                                bool first = true;
-                                for (auto &d : stack) {
-                                        if (!first)
-                                                printf("\nInlined in:\n");
-                                        first = false;
-                                        dump_die(d);
-                                }
-                        }
-                        break;
+                bool first = true;
+                for (auto &d : info.frames()) {
+                        if (!first)
+                                printf("\nInlined in:\n");
+                        first = false;
+                        dump_die(d);
                 }
         }
 
@@ -0,0 +1,170 @@
+// Randomized tests of cursor's LEB128 and fixed-size decoders against
+// simple reference decoders.
+
+#include "../dwarf/internal.hh"
+
+#include <cstdio>
+#include <cstring>
+#include <random>
+
+using namespace std;
+using namespace dwarf;
+
+static int failures;
+
+static void
+check(bool ok, const char *what, const unsigned char *buf, size_t len)
+{
+        if (ok)
+                return;
+        if (++failures > 10)
+                return;
+        printf("FAIL %s:", what);
+        for (size_t i = 0; i < len; i++)
+                printf(" %02x", buf[i]);
+        printf("\n");
+}
+
+/**
+ * Decode a LEB128 value from the len bytes at p the way DWARF4
+ * appendix C describes.  Sets *used to the number of bytes read, and
+ * returns false if the value runs past the end of the buffer.
+ */
+static bool
+ref_leb128(const unsigned char *p, size_t len, bool is_signed,
+           uint64_t *out, size_t *used)
+{
+        uint64_t result = 0;
+        unsigned shift = 0;
+        for (size_t i = 0; i < len; i++) {
+                if (shift < 64)
+                        result |= (uint64_t)(p[i] & 0x7f) << shift;
+                shift += 7;
+                if (!(p[i] & 0x80)) {
+                        if (is_signed && shift < 64 && (p[i] & 0x40))
+                                result |= -((uint64_t)1 << shift);
+                        *out = result;
+                        *used = i + 1;
+                        return true;
+                }
+        }
+        return false;
+}
+
+template<typename T>
+static T
+ref_fixed(const unsigned char *p, byte_order ord)
+{
+        T val = 0;
+        for (size_t i = 0; i < sizeof(T); i++) {
+                size_t b = ord == byte_order::lsb ? sizeof(T) - 1 - i : i;
+                val = (T)((uint64_t)val << 8 | p[b]);
+        }
+        return val;
+}
+
+template<typename T>
+static void
+test_fixed(const shared_ptr<section> &sec, const unsigned char *buf,
+           size_t len)
+{
+        bool fits = len >= sizeof(T);
+        T expect = fits ? ref_fixed<T>(buf, sec->ord) : 0;
+
+        // Both the byte order dispatching and the explicit forms
+        cursor cur(sec);
+        try {
+                T val = cur.fixed<T>();
+                check(fits && val == expect &&
+                      cur.get_section_offset() == sizeof(T),
+                      "fixed", buf, len);
+        } catch (underflow_error &e) {
+                check(!fits, "fixed underflow", buf, len);
+        }
+
+        cursor cur2(sec);
+        try {
+                T val = sec->ord == byte_order::lsb ?
+                        cur2.fixed<T, byte_order::lsb>() :
+                        cur2.fixed<T, byte_order::msb>();
+                check(fits && val == expect, "fixed<T, Ord>", buf, len);
+        } catch (underflow_error &e) {
+                check(!fits, "fixed<T, Ord> underflow", buf, len);
+        }
+}
+
+int
+main()
+{
+        mt19937_64 rng(1);
+        for (int iter = 0; iter < 200000; iter++) {
+                // Random bytes, with the continuation bit set often
+                // enough to produce long and unterminated values.
+                // Values of more than two bytes, or that reach the
+                // end of the buffer, take uleb128's slow path.
+                unsigned char buf[32];
+                size_t len = rng() % 24 + 1;
+                for (size_t i = 0; i < len; i++) {
+                        buf[i] = rng();
+                        if (rng() % 3 == 0)
+                                buf[i] |= 0x80;
+                        else if (rng() % 3 == 0)
+                                buf[i] &= 0x7f;
+                }
+                auto sec = make_shared<section>(
+                        section_type::info, buf, len,
+                        rng() % 2 ? byte_order::lsb : byte_order::msb);
+
+                uint64_t expect;
+                size_t used;
+                bool ok = ref_leb128(buf, len, false, &expect, &used);
+                cursor cur(sec);
+                try {
+                        uint64_t val = cur.uleb128();
+                        check(ok && val == expect &&
+                              cur.get_section_offset() == used,
+                              "uleb128", buf, len);
+                } catch (underflow_error &e) {
+                        check(!ok, "uleb128 underflow", buf, len);
+                }
+
+                ok = ref_leb128(buf, len, true, &expect, &used);
+                cursor cur2(sec);
+                try {
+                        int64_t val = cur2.sleb128();
+                        check(ok && (uint64_t)val == expect &&
+                              cur2.get_section_offset() == used,
+                              "sleb128", buf, len);
+                } catch (underflow_error &e) {
+                        check(!ok, "sleb128 underflow", buf, len);
+                }
+
+                unsigned n = rng() % 5;
+                size_t end = 0;
+                ok = true;
+                for (unsigned i = 0; ok && i < n; i++) {
+                        ok = ref_leb128(buf + end, len - end, false,
+                                        &expect, &used);
+                        end += used;
+                }
+                cursor cur3(sec);
+                try {
+                        cur3.skip_leb128(n);
+                        check(ok && cur3.get_section_offset() == end,
+                              "skip_leb128", buf, len);
+                } catch (underflow_error &e) {
+                        check(!ok, "skip_leb128 underflow", buf, len);
+                }
+
+                test_fixed<uint8_t>(sec, buf, len);
+                test_fixed<uint16_t>(sec, buf, len);
+                test_fixed<uint32_t>(sec, buf, len);
+                test_fixed<uint64_t>(sec, buf, len);
+        }
+
+        if (failures) {
+                printf("%d failure(s)\n", failures);
+                return 1;
+        }
+        return 0;
+}
@@ -0,0 +1,30 @@
+static int history[16];
+
+__attribute__((noinline)) static int
+record(int x)
+{
+        history[x & 15] += x;
+        return history[(x + 1) & 15];
+}
+
+__attribute__((noinline)) int
+fib(int x)
+{
+        if (x <= 1)
+                return x;
+        int a = fib(x - 1);
+        if (a > 100) {
+                int b = record(a);
+                return a + b;
+        }
+        return a + fib(x - 2) * record(x);
+}
+
+int
+main(int argc, char **argv)
+{
+        int total = 0;
+        for (int i = 0; i < argc; i++)
+                total += fib(argv[i][0] & 15);
+        return total;
+}
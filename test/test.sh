@@ -5,25 +5,44 @@ die() {
     exit 1
 }
 
-(cd ../examples && make --quiet) || die "failed to build examples"
+# EXAMPLES names a directory of already-built examples, such as the
+# examples directory of a CMake build.  Otherwise, build them here.
+if [[ -z $EXAMPLES ]]; then
+    EXAMPLES=../examples
+    (cd $EXAMPLES && make --quiet) || die "failed to build examples"
+fi
 
-dumps="sections segments lines syms tree"
+dumps="cfi sections segments lines loclists syms tree find-pc"
 binaries=example
-compilers="gcc-4.9.2 gcc-6.2.1-s390x"
+compilers="gcc-4.9.2 gcc-6.2.1-s390x gcc-12.2.0-dwarf4 gcc-12.2.0-dwarf5"
 
 if [[ $1 == --make-golden ]]; then
     MODE=make-golden
 fi
 
+# Run the example program $prog on golden-$compiler/$binary.  find-pc
+# looks up the PCs listed in golden-$compiler/pcs.
+run() {
+    if [[ $prog == find-pc ]]; then
+        $EXAMPLES/find-pc golden-$compiler/$binary $(cat golden-$compiler/pcs)
+    else
+        $EXAMPLES/$prog golden-$compiler/$binary
+    fi
+}
+
 output=$(mktemp --tmpdir libelfin.XXXXXXXXXX)
 trap "rm -f $output $output.out" EXIT
 
 FAILED=0
 for dump in $dumps; do
+    prog=dump-$dump
+    if [[ $dump == find-pc ]]; then
+        prog=find-pc
+    fi
     for binary in $binaries; do
         for compiler in $compilers; do
             if [[ $MODE == make-golden ]]; then
-                ../examples/dump-$dump golden-$compiler/$binary > golden-$compiler/$dump || \
+                run > golden-$compiler/$dump || \
                     die "failed to create golden output"
                 continue
             fi
@@ -34,7 +53,7 @@ for dump in $dumps; do
             exec 3>&1 4>&2 1>$output 2>&1
 
             # Run the test.
-            ../examples/dump-$dump golden-$compiler/$binary >& $output.out
+            run >& $output.out
             STATUS=$?
             if [[ $STATUS != 0 ]]; then
                 PASS=0
@@ -54,7 +73,7 @@ for dump in $dumps; do
             else
                 echo -n "PASS "
             fi
-            echo dump-$dump golden-$compiler/$binary
+            echo $prog golden-$compiler/$binary
 
             if [[ $PASS == 0 ]]; then
                 sed 's/^/\t/' $output